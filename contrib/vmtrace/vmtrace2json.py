@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+#
+# vmtrace2json.py: Convert the trace segments of -record-log-opcodes to the
+# JSON of the former vmExecLogs.json.
+#
+# Copyright (c) 2019 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#
+
+import argparse
+import io
+import json
+import os
+import re
+import struct
+import sys
+
+MAGIC = b'mrxt'
+VERSION = 1
+
+def read_compact_size(f):
+    n = struct.unpack('<B', f.read(1))[0]
+    if n == 253:
+        n = struct.unpack('<H', f.read(2))[0]
+    elif n == 254:
+        n = struct.unpack('<I', f.read(4))[0]
+    elif n == 255:
+        n = struct.unpack('<Q', f.read(8))[0]
+    return n
+
+def read_record(f):
+    txid = f.read(32)[::-1]
+    blockhash = f.read(32)[::-1]
+    height, time = struct.unpack('<iq', f.read(12))
+    record = {}
+    if any(txid):
+        record['txid'] = txid.hex()
+    record['address'] = f.read(20).hex()
+    record['time'] = time
+    if any(blockhash):
+        record['blockhash'] = blockhash.hex()
+    record['blockheight'] = height
+    entries = []
+    for i in range(read_compact_size(f)):
+        address = f.read(20).hex()
+        topics = [{'raw': f.read(32).hex()} for j in range(read_compact_size(f))]
+        data = f.read(read_compact_size(f)).hex()
+        entries.append({'address': address, 'data': {'raw': data}, 'topics': topics})
+    record['entries'] = entries
+    return height, record
+
+def read_segment(path, offset):
+    """Yield the (height, record) of a segment, starting at offset when it is not 0."""
+    with open(path, 'rb') as f:
+        if f.read(4) != MAGIC or struct.unpack('<I', f.read(4))[0] != VERSION:
+            raise ValueError('%s is not a trace segment' % path)
+        if offset:
+            f.seek(offset)
+        while True:
+            size = f.read(4)
+            if len(size) < 4:
+                break
+            body = f.read(struct.unpack('<I', size)[0])
+            yield read_record(io.BytesIO(body))
+
+def find_height(directory, height):
+    """The segment and offset of the first record at height or above, from index.dat."""
+    with open(os.path.join(directory, 'index.dat'), 'rb') as f:
+        while True:
+            entry = f.read(12)
+            if len(entry) < 12:
+                return None
+            entry_height, segment, offset = struct.unpack('<iII', entry)
+            if entry_height >= height and os.path.exists(segment_path(directory, segment)):
+                return segment, offset
+
+def segment_path(directory, segment):
+    return os.path.join(directory, 'vmtrace%05u.dat' % segment)
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('directory', help='vmtrace directory in the data directory')
+    parser.add_argument('--from-height', type=int, default=0, help='skip the records below this height')
+    parser.add_argument('-o', '--output', help='output file (default: stdout)')
+    args = parser.parse_args()
+
+    segments = sorted(int(m.group(1)) for m in (re.match(r'vmtrace(\d{5})\.dat$', name) for name in os.listdir(args.directory)) if m)
+    start = (segments[0], 0) if segments else None
+    if args.from_height > 0:
+        start = find_height(args.directory, args.from_height)
+
+    out = open(args.output, 'w', encoding='utf8') if args.output else sys.stdout
+    out.write('{"logs":[')
+    first = True
+    if start is not None:
+        for segment in (s for s in segments if s >= start[0]):
+            offset = start[1] if segment == start[0] else 0
+            for height, record in read_segment(segment_path(args.directory, segment), offset):
+                if height < args.from_height:
+                    continue
+                if not first:
+                    out.write(',')
+                out.write(json.dumps(record, separators=(',', ':')))
+                first = False
+    out.write(']}')
+    if args.output:
+        out.close()
+
+if __name__ == '__main__':
+    main()
@@ -51,4 +51,56 @@ static void AssembleBlock(benchmark::State& state)
     }
 }
 
+// Chains of txs spending each other, as sent by bots calling contracts. The
+// children pay more than their parents, so the packages are picked from the
+// tips of the chains and the scores of the rest of the chain are updated for
+// every package added to the block.
+static void AssembleBlockChains(benchmark::State& state)
+{
+    const std::vector<unsigned char> op_true{OP_TRUE};
+    CScriptWitness witness;
+    witness.stack.push_back(op_true);
+
+    uint256 witness_program;
+    CSHA256().Write(&op_true[0], op_true.size()).Finalize(witness_program.begin());
+
+    const CScript SCRIPT_PUB{CScript(OP_0) << std::vector<unsigned char>{witness_program.begin(), witness_program.end()}};
+
+    constexpr size_t NUM_CHAINS{50};
+    constexpr int CHAIN_LENGTH{DEFAULT_ANCESTOR_LIMIT - 1};
+    std::vector<CTxIn> coinbases;
+    for (size_t b{0}; b < COINBASE_MATURITY + NUM_CHAINS; ++b) {
+        CTxIn in{MineBlock(SCRIPT_PUB)};
+        if (b < NUM_CHAINS)
+            coinbases.push_back(in);
+    }
+    {
+        LOCK(::cs_main); // Required for ::AcceptToMemoryPool.
+
+        for (const CTxIn& coinbase : coinbases) {
+            CTxIn in{coinbase};
+            CAmount nValue{::ChainstateActive().CoinsTip().AccessCoin(in.prevout).out.nValue};
+            const CAmount nFeeStep{nValue / (2 * CHAIN_LENGTH * CHAIN_LENGTH)};
+            for (int i{0}; i < CHAIN_LENGTH; ++i) {
+                CMutableTransaction tx;
+                tx.vin.push_back(in);
+                tx.vin.back().scriptWitness = witness;
+                nValue -= nFeeStep * (i + 1);
+                tx.vout.emplace_back(nValue, SCRIPT_PUB);
+                CTransactionRef txr{MakeTransactionRef(tx)};
+                in = CTxIn{txr->GetHash(), 0};
+
+                CValidationState state;
+                bool ret{::AcceptToMemoryPool(::mempool, state, txr, nullptr /* pfMissingInputs */, nullptr /* plTxnReplaced */, false /* bypass_limits */, /* nAbsurdFee */ 0)};
+                assert(ret);
+            }
+        }
+    }
+
+    while (state.KeepRunning()) {
+        PrepareBlock(SCRIPT_PUB);
+    }
+}
+
 BENCHMARK(AssembleBlock, 700);
+BENCHMARK(AssembleBlockChains, 100);
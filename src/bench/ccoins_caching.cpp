@@ -53,8 +53,9 @@ SetupDummyInputs(FillableSigningProvider& keystoreRet, CCoinsViewCache& coinsRet
 // characteristics than e.g. reindex timings. But that's not a requirement of
 // every benchmark."
 // (https://github.com/bitcoin/bitcoin/issues/7883#issuecomment-224807484)
-static void CCoinsCaching(benchmark::State& state)
+static void CCoinsCachingBackend(benchmark::State& state, CoinsCacheBackend backend)
 {
+    CCoinsMap::SetDefaultBackend(backend);
     FillableSigningProvider keystore;
     CCoinsView coinsDummy;
     CCoinsViewCache coins(&coinsDummy);
@@ -83,6 +84,18 @@ static void CCoinsCaching(benchmark::State& state)
         CAmount value = coins.GetValueIn(tx_1);
         assert(value == (50 + 21 + 22) * COIN);
     }
+    CCoinsMap::SetDefaultBackend(CoinsCacheBackend::NODE);
+}
+
+static void CCoinsCaching(benchmark::State& state)
+{
+    CCoinsCachingBackend(state, CoinsCacheBackend::NODE);
+}
+
+static void CCoinsCachingFlat(benchmark::State& state)
+{
+    CCoinsCachingBackend(state, CoinsCacheBackend::FLAT);
 }
 
 BENCHMARK(CCoinsCaching, 170 * 1000);
+BENCHMARK(CCoinsCachingFlat, 170 * 1000);
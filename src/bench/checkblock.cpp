@@ -6,9 +6,13 @@
 #include <bench/data.h>
 
 #include <chainparams.h>
+#include <key.h>
+#include <qtum/contractexecutor.h>
+#include <random.h>
 #include <validation.h>
 #include <streams.h>
 #include <consensus/validation.h>
+#include <script/standard.h>
 
 // These are the two major time-sinks which happen after we have fully received
 // a block off the wire, but before we can relay the block on to peers using
@@ -48,5 +52,61 @@ static void DeserializeAndCheckBlockTest(benchmark::State& state)
     }
 }
 
+// The connection of a block of contract txs: the signatures of the inputs of each tx are checked
+// and its contract is executed, one tx after the other or with the executions running on the
+// ContractExecutor thread while the next txs are checked, as ConnectBlock does with -pipelinedconnect.
+
+static const int CONTRACT_BLOCK_TXS = 50;
+
+// Deploy code counting down from 10000 before it stops
+static const std::vector<unsigned char> LOOP_CODE{0x61, 0x27, 0x10, 0x5b, 0x60, 0x01, 0x90, 0x03, 0x80, 0x60, 0x03, 0x57, 0x00};
+
+static void ConnectContractBlock(benchmark::State& state, bool fPipelined)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CPubKey pubkey = key.GetPubKey();
+    uint256 hash = GetRandHash();
+    std::vector<unsigned char> sig;
+    key.Sign(hash, sig);
+
+    QtumTransaction deploy(dev::u256(0), dev::u256(0), dev::u256(1000000), LOOP_CODE, dev::u256(0));
+    deploy.forceSender(dev::Address(1));
+    deploy.setVersion(VersionVM::GetEVMDefault());
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vout.push_back(CTxOut(0, GetScriptForDestination(PKHash(pubkey))));
+    CBlock block;
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+    CBlockIndex* tip = WITH_LOCK(cs_main, return ::ChainActive().Tip());
+
+    while (state.KeepRunning()) {
+        ContractExecutor executor(fPipelined);
+        for (int n = 0; n < CONTRACT_BLOCK_TXS; n++) {
+            std::shared_ptr<ByteCodeExec> exec = std::make_shared<ByteCodeExec>(block, std::vector<QtumTransaction>(1, deploy), 40000000, tip);
+            executor.push([exec]() { return exec->performByteCode(dev::eth::Permanence::Reverted); });
+            for (int in = 0; in < 4; in++) {
+                bool verified = pubkey.Verify(hash, sig);
+                assert(verified);
+            }
+        }
+        bool executed = executor.wait();
+        assert(executed);
+    }
+}
+
+static void ConnectContractBlockSerial(benchmark::State& state)
+{
+    ConnectContractBlock(state, false);
+}
+
+static void ConnectContractBlockPipelined(benchmark::State& state)
+{
+    ConnectContractBlock(state, true);
+}
+
 BENCHMARK(DeserializeBlockTest, 130);
 BENCHMARK(DeserializeAndCheckBlockTest, 160);
+BENCHMARK(ConnectContractBlockSerial, 5);
+BENCHMARK(ConnectContractBlockPipelined, 5);
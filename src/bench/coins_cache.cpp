@@ -0,0 +1,131 @@
+// Copyright (c) 2016-2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <arith_uint256.h>
+#include <coins.h>
+#include <random.h>
+#include <script/standard.h>
+
+#include <algorithm>
+#include <stdio.h>
+
+// Lookups in a cache of 1M coins, and an IBD-like replay through a block cache and a
+// tip cache kept under a fixed budget, for both backends of CCoinsMap. The time per
+// iteration of the lookup benchmarks is the time of one lookup. The replay benchmarks
+// print the coins held per GiB when the tip reaches its budget.
+
+static const uint32_t LOOKUP_COINS = 1000 * 1000;
+static const size_t REPLAY_BUDGET = 64 << 20;
+static const uint32_t REPLAY_BLOCK_COINS = 2000;
+//! Blocks between the creation of a coin and its spend
+static const uint32_t REPLAY_SPEND_DEPTH = 20;
+
+static COutPoint ReplayOutPoint(uint32_t nHeight, uint32_t n)
+{
+    return COutPoint(ArithToUint256(arith_uint256(nHeight) << 32 | arith_uint256(n)), 0);
+}
+
+static Coin ReplayCoin(uint32_t nHeight)
+{
+    return Coin(CTxOut(COIN, GetScriptForDestination(PKHash(uint160()))), nHeight, false, false);
+}
+
+//! The database at the bottom, drops the coins written to it
+class CCoinsViewSink : public CCoinsView
+{
+public:
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock) override
+    {
+        for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); it = mapCoins.erase(it)) {
+        }
+        return true;
+    }
+};
+
+static void CoinsCacheLookup(benchmark::State& state, CoinsCacheBackend backend)
+{
+    CCoinsMap::SetDefaultBackend(backend);
+    CCoinsView coinsDummy;
+    CCoinsViewCache coins(&coinsDummy);
+    std::vector<COutPoint> outpoints;
+    outpoints.reserve(LOOKUP_COINS);
+    for (uint32_t i = 0; i < LOOKUP_COINS; i++) {
+        outpoints.push_back(ReplayOutPoint(i / REPLAY_BLOCK_COINS, i % REPLAY_BLOCK_COINS));
+        coins.AddCoin(outpoints.back(), ReplayCoin(i / REPLAY_BLOCK_COINS), false);
+    }
+    FastRandomContext rng(true);
+    std::shuffle(outpoints.begin(), outpoints.end(), rng);
+
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        const Coin& coin = coins.AccessCoin(outpoints[i]);
+        assert(!coin.IsSpent());
+        if (++i == outpoints.size()) i = 0;
+    }
+    CCoinsMap::SetDefaultBackend(CoinsCacheBackend::NODE);
+}
+
+static void CoinsCacheReplay(benchmark::State& state, CoinsCacheBackend backend)
+{
+    CCoinsMap::SetDefaultBackend(backend);
+    CCoinsViewSink db;
+    CCoinsViewCache tip(&db);
+    uint32_t nHeight = 0;
+    size_t coinsAtBudget = 0, usageAtBudget = 0;
+
+    while (state.KeepRunning()) {
+        // Spend the coins of an earlier block and create those of this one, like ConnectBlock
+        CCoinsViewCache view(&tip);
+        for (uint32_t n = 0; nHeight >= REPLAY_SPEND_DEPTH && n < REPLAY_BLOCK_COINS; n++) {
+            view.SpendCoin(ReplayOutPoint(nHeight - REPLAY_SPEND_DEPTH, n));
+        }
+        for (uint32_t n = 0; n < REPLAY_BLOCK_COINS; n++) {
+            view.AddCoin(ReplayOutPoint(nHeight, n), ReplayCoin(nHeight), false);
+        }
+        view.Flush();
+        nHeight++;
+
+        // Spends of fresh coins leave nothing behind, keep the older ones to fill the cache
+        for (uint32_t n = 0; n < REPLAY_BLOCK_COINS / 2; n++) {
+            tip.AddCoin(ReplayOutPoint(nHeight + (1 << 20), n), ReplayCoin(nHeight), false);
+        }
+
+        if (tip.DynamicMemoryUsage() > REPLAY_BUDGET) {
+            coinsAtBudget = tip.GetCacheSize();
+            usageAtBudget = tip.DynamicMemoryUsage();
+            tip.Flush();
+        }
+    }
+    if (usageAtBudget) {
+        fprintf(stderr, "%s: %.0f coins per GiB\n", state.m_name.c_str(), coinsAtBudget * (double)(1 << 30) / usageAtBudget);
+    }
+    CCoinsMap::SetDefaultBackend(CoinsCacheBackend::NODE);
+}
+
+static void CoinsCacheLookupNode(benchmark::State& state)
+{
+    CoinsCacheLookup(state, CoinsCacheBackend::NODE);
+}
+
+static void CoinsCacheLookupFlat(benchmark::State& state)
+{
+    CoinsCacheLookup(state, CoinsCacheBackend::FLAT);
+}
+
+static void CoinsCacheReplayNode(benchmark::State& state)
+{
+    CoinsCacheReplay(state, CoinsCacheBackend::NODE);
+}
+
+static void CoinsCacheReplayFlat(benchmark::State& state)
+{
+    CoinsCacheReplay(state, CoinsCacheBackend::FLAT);
+}
+
+BENCHMARK(CoinsCacheLookupNode, 1000 * 1000);
+BENCHMARK(CoinsCacheLookupFlat, 1000 * 1000);
+BENCHMARK(CoinsCacheReplayNode, 500);
+BENCHMARK(CoinsCacheReplayFlat, 500);
@@ -0,0 +1,90 @@
+// Copyright (c) 2020 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <primitives/block.h>
+#include <script/standard.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// Count the allocations made to extract the contract of a deploy tx with 24KB of code and hand
+// it to ByteCodeExec, the path ContractPipelineDeploy times. Replacing operator new applies to
+// the whole program, so this is built on its own and not linked into bench_metrix. Only the
+// allocations between the start and the end of the measured path are counted.
+
+static const size_t CODE_SIZE = 24 * 1024;
+// The script interpreter reads the push into a buffer and copies it onto its stack, the
+// QtumTransaction holds one more copy. Everything after that is moved.
+static const uint64_t MAX_CODE_COPIES = 3;
+
+static std::atomic<bool> g_counting{false};
+static std::atomic<uint64_t> g_allocations{0};
+static std::atomic<uint64_t> g_allocated_bytes{0};
+static std::atomic<uint64_t> g_code_copies{0};
+
+void* operator new(size_t size)
+{
+    if (g_counting) {
+        g_allocations++;
+        g_allocated_bytes += size;
+        if (size >= CODE_SIZE)
+            g_code_copies++;
+    }
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+int main(int argc, char** argv)
+{
+    SetupEnvironment();
+    SelectParams(CBaseChainParams::REGTEST);
+
+    CMutableTransaction funding;
+    funding.vin.resize(1);
+    funding.vout.push_back(CTxOut(COIN, GetScriptForDestination(PKHash())));
+    std::vector<CTransactionRef> blockTxs{MakeTransactionRef(funding)};
+
+    CMutableTransaction deploy;
+    deploy.vin.push_back(CTxIn(COutPoint(blockTxs[0]->GetHash(), 0)));
+    deploy.vout.push_back(CTxOut(0, CScript() << CScriptNum(VersionVM::GetEVMDefault().toRaw()) << CScriptNum(2500000) << CScriptNum(40) << std::vector<unsigned char>(CODE_SIZE, 0x60) << OP_CREATE));
+    const CTransaction tx(deploy);
+    CBlock block;
+
+    bool fExtracted;
+    size_t nTxs, nCodeSize;
+    {
+        g_counting = true;
+        QtumTxConverter converter(tx, nullptr, &blockTxs);
+        ExtractQtumTX extracted;
+        fExtracted = converter.extractionQtumTransactions(extracted);
+        ByteCodeExec exec(block, std::move(extracted.first), 2500000, nullptr);
+        g_counting = false;
+        nTxs = exec.getTxs().size();
+        nCodeSize = nTxs ? exec.getTxs()[0].data().size() : 0;
+    }
+    if (!fExtracted || nTxs != 1 || nCodeSize != CODE_SIZE) {
+        fprintf(stderr, "Error: the deploy was not extracted\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("%u bytes in %u allocations, %u of them hold a copy of the %u byte code (at most %u expected)\n",
+        (unsigned)g_allocated_bytes, (unsigned)g_allocations, (unsigned)g_code_copies, (unsigned)CODE_SIZE, (unsigned)MAX_CODE_COPIES);
+    return g_code_copies <= MAX_CODE_COPIES ? EXIT_SUCCESS : EXIT_FAILURE;
+}
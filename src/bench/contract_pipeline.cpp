@@ -0,0 +1,39 @@
+// Copyright (c) 2016-2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <primitives/block.h>
+#include <script/standard.h>
+#include <validation.h>
+
+// Extract the contract of a deploy tx with 24KB of code and hand it to ByteCodeExec the way
+// ConnectBlock and the block assembler do. The allocations of this path are counted by
+// bench_contract_alloc, which replaces operator new and is built as a program of its own.
+
+static const size_t CODE_SIZE = 24 * 1024;
+
+static void ContractPipelineDeploy(benchmark::State& state)
+{
+    CMutableTransaction funding;
+    funding.vin.resize(1);
+    funding.vout.push_back(CTxOut(COIN, GetScriptForDestination(PKHash())));
+    std::vector<CTransactionRef> blockTxs{MakeTransactionRef(funding)};
+
+    CMutableTransaction deploy;
+    deploy.vin.push_back(CTxIn(COutPoint(blockTxs[0]->GetHash(), 0)));
+    deploy.vout.push_back(CTxOut(0, CScript() << CScriptNum(VersionVM::GetEVMDefault().toRaw()) << CScriptNum(2500000) << CScriptNum(40) << std::vector<unsigned char>(CODE_SIZE, 0x60) << OP_CREATE));
+    const CTransaction tx(deploy);
+    CBlock block;
+
+    while (state.KeepRunning()) {
+        QtumTxConverter converter(tx, nullptr, &blockTxs);
+        ExtractQtumTX extracted;
+        bool fExtracted = converter.extractionQtumTransactions(extracted);
+        ByteCodeExec exec(block, std::move(extracted.first), 2500000, nullptr);
+        assert(fExtracted && exec.getTxs().size() == 1 && exec.getTxs()[0].data().size() == CODE_SIZE);
+    }
+}
+
+BENCHMARK(ContractPipelineDeploy, 500);
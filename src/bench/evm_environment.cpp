@@ -0,0 +1,79 @@
+// Copyright (c) 2016-2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <arith_uint256.h>
+#include <chain.h>
+#include <validation.h>
+
+#include <deque>
+
+// Build the EVM environment of the 100 contract txs of a block, sharing the hashes of the last
+// 256 blocks and the header template at the tip, against walking the chain for each tx.
+
+static const int CHAIN_LENGTH = 1000;
+static const int CONTRACT_TXS = 100;
+
+struct BenchChain {
+    std::deque<uint256> hashes;
+    std::deque<CBlockIndex> indexes;
+
+    BenchChain()
+    {
+        for (int i = 0; i < CHAIN_LENGTH; i++) {
+            hashes.push_back(ArithToUint256(arith_uint256(i + 1)));
+            indexes.emplace_back();
+            indexes.back().phashBlock = &hashes.back();
+            indexes.back().pprev = i ? &indexes[i - 1] : nullptr;
+            indexes.back().nHeight = i;
+        }
+    }
+
+    const CBlockIndex* Tip() const { return &indexes.back(); }
+};
+
+static void EVMEnvironmentPerTx(benchmark::State& state)
+{
+    BenchChain chain;
+    const CBlockIndex* tip = chain.Tip();
+
+    while (state.KeepRunning()) {
+        for (int n = 0; n < CONTRACT_TXS; n++) {
+            dev::eth::BlockHeader header;
+            header.setNumber(tip->nHeight + 1);
+            header.setTimestamp(1500000000);
+            header.setDifficulty(dev::u256(0x1d00ffff));
+            header.setGasLimit(40000000);
+            header.setAuthor(dev::Address(1));
+
+            dev::h256s lastHashes(256);
+            const CBlockIndex* pindex = tip;
+            for (int i = 0; i < 256 && pindex; i++) {
+                lastHashes[i] = uintToh256(*pindex->phashBlock);
+                pindex = pindex->pprev;
+            }
+            assert(lastHashes[255] != dev::h256());
+        }
+    }
+}
+
+static void EVMEnvironmentShared(benchmark::State& state)
+{
+    BenchChain chain;
+    const CBlockIndex* tip = chain.Tip();
+    evmEnvironmentCache.clear();
+
+    while (state.KeepRunning()) {
+        for (int n = 0; n < CONTRACT_TXS; n++) {
+            LastHashes lastHashes;
+            lastHashes.set(tip);
+            std::shared_ptr<const dev::eth::BlockHeader> header = evmEnvironmentCache.header(tip, 1500000000, 0x1d00ffff, 40000000, dev::Address(1));
+            assert(header->number() == tip->nHeight + 1);
+        }
+    }
+}
+
+BENCHMARK(EVMEnvironmentPerTx, 50);
+BENCHMARK(EVMEnvironmentShared, 50);
@@ -0,0 +1,66 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <policy/fees.h>
+#include <txmempool.h>
+
+#include <memory>
+#include <vector>
+
+// An iteration is a block of the txs seen entering the mempool at the previous height
+// being connected, the fee estimator tracking the txs and updating its stats for the block.
+// Contract txs are tracked by gas price as well, in three gas limit classes.
+
+static const int BLOCK_TXS = 200;
+static const uint64_t BLOCK_GAS_LIMIT = 40000000;
+
+static void PolicyEstimatorBlock(benchmark::State& state, int nContractTxs)
+{
+    CBlockPolicyEstimator feeEst;
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << OP_1;
+    CMutableTransaction contractTx = tx;
+    contractTx.vout[0].scriptPubKey = CScript() << CScriptNum(4) << CScriptNum(250000) << CScriptNum(5000) << std::vector<unsigned char>(1, 0) << std::vector<unsigned char>(20, 0) << OP_CALL;
+
+    unsigned int nHeight = 0;
+    uint32_t n = 0;
+    LockPoints lp;
+    while (state.KeepRunning()) {
+        std::vector<std::unique_ptr<CTxMemPoolEntry>> entries;
+        for (int i = 0; i < BLOCK_TXS; i++) {
+            if (i < nContractTxs) {
+                contractTx.vin[0].prevout.n = n++;
+                uint64_t nGasLimit = 250000ULL << (i % 6);
+                CAmount nGasPrice = 5000 + 100 * (i % 50);
+                entries.emplace_back(new CTxMemPoolEntry(MakeTransactionRef(contractTx), nGasLimit * nGasPrice, 0, nHeight, false, 4, lp, nGasPrice, nGasLimit, BLOCK_GAS_LIMIT));
+            } else {
+                tx.vin[0].prevout.n = n++;
+                entries.emplace_back(new CTxMemPoolEntry(MakeTransactionRef(tx), 1000 + 100 * (i % 100), 0, nHeight, false, 4, lp));
+            }
+            feeEst.processTransaction(*entries.back(), true);
+        }
+        std::vector<const CTxMemPoolEntry*> block;
+        for (const auto& entry : entries) {
+            block.push_back(entry.get());
+        }
+        feeEst.processBlock(++nHeight, block);
+    }
+}
+
+static void PolicyEstimatorBlockNoContracts(benchmark::State& state)
+{
+    PolicyEstimatorBlock(state, 0);
+}
+
+static void PolicyEstimatorBlockContracts(benchmark::State& state)
+{
+    PolicyEstimatorBlock(state, BLOCK_TXS / 4);
+}
+
+BENCHMARK(PolicyEstimatorBlockNoContracts, 500);
+BENCHMARK(PolicyEstimatorBlockContracts, 500);
@@ -0,0 +1,149 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <compat.h>
+#include <netbase.h>
+#include <util/system.h>
+
+#ifdef USE_EPOLL
+
+#include <poll.h>
+#include <sys/epoll.h>
+
+#include <algorithm>
+#include <assert.h>
+#include <stdio.h>
+#include <vector>
+
+// Loopback connections of which a few are busy and the rest idle, as on a node with
+// a few thousand peers. An iteration is one round of a byte sent by every busy client
+// and received by the server side, waiting for the sockets with poll, the pollfd set
+// rebuilt every wait like the socket handler does, or with edge-triggered epoll.
+
+static const int IDLE_SOCKETS = 2000;
+static const int BUSY_SOCKETS = 20;
+
+struct LoopbackSockets
+{
+    std::vector<SOCKET> vClient;
+    std::vector<SOCKET> vServer;
+
+    explicit LoopbackSockets(int nSockets)
+    {
+        SOCKET hListen = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        assert(hListen != INVALID_SOCKET);
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        assert(bind(hListen, (struct sockaddr*)&addr, len) == 0);
+        assert(listen(hListen, SOMAXCONN) == 0);
+        assert(getsockname(hListen, (struct sockaddr*)&addr, &len) == 0);
+
+        for (int i = 0; i < nSockets; i++) {
+            SOCKET hClient = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            assert(connect(hClient, (struct sockaddr*)&addr, len) == 0);
+            SOCKET hServer = accept(hListen, nullptr, nullptr);
+            assert(hServer != INVALID_SOCKET);
+            vClient.push_back(hClient);
+            vServer.push_back(hServer);
+        }
+        CloseSocket(hListen);
+    }
+
+    ~LoopbackSockets()
+    {
+        for (SOCKET& hSocket : vClient)
+            CloseSocket(hSocket);
+        for (SOCKET& hSocket : vServer)
+            CloseSocket(hSocket);
+    }
+
+    void SendBusy()
+    {
+        char ch = 0;
+        for (int i = 0; i < BUSY_SOCKETS; i++) {
+            assert(send(vClient[i], &ch, 1, MSG_NOSIGNAL) == 1);
+        }
+    }
+};
+
+static int SocketCount()
+{
+    // Every connection takes a socket on both ends
+    int nWanted = 2 * (IDLE_SOCKETS + BUSY_SOCKETS) + 64;
+    int nAvailable = RaiseFileDescriptorLimit(nWanted);
+    if (nAvailable < nWanted) {
+        fprintf(stderr, "Only %d file descriptors available, running with fewer idle sockets\n", nAvailable);
+        return std::max(BUSY_SOCKETS, (nAvailable - 64) / 2);
+    }
+    return IDLE_SOCKETS + BUSY_SOCKETS;
+}
+
+static void SocketEventsPoll(benchmark::State& state)
+{
+    LoopbackSockets sockets(SocketCount());
+    char pchBuf[0x10000];
+
+    while (state.KeepRunning()) {
+        sockets.SendBusy();
+        int nReceived = 0;
+        while (nReceived < BUSY_SOCKETS) {
+            std::vector<struct pollfd> vpollfds;
+            vpollfds.reserve(sockets.vServer.size());
+            for (SOCKET hSocket : sockets.vServer) {
+                struct pollfd entry = {};
+                entry.fd = hSocket;
+                entry.events = POLLIN;
+                vpollfds.push_back(entry);
+            }
+            assert(poll(vpollfds.data(), vpollfds.size(), 1000) > 0);
+            for (const struct pollfd& entry : vpollfds) {
+                if (entry.revents & POLLIN) {
+                    nReceived += recv(entry.fd, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+                }
+            }
+        }
+    }
+}
+
+static void SocketEventsEpoll(benchmark::State& state)
+{
+    LoopbackSockets sockets(SocketCount());
+    char pchBuf[0x10000];
+
+    int epollfd = epoll_create1(EPOLL_CLOEXEC);
+    assert(epollfd != -1);
+    for (SOCKET hSocket : sockets.vServer) {
+        struct epoll_event event = {};
+        event.events = EPOLLIN | EPOLLET;
+        event.data.fd = hSocket;
+        assert(epoll_ctl(epollfd, EPOLL_CTL_ADD, hSocket, &event) == 0);
+    }
+
+    struct epoll_event events[1024];
+    while (state.KeepRunning()) {
+        sockets.SendBusy();
+        int nReceived = 0;
+        while (nReceived < BUSY_SOCKETS) {
+            int nEvents = epoll_wait(epollfd, events, 1024, 1000);
+            assert(nEvents > 0);
+            for (int i = 0; i < nEvents; i++) {
+                // Edge-triggered, read until the socket would block
+                int nBytes;
+                while ((nBytes = recv(events[i].data.fd, pchBuf, sizeof(pchBuf), MSG_DONTWAIT)) > 0) {
+                    nReceived += nBytes;
+                }
+            }
+        }
+    }
+    close(epollfd);
+}
+
+BENCHMARK(SocketEventsPoll, 500);
+BENCHMARK(SocketEventsEpoll, 500);
+
+#endif
@@ -0,0 +1,64 @@
+// Copyright (c) 2016-2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <qtum/statediff.h>
+
+// Diff two versions of a contract storage trie with 50000 slots of which 10 changed,
+// against reading every slot of both versions to find the changes.
+
+static const unsigned STORAGE_SLOTS = 50000;
+static const unsigned CHANGED_SLOTS = 10;
+
+static void SetupStorage(dev::OverlayDB& db, dev::h256& rootBefore, dev::h256& rootAfter)
+{
+    dev::eth::SecureTrieDB<dev::h256, dev::OverlayDB> trie(&db);
+    trie.init();
+    for (unsigned i = 0; i < STORAGE_SLOTS; i++) {
+        trie.insert(dev::h256(i), dev::rlp(dev::u256(i + 1)));
+    }
+    rootBefore = trie.root();
+    for (unsigned i = 0; i < CHANGED_SLOTS; i++) {
+        trie.insert(dev::h256(i * (STORAGE_SLOTS / CHANGED_SLOTS)), dev::rlp(dev::u256(0xff)));
+    }
+    rootAfter = trie.root();
+}
+
+static void StateDiffChangedSlots(benchmark::State& state)
+{
+    dev::OverlayDB db;
+    dev::h256 rootBefore, rootAfter;
+    SetupStorage(db, rootBefore, rootAfter);
+
+    while (state.KeepRunning()) {
+        unsigned changes = 0;
+        TrieDiff(db).diff(rootBefore, rootAfter, [&](dev::h256 const&, std::string const&, std::string const&) {
+            changes++;
+            return true;
+        });
+        assert(changes == CHANGED_SLOTS);
+    }
+}
+
+static void StateDiffFullScan(benchmark::State& state)
+{
+    dev::OverlayDB db;
+    dev::h256 rootBefore, rootAfter;
+    SetupStorage(db, rootBefore, rootAfter);
+
+    while (state.KeepRunning()) {
+        unsigned changes = 0;
+        dev::eth::SecureTrieDB<dev::h256, dev::OverlayDB> before(&db, rootBefore);
+        dev::eth::SecureTrieDB<dev::h256, dev::OverlayDB> after(&db, rootAfter);
+        for (unsigned i = 0; i < STORAGE_SLOTS; i++) {
+            if (before.at(dev::h256(i)) != after.at(dev::h256(i)))
+                changes++;
+        }
+        assert(changes == CHANGED_SLOTS);
+    }
+}
+
+BENCHMARK(StateDiffChangedSlots, 200);
+BENCHMARK(StateDiffFullScan, 1);
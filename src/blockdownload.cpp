@@ -0,0 +1,28 @@
+// Copyright (c) 2020 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockdownload.h>
+
+#include <algorithm>
+
+void BlockDownloadWindow::received(int64_t _nServiceTime, uint64_t _nBytes, int64_t _nRtt)
+{
+    _nServiceTime = std::max<int64_t>(_nServiceTime, 1);
+    // Moving averages weighing each new sample by 1/8, like the round trip time of TCP
+    if(nBlocks == 0){
+        nServiceTime = _nServiceTime;
+    }else{
+        nServiceTime += (_nServiceTime - nServiceTime) / 8;
+    }
+    if(_nRtt > 0){
+        nRtt = _nRtt;
+    }
+    nBlocks++;
+    nBytes += _nBytes;
+    nDownloadTime += _nServiceTime;
+
+    int64_t nServiceTimeMin = std::max<int64_t>(nServiceTime, 1);
+    int64_t nCover = (nRtt + nServiceTimeMin - 1) / nServiceTimeMin + 1;
+    nSize = std::max<int64_t>(MIN_BLOCK_DOWNLOAD_WINDOW, std::min<int64_t>(MAX_BLOCK_DOWNLOAD_WINDOW, 2 * nCover));
+}
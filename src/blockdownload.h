@@ -0,0 +1,66 @@
+// Copyright (c) 2020 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKDOWNLOAD_H
+#define BITCOIN_BLOCKDOWNLOAD_H
+
+#include <stdint.h>
+
+/** Fewest blocks kept in flight from a peer whose download has been measured */
+static const int MIN_BLOCK_DOWNLOAD_WINDOW = 2;
+/** Most blocks kept in flight from one peer */
+static const int MAX_BLOCK_DOWNLOAD_WINDOW = 128;
+/** A block in flight is requested from another peer when that peer is expected to deliver it this many times sooner */
+static const int BLOCK_REASSIGN_FACTOR = 2;
+/** Time in microseconds a block must be expected to take at least before it is requested from another peer */
+static const int64_t BLOCK_REASSIGN_MIN_WAIT = 500000;
+
+/**
+ * Number of blocks kept in flight from a peer, sized from the measured time the peer takes
+ * per block and its round trip time. Enough blocks are requested to cover a round trip at
+ * the rate the peer delivers them, twice over for jitter, so fast peers are never left idle
+ * and slow peers do not hold on to more of the download window than they can deliver.
+ * Until the first block is measured the window has its default size.
+ */
+class BlockDownloadWindow
+{
+public:
+    explicit BlockDownloadWindow(int _nDefaultSize) : nDefaultSize(_nDefaultSize) {}
+
+    /**
+     * The block at the head of the queue of the peer arrived, nServiceTime microseconds after
+     * the previous one arrived or it was requested, whichever is later.
+     * @param[in] nRtt  Round trip time of the peer in microseconds, 0 if it is not known
+     */
+    void received(int64_t nServiceTime, uint64_t nBytes, int64_t nRtt);
+
+    /** Number of blocks to keep in flight */
+    int size() const { return nSize; }
+
+    bool measured() const { return nBlocks > 0; }
+
+    /** Average microseconds per block */
+    int64_t serviceTime() const { return nServiceTime; }
+
+    int64_t rtt() const { return nRtt; }
+
+    /** Microseconds until a block requested now arrives, behind nQueued blocks already in flight */
+    int64_t expectedDelivery(int nQueued) const { return nRtt + nServiceTime * (nQueued + 1); }
+
+    /** Blocks received, their size and the microseconds spent receiving them */
+    uint64_t blocks() const { return nBlocks; }
+    uint64_t bytes() const { return nBytes; }
+    int64_t downloadTime() const { return nDownloadTime; }
+
+private:
+    const int nDefaultSize;
+    int nSize = nDefaultSize;
+    int64_t nServiceTime = 0;
+    int64_t nRtt = 0;
+    uint64_t nBlocks = 0;
+    uint64_t nBytes = 0;
+    int64_t nDownloadTime = 0;
+};
+
+#endif // BITCOIN_BLOCKDOWNLOAD_H
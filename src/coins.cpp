@@ -33,10 +33,193 @@ size_t CCoinsViewBacked::EstimateSize() const { return base->EstimateSize(); }
 
 SaltedOutpointHasher::SaltedOutpointHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
+CoinsCacheBackend CCoinsMap::g_default_backend = CoinsCacheBackend::NODE;
+
+uint32_t CCoinsMap::NextUsed(uint32_t pos) const
+{
+    while (pos < m_end && !m_used[pos]) {
+        ++pos;
+    }
+    return pos;
+}
+
+uint32_t CCoinsMap::FlatFind(const COutPoint& key) const
+{
+    if (m_index.empty()) {
+        return m_end;
+    }
+    const size_t mask = m_index.size() - 1;
+    for (size_t i = m_node.hash_function()(key) & mask; ; i = (i + 1) & mask) {
+        uint32_t pos = m_index[i];
+        if (pos == SLOT_EMPTY) {
+            return m_end;
+        }
+        if (pos != SLOT_ERASED && Entry(pos).first == key) {
+            return pos;
+        }
+    }
+}
+
+uint32_t CCoinsMap::FlatAllocate()
+{
+    if (!m_free.empty()) {
+        uint32_t pos = m_free.back();
+        m_free.pop_back();
+        return pos;
+    }
+    assert(m_end < SLOT_ERASED);
+    if ((m_end >> CHUNK_BITS) == m_chunks.size()) {
+        m_chunks.emplace_back(new Slot[CHUNK_SIZE]);
+        m_used.resize(m_chunks.size() << CHUNK_BITS, false);
+    }
+    return m_end++;
+}
+
+std::pair<uint32_t, bool> CCoinsMap::FlatInsert(uint32_t pos)
+{
+    // Keep the table at most 3/4 full, erased slots included
+    if ((m_size + m_erased_slots + 1) * 4 > m_index.size() * 3) {
+        size_t slots = 16;
+        while ((m_size + 1) * 8 > slots * 3) {
+            slots <<= 1;
+        }
+        FlatRehash(slots);
+    }
+
+    const COutPoint& key = Entry(pos).first;
+    const size_t mask = m_index.size() - 1;
+    size_t target = m_index.size();
+    for (size_t i = m_node.hash_function()(key) & mask; ; i = (i + 1) & mask) {
+        uint32_t other = m_index[i];
+        if (other == SLOT_EMPTY) {
+            if (target == m_index.size()) {
+                target = i;
+            }
+            break;
+        }
+        if (other == SLOT_ERASED) {
+            if (target == m_index.size()) {
+                target = i;
+            }
+        } else if (Entry(other).first == key) {
+            Entry(pos).~value_type();
+            m_free.push_back(pos);
+            return {other, false};
+        }
+    }
+    if (m_index[target] == SLOT_ERASED) {
+        --m_erased_slots;
+    }
+    m_index[target] = pos;
+    m_used[pos] = true;
+    ++m_size;
+    return {pos, true};
+}
+
+void CCoinsMap::FlatErase(uint32_t pos)
+{
+    const size_t mask = m_index.size() - 1;
+    size_t i = m_node.hash_function()(Entry(pos).first) & mask;
+    while (m_index[i] != pos) {
+        i = (i + 1) & mask;
+    }
+    m_index[i] = SLOT_ERASED;
+    ++m_erased_slots;
+    Entry(pos).~value_type();
+    m_used[pos] = false;
+    m_free.push_back(pos);
+    --m_size;
+}
+
+void CCoinsMap::FlatRehash(size_t slots)
+{
+    std::vector<uint32_t> index(slots, SLOT_EMPTY);
+    const size_t mask = slots - 1;
+    for (uint32_t pos = NextUsed(0); pos < m_end; pos = NextUsed(pos + 1)) {
+        size_t i = m_node.hash_function()(Entry(pos).first) & mask;
+        while (index[i] != SLOT_EMPTY) {
+            i = (i + 1) & mask;
+        }
+        index[i] = pos;
+    }
+    m_index.swap(index);
+    m_erased_slots = 0;
+}
+
+CCoinsMap::iterator CCoinsMap::begin()
+{
+    return m_backend == CoinsCacheBackend::FLAT ? iterator(this, NodeMap::iterator(), NextUsed(0)) : iterator(this, m_node.begin(), 0);
+}
+
+CCoinsMap::iterator CCoinsMap::end()
+{
+    return m_backend == CoinsCacheBackend::FLAT ? iterator(this, NodeMap::iterator(), m_end) : iterator(this, m_node.end(), 0);
+}
+
+CCoinsMap::const_iterator CCoinsMap::begin() const
+{
+    return m_backend == CoinsCacheBackend::FLAT ? const_iterator(this, NodeMap::const_iterator(), NextUsed(0)) : const_iterator(this, m_node.begin(), 0);
+}
+
+CCoinsMap::const_iterator CCoinsMap::end() const
+{
+    return m_backend == CoinsCacheBackend::FLAT ? const_iterator(this, NodeMap::const_iterator(), m_end) : const_iterator(this, m_node.end(), 0);
+}
+
+CCoinsMap::iterator CCoinsMap::find(const COutPoint& key)
+{
+    return m_backend == CoinsCacheBackend::FLAT ? iterator(this, NodeMap::iterator(), FlatFind(key)) : iterator(this, m_node.find(key), 0);
+}
+
+CCoinsMap::const_iterator CCoinsMap::find(const COutPoint& key) const
+{
+    return m_backend == CoinsCacheBackend::FLAT ? const_iterator(this, NodeMap::const_iterator(), FlatFind(key)) : const_iterator(this, m_node.find(key), 0);
+}
+
+CCoinsMap::iterator CCoinsMap::erase(iterator it)
+{
+    if (m_backend == CoinsCacheBackend::NODE) {
+        return iterator(this, m_node.erase(it.m_node_it), 0);
+    }
+    FlatErase(it.m_pos);
+    return iterator(this, NodeMap::iterator(), NextUsed(it.m_pos + 1));
+}
+
+void CCoinsMap::clear()
+{
+    m_node.clear();
+    for (uint32_t pos = NextUsed(0); pos < m_end; pos = NextUsed(pos + 1)) {
+        Entry(pos).~value_type();
+    }
+    m_chunks.clear();
+    m_chunks.shrink_to_fit();
+    m_used.clear();
+    m_used.shrink_to_fit();
+    m_free.clear();
+    m_free.shrink_to_fit();
+    m_index.clear();
+    m_index.shrink_to_fit();
+    m_end = 0;
+    m_size = 0;
+    m_erased_slots = 0;
+}
+
+size_t CCoinsMap::DynamicMemoryUsage() const
+{
+    if (m_backend == CoinsCacheBackend::NODE) {
+        return memusage::DynamicUsage(m_node);
+    }
+    return m_chunks.size() * memusage::MallocUsage(sizeof(Slot) * CHUNK_SIZE) +
+           memusage::DynamicUsage(m_chunks) +
+           memusage::MallocUsage(m_used.capacity() / 8) +
+           memusage::DynamicUsage(m_free) +
+           memusage::DynamicUsage(m_index);
+}
+
 CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0) {}
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
-    return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage;
+    return cacheCoins.DynamicMemoryUsage() + cachedCoinsUsage;
 }
 
 CCoinsMap::iterator CCoinsViewCache::FetchCoin(const COutPoint &outpoint) const {
@@ -18,7 +18,10 @@
 #include <stdint.h>
 
 #include <functional>
+#include <memory>
+#include <type_traits>
 #include <unordered_map>
+#include <vector>
 
 #ifdef ENABLE_BITCORE_RPC
 ////////////////////////////////////////////////////////////////// // qtum
@@ -212,7 +215,164 @@ struct CCoinsCacheEntry
     explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+/** Hash table implementations of CCoinsMap */
+enum class CoinsCacheBackend {
+    NODE, //!< std::unordered_map, one heap node per entry
+    FLAT, //!< entries pooled in chunks, found through an open-addressing table of their positions
+};
+
+/** Default for -flatcoinscache */
+static const bool DEFAULT_FLAT_COINS_CACHE = false;
+
+/**
+ * Map from outpoints to cache entries with the subset of the std::unordered_map
+ * interface the coins views use. The backend is picked at construction from the
+ * default set with SetDefaultBackend.
+ *
+ * The flat backend stores the entries in fixed size chunks without a heap node
+ * each, and finds them through a power of two table of 32-bit positions with
+ * linear probing. Erased positions are reused by later insertions. Contrary to
+ * the node backend its iterators stay valid on insertion, and iterators to the
+ * other entries stay valid on erase, like those of the node backend. The chunks
+ * are only released by clear().
+ */
+class CCoinsMap
+{
+public:
+    typedef COutPoint key_type;
+    typedef CCoinsCacheEntry mapped_type;
+    typedef std::pair<const COutPoint, CCoinsCacheEntry> value_type;
+    typedef size_t size_type;
+
+private:
+    typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> NodeMap;
+
+    //! Entries per chunk of the flat backend
+    static constexpr uint32_t CHUNK_BITS = 8;
+    static constexpr uint32_t CHUNK_SIZE = 1 << CHUNK_BITS;
+    //! Index table slots that hold no position
+    static constexpr uint32_t SLOT_EMPTY = 0xffffffff;
+    static constexpr uint32_t SLOT_ERASED = 0xfffffffe;
+
+    struct Slot {
+        typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type data;
+    };
+
+    static CoinsCacheBackend g_default_backend;
+
+    const CoinsCacheBackend m_backend;
+    NodeMap m_node;
+
+    // Flat backend
+    std::vector<std::unique_ptr<Slot[]>> m_chunks;
+    std::vector<bool> m_used;       //!< Whether each position holds an entry
+    std::vector<uint32_t> m_free;   //!< Erased positions below m_end
+    std::vector<uint32_t> m_index;  //!< Positions by hash, linear probing
+    uint32_t m_end{0};              //!< Positions ever used since the last clear()
+    size_t m_size{0};
+    size_t m_erased_slots{0};
+
+    value_type& Entry(uint32_t pos) const { return *reinterpret_cast<value_type*>(&m_chunks[pos >> CHUNK_BITS][pos & (CHUNK_SIZE - 1)].data); }
+    uint32_t NextUsed(uint32_t pos) const;
+    //! The position of the entry for key, m_end if there is none
+    uint32_t FlatFind(const COutPoint& key) const;
+    //! The position of a free slot for a new entry
+    uint32_t FlatAllocate();
+    //! Index an entry constructed at pos, or drop it if its key is already present
+    std::pair<uint32_t, bool> FlatInsert(uint32_t pos);
+    void FlatErase(uint32_t pos);
+    void FlatRehash(size_t slots);
+
+public:
+    template <bool Const>
+    class Iter
+    {
+        friend class CCoinsMap;
+        template <bool> friend class Iter;
+        typedef typename std::conditional<Const, const CCoinsMap, CCoinsMap>::type Map;
+        typedef typename std::conditional<Const, NodeMap::const_iterator, NodeMap::iterator>::type NodeIter;
+
+        Map* m_map{nullptr};
+        NodeIter m_node_it{};
+        uint32_t m_pos{0};
+
+        Iter(Map* map, NodeIter node_it, uint32_t pos) : m_map(map), m_node_it(node_it), m_pos(pos) {}
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef CCoinsMap::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef typename std::conditional<Const, const value_type*, value_type*>::type pointer;
+        typedef typename std::conditional<Const, const value_type&, value_type&>::type reference;
+
+        Iter() {}
+        //! iterator to const_iterator
+        template <bool C = Const, typename = typename std::enable_if<C>::type>
+        Iter(const Iter<false>& other) : m_map(other.m_map), m_node_it(other.m_node_it), m_pos(other.m_pos) {}
+
+        reference operator*() const { return m_map->m_backend == CoinsCacheBackend::FLAT ? m_map->Entry(m_pos) : *m_node_it; }
+        pointer operator->() const { return &**this; }
+        Iter& operator++()
+        {
+            if (m_map->m_backend == CoinsCacheBackend::FLAT) {
+                m_pos = m_map->NextUsed(m_pos + 1);
+            } else {
+                ++m_node_it;
+            }
+            return *this;
+        }
+        Iter operator++(int) { Iter ret = *this; ++*this; return ret; }
+        bool operator==(const Iter& other) const { return m_node_it == other.m_node_it && m_pos == other.m_pos; }
+        bool operator!=(const Iter& other) const { return !(*this == other); }
+    };
+    typedef Iter<false> iterator;
+    typedef Iter<true> const_iterator;
+
+    CCoinsMap() : m_backend(g_default_backend) {}
+    explicit CCoinsMap(CoinsCacheBackend backend) : m_backend(backend) {}
+    CCoinsMap(const CCoinsMap&) = delete;
+    CCoinsMap& operator=(const CCoinsMap&) = delete;
+    ~CCoinsMap() { clear(); }
+
+    //! Backend of the maps constructed from now on
+    static void SetDefaultBackend(CoinsCacheBackend backend) { g_default_backend = backend; }
+    CoinsCacheBackend GetBackend() const { return m_backend; }
+
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+    iterator find(const COutPoint& key);
+    const_iterator find(const COutPoint& key) const;
+
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args)
+    {
+        if (m_backend == CoinsCacheBackend::NODE) {
+            auto ret = m_node.emplace(std::forward<Args>(args)...);
+            return {iterator(this, ret.first, 0), ret.second};
+        }
+        uint32_t pos = FlatAllocate();
+        new (&Entry(pos)) value_type(std::forward<Args>(args)...);
+        std::pair<uint32_t, bool> ret = FlatInsert(pos);
+        return {iterator(this, NodeMap::iterator(), ret.first), ret.second};
+    }
+
+    CCoinsCacheEntry& operator[](const COutPoint& key)
+    {
+        return emplace(std::piecewise_construct, std::forward_as_tuple(key), std::tuple<>()).first->second;
+    }
+
+    //! Erase the entry at it, returns an iterator to the next one
+    iterator erase(iterator it);
+    //! Remove all the entries and release the memory of the flat backend
+    void clear();
+    size_t size() const { return m_backend == CoinsCacheBackend::FLAT ? m_size : m_node.size(); }
+    bool empty() const { return size() == 0; }
+
+    //! Memory used by the table and the entries, without the dynamic memory of the coins
+    size_t DynamicMemoryUsage() const;
+};
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
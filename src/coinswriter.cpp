@@ -0,0 +1,163 @@
+// Copyright (c) 2020 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <coinswriter.h>
+#include <txdb.h>
+#include <util/system.h>
+#include <util/time.h>
+
+#include <boost/thread/thread.hpp>
+
+#include <chrono>
+
+CCoinsViewWriteBehind::CCoinsViewWriteBehind(CCoinsView* viewIn, CCoinsViewDB* dbIn, size_t _nBatchSize) :
+    CCoinsViewBacked(viewIn),
+    db(dbIn),
+    nBatchSize(_nBatchSize),
+    pending(new CoinsMap()),
+    writing(new CoinsMap())
+{
+}
+
+bool CCoinsViewWriteBehind::GetCoin(const COutPoint& outpoint, Coin& coin) const
+{
+    {
+        LOCK(cs);
+        for(const CoinsMap* coins : {pending.get(), writing.get()}){
+            auto it = coins->find(outpoint);
+            if(it != coins->end()){
+                coin = it->second;
+                return !coin.IsSpent();
+            }
+        }
+    }
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewWriteBehind::HaveCoin(const COutPoint& outpoint) const
+{
+    {
+        LOCK(cs);
+        for(const CoinsMap* coins : {pending.get(), writing.get()}){
+            auto it = coins->find(outpoint);
+            if(it != coins->end())
+                return !it->second.IsSpent();
+        }
+    }
+    return base->HaveCoin(outpoint);
+}
+
+uint256 CCoinsViewWriteBehind::GetBestBlock() const
+{
+    {
+        LOCK(cs);
+        if(!hashPending.IsNull())
+            return hashPending;
+        if(!hashWriting.IsNull())
+            return hashWriting;
+    }
+    return base->GetBestBlock();
+}
+
+bool CCoinsViewWriteBehind::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
+{
+    {
+        WAIT_LOCK(cs, lock);
+        // The previous flush is written first, a write is never queued behind another
+        while(nWorkers > 0 && !fFailed && (!hashPending.IsNull() || !hashWriting.IsNull())){
+            cond.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        if(fFailed)
+            return false;
+        for(CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); it = mapCoins.erase(it)){
+            if(it->second.flags & CCoinsCacheEntry::DIRTY)
+                (*pending)[it->first] = std::move(it->second.coin);
+        }
+        hashPending = hashBlock;
+    }
+    cond.notify_all();
+    if(nWorkers == 0)
+        return Sync();
+    return true;
+}
+
+bool CCoinsViewWriteBehind::Sync()
+{
+    LOCK(cs_write);
+    return writePending();
+}
+
+bool CCoinsViewWriteBehind::writePending()
+{
+    {
+        LOCK(cs);
+        if(fFailed)
+            return false;
+        if(hashPending.IsNull())
+            return true;
+        std::swap(pending, writing);
+        hashWriting = hashPending;
+        hashPending.SetNull();
+    }
+
+    int64_t nStart = GetTimeMillis();
+    bool ret = true;
+    try{
+        CoinsMap::const_iterator it = writing->begin();
+        do{
+            CCoinsMap batch;
+            for(; it != writing->end() && batch.size() < nBatchSize; ++it){
+                CCoinsCacheEntry& entry = batch[it->first];
+                entry.coin = it->second;
+                entry.flags = CCoinsCacheEntry::DIRTY;
+            }
+            ret = db->WriteCoins(batch, hashWriting, it == writing->end());
+        }while(ret && it != writing->end());
+    }catch(const std::runtime_error& e){
+        LogPrintf("%s: %s\n", __func__, e.what());
+        ret = false;
+    }
+    LogPrint(BCLog::COINDB, "Wrote %u coins up to block %s behind the chain tip (%dms)\n", writing->size(), hashWriting.ToString(), GetTimeMillis() - nStart);
+
+    {
+        LOCK(cs);
+        // A failed write keeps its coins, they are newer than the database
+        if(ret){
+            writing->clear();
+            hashWriting.SetNull();
+        }else{
+            fFailed = true;
+        }
+    }
+    cond.notify_all();
+    return ret;
+}
+
+size_t CCoinsViewWriteBehind::pendingCount() const
+{
+    LOCK(cs);
+    return pending->size() + writing->size();
+}
+
+void CCoinsViewWriteBehind::ThreadWrite()
+{
+    nWorkers++;
+    try{
+        while(true){
+            {
+                WAIT_LOCK(cs, lock);
+                while(hashPending.IsNull() || fFailed){
+                    cond.wait_for(lock, std::chrono::milliseconds(100));
+                    boost::this_thread::interruption_point();
+                }
+            }
+            LOCK(cs_write);
+            writePending();
+        }
+    }catch(...){
+        nWorkers--;
+        cond.notify_all();
+        throw;
+    }
+}
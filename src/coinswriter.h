@@ -0,0 +1,87 @@
+// Copyright (c) 2020 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_COINSWRITER_H
+#define BITCOIN_COINSWRITER_H
+
+#include <coins.h>
+#include <sync.h>
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+
+class CCoinsViewDB;
+
+/** Write the coins cache to the database on a background thread */
+static const bool DEFAULT_WRITE_BEHIND = true;
+/** Coins written to the database per call, bounds the memory of a write */
+static const size_t DEFAULT_COINS_WRITE_BATCH = 50000;
+
+/**
+ * Write-behind layer between the coins cache and the database. A flush of the cache
+ * hands its dirty coins over to this view and returns, a worker thread then writes them
+ * in bounded batches while blocks keep being connected. The coins being written are
+ * served from memory until the write of their flush is complete.
+ *
+ * The database is marked as in transition to the flushed block by the first batch and
+ * as consistent by the last one, a crash in between is rolled forward by ReplayBlocks
+ * like an interrupted synchronous flush. At most one flush is written at a time, the
+ * next one waits for it, so the memory held here never exceeds one full cache.
+ */
+class CCoinsViewWriteBehind : public CCoinsViewBacked
+{
+public:
+    CCoinsViewWriteBehind(CCoinsView* viewIn, CCoinsViewDB* dbIn, size_t _nBatchSize = DEFAULT_COINS_WRITE_BATCH);
+
+    bool GetCoin(const COutPoint& outpoint, Coin& coin) const override;
+    bool HaveCoin(const COutPoint& outpoint) const override;
+    uint256 GetBestBlock() const override;
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock) override;
+
+    /** Wait for the coins handed over so far to be on disk, writes them inline if no worker does */
+    bool Sync();
+
+    /** Coins handed over and not written yet */
+    size_t pendingCount() const;
+
+    bool hasWorkers() const { return nWorkers > 0; }
+
+    /** Worker thread writing the flushed coins */
+    void ThreadWrite();
+
+private:
+    typedef std::unordered_map<COutPoint, Coin, SaltedOutpointHasher> CoinsMap;
+
+    /** Write the coins handed over, requires cs_write */
+    bool writePending();
+
+    CCoinsViewDB* db;
+
+    const size_t nBatchSize;
+
+    mutable Mutex cs;
+
+    std::condition_variable cond;
+
+    //! Coins of the last flush, not picked up by a writer yet. The maps are swapped
+    //! through pointers, the salted hasher can not be swapped.
+    std::unique_ptr<CoinsMap> pending GUARDED_BY(cs);
+    uint256 hashPending GUARDED_BY(cs);
+
+    //! Coins being written, only changed by the holder of cs_write under cs so the
+    //! writer can read them without cs
+    std::unique_ptr<CoinsMap> writing;
+    uint256 hashWriting;
+
+    //! A write failed, the database is left in transition
+    bool fFailed GUARDED_BY(cs) = false;
+
+    //! Held for the whole write of a flush
+    Mutex cs_write;
+
+    std::atomic<int> nWorkers{0};
+};
+
+#endif // BITCOIN_COINSWRITER_H
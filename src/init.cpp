@@ -34,6 +34,13 @@
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <policy/settings.h>
+#include <qtum/contractpreexec.h>
+#include <qtum/statepruner.h>
+#include <qtum/statesnapshot.h>
+#include <qtum/vmtracewriter.h>
+#include <qtum/stakeprefetch.h>
+#include <qtum/contractexecutor.h>
+#include <rawblockcache.h>
 #include <rpc/blockchain.h>
 #include <rpc/register.h>
 #include <rpc/server.h>
@@ -218,6 +225,7 @@ void Shutdown(InitInterfaces& interfaces)
     // destruct and reset all to nullptr.
     peerLogic.reset();
     g_connman.reset();
+    prawblockcache.reset();
     g_banman.reset();
     g_txindex.reset();
     DestroyAllBlockFilterIndexes();
@@ -267,6 +275,9 @@ void Shutdown(InitInterfaces& interfaces)
         }
         pblocktree.reset();
         pstorageresult.reset();
+        pstatepruner.reset();
+        pvmtracewriter.reset();
+        pstakeprefetcher.reset();
         globalState.reset();
         globalSealEngine.reset();
     }
@@ -382,6 +393,7 @@ void SetupServerArgs()
     gArgs.AddArg("-dbcache=<n>", strprintf("Maximum database cache size <n> MiB (%d to %d, default: %d). In addition, unused mempool memory is shared for this cache (see -maxmempool).", nMinDbCache, nMaxDbCache, nDefaultDbCache), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-debuglogfile=<file>", strprintf("Specify location of debug log file. Relative paths will be prefixed by a net-specific datadir location. (-nodebuglogfile to disable; default: %s)", DEFAULT_DEBUGLOGFILE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-debugvmlogfile=<file>", strprintf("Specify location of EMV debug log file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)", DEFAULT_DEBUGVMLOGFILE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-flatcoinscache", strprintf("Keep the in-memory UTXO set in a flat open-addressing table instead of a node based hash map, which fits more coins in -dbcache (default: %u)", DEFAULT_FLAT_COINS_CACHE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-includeconf=<file>", "Specify additional configuration file, relative to the -datadir path (only useable from configuration file, not command line)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-loadblock=<file>", "Imports blocks from external blk000??.dat file on startup", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
@@ -390,8 +402,9 @@ void SetupServerArgs()
     gArgs.AddArg("-maxorphanblocksmib=<n>", strprintf("Keep at most <n> unconnectable blocks in memory (default: %u)", DEFAULT_MAX_ORPHAN_BLOCKS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-mempoolexpiry=<n>", strprintf("Do not keep transactions in the mempool longer than <n> hours (default: %u)", DEFAULT_MEMPOOL_EXPIRY), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-minimumchainwork=<hex>", strprintf("Minimum work assumed to exist on a valid chain in hex (default: %s, testnet: %s)", defaultChainParams->GetConsensus().nMinimumChainWork.GetHex(), testnetChainParams->GetConsensus().nMinimumChainWork.GetHex()), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::OPTIONS);
-    gArgs.AddArg("-par=<n>", strprintf("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)",
+    gArgs.AddArg("-par=<n>", strprintf("Set the number of script and contract verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)",
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-loadcontractstate=<file>", "Import the contract state of the chain tip from a dumpcontractstate snapshot before starting, e.g. after the stateQtum directory was lost. The snapshot must be of the current tip, its roots are checked against the tip header. Relative paths are prefixed by the data directory", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-persistmempool", strprintf("Whether to save the mempool on shutdown and load on restart (default: %u)", DEFAULT_PERSIST_MEMPOOL), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-pid=<file>", strprintf("Specify pid file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)", BITCOIN_PID_FILENAME), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-prune=<n>", strprintf("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex and -rescan. "
@@ -399,13 +412,19 @@ void SetupServerArgs()
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >=%u = automatically prune block files to stay under the specified target size in MiB)", MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-reindex", "Rebuild chain state and block index from the blk*.dat files on disk", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-reindex-chainstate", "Rebuild chain state from the currently indexed blocks. When in pruning mode or if blocks on disk might be corrupted, use full -reindex instead.", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
-    gArgs.AddArg("-record-log-opcodes", "Logs all EVM LOG opcode operations to the file vmExecLogs.json", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-record-log-opcodes", "Logs all EVM LOG opcode operations to trace segments in the vmtrace directory, contrib/vmtrace/vmtrace2json.py converts them to the former vmExecLogs.json", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-prunestate", strprintf("Delete the contract state of blocks older than -statekeepblocks, contracts can then not be queried at those heights (default: %u)", DEFAULT_STATE_PRUNE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-vmtracesegments=<n>", strprintf("Keep the last <n> trace segments of -record-log-opcodes, deleting older ones (default: %u, 0 = keep all)", DEFAULT_VMTRACE_SEGMENTS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-vmtracesegmentsize=<n>", strprintf("Start a new trace segment of -record-log-opcodes once the current one reaches <n> MiB (default: %u)", DEFAULT_VMTRACE_SEGMENT_SIZE), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-statekeepblocks=<n>", strprintf("Keep the contract state of the last <n> blocks when the state is pruned (default: %u, minimum: %u)", DEFAULT_STATE_KEEP_BLOCKS, MIN_STATE_KEEP_BLOCKS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #ifndef WIN32
     gArgs.AddArg("-sysperms", "Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)", ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
 #else
     hidden_args.emplace_back("-sysperms");
 #endif
     gArgs.AddArg("-txindex", strprintf("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)", DEFAULT_TXINDEX), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-utxoprefetch=<n>", strprintf("Number of threads reading the coins spent by received blocks from the database ahead of their connection (0 to disable, default: %d)", DEFAULT_UTXO_PREFETCH_THREADS), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-writebehind", strprintf("Write the coins cache to disk on a background thread while blocks are connected, the coins being written are held in memory on top of -dbcache (default: %u)", DEFAULT_WRITE_BEHIND), ArgsManager::ALLOW_ANY, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blockfilterindex=<type>",
                  strprintf("Maintain an index of compact filters by block (default: %s, values: %s).", DEFAULT_BLOCKFILTERINDEX, ListBlockFilterTypes()) +
                  " If <type> is not supplied or if <type> = 1, indexes for all known types are enabled.",
@@ -434,6 +453,7 @@ void SetupServerArgs()
     gArgs.AddArg("-maxsendbuffer=<n>", strprintf("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)", DEFAULT_MAXSENDBUFFER), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxtimeadjustment", strprintf("Maximum allowed median peer time offset adjustment. Local perspective of time may be influenced by peers forward or backward by this amount. (default: %u seconds)", DEFAULT_MAX_TIME_ADJUSTMENT), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxuploadtarget=<n>", strprintf("Tries to keep outbound traffic under the given target (in MiB per 24h), 0 = no limit (default: %d)", DEFAULT_MAX_UPLOAD_TARGET), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-msgworkers=<n>", strprintf("Number of threads answering block, header and transaction requests of peers next to the message handler, 0 = disable (default: %d, maximum: %d)", DEFAULT_MESSAGE_WORKERS, MAX_MESSAGE_WORKERS), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-onion=<ip:port>", "Use separate SOCKS5 proxy to reach peers via Tor hidden services, set -noonion to disable (default: -proxy)", ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-onlynet=<net>", "Make outgoing connections only through network <net> (ipv4, ipv6 or onion). Incoming connections are not affected by this option. This option can be specified multiple times to allow multiple networks.", ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-peerbloomfilters", strprintf("Support filtering of blocks and transaction with bloom filters (default: %u)", DEFAULT_PEERBLOOMFILTERS), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
@@ -441,6 +461,7 @@ void SetupServerArgs()
     gArgs.AddArg("-port=<port>", strprintf("Listen for connections on <port> (default: %u, testnet: %u, regtest: %u)", defaultChainParams->GetDefaultPort(), testnetChainParams->GetDefaultPort(), regtestChainParams->GetDefaultPort()), ArgsManager::ALLOW_ANY | ArgsManager::NETWORK_ONLY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-proxy=<ip:port>", "Connect through SOCKS5 proxy, set -noproxy to disable (default: disabled)", ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-proxyrandomize", strprintf("Randomize credentials for every proxy connection. This enables Tor stream isolation (default: %u)", DEFAULT_PROXYRANDOMIZE), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-rawblockcache=<n>", strprintf("Memory in MiB for blocks served to peers as they are stored on disk, 0 = disable (default: %d)", DEFAULT_RAW_BLOCK_CACHE), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-seednode=<ip>", "Connect to a node to retrieve peer addresses, and disconnect. This option can be specified multiple times to connect to multiple nodes.", ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-timeout=<n>", strprintf("Specify connection timeout in milliseconds (minimum: 1, default: %d)", DEFAULT_CONNECT_TIMEOUT), ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     gArgs.AddArg("-peertimeout=<n>", strprintf("Specify p2p connection timeout in seconds. This option determines the amount of time a peer may be inactive before the connection to it is dropped. (minimum: 1, default: %d)", DEFAULT_PEER_CONNECT_TIMEOUT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::CONNECTION);
@@ -477,19 +498,27 @@ void SetupServerArgs()
     gArgs.AddArg("-zmqpubhashtx=<address>", "Enable publish hash transaction in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawblock=<address>", "Enable publish raw block in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawtx=<address>", "Enable publish raw transaction in <address>", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubcontractlogs=<address>", "Enable publish contract logs of connected and disconnected blocks in <address> (requires -logevents)", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawreceipt=<address>", "Enable publish raw transaction receipts of connected and disconnected blocks in <address> (requires -logevents)", ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubhashblockhwm=<n>", strprintf("Set publish hash block outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubhashtxhwm=<n>", strprintf("Set publish hash transaction outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawblockhwm=<n>", strprintf("Set publish raw block outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawtxhwm=<n>", strprintf("Set publish raw transaction outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubcontractlogshwm=<n>", strprintf("Set publish contract logs outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawreceipthwm=<n>", strprintf("Set publish raw transaction receipts outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), ArgsManager::ALLOW_ANY, OptionsCategory::ZMQ);
 #else
     hidden_args.emplace_back("-zmqpubhashblock=<address>");
     hidden_args.emplace_back("-zmqpubhashtx=<address>");
     hidden_args.emplace_back("-zmqpubrawblock=<address>");
     hidden_args.emplace_back("-zmqpubrawtx=<address>");
+    hidden_args.emplace_back("-zmqpubcontractlogs=<address>");
+    hidden_args.emplace_back("-zmqpubrawreceipt=<address>");
     hidden_args.emplace_back("-zmqpubhashblockhwm=<n>");
     hidden_args.emplace_back("-zmqpubhashtxhwm=<n>");
     hidden_args.emplace_back("-zmqpubrawblockhwm=<n>");
     hidden_args.emplace_back("-zmqpubrawtxhwm=<n>");
+    hidden_args.emplace_back("-zmqpubcontractlogshwm=<n>");
+    hidden_args.emplace_back("-zmqpubrawreceipthwm=<n>");
 #endif
 
     gArgs.AddArg("-checkblocks=<n>", strprintf("How many blocks to check at startup (default: %u, 0 = all)", DEFAULT_CHECKBLOCKS), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
@@ -508,6 +537,8 @@ void SetupServerArgs()
     gArgs.AddArg("-dropmessagestest=<n>", "Randomly drop 1 of every <n> network messages", ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-stopafterblockimport", strprintf("Stop running after importing blocks from disk (default: %u)", DEFAULT_STOPAFTERBLOCKIMPORT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-stopatheight", strprintf("Stop running after reaching the given height in the main chain (default: %u)", DEFAULT_STOPATHEIGHT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-pipelinedconnect", strprintf("Run the contract executions of a block on a thread of their own while its inputs are checked, experimental (default: %u)", DEFAULT_PIPELINED_CONNECT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-stakeprefetch", strprintf("Read the blocks ahead of the tip and check their proof-of-stake kernels and signatures on the verification threads during initial block download (default: %u)", DEFAULT_STAKE_PREFETCH), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-limitancestorcount=<n>", strprintf("Do not accept transactions if number of in-mempool ancestors is <n> or more (default: %u)", DEFAULT_ANCESTOR_LIMIT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-limitancestorsize=<n>", strprintf("Do not accept transactions whose size with all in-mempool ancestors exceeds <n> kilobytes (default: %u)", DEFAULT_ANCESTOR_SIZE_LIMIT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-limitdescendantcount=<n>", strprintf("Do not accept transactions if any ancestor would have <n> or more in-mempool descendants (default: %u)", DEFAULT_DESCENDANT_LIMIT), ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY, OptionsCategory::DEBUG_TEST);
@@ -555,6 +586,7 @@ void SetupServerArgs()
     gArgs.AddArg("-staker-min-tx-gas-price=<amt>", "Any contract execution with a gas price below this will not be included in a block (defaults to the value specified by the DGP)", ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
     gArgs.AddArg("-staker-max-tx-gas-limit=<n>", "Any contract execution with a gas limit over this amount will not be included in a block (defaults to soft block gas limit)", ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
     gArgs.AddArg("-staker-soft-block-gas-limit=<n>", "After this amount of gas is surpassed in a block, no more contract executions will be added to the block (defaults to consensus-critical maximum block gas limit)", ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
+    gArgs.AddArg("-staker-preexec", strprintf("While staking, execute the contract transactions of the mempool in the background after every block, so block creation orders them by the fee kept per unit of gas used and skips the ones that would be rejected without executing them again (default: %u)", DEFAULT_STAKER_PREEXEC), ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
     gArgs.AddArg("-aggressive-staking", "Check more often to publish immediately when valid block is found.", ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
     gArgs.AddArg("-disablecontractstaking", "Makes it so that no contracts will be added to any PoW or PoS blocks made by this node, useful for when there is a bug for contracts that affects the staker.", ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
     gArgs.AddArg("-emergencystaking", "Allows for staking to happen even if the node doesn't think it is up to date (Useful for when the chain gets stuck and then nodes think they aren't synced and so they don't stake, waiting for a new block)", ArgsManager::ALLOW_ANY, OptionsCategory::BLOCK_CREATION);
@@ -1124,6 +1156,7 @@ bool AppInitParameterInteraction()
         nScriptCheckThreads = 0;
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
+    fPipelinedConnect = gArgs.GetBoolArg("-pipelinedconnect", DEFAULT_PIPELINED_CONNECT);
 
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
     int64_t nPruneArg = gArgs.GetArg("-prune", 0);
@@ -1143,6 +1176,11 @@ bool AppInitParameterInteraction()
         fPruneMode = true;
     }
 
+    // contract state pruning
+    if (gArgs.GetBoolArg("-prunestate", DEFAULT_STATE_PRUNE) && gArgs.GetArg("-statekeepblocks", DEFAULT_STATE_KEEP_BLOCKS) < MIN_STATE_KEEP_BLOCKS) {
+        return InitError(strprintf(_("State pruning configured to keep less than the minimum of %d blocks.").translated, MIN_STATE_KEEP_BLOCKS));
+    }
+
     nConnectTimeout = gArgs.GetArg("-timeout", DEFAULT_CONNECT_TIMEOUT);
     if (nConnectTimeout <= 0) {
         nConnectTimeout = DEFAULT_CONNECT_TIMEOUT;
@@ -1377,10 +1415,17 @@ bool AppInitMain(InitInterfaces& interfaces)
     InitSignatureCache();
     InitScriptExecutionCache();
 
-    LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
+    LogPrintf("Using %u threads for script and contract verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
         for (int i=0; i<nScriptCheckThreads-1; i++)
             threadGroup.create_thread([i]() { return ThreadScriptCheck(i); });
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread([i]() { return ThreadContractCheck(i); });
+        if (nScriptCheckThreads > 1 && gArgs.GetBoolArg("-stakeprefetch", DEFAULT_STAKE_PREFETCH)) {
+            pstakeprefetcher = MakeUnique<StakePrefetcher>(chainparams.GetConsensus());
+            for (int i=0; i<nScriptCheckThreads-1; i++)
+                threadGroup.create_thread(std::bind(&TraceThread<std::function<void()>>, "stakepf", std::function<void()>(std::bind(&StakePrefetcher::ThreadPrefetch, pstakeprefetcher.get()))));
+        }
     }
 
     // Start the lightweight task scheduler thread
@@ -1438,6 +1483,11 @@ bool AppInitMain(InitInterfaces& interfaces)
     assert(!g_connman);
     g_connman = std::unique_ptr<CConnman>(new CConnman(GetRand(std::numeric_limits<uint64_t>::max()), GetRand(std::numeric_limits<uint64_t>::max())));
 
+    int64_t nRawBlockCache = gArgs.GetArg("-rawblockcache", DEFAULT_RAW_BLOCK_CACHE);
+    if (nRawBlockCache > 0) {
+        prawblockcache.reset(new RawBlockCache(nRawBlockCache << 20));
+    }
+
     peerLogic.reset(new PeerLogicValidation(g_connman.get(), g_banman.get(), scheduler, gArgs.GetBoolArg("-enablebip61", DEFAULT_ENABLE_BIP61)));
     RegisterValidationInterface(peerLogic.get());
 
@@ -1532,6 +1582,9 @@ bool AppInitMain(InitInterfaces& interfaces)
     }
 
 #if ENABLE_ZMQ
+    if ((gArgs.IsArgSet("-zmqpubcontractlogs") || gArgs.IsArgSet("-zmqpubrawreceipt")) && !gArgs.GetBoolArg("-logevents", DEFAULT_LOGEVENTS))
+        return InitError(_("-zmqpubcontractlogs and -zmqpubrawreceipt require -logevents.").translated);
+
     g_zmq_notification_interface = CZMQNotificationInterface::Create();
 
     if (g_zmq_notification_interface) {
@@ -1579,6 +1632,7 @@ bool AppInitMain(InitInterfaces& interfaces)
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
     nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache
+    CCoinsMap::SetDefaultBackend(gArgs.GetBoolArg("-flatcoinscache", DEFAULT_FLAT_COINS_CACHE) ? CoinsCacheBackend::FLAT : CoinsCacheBackend::NODE);
     int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1f MiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
@@ -1590,7 +1644,7 @@ bool AppInitMain(InitInterfaces& interfaces)
                   filter_index_cache * (1.0 / 1024 / 1024), BlockFilterTypeName(filter_type));
     }
     LogPrintf("* Using %.1f MiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
-    LogPrintf("* Using %.1f MiB for in-memory UTXO set (plus up to %.1f MiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
+    LogPrintf("* Using %.1f MiB for in-memory UTXO set (plus up to %.1f MiB of unused mempool space) in a %s hash table\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024), gArgs.GetBoolArg("-flatcoinscache", DEFAULT_FLAT_COINS_CACHE) ? "flat" : "node based");
 
     bool fLoaded = false;
     while (!fLoaded && !ShutdownRequested()) {
@@ -1612,6 +1666,7 @@ bool AppInitMain(InitInterfaces& interfaces)
                 // fails if it's still open from the previous loop. Close it first:
                 pblocktree.reset();
                 pstorageresult.reset();
+                pstatepruner.reset();
                 globalState.reset();
                 globalSealEngine.reset();
                 pblocktree.reset(new CBlockTreeDB(nBlockTreeDBCache, false, fReset));
@@ -1719,7 +1774,9 @@ bool AppInitMain(InitInterfaces& interfaces)
                 const std::string dirQtum(qtumStateDir.string());
                 const dev::h256 hashDB(dev::sha3(dev::rlp("")));
                 dev::eth::BaseState existsQtumstate = fStatus ? dev::eth::BaseState::PreExisting : dev::eth::BaseState::Empty;
-                globalState = std::unique_ptr<QtumState>(new QtumState(dev::u256(0), QtumState::openDB(dirQtum, hashDB, dev::WithExisting::Trust), dirQtum, existsQtumstate));
+                dev::db::DatabaseFace* rawStateDB = nullptr;
+                dev::OverlayDB stateDB = QtumState::openDB(dirQtum, hashDB, dev::WithExisting::Trust, rawStateDB);
+                globalState = std::unique_ptr<QtumState>(new QtumState(dev::u256(0), stateDB, dirQtum, existsQtumstate, rawStateDB));
                 dev::eth::Network ethNetwork;// = dev::eth::Network::qtumMainNetwork;
                 if (gArgs.GetChainName() == CBaseChainParams::MAIN) {
                     ethNetwork = dev::eth::Network::qtumMainNetwork;
@@ -1735,6 +1792,34 @@ bool AppInitMain(InitInterfaces& interfaces)
                 }
 
                 if(::ChainActive().Tip() != nullptr){
+                    const CBlockIndex* tip = ::ChainActive().Tip();
+                    StateSnapshotHeader tipState;
+                    tipState.hashBlock = tip->GetBlockHash();
+                    tipState.nHeight = tip->nHeight;
+                    tipState.hashStateRoot = tip->hashStateRoot;
+                    tipState.hashUTXORoot = tip->hashUTXORoot;
+                    if (gArgs.IsArgSet("-loadcontractstate")) {
+                        fs::path snapshotPath = fs::absolute(gArgs.GetArg("-loadcontractstate", ""), GetDataDir());
+                        try {
+                            CAutoFile file(fsbridge::fopen(snapshotPath, "rb"), SER_DISK, CLIENT_VERSION);
+                            if (file.IsNull())
+                                throw std::runtime_error("unable to open " + snapshotPath.string());
+                            StateSnapshotHeader header = ReadStateSnapshotHeader(file);
+                            if (header.hashBlock != tipState.hashBlock || header.hashStateRoot != tipState.hashStateRoot || header.hashUTXORoot != tipState.hashUTXORoot)
+                                throw std::runtime_error(strprintf("the snapshot is of block %s at height %d, the chain tip is %s at height %d", header.hashBlock.GetHex(), header.nHeight, tipState.hashBlock.GetHex(), tipState.nHeight));
+                            uiInterface.InitMessage(_("Loading contract state...").translated);
+                            StateSnapshotStats stats = LoadStateSnapshot(file, header, *globalState->rawDB(), *globalState->rawDBUtxo());
+                            LogPrintf("Loaded the contract state at height %d from %s: %u chunks, %u nodes, %u preimages\n", header.nHeight, snapshotPath.string(), stats.nChunks, stats.nNodes, stats.nPreimages);
+                        } catch (const std::exception& e) {
+                            LogPrintf("%s\n", e.what());
+                            strLoadError = strprintf(_("Error loading the contract state snapshot: %s").translated, e.what());
+                            break;
+                        }
+                    }
+                    if (!HaveStateSnapshotRoots(tipState, *globalState->rawDB(), *globalState->rawDBUtxo())) {
+                        strLoadError = _("The contract state of the chain tip is missing, it can be imported from a snapshot with -loadcontractstate").translated;
+                        break;
+                    }
                     globalState->setRoot(uintToh256(::ChainActive().Tip()->hashStateRoot));
                     globalState->setRootUTXO(uintToh256(::ChainActive().Tip()->hashUTXORoot));
                 } else {
@@ -1745,8 +1830,14 @@ bool AppInitMain(InitInterfaces& interfaces)
                 globalState->db().commit();
                 globalState->dbUtxo().commit();
 
+                if (gArgs.GetBoolArg("-prunestate", DEFAULT_STATE_PRUNE)) {
+                    pstatepruner.reset(new StatePruner(*globalState->rawDB(), *globalState->rawDBUtxo(), gArgs.GetArg("-statekeepblocks", DEFAULT_STATE_KEEP_BLOCKS)));
+                }
+
                 fRecordLogOpcodes = gArgs.IsArgSet("-record-log-opcodes");
-                fIsVMlogFile = fs::exists(GetDataDir() / "vmExecLogs.json");
+                if (fRecordLogOpcodes && !pvmtracewriter) {
+                    pvmtracewriter.reset(new VMTraceWriter(GetDataDir() / "vmtrace", std::max<int64_t>(gArgs.GetArg("-vmtracesegmentsize", DEFAULT_VMTRACE_SEGMENT_SIZE), 1) << 20, std::max<int64_t>(gArgs.GetArg("-vmtracesegments", DEFAULT_VMTRACE_SEGMENTS), 0)));
+                }
                 ///////////////////////////////////////////////////////////
 
                 ///////////////////////////////////////////////////////////// // metrix
@@ -1924,8 +2015,28 @@ bool AppInitMain(InitInterfaces& interfaces)
         vImportFiles.push_back(strFile);
     }
 
+    int nPrefetchThreads = std::max<int64_t>(gArgs.GetArg("-utxoprefetch", DEFAULT_UTXO_PREFETCH_THREADS), 0);
+    for (int i = 0; i < nPrefetchThreads; i++) {
+        CCoinsViewPrefetch* prefetch = &::ChainstateActive().CoinsPrefetch();
+        threadGroup.create_thread(std::bind(&TraceThread<std::function<void()>>, "utxoprefetch", std::function<void()>(std::bind(&CCoinsViewPrefetch::ThreadPrefetch, prefetch))));
+    }
+
+    if (gArgs.GetBoolArg("-writebehind", DEFAULT_WRITE_BEHIND)) {
+        CCoinsViewWriteBehind* writer = &::ChainstateActive().CoinsWriteBehind();
+        threadGroup.create_thread(std::bind(&TraceThread<std::function<void()>>, "coinswrite", std::function<void()>(std::bind(&CCoinsViewWriteBehind::ThreadWrite, writer))));
+    }
+
     threadGroup.create_thread(std::bind(&ThreadImport, vImportFiles));
 
+    if (pstatepruner) {
+        LogPrintf("Contract state pruning enabled, keeping the state of the last %d blocks\n", pstatepruner->getKeepBlocks());
+        threadGroup.create_thread(std::bind(&TraceThread<std::function<void()>>, "stateprune", std::function<void()>(std::bind(&StatePruner::ThreadPrune, pstatepruner.get()))));
+    }
+
+    if (pvmtracewriter) {
+        threadGroup.create_thread(std::bind(&TraceThread<std::function<void()>>, "vmtrace", std::function<void()>(std::bind(&VMTraceWriter::ThreadWrite, pvmtracewriter.get()))));
+    }
+
     if(gArgs.GetBoolArg("-cleanblockindex", DEFAULT_CLEANBLOCKINDEX))
         threadGroup.create_thread(std::bind(&CleanBlockIndex));
 
@@ -1985,6 +2096,7 @@ bool AppInitMain(InitInterfaces& interfaces)
     connOptions.nMaxOutboundTimeframe = nMaxOutboundTimeframe;
     connOptions.nMaxOutboundLimit = nMaxOutboundLimit;
     connOptions.m_peer_connect_timeout = peer_connect_timeout;
+    connOptions.nMessageWorkers = std::max(0, std::min((int)gArgs.GetArg("-msgworkers", DEFAULT_MESSAGE_WORKERS), MAX_MESSAGE_WORKERS));
 
     for (const std::string& strBind : gArgs.GetArgs("-bind")) {
         CService addrBind;
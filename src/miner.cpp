@@ -18,6 +18,7 @@
 #include <pow.h>
 #include <pos.h>
 #include <primitives/transaction.h>
+#include <qtum/contractpreexec.h>
 #include <script/standard.h>
 #include <timedata.h>
 #include <util/convert.h>
@@ -406,15 +407,18 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateEmptyBlock(const CScript&
     return std::move(pblocktemplate);
 }
 
-void BlockAssembler::onlyUnconfirmed(CTxMemPool::setEntries& testSet)
+void BlockAssembler::CalculateUnconfirmedAncestors(CTxMemPool::txiter iter, CTxMemPool::setEntries& ancestors)
 {
-    for (CTxMemPool::setEntries::iterator iit = testSet.begin(); iit != testSet.end(); ) {
-        // Only test txs not already in the block
-        if (inBlock.count(*iit)) {
-            testSet.erase(iit++);
-        }
-        else {
-            iit++;
+    // The block holds all the in-mempool ancestors of its txs, so the walk
+    // never has to go past a tx that is in the block
+    std::vector<CTxMemPool::txiter> vStage(1, iter);
+    while (!vStage.empty()) {
+        CTxMemPool::txiter it = vStage.back();
+        vStage.pop_back();
+        for (CTxMemPool::txiter parent : mempool.GetMemPoolParents(it)) {
+            if (!inBlock.count(parent) && ancestors.insert(parent).second) {
+                vStage.push_back(parent);
+            }
         }
     }
 }
@@ -452,6 +456,10 @@ bool BlockAssembler::AttemptToAddContractToBlock(CTxMemPool::txiter iter, uint64
     {
         return false;
     }
+    if (iter->PreExecFailed(::ChainActive().Tip()->GetBlockHash())) {
+        // Already executed on top of this tip in the background, it would be rejected again
+        return false;
+    }
     
     dev::h256 oldHashStateRoot(globalState->rootHash());
     dev::h256 oldHashUTXORoot(globalState->rootHashUTXO());
@@ -468,9 +476,9 @@ bool BlockAssembler::AttemptToAddContractToBlock(CTxMemPool::txiter iter, uint64
         //therefore, this can only be triggered by using raw transactions on the staker itself
         return false;
     }
-    std::vector<QtumTransaction> qtumTransactions = resultConverter.first;
+    std::vector<QtumTransaction>& qtumTransactions = resultConverter.first;
     dev::u256 txGas = 0;
-    for(QtumTransaction qtumTransaction : qtumTransactions){
+    for(const QtumTransaction& qtumTransaction : qtumTransactions){
         txGas += qtumTransaction.gas();
         if(txGas > txGasLimit) {
             // Limit the tx gas limit by the soft limit if such a limit has been specified.
@@ -487,7 +495,7 @@ bool BlockAssembler::AttemptToAddContractToBlock(CTxMemPool::txiter iter, uint64
         }
     }
     // We need to pass the DGP's block gas limit (not the soft limit) since it is consensus critical.
-    ByteCodeExec exec(*pblock, qtumTransactions, hardBlockGasLimit, ::ChainActive().Tip());
+    ByteCodeExec exec(*pblock, std::move(qtumTransactions), hardBlockGasLimit, ::ChainActive().Tip());
     if(!exec.performByteCode()){
         //error, don't add contract
         globalState->setRoot(oldHashStateRoot);
@@ -656,7 +664,7 @@ int BlockAssembler::UpdatePackagesForAdded(const CTxMemPool::setEntries& already
                 modEntry.nSigOpCostWithAncestors -= it->GetSigOpCost();
                 mapModifiedTx.insert(modEntry);
             } else {
-                mapModifiedTx.modify(mit, update_for_parent_inclusion(it));
+                mapModifiedTx.modify(mit, update_for_parent_inclusion(it->GetTxSize(), it->GetModifiedFee(), it->GetSigOpCost()));
             }
         }
     }
@@ -797,11 +805,7 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
         }
 
         CTxMemPool::setEntries ancestors;
-        uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
-        std::string dummy;
-        mempool.CalculateMemPoolAncestors(*iter, ancestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
-
-        onlyUnconfirmed(ancestors);
+        CalculateUnconfirmedAncestors(iter, ancestors);
         ancestors.insert(iter);
 
         // Test if all tx's are Final
@@ -1084,6 +1088,8 @@ void StakeQtums(bool fStake, CWallet *pwallet, CConnman* connman, boost::thread_
     {
         stakeThread = new boost::thread_group();
         stakeThread->create_thread(boost::bind(&ThreadStakeMiner, pwallet, connman));
+        if (gArgs.GetBoolArg("-staker-preexec", DEFAULT_STAKER_PREEXEC))
+            stakeThread->create_thread(boost::bind(&TraceThread<void (*)()>, "preexec", &ThreadPreExecuteContracts));
     }
 }
 #endif
@@ -141,12 +141,19 @@ struct CompareModifiedEntry {
                 return false;
             }
 
-            // Otherwise, prioritize the contract tx with the highest (minimum among its outputs) gas price
-            // The reason for using the gas price of the output that sets the minimum gas price is that
-            // otherwise it may be possible to game the prioritization by setting a large gas price in one output
-            // that does no execution, while the real execution has a very low gas price
-            if(a.iter->GetMinGasPrice() != b.iter->GetMinGasPrice()) {
-                return a.iter->GetMinGasPrice() > b.iter->GetMinGasPrice();
+            // Deprioritize the contract txs that failed their pre-execution on the tip, the block assembler
+            // skips them. The flag cannot be stale, failures on older tips are cleared when the tip changes
+            if(a.iter->PreExecFailed() != b.iter->PreExecFailed()) {
+                return b.iter->PreExecFailed();
+            }
+
+            // Otherwise, prioritize the contract tx with the highest gas price score
+            // That is the fee kept by the staker per unit of gas, so pre-executed txs and txs still waiting
+            // for it compare in the same unit. The reason for not using the largest gas price of the outputs
+            // is that otherwise it may be possible to game the prioritization by setting a large gas price in
+            // one output that does no execution, while the real execution has a very low gas price
+            if(a.iter->GetGasPriceScore() != b.iter->GetGasPriceScore()) {
+                return a.iter->GetGasPriceScore() > b.iter->GetGasPriceScore();
             }
 
             // Otherwise, prioritize the tx with the min size
@@ -198,16 +205,19 @@ typedef indexed_modified_transaction_set::index<ancestor_score_or_gas_price>::ty
 
 struct update_for_parent_inclusion
 {
-    explicit update_for_parent_inclusion(CTxMemPool::txiter it) : iter(it) {}
+    update_for_parent_inclusion(uint64_t _nSize, CAmount _nModFees, int64_t _nSigOpCost) :
+        nSize(_nSize), nModFees(_nModFees), nSigOpCost(_nSigOpCost) {}
 
     void operator() (CTxMemPoolModifiedEntry &e)
     {
-        e.nModFeesWithAncestors -= iter->GetFee();
-        e.nSizeWithAncestors -= iter->GetTxSize();
-        e.nSigOpCostWithAncestors -= iter->GetSigOpCost();
+        e.nModFeesWithAncestors -= nModFees;
+        e.nSizeWithAncestors -= nSize;
+        e.nSigOpCostWithAncestors -= nSigOpCost;
     }
 
-    CTxMemPool::txiter iter;
+    uint64_t nSize;
+    CAmount nModFees;
+    int64_t nSigOpCost;
 };
 
 /** Generate a new block, without valid proof-of-work */
@@ -285,8 +295,8 @@ private:
     /** Rebuild the coinbase/coinstake transaction to account for new gas refunds **/
     void RebuildRefundTransaction();
     // helper functions for addPackageTxs()
-    /** Remove confirmed (inBlock) entries from given set */
-    void onlyUnconfirmed(CTxMemPool::setEntries& testSet);
+    /** Add the in-mempool ancestors of a tx that are not in the block yet to ancestors */
+    void CalculateUnconfirmedAncestors(CTxMemPool::txiter iter, CTxMemPool::setEntries& ancestors) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
     /** Test if a new package would "fit" in the block */
     bool TestPackage(uint64_t packageSize, int64_t packageSigOpsCost) const;
     /** Perform checks on each transaction in a package:
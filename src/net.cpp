@@ -33,6 +33,10 @@
 #include <poll.h>
 #endif
 
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/miniwget.h>
@@ -77,6 +81,13 @@ enum BindFlags {
 // The sleep time needs to be small to avoid new sockets stalling
 static const uint64_t SELECT_TIMEOUT_MILLISECONDS = 50;
 
+#ifdef USE_EPOLL
+/** Maximum number of socket events taken from epoll per wait */
+static const int MAX_EPOLL_EVENTS = 1024;
+/** Seconds between the inactivity checks of all nodes, the socket events only cover the ready ones */
+static const int64_t INACTIVITY_CHECK_INTERVAL = 1;
+#endif
+
 const std::string NET_MESSAGE_COMMAND_OTHER = "*other*";
 
 static const uint64_t RANDOMIZER_ID_NETGROUP = 0x6c0edd8036ef4036ULL; // SHA256("netgroup")[0:8]
@@ -745,6 +756,7 @@ size_t CConnman::SocketSendData(CNode *pnode) const EXCLUSIVE_LOCKS_REQUIRED(pno
         assert(pnode->nSendSize == 0);
     }
     pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
+    pnode->fSendPending = !pnode->vSendMsg.empty();
     return nSentSize;
 }
 
@@ -1000,6 +1012,7 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
 
     LogPrint(BCLog::NET, "connection from %s accepted\n", addr.ToString());
 
+    RegisterSocketEvents(pnode);
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
@@ -1279,8 +1292,208 @@ void CConnman::SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_s
 }
 #endif
 
+bool CConnman::SocketRecvData(CNode* pnode)
+{
+    // typical socket buffer is 8K-64K
+    char pchBuf[0x10000];
+    int nBytes = 0;
+    {
+        LOCK(pnode->cs_hSocket);
+        if (pnode->hSocket == INVALID_SOCKET)
+            return false;
+        nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+    }
+    if (nBytes > 0)
+    {
+        bool notify = false;
+        if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify))
+            pnode->CloseSocketDisconnect();
+        RecordBytesRecv(nBytes);
+        if (notify) {
+            size_t nSizeAdded = 0;
+            auto it(pnode->vRecvMsg.begin());
+            for (; it != pnode->vRecvMsg.end(); ++it) {
+                if (!it->complete())
+                    break;
+                nSizeAdded += it->vRecv.size() + CMessageHeader::HEADER_SIZE;
+            }
+            {
+                LOCK(pnode->cs_vProcessMsg);
+                pnode->vProcessMsg.splice(pnode->vProcessMsg.end(), pnode->vRecvMsg, pnode->vRecvMsg.begin(), it);
+                pnode->nProcessQueueSize += nSizeAdded;
+                pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
+            }
+            WakeMessageHandler();
+        }
+        return nBytes == sizeof(pchBuf);
+    }
+    else if (nBytes == 0)
+    {
+        // socket closed gracefully
+        if (!pnode->fDisconnect) {
+            LogPrint(BCLog::NET, "socket closed\n");
+        }
+        pnode->CloseSocketDisconnect();
+    }
+    else if (nBytes < 0)
+    {
+        // error
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
+        {
+            if (!pnode->fDisconnect)
+                LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
+            pnode->CloseSocketDisconnect();
+        }
+    }
+    return false;
+}
+
+void CConnman::RegisterSocketEvents(CNode* pnode)
+{
+#ifdef USE_EPOLL
+    if (epollfd == -1)
+        return;
+
+    // Edge-triggered, the socket handler keeps the readiness on the node until a call would block
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.ptr = pnode;
+    LOCK(pnode->cs_hSocket);
+    if (pnode->hSocket == INVALID_SOCKET)
+        return;
+    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, pnode->hSocket, &event) != 0) {
+        LogPrintf("Failed to add the socket of peer=%d to the epoll set: %s\n", pnode->GetId(), NetworkErrorString(WSAGetLastError()));
+        pnode->fDisconnect = true;
+    }
+#endif
+}
+
+#ifdef USE_EPOLL
+void CConnman::EpollSocketHandler()
+{
+    // A node left with data to read, e.g. more than one read of it, is serviced without waiting
+    bool fRecvLeft = std::any_of(vReadyNodes.begin(), vReadyNodes.end(), [](const CNode* pnode) {
+        return pnode->fSocketError || (pnode->fRecvReady && !pnode->fPauseRecv && !pnode->fSendPending);
+    });
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int nEvents = epoll_wait(epollfd, events, MAX_EPOLL_EVENTS, fRecvLeft ? 0 : SELECT_TIMEOUT_MILLISECONDS);
+
+    if (interruptNet) return;
+
+    if (nEvents < 0) {
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEINTR) {
+            LogPrintf("socket epoll error %s\n", NetworkErrorString(nErr));
+            interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
+        }
+        return;
+    }
+
+    // Nodes are only deleted by this thread and their sockets are closed before, which
+    // takes them out of the epoll set, so the pointers of the events are valid here.
+    // A node with events joins the ready list, which holds a reference to it.
+    bool fAccept = false;
+    for (int i = 0; i < nEvents; i++) {
+        CNode* pnode = static_cast<CNode*>(events[i].data.ptr);
+        if (!pnode) {
+            fAccept = true;
+            continue;
+        }
+        if (events[i].events & EPOLLIN)
+            pnode->fRecvReady = true;
+        if (events[i].events & EPOLLOUT)
+            pnode->fSendReady = true;
+        // A shutdown is read until recv reports it, the edge does not come again
+        if (events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP))
+            pnode->fSocketError = true;
+        if (!pnode->fReadyListed) {
+            pnode->fReadyListed = true;
+            pnode->AddRef();
+            vReadyNodes.push_back(pnode);
+        }
+    }
+
+    //
+    // Accept new connections
+    //
+    if (fAccept) {
+        for (const ListenSocket& hListenSocket : vhListenSocket) {
+            if (hListenSocket.socket != INVALID_SOCKET)
+                AcceptConnection(hListenSocket);
+        }
+    }
+
+    //
+    // Service the sockets that are ready, the others are not touched
+    //
+    size_t nKeep = 0;
+    for (size_t i = 0; i < vReadyNodes.size(); i++)
+    {
+        CNode* pnode = vReadyNodes[i];
+        if (!interruptNet && !pnode->fDisconnect) {
+            // As with select, the send buffer is drained before more data is received.
+            // An error or shutdown is read from the socket until it is closed.
+            if (pnode->fSocketError || (pnode->fRecvReady && !pnode->fPauseRecv && !pnode->fSendPending)) {
+                pnode->fRecvReady = SocketRecvData(pnode);
+            }
+
+            if (pnode->fSendReady && pnode->fSendPending) {
+                LOCK(pnode->cs_vSend);
+                size_t nBytes = SocketSendData(pnode);
+                if (nBytes) {
+                    RecordBytesSent(nBytes);
+                }
+                // Data left means the socket buffer is full, the next EPOLLOUT edge reports room
+                pnode->fSendReady = !pnode->fSendPending;
+            }
+        }
+
+        // Readiness that could not be used up, e.g. a receive paused by a full process queue
+        // or held back by a pending send, comes with no further edge, the node stays listed
+        if (!pnode->fDisconnect && (pnode->fSocketError || pnode->fRecvReady || (pnode->fSendReady && pnode->fSendPending))) {
+            vReadyNodes[nKeep++] = pnode;
+        } else {
+            pnode->fReadyListed = false;
+            pnode->Release();
+        }
+    }
+    vReadyNodes.resize(nKeep);
+
+    if (interruptNet)
+        return;
+
+    // The timeouts are counted in seconds, idle nodes are checked on a timer instead of every wait
+    int64_t nNow = GetSystemTimeInSeconds();
+    if (nNow - nLastInactivityCheck >= INACTIVITY_CHECK_INTERVAL) {
+        nLastInactivityCheck = nNow;
+        std::vector<CNode*> vNodesCopy;
+        {
+            LOCK(cs_vNodes);
+            vNodesCopy = vNodes;
+            for (CNode* pnode : vNodesCopy)
+                pnode->AddRef();
+        }
+        for (CNode* pnode : vNodesCopy)
+            InactivityCheck(pnode);
+        {
+            LOCK(cs_vNodes);
+            for (CNode* pnode : vNodesCopy)
+                pnode->Release();
+        }
+    }
+}
+#endif
+
 void CConnman::SocketHandler()
 {
+#ifdef USE_EPOLL
+    if (epollfd != -1) {
+        EpollSocketHandler();
+        return;
+    }
+#endif
+
     std::set<SOCKET> recv_set, send_set, error_set;
     SocketEvents(recv_set, send_set, error_set);
 
@@ -1328,57 +1541,7 @@ void CConnman::SocketHandler()
         }
         if (recvSet || errorSet)
         {
-            // typical socket buffer is 8K-64K
-            char pchBuf[0x10000];
-            int nBytes = 0;
-            {
-                LOCK(pnode->cs_hSocket);
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-                nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
-            }
-            if (nBytes > 0)
-            {
-                bool notify = false;
-                if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify))
-                    pnode->CloseSocketDisconnect();
-                RecordBytesRecv(nBytes);
-                if (notify) {
-                    size_t nSizeAdded = 0;
-                    auto it(pnode->vRecvMsg.begin());
-                    for (; it != pnode->vRecvMsg.end(); ++it) {
-                        if (!it->complete())
-                            break;
-                        nSizeAdded += it->vRecv.size() + CMessageHeader::HEADER_SIZE;
-                    }
-                    {
-                        LOCK(pnode->cs_vProcessMsg);
-                        pnode->vProcessMsg.splice(pnode->vProcessMsg.end(), pnode->vRecvMsg, pnode->vRecvMsg.begin(), it);
-                        pnode->nProcessQueueSize += nSizeAdded;
-                        pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
-                    }
-                    WakeMessageHandler();
-                }
-            }
-            else if (nBytes == 0)
-            {
-                // socket closed gracefully
-                if (!pnode->fDisconnect) {
-                    LogPrint(BCLog::NET, "socket closed\n");
-                }
-                pnode->CloseSocketDisconnect();
-            }
-            else if (nBytes < 0)
-            {
-                // error
-                int nErr = WSAGetLastError();
-                if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
-                {
-                    if (!pnode->fDisconnect)
-                        LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
-                    pnode->CloseSocketDisconnect();
-                }
-            }
+            SocketRecvData(pnode);
         }
 
         //
@@ -1969,12 +2132,60 @@ void CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
         pnode->m_manual_connection = true;
 
     m_msgproc->InitializeNode(pnode);
+    RegisterSocketEvents(pnode);
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
     }
 }
 
+void CConnman::QueueMessageWork(CNode* pnode, std::function<void()> fn)
+{
+    pnode->AddRef();
+    pnode->fMessageWork = true;
+    {
+        LOCK(mutexMsgWork);
+        queueMsgWork.emplace_back(pnode, std::move(fn));
+    }
+    condMsgWork.notify_one();
+}
+
+void CConnman::ThreadMessageWorker()
+{
+    while (!flagInterruptMsgProc)
+    {
+        std::pair<CNode*, std::function<void()>> work;
+        {
+            WAIT_LOCK(mutexMsgWork, lock);
+            if (queueMsgWork.empty()) {
+                condMsgWork.wait_for(lock, std::chrono::milliseconds(100));
+                continue;
+            }
+            work = std::move(queueMsgWork.front());
+            queueMsgWork.pop_front();
+        }
+
+        CNode* pnode = work.first;
+        if (!pnode->fDisconnect) {
+            // Caught like in the message handler, a bad request must not take the worker down
+            try {
+                work.second();
+            } catch (const std::exception& e) {
+                LogPrint(BCLog::NET, "%s: Exception '%s' (%s) caught, peer=%d\n", __func__, e.what(), typeid(e).name(), pnode->GetId());
+            } catch (...) {
+                LogPrint(BCLog::NET, "%s: Unknown exception caught, peer=%d\n", __func__, pnode->GetId());
+            }
+        }
+        pnode->fMessageWork = false;
+        {
+            LOCK(cs_vNodes);
+            pnode->Release();
+        }
+        // Let the message handler continue with the node
+        WakeMessageHandler();
+    }
+}
+
 void CConnman::ThreadMessageHandler()
 {
     while (!flagInterruptMsgProc)
@@ -1995,11 +2206,18 @@ void CConnman::ThreadMessageHandler()
             if (pnode->fDisconnect)
                 continue;
 
+            // A worker is handling a message of this node, its later messages wait for it
+            if (pnode->fMessageWork)
+                continue;
+
             // Receive messages
             bool fMoreNodeWork = m_msgproc->ProcessMessages(pnode, flagInterruptMsgProc);
             fMoreWork |= (fMoreNodeWork && !pnode->fPauseSend);
             if (flagInterruptMsgProc)
                 return;
+            // The message may have been handed to a worker, which sends its own reply
+            if (pnode->fMessageWork)
+                continue;
             // Send messages
             {
                 LOCK(pnode->cs_sendProcessing);
@@ -2265,6 +2483,27 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
         semAddnode = MakeUnique<CSemaphore>(nMaxAddnode);
     }
 
+#ifdef USE_EPOLL
+    // The sockets are registered once, the listen sockets level-triggered so that a
+    // backlog of connections is accepted one per iteration like with poll
+    epollfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollfd == -1) {
+        LogPrintf("Failed to create the epoll instance, polling sockets instead: %s\n", NetworkErrorString(WSAGetLastError()));
+    }
+    for (const ListenSocket& hListenSocket : vhListenSocket) {
+        if (epollfd == -1)
+            break;
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;
+        if (epoll_ctl(epollfd, EPOLL_CTL_ADD, hListenSocket.socket, &event) != 0) {
+            LogPrintf("Failed to add a listen socket to the epoll set, polling sockets instead: %s\n", NetworkErrorString(WSAGetLastError()));
+            close(epollfd);
+            epollfd = -1;
+        }
+    }
+#endif
+
     //
     // Start threads
     //
@@ -2300,6 +2539,11 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
     if (connOptions.m_use_addrman_outgoing || !connOptions.m_specified_outgoing.empty())
         threadOpenConnections = std::thread(&TraceThread<std::function<void()> >, "opencon", std::function<void()>(std::bind(&CConnman::ThreadOpenConnections, this, connOptions.m_specified_outgoing)));
 
+    // Answer block, header and tx requests next to the message handler
+    for (int i = 0; i < nMessageWorkers; i++) {
+        threadMessageWorkers.emplace_back(&TraceThread<std::function<void()> >, "msgwork", std::function<void()>(std::bind(&CConnman::ThreadMessageWorker, this)));
+    }
+
     // Process messages
     threadMessageHandler = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
 
@@ -2331,6 +2575,7 @@ void CConnman::Interrupt()
         flagInterruptMsgProc = true;
     }
     condMsgProc.notify_all();
+    condMsgWork.notify_all();
 
     interruptNet();
     InterruptSocks5(true);
@@ -2352,6 +2597,19 @@ void CConnman::Stop()
 {
     if (threadMessageHandler.joinable())
         threadMessageHandler.join();
+    for (std::thread& thread : threadMessageWorkers) {
+        if (thread.joinable())
+            thread.join();
+    }
+    threadMessageWorkers.clear();
+    {
+        LOCK(mutexMsgWork);
+        for (auto& work : queueMsgWork) {
+            work.first->fMessageWork = false;
+            work.first->Release();
+        }
+        queueMsgWork.clear();
+    }
     if (threadOpenConnections.joinable())
         threadOpenConnections.join();
     if (threadOpenAddedConnections.joinable())
@@ -2385,6 +2643,13 @@ void CConnman::Stop()
     vNodes.clear();
     vNodesDisconnected.clear();
     vhListenSocket.clear();
+#ifdef USE_EPOLL
+    if (epollfd != -1) {
+        close(epollfd);
+        epollfd = -1;
+    }
+    vReadyNodes.clear();
+#endif
     semOutbound.reset();
     semAddnode.reset();
 }
@@ -2698,7 +2963,7 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 
     std::vector<unsigned char> serializedHeader;
     serializedHeader.reserve(CMessageHeader::HEADER_SIZE);
-    uint256 hash = Hash(msg.data.data(), msg.data.data() + nMessageSize);
+    uint256 hash = msg.hash.IsNull() ? Hash(msg.data.data(), msg.data.data() + nMessageSize) : msg.hash;
     CMessageHeader hdr(Params().MessageStart(), msg.command.c_str(), nMessageSize);
     memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
 
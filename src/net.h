@@ -85,6 +85,10 @@ static const uint64_t MAX_UPLOAD_TIMEFRAME = 60 * 60 * 24;
 static const bool DEFAULT_BLOCKSONLY = false;
 /** -peertimeout default */
 static const int64_t DEFAULT_PEER_CONNECT_TIMEOUT = 60;
+/** Default for -msgworkers, threads answering block, header and tx requests next to the message handler */
+static const int DEFAULT_MESSAGE_WORKERS = 2;
+/** Maximum number of message workers */
+static const int MAX_MESSAGE_WORKERS = 16;
 
 static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
@@ -114,6 +118,8 @@ struct CSerializedNetMsg
 
     std::vector<unsigned char> data;
     std::string command;
+    //! Hash of data if it is already known, PushMessage computes it otherwise
+    uint256 hash;
 };
 
 
@@ -146,6 +152,7 @@ public:
         uint64_t nMaxOutboundTimeframe = 0;
         uint64_t nMaxOutboundLimit = 0;
         int64_t m_peer_connect_timeout = DEFAULT_PEER_CONNECT_TIMEOUT;
+        int nMessageWorkers = 0;
         std::vector<std::string> vSeedNodes;
         std::vector<NetWhitelistPermissions> vWhitelistedRange;
         std::vector<NetWhitebindPermissions> vWhiteBinds;
@@ -171,6 +178,7 @@ public:
         nSendBufferMaxSize = connOptions.nSendBufferMaxSize;
         nReceiveFloodSize = connOptions.nReceiveFloodSize;
         m_peer_connect_timeout = connOptions.m_peer_connect_timeout;
+        nMessageWorkers = connOptions.nMessageWorkers;
         {
             LOCK(cs_totalBytesSent);
             nMaxOutboundTimeframe = connOptions.nMaxOutboundTimeframe;
@@ -324,6 +332,15 @@ public:
 
     void WakeMessageHandler();
 
+    /**
+     * Handle a message of pnode on a message worker. The message handler skips the node
+     * until fn returns, so the messages of a peer are still handled one at a time and in
+     * the order they were received.
+     */
+    void QueueMessageWork(CNode* pnode, std::function<void()> fn);
+
+    bool HasMessageWorkers() const { return !threadMessageWorkers.empty(); }
+
     /** Attempts to obfuscate tx time through exponentially distributed emitting.
         Works assuming that a single interval is used.
         Variable intervals will result in privacy decrease.
@@ -348,6 +365,7 @@ private:
     void ProcessOneShot();
     void ThreadOpenConnections(std::vector<std::string> connect);
     void ThreadMessageHandler();
+    void ThreadMessageWorker();
     void AcceptConnection(const ListenSocket& hListenSocket);
     void DisconnectNodes();
     void NotifyNumConnectionsChanged();
@@ -355,6 +373,14 @@ private:
     bool GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set);
     void SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set);
     void SocketHandler();
+#ifdef USE_EPOLL
+    /** Wait for the sockets reported ready by epoll and service only those */
+    void EpollSocketHandler();
+#endif
+    /** Add the socket of a node to the epoll set, a closed socket leaves the set by itself */
+    void RegisterSocketEvents(CNode* pnode);
+    /** Read from the socket of pnode, returns true if the read filled the buffer and more data may be waiting */
+    bool SocketRecvData(CNode* pnode);
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
 
@@ -463,13 +489,28 @@ private:
     Mutex mutexMsgProc;
     std::atomic<bool> flagInterruptMsgProc{false};
 
+    int nMessageWorkers;
+    std::condition_variable condMsgWork;
+    Mutex mutexMsgWork;
+    std::deque<std::pair<CNode*, std::function<void()>>> queueMsgWork GUARDED_BY(mutexMsgWork);
+
     CThreadInterrupt interruptNet;
 
     std::thread threadDNSAddressSeed;
+    //! epoll instance of the socket handler, -1 if the sockets are polled
+    int epollfd{-1};
+#ifdef USE_EPOLL
+    //! Nodes with socket readiness left to service, only used by the socket handler
+    std::vector<CNode*> vReadyNodes;
+    //! When the epoll socket handler last ran the inactivity checks of all nodes
+    int64_t nLastInactivityCheck{0};
+#endif
+
     std::thread threadSocketHandler;
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
     std::thread threadMessageHandler;
+    std::vector<std::thread> threadMessageWorkers;
 
     /** flag for deciding to connect to an extra outbound peer,
      *  in excess of m_max_outbound_full_relay
@@ -718,6 +759,17 @@ public:
     const uint64_t nKeyedNetGroup;
     std::atomic_bool fPauseRecv{false};
     std::atomic_bool fPauseSend{false};
+    //! A message of this node is being handled on a message worker
+    std::atomic_bool fMessageWork{false};
+    //! Data is queued in vSendMsg, set whenever the queue is sent from
+    std::atomic_bool fSendPending{false};
+    //! Readiness of the socket reported by epoll, only used by the socket handler.
+    //! Events are edge-triggered, a flag is kept until the socket would block.
+    bool fRecvReady{false};
+    bool fSendReady{false};
+    bool fSocketError{false};
+    //! In the ready list of the socket handler, which holds a reference to the node
+    bool fReadyListed{false};
 
 protected:
     mapMsgCmdSize mapSendBytesPerMsgCmd;
@@ -32,6 +32,9 @@
 #include <clientversion.h>
 #include <consensus/merkle.h>
 #include <shutdown.h>
+#include <blockdownload.h>
+#include <qtum/orphanblocks.h>
+#include <rawblockcache.h>
 
 #include <memory>
 #include <typeinfo>
@@ -98,16 +101,7 @@ std::map<uint256, COrphanTx> mapOrphanTransactions GUARDED_BY(g_cs_orphans);
 
 void EraseOrphansFor(NodeId peer);
 
-struct COrphanBlock {
-    uint256 hashBlock;
-    uint256 hashPrev;
-    std::pair<COutPoint, unsigned int> stake;
-    std::vector<unsigned char> vchBlock;
-};
-std::map<uint256, COrphanBlock*> mapOrphanBlocks GUARDED_BY(cs_main);
-std::multimap<uint256, COrphanBlock*> mapOrphanBlocksByPrev GUARDED_BY(cs_main);
-std::set<std::pair<COutPoint, unsigned int>> setStakeSeenOrphan GUARDED_BY(cs_main);
-size_t nOrphanBlocksSize = 0;
+OrphanBlocks orphanBlocks GUARDED_BY(cs_main);
 
 /** Increase a node's misbehavior score. */
 void Misbehaving(NodeId nodeid, int howmuch, const std::string& message="") EXCLUSIVE_LOCKS_REQUIRED(cs_main);
@@ -340,8 +334,14 @@ struct CNodeState {
     std::list<QueuedBlock> vBlocksInFlight;
     //! When the first entry in vBlocksInFlight started downloading. Don't care when vBlocksInFlight is empty.
     int64_t nDownloadingSince;
+    //! When the previous block of this peer was received (or the batch started), the start of the next download measurement
+    int64_t nMeasureSince;
     int nBlocksInFlight;
     int nBlocksInFlightValidHeaders;
+    //! Number of blocks to keep in flight, adapted to the measured download of the peer
+    BlockDownloadWindow downloadWindow{MAX_BLOCKS_IN_TRANSIT_PER_PEER};
+    //! Blocks requested from this peer that were in flight from a slower one
+    int nBlocksReassigned;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
     //! Whether this peer wants invs or headers (when possible) for block announcements.
@@ -363,6 +363,10 @@ struct CNodeState {
      * otherwise: whether this peer sends non-witnesses in cmpctblocks/blocktxns.
      */
     bool fSupportsDesiredCmpctVersion;
+    //! Txs this peer prefilled in its compact blocks, the coinbase and the coinstake included
+    uint64_t nCmpctTxPrefilled;
+    //! Compact blocks from this peer completed without a getblocktxn
+    uint64_t nCmpctRoundTripsSaved;
 
     /** State used to enforce CHAIN_SYNC_TIMEOUT
       * Only in effect for outbound, non-manual, full-relay connections, with
@@ -479,8 +483,10 @@ struct CNodeState {
         nHeadersSyncTimeout = 0;
         nStallingSince = 0;
         nDownloadingSince = 0;
+        nMeasureSince = 0;
         nBlocksInFlight = 0;
         nBlocksInFlightValidHeaders = 0;
+        nBlocksReassigned = 0;
         fPreferredDownload = false;
         fPreferHeaders = false;
         fPreferHeaderAndIDs = false;
@@ -488,6 +494,8 @@ struct CNodeState {
         fHaveWitness = false;
         fWantsCmpctWitness = false;
         fSupportsDesiredCmpctVersion = false;
+        nCmpctTxPrefilled = 0;
+        nCmpctRoundTripsSaved = 0;
         m_chain_sync = { 0, nullptr, false, false };
         m_last_block_announcement = 0;
     }
@@ -627,6 +635,7 @@ static bool MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const CBlock
     if (state->nBlocksInFlight == 1) {
         // We're starting a block download (batch) from this peer.
         state->nDownloadingSince = GetTimeMicros();
+        state->nMeasureSince = state->nDownloadingSince;
     }
     if (state->nBlocksInFlightValidHeaders == 1 && pindex != nullptr) {
         nPeersWithValidatedDownloads++;
@@ -637,6 +646,60 @@ static bool MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const CBlock
     return true;
 }
 
+/** Measure the download of a block received from pfrom, before it is marked as received */
+static void MeasureBlockDownload(CNode* pfrom, const uint256& hash, uint64_t nBytes, int64_t nTimeReceived) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
+    if (itInFlight == mapBlocksInFlight.end() || itInFlight->second.first != pfrom->GetId())
+        return;
+    CNodeState *state = State(pfrom->GetId());
+    assert(state != nullptr);
+    // Blocks arrive in the order they were requested, the head of the queue has been
+    // downloading since the previous block arrived. A block out of order is not measured.
+    // Time it by when the message came off the wire, not by when it is processed here,
+    // so a backlog in the message handler isn't charged to the peer.
+    if (state->vBlocksInFlight.begin() != itInFlight->second.second)
+        return;
+    int64_t nRtt = pfrom->nMinPingUsecTime;
+    if (nRtt == std::numeric_limits<int64_t>::max())
+        nRtt = 0;
+    if (nTimeReceived > state->nMeasureSince)
+        state->downloadWindow.received(nTimeReceived - state->nMeasureSince, nBytes, nRtt);
+    state->nMeasureSince = std::max(state->nMeasureSince, nTimeReceived);
+}
+
+/**
+ * Request the block holding back the download window from nodeid instead of the peer it is
+ * in flight from, if nodeid is expected to deliver it several times sooner. Both peers must
+ * have been measured. @return whether the block is now in flight from nodeid
+ */
+static bool ReassignStalledBlock(NodeId nodeid, NodeId staller, const CBlockIndex* pindex, int64_t nNow) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    CNodeState *state = State(nodeid);
+    CNodeState *stateStaller = State(staller);
+    assert(state != nullptr && stateStaller != nullptr);
+    if (!state->downloadWindow.measured() || !stateStaller->downloadWindow.measured())
+        return false;
+
+    // The blocks ahead of it in the queue of the staller arrive first
+    int nPos = 0;
+    for (const QueuedBlock& queued : stateStaller->vBlocksInFlight) {
+        if (queued.hash == pindex->GetBlockHash())
+            break;
+        nPos++;
+    }
+    if (nPos == (int)stateStaller->vBlocksInFlight.size())
+        return false;
+    // A peer that is already late is assumed to take at least as long again
+    int64_t nStallerDelivery = std::max(stateStaller->nDownloadingSince + stateStaller->downloadWindow.serviceTime() * (nPos + 1) - nNow,
+                                        nNow - stateStaller->nDownloadingSince);
+    int64_t nDelivery = state->downloadWindow.expectedDelivery(state->nBlocksInFlight);
+    if (nStallerDelivery < BLOCK_REASSIGN_MIN_WAIT || nStallerDelivery < BLOCK_REASSIGN_FACTOR * nDelivery)
+        return false;
+
+    MarkBlockAsInFlight(nodeid, pindex->GetBlockHash(), pindex);
+    state->nBlocksReassigned++;
+    return true;
+}
+
 /** Check whether the last unknown block a peer advertised is not yet known. */
 static void ProcessBlockAvailability(NodeId nodeid) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
     CNodeState *state = State(nodeid);
@@ -739,7 +802,7 @@ static bool PeerHasHeader(CNodeState *state, const CBlockIndex *pindex) EXCLUSIV
 
 /** Update pindexLastCommonBlock and add not-in-flight missing successors to vBlocks, until it has
  *  at most count entries. */
-static void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<const CBlockIndex*>& vBlocks, NodeId& nodeStaller, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+static void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<const CBlockIndex*>& vBlocks, NodeId& nodeStaller, const CBlockIndex*& pindexStalled, const Consensus::Params& consensusParams) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     if (count == 0)
         return;
@@ -776,6 +839,7 @@ static void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vec
     int nWindowEnd = state->pindexLastCommonBlock->nHeight + BLOCK_DOWNLOAD_WINDOW;
     int nMaxHeight = std::min<int>(state->pindexBestKnownBlock->nHeight, nWindowEnd + 1);
     NodeId waitingfor = -1;
+    const CBlockIndex* pindexWaitingFor = nullptr;
     while (pindexWalk->nHeight < nMaxHeight) {
         // Read up to 128 (or more, if more blocks than that are needed) successors of pindexWalk (towards
         // pindexBestKnownBlock) into vToFetch. We fetch 128, because CBlockIndex::GetAncestor may be as expensive
@@ -811,6 +875,7 @@ static void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vec
                     if (vBlocks.size() == 0 && waitingfor != nodeid) {
                         // We aren't able to fetch anything, but we would be if the download window was one larger.
                         nodeStaller = waitingfor;
+                        pindexStalled = pindexWaitingFor;
                     }
                     return;
                 }
@@ -821,6 +886,7 @@ static void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vec
             } else if (waitingfor == -1) {
                 // This is the first already-in-flight block.
                 waitingfor = mapBlocksInFlight[pindex->GetBlockHash()].first;
+                pindexWaitingFor = pindex;
             }
         }
     }
@@ -961,6 +1027,13 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
     stats.nMisbehavior = state->nMisbehavior;
     stats.nSyncHeight = state->pindexBestKnownBlock ? state->pindexBestKnownBlock->nHeight : -1;
     stats.nCommonHeight = state->pindexLastCommonBlock ? state->pindexLastCommonBlock->nHeight : -1;
+    stats.nCmpctTxPrefilled = state->nCmpctTxPrefilled;
+    stats.nCmpctRoundTripsSaved = state->nCmpctRoundTripsSaved;
+    stats.nBlockWindow = state->downloadWindow.size();
+    stats.nBlockServiceTime = state->downloadWindow.serviceTime();
+    stats.nBlocksDownloaded = state->downloadWindow.blocks();
+    stats.nBlockDownloadTime = state->downloadWindow.downloadTime();
+    stats.nBlocksReassigned = state->nBlocksReassigned;
     for (const QueuedBlock& queue : state->vBlocksInFlight) {
         if (queue.pindex)
             stats.vHeightInFlight.push_back(queue.pindex->nHeight);
@@ -968,6 +1041,13 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
     return true;
 }
 
+void GetOrphanBlocksInfo(size_t& count, size_t& bytes, size_t& usage) {
+    LOCK(cs_main);
+    count = orphanBlocks.size();
+    bytes = orphanBlocks.bytes();
+    usage = orphanBlocks.usage();
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // mapOrphanTransactions
@@ -1510,6 +1590,36 @@ static void RelayAddress(const CAddress& addr, bool fReachable, CConnman* connma
     connman->ForEachNodeThen(std::move(sortfunc), std::move(pushfunc));
 }
 
+/**
+ * Read a block as stored on disk, through the raw block cache if it is enabled. The position
+ * is copied under cs_main by the caller, the read checks it still holds the block of that hash.
+ */
+static std::shared_ptr<const RawBlock> ReadRawBlock(const FlatFilePos& pos, const uint256& hash, const CChainParams& chainparams)
+{
+    if (prawblockcache) {
+        std::shared_ptr<const RawBlock> cached = prawblockcache->get(hash);
+        if (cached)
+            return cached;
+    }
+
+    std::shared_ptr<RawBlock> raw = std::make_shared<RawBlock>();
+    if (!ReadRawBlockFromDisk(raw->data, pos, chainparams.MessageStart()))
+        return nullptr;
+    CBlockHeader header;
+    try {
+        VectorReader(SER_NETWORK, PROTOCOL_VERSION, raw->data, 0) >> header;
+    } catch (const std::exception&) {
+        return nullptr;
+    }
+    if (header.GetHash() != hash)
+        return nullptr;
+    raw->hash = Hash(raw->data.begin(), raw->data.end());
+    raw->fWitness = RawBlockHasWitness(raw->data);
+    if (prawblockcache)
+        prawblockcache->insert(hash, raw);
+    return raw;
+}
+
 void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, const CInv& inv, CConnman* connman)
 {
     bool send = false;
@@ -1547,15 +1657,23 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
         }
     }
 
+    // The checks are done under cs_main, the block is read from disk and sent without it so
+    // that serving old blocks does not hold up validation and the other peers
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    const CBlockIndex* pindex = nullptr;
+    FlatFilePos pos;
+    bool fCompact = false;
+    bool fPeerWantsWitness = false;
+    uint256 hashTip;
+    {
     LOCK(cs_main);
-    const CBlockIndex* pindex = LookupBlockIndex(inv.hash);
+    pindex = LookupBlockIndex(inv.hash);
     if (pindex) {
         send = BlockRequestAllowed(pindex, consensusParams);
         if (!send) {
             LogPrint(BCLog::NET, "%s: ignoring request from peer=%i for old block that isn't in the main chain\n", __func__, pfrom->GetId());
         }
     }
-    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
     // disconnect node in case we have reached the outbound limit for serving historical blocks
     // never disconnect whitelisted nodes
     if (send && connman->OutboundTargetReached(true) && ( ((pindexBestHeader != nullptr) && (pindexBestHeader->GetBlockTime() - pindex->GetBlockTime() > HISTORICAL_BLOCK_AGE)) || inv.type == MSG_FILTERED_BLOCK) && !pfrom->HasPermission(PF_NOBAN))
@@ -1578,25 +1696,47 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
     }
     // Pruned nodes may have deleted the block, so check whether
     // it's available before trying to send.
-    if (send && (pindex->nStatus & BLOCK_HAVE_DATA))
+    send = send && (pindex->nStatus & BLOCK_HAVE_DATA);
+    if (send) {
+        fPeerWantsWitness = State(pfrom->GetId())->fWantsCmpctWitness;
+        fCompact = CanDirectFetch(consensusParams) && pindex->nHeight >= ::ChainActive().Height() - MAX_CMPCTBLOCK_DEPTH;
+        hashTip = ::ChainActive().Tip()->GetBlockHash();
+        // Pruning may delete the file once cs_main is released, read from where the block was
+        pos = pindex->GetBlockPos();
+    }
+    } // release cs_main
+    if (send)
     {
         std::shared_ptr<const CBlock> pblock;
         if (a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash()) {
             pblock = a_recent_block;
-        } else if (inv.type == MSG_WITNESS_BLOCK) {
+        } else if (inv.type == MSG_WITNESS_BLOCK || inv.type == MSG_BLOCK) {
             // Fast-path: in this case it is possible to serve the block directly from disk,
-            // as the network format matches the format on disk
-            std::vector<uint8_t> block_data;
-            if (!ReadRawBlockFromDisk(block_data, pindex, chainparams.MessageStart())) {
-                assert(!"cannot load block from disk");
+            // as the network format matches the format on disk. Without witness data that
+            // is also the format of the stripped block.
+            std::shared_ptr<const RawBlock> raw = ReadRawBlock(pos, inv.hash, chainparams);
+            if (!raw) {
+                // Without cs_main the block may have been pruned since the checks
+                LogPrint(BCLog::NET, "%s: cannot load block %s from disk for peer=%d\n", __func__, inv.hash.ToString(), pfrom->GetId());
+                return;
+            }
+            if (inv.type == MSG_WITNESS_BLOCK || !raw->fWitness) {
+                CSerializedNetMsg msg = msgMaker.Make(NetMsgType::BLOCK, MakeSpan(raw->data));
+                msg.hash = raw->hash;
+                connman->PushMessage(pfrom, std::move(msg));
+                // Don't set pblock as we've sent the block
+            } else {
+                std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+                VectorReader(SER_NETWORK, PROTOCOL_VERSION, raw->data, 0) >> *pblockRead;
+                pblock = pblockRead;
             }
-            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, MakeSpan(block_data)));
-            // Don't set pblock as we've sent the block
         } else {
             // Send block from disk
             std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
-            if (!ReadBlockFromDisk(*pblockRead, pindex, consensusParams))
-                assert(!"cannot load block from disk");
+            if (!ReadBlockFromDisk(*pblockRead, pos, consensusParams) || pblockRead->GetHash() != inv.hash) {
+                LogPrint(BCLog::NET, "%s: cannot load block %s from disk for peer=%d\n", __func__, inv.hash.ToString(), pfrom->GetId());
+                return;
+            }
             pblock = pblockRead;
         }
         if (pblock) {
@@ -1636,9 +1776,8 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
                 // they won't have a useful mempool to match against a compact block,
                 // and we don't feel like constructing the object for them, so
                 // instead we respond with the full, non-compact block.
-                bool fPeerWantsWitness = State(pfrom->GetId())->fWantsCmpctWitness;
                 int nSendFlags = fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
-                if (CanDirectFetch(consensusParams) && pindex->nHeight >= ::ChainActive().Height() - MAX_CMPCTBLOCK_DEPTH) {
+                if (fCompact) {
                     if ((fPeerWantsWitness || !fWitnessesPresentInARecentCompactBlock) && a_recent_compact_block && a_recent_compact_block->header.GetHash() == pindex->GetBlockHash()) {
                         connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *a_recent_compact_block));
                     } else {
@@ -1658,7 +1797,7 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
             // and we want it right after the last block so they don't
             // wait for other stuff first.
             std::vector<CInv> vInv;
-            vInv.push_back(CInv(MSG_BLOCK, ::ChainActive().Tip()->GetBlockHash()));
+            vInv.push_back(CInv(MSG_BLOCK, hashTip));
             connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::INV, vInv));
             pfrom->hashContinue.SetNull();
         }
@@ -1872,7 +2011,7 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
             std::vector<const CBlockIndex*> vToFetch;
             const CBlockIndex *pindexWalk = pindexLast;
             // Calculate all the blocks we'd need to switch to pindexLast, up to a limit.
-            while (pindexWalk && !::ChainActive().Contains(pindexWalk) && vToFetch.size() <= MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+            while (pindexWalk && !::ChainActive().Contains(pindexWalk) && vToFetch.size() <= (size_t)nodestate->downloadWindow.size()) {
                 if (!(pindexWalk->nStatus & BLOCK_HAVE_DATA) &&
                         !mapBlocksInFlight.count(pindexWalk->GetBlockHash()) &&
                         (!IsWitnessEnabled(pindexWalk->pprev, chainparams.GetConsensus()) || State(pfrom->GetId())->fHaveWitness)) {
@@ -1893,7 +2032,7 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
                 std::vector<CInv> vGetData;
                 // Download as much as possible, from earliest to latest.
                 for (const CBlockIndex *pindex : reverse_iterate(vToFetch)) {
-                    if (nodestate->nBlocksInFlight >= MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+                    if (nodestate->nBlocksInFlight >= nodestate->downloadWindow.size()) {
                         // Can't download any more from this peer
                         break;
                     }
@@ -2553,6 +2692,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             return true;
         }
 
+        FlatFilePos pos;
+        {
         LOCK(cs_main);
 
         const CBlockIndex* pindex = LookupBlockIndex(req.blockhash);
@@ -2577,10 +2718,15 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             // The message processing loop will go around again (without pausing) and we'll respond then (without cs_main)
             return true;
         }
+        // Pruning may delete the file once cs_main is released, read from where the block was
+        pos = pindex->GetBlockPos();
+        } // release cs_main
 
         CBlock block;
-        bool ret = ReadBlockFromDisk(block, pindex, chainparams.GetConsensus());
-        assert(ret);
+        if (!ReadBlockFromDisk(block, pos, chainparams.GetConsensus()) || block.GetHash() != req.blockhash) {
+            LogPrint(BCLog::NET, "Cannot load block %s for the getblocktxn of peer=%d\n", req.blockhash.ToString(), pfrom->GetId());
+            return true;
+        }
 
         SendBlockTransactions(block, req, pfrom, connman);
         return true;
@@ -2597,6 +2743,9 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             return true;
         }
 
+        // we must use CBlocks, as CBlockHeaders won't include the 0x00 nTx count at the end
+        std::vector<CBlock> vHeaders;
+        {
         LOCK(cs_main);
         if (::ChainstateActive().IsInitialBlockDownload() && !pfrom->HasPermission(PF_NOBAN)) {
             LogPrint(BCLog::NET, "Ignoring getheaders from peer=%d because node is in initial block download\n", pfrom->GetId());
@@ -2626,8 +2775,6 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 pindex = ::ChainActive().Next(pindex);
         }
 
-        // we must use CBlocks, as CBlockHeaders won't include the 0x00 nTx count at the end
-        std::vector<CBlock> vHeaders;
         int nLimit = MAX_HEADERS_RESULTS;
         LogPrint(BCLog::NET, "getheaders %d to %s from peer=%d\n", (pindex ? pindex->nHeight : -1), hashStop.IsNull() ? "end" : hashStop.ToString(), pfrom->GetId());
         for (; pindex; pindex = ::ChainActive().Next(pindex))
@@ -2649,6 +2796,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         // will re-announce the new block via headers (or compact blocks again)
         // in the SendMessages logic.
         nodestate->pindexBestHeaderSent = pindex ? pindex : ::ChainActive().Tip();
+        } // release cs_main, the headers are serialized without it
         connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::HEADERS, vHeaders));
         return true;
     }
@@ -2934,6 +3082,9 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                     if (!partialBlock.IsTxAvailable(i))
                         req.indexes.push_back(i);
                 }
+                nodestate->nCmpctTxPrefilled += cmpctblock.prefilledtxn.size();
+                if (req.indexes.empty())
+                    nodestate->nCmpctRoundTripsSaved++;
                 if (req.indexes.empty()) {
                     // Dirty hack to jump to BLOCKTXN code (TODO: move message handling into their own functions)
                     BlockTransactions txn;
@@ -3140,6 +3291,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             return true;
         }
 
+        const uint64_t nBlockSize = vRecv.size();
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
         vRecv >> *pblock;
 
@@ -3149,6 +3301,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         const uint256 hash(pblock->GetHash());
         {
             LOCK(cs_main);
+            MeasureBlockDownload(pfrom, hash, nBlockSize, nTimeReceived);
             // Also always process if we requested the block explicitly, as we may
             // need it even though it is not a candidate for a new best tip.
             forceProcessing |= MarkBlockAsReceived(hash);
@@ -3441,6 +3594,15 @@ bool PeerLogicValidation::SendRejectsAndCheckIfBanned(CNode* pnode, bool enable_
     return false;
 }
 
+/** Requests answered from the chain without changing it, they can be handled on a message worker */
+static bool IsWorkerMessage(const std::string& strCommand)
+{
+    return strCommand == NetMsgType::GETDATA ||
+           strCommand == NetMsgType::GETBLOCKS ||
+           strCommand == NetMsgType::GETHEADERS ||
+           strCommand == NetMsgType::GETBLOCKTXN;
+}
+
 bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& interruptMsgProc)
 {
     const CChainParams& chainparams = Params();
@@ -3454,8 +3616,16 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     //
     bool fMoreWork = false;
 
-    if (!pfrom->vRecvGetData.empty())
+    if (!pfrom->vRecvGetData.empty()) {
+        if (connman->HasMessageWorkers() && !pfrom->fPauseSend) {
+            CConnman* connman = this->connman;
+            connman->QueueMessageWork(pfrom, [pfrom, connman, &interruptMsgProc]() {
+                ProcessGetData(pfrom, Params(), connman, interruptMsgProc);
+            });
+            return false;
+        }
         ProcessGetData(pfrom, chainparams, connman, interruptMsgProc);
+    }
 
     if (!pfrom->orphan_work_set.empty()) {
         std::list<CTransactionRef> removed_txn;
@@ -3512,7 +3682,6 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     unsigned int nMessageSize = hdr.nMessageSize;
 
     // Checksum
-    CDataStream& vRecv = msg.vRecv;
     const uint256& hash = msg.GetMessageHash();
     if (memcmp(hash.begin(), hdr.pchChecksum, CMessageHeader::CHECKSUM_SIZE) != 0)
     {
@@ -3523,11 +3692,32 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         return fMoreWork;
     }
 
+    // Requests only reading the chain are answered on a message worker, the node
+    // is skipped by the message handler until the answer is sent
+    if (connman->HasMessageWorkers() && IsWorkerMessage(strCommand)) {
+        std::shared_ptr<std::list<CNetMessage>> work = std::make_shared<std::list<CNetMessage>>();
+        work->splice(work->begin(), msgs);
+        connman->QueueMessageWork(pfrom, [this, pfrom, work, &interruptMsgProc]() {
+            HandleMessage(pfrom, work->front(), interruptMsgProc);
+        });
+        return fMoreWork;
+    }
+
+    return HandleMessage(pfrom, msg, interruptMsgProc) || fMoreWork;
+}
+
+bool PeerLogicValidation::HandleMessage(CNode* pfrom, CNetMessage& msg, std::atomic<bool>& interruptMsgProc)
+{
+    const CChainParams& chainparams = Params();
+    const std::string strCommand = msg.hdr.GetCommand();
+    unsigned int nMessageSize = msg.hdr.nMessageSize;
+    bool fMoreWork = false;
+
     // Process message
     bool fRet = false;
     try
     {
-        fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime, chainparams, connman, interruptMsgProc, m_enable_bip61);
+        fRet = ProcessMessage(pfrom, strCommand, msg.vRecv, msg.nTime, chainparams, connman, interruptMsgProc, m_enable_bip61);
         if (interruptMsgProc)
             return false;
         if (!pfrom->vRecvGetData.empty())
@@ -4158,10 +4348,11 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
         // Message: getdata (blocks)
         //
         std::vector<CInv> vGetData;
-        if (!pto->fClient && ((fFetch && !pto->m_limited_node) || !::ChainstateActive().IsInitialBlockDownload()) && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        if (!pto->fClient && ((fFetch && !pto->m_limited_node) || !::ChainstateActive().IsInitialBlockDownload()) && state.nBlocksInFlight < state.downloadWindow.size()) {
             std::vector<const CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller, consensusParams);
+            const CBlockIndex* pindexStalled = nullptr;
+            FindNextBlocksToDownload(pto->GetId(), state.downloadWindow.size() - state.nBlocksInFlight, vToDownload, staller, pindexStalled, consensusParams);
             for (const CBlockIndex *pindex : vToDownload) {
                 uint32_t nFetchFlags = GetFetchFlags(pto);
                 vGetData.push_back(CInv(MSG_BLOCK | nFetchFlags, pindex->GetBlockHash()));
@@ -4169,6 +4360,13 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                 LogPrint(BCLog::NET, "Requesting block %s (%d) peer=%d\n", pindex->GetBlockHash().ToString(),
                     pindex->nHeight, pto->GetId());
             }
+            // Rather than wait for a slow peer to deliver the block holding back the window, fetch it from this one
+            if (staller != -1 && pindexStalled != nullptr && ReassignStalledBlock(pto->GetId(), staller, pindexStalled, nNow)) {
+                vGetData.push_back(CInv(MSG_BLOCK | GetFetchFlags(pto), pindexStalled->GetBlockHash()));
+                LogPrint(BCLog::NET, "Requesting block %s (%d) peer=%d, reassigned from slower peer=%d\n", pindexStalled->GetBlockHash().ToString(),
+                    pindexStalled->nHeight, pto->GetId(), staller);
+                staller = -1;
+            }
             if (state.nBlocksInFlight == 0 && staller != -1) {
                 if (State(staller)->nStallingSince == 0) {
                     State(staller)->nStallingSince = nNow;
@@ -4277,57 +4475,13 @@ void PushGetBlocks(CNode* pnode, const CBlockIndex* pindexBegin, const uint256&
     connman.PushMessage(pnode, msgMaker.Make(NetMsgType::GETBLOCKS, ::ChainActive().GetLocator(pindexBegin), hashEnd));
 }
 
-uint256 static GetOrphanRoot(const uint256& hash)
-{
-    std::map<uint256, COrphanBlock*>::iterator it = mapOrphanBlocks.find(hash);
-    if (it == mapOrphanBlocks.end())
-        return hash;
-
-    // Work back to the first block in the orphan chain
-    do {
-        std::map<uint256, COrphanBlock*>::iterator it2 = mapOrphanBlocks.find(it->second->hashPrev);
-        if (it2 == mapOrphanBlocks.end())
-            return it->first;
-        it = it2;
-    } while(true);
-}
-
-// ppcoin: find block wanted by given orphan block
-uint256 WantedByOrphan(const COrphanBlock* pblockOrphan)
-{
-    // Work back to the first block in the orphan chain
-    while (mapOrphanBlocks.count(pblockOrphan->hashPrev))
-        pblockOrphan = mapOrphanBlocks[pblockOrphan->hashPrev];
-    return pblockOrphan->hashPrev;
-}
-
-// Remove a random orphan block (which does not have any dependent orphans).
-void static PruneOrphanBlocks()
+// Drop the expired orphan blocks and the oldest ones above -maxorphanblocksmib
+void static PruneOrphanBlocks() EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     size_t nMaxOrphanBlocksSize = gArgs.GetArg("-maxorphanblocksmib", DEFAULT_MAX_ORPHAN_BLOCKS) * ((size_t) 1 << 20);
-    while (nOrphanBlocksSize > nMaxOrphanBlocksSize)
-    {
-        // Pick a random orphan block.
-        uint256 randomhash = GetRandHash();
-        std::multimap<uint256, COrphanBlock*>::iterator it = mapOrphanBlocksByPrev.lower_bound(randomhash);
-        if (it == mapOrphanBlocksByPrev.end())
-            it = mapOrphanBlocksByPrev.begin();
-
-        // As long as this block has other orphans depending on it, move to one of those successors.
-        do {
-            std::multimap<uint256, COrphanBlock*>::iterator it2 = mapOrphanBlocksByPrev.find(it->second->hashBlock);
-            if (it2 == mapOrphanBlocksByPrev.end())
-                break;
-            it = it2;
-        } while(1);
-
-        setStakeSeenOrphan.erase(it->second->stake);
-        uint256 hash = it->second->hashBlock;
-        nOrphanBlocksSize -= it->second->vchBlock.size();
-        delete it->second;
-        mapOrphanBlocksByPrev.erase(it);
-        mapOrphanBlocks.erase(hash);
-    }
+    size_t nErased = orphanBlocks.limit(nMaxOrphanBlocksSize, GetTime());
+    if (nErased > 0)
+        LogPrint(BCLog::NET, "orphanblocks: dropped %u orphan blocks, %u left\n", nErased, orphanBlocks.size());
 }
 
 bool ProcessNetBlock(const CChainParams& chainparams, const std::shared_ptr<const CBlock> pblock, bool fForceProcessing, bool* fNewBlock, CNode* pfrom, CConnman& connman)
@@ -4347,7 +4501,7 @@ bool ProcessNetBlock(const CChainParams& chainparams, const std::shared_ptr<cons
         // Duplicate stake allowed only when there is orphan child block
         // if the block header is already known, allow it (to account for headers being sent before the block itself)
         uint256 hash = pblock->GetHash();
-        if (!fReindex && !fImporting && pblock->IsProofOfStake() && ::ChainstateActive().setStakeSeen.count(pblock->GetProofOfStake()) && !::BlockIndex().count(hash) && !mapOrphanBlocksByPrev.count(hash))
+        if (!fReindex && !fImporting && pblock->IsProofOfStake() && ::ChainstateActive().setStakeSeen.count(pblock->GetProofOfStake()) && !::BlockIndex().count(hash) && !orphanBlocks.haveChildren(hash))
             return error("ProcessNetBlock() : duplicate proof-of-stake (%s, %d) for block %s", pblock->GetProofOfStake().first.ToString(), pblock->GetProofOfStake().second, hash.ToString());
 
         // Process the header before processing the block
@@ -4360,7 +4514,7 @@ bool ProcessNetBlock(const CChainParams& chainparams, const std::shared_ptr<cons
             }
         }
 
-        if (mapOrphanBlocks.count(hash))
+        if (orphanBlocks.have(hash))
             return error("ProcessNetBlock() : already have block (orphan) %s", hash.ToString());
 
         // Check for the checkpoint
@@ -4390,7 +4544,7 @@ bool ProcessNetBlock(const CChainParams& chainparams, const std::shared_ptr<cons
         // If we don't already have its previous block, shunt it off to holding area until we get it
         if (!::BlockIndex().count(pblock->hashPrevBlock))
         {
-            LogPrintf("ProcessNetBlock: ORPHAN BLOCK %lu, prev=%s\n", (unsigned long)mapOrphanBlocks.size(), pblock->hashPrevBlock.ToString());
+            LogPrintf("ProcessNetBlock: ORPHAN BLOCK %lu, prev=%s\n", (unsigned long)orphanBlocks.size(), pblock->hashPrevBlock.ToString());
 
             // Accept orphans as long as there is a node to request its parents from
             if (pfrom) {
@@ -4399,27 +4553,14 @@ bool ProcessNetBlock(const CChainParams& chainparams, const std::shared_ptr<cons
                 {
                     // Limited duplicity on stake: prevents block flood attack
                     // Duplicate stake allowed only when there is orphan child block
-                    if (setStakeSeenOrphan.count(pblock->GetProofOfStake()) && !mapOrphanBlocksByPrev.count(hash))
+                    if (orphanBlocks.haveStake(pblock->GetProofOfStake()) && !orphanBlocks.haveChildren(hash))
                         return error("ProcessNetBlock() : duplicate proof-of-stake (%s, %d) for orphan block %s", pblock->GetProofOfStake().first.ToString(), pblock->GetProofOfStake().second, hash.ToString());
                 }
                 PruneOrphanBlocks();
-                COrphanBlock* pblock2 = new COrphanBlock();
-                {
-                    CDataStream ss(SER_DISK, CLIENT_VERSION);
-                    ss << *pblock;
-                    pblock2->vchBlock = std::vector<unsigned char>(ss.begin(), ss.end());
-                }
-                pblock2->hashBlock = hash;
-                pblock2->hashPrev = pblock->hashPrevBlock;
-                pblock2->stake = pblock->GetProofOfStake();
-                nOrphanBlocksSize += pblock2->vchBlock.size();
-                mapOrphanBlocks.insert(std::make_pair(hash, pblock2));
-                mapOrphanBlocksByPrev.insert(std::make_pair(pblock2->hashPrev, pblock2));
-                if (pblock->IsProofOfStake())
-                    setStakeSeenOrphan.insert(pblock->GetProofOfStake());
+                orphanBlocks.add(pblock, GetTime());
 
                 // Ask this guy to fill in what we're missing
-                PushGetBlocks(pfrom, pindexBestHeader, GetOrphanRoot(hash), connman);
+                PushGetBlocks(pfrom, pindexBestHeader, orphanBlocks.root(hash), connman);
             }
             return true;
         }
@@ -4428,36 +4569,21 @@ bool ProcessNetBlock(const CChainParams& chainparams, const std::shared_ptr<cons
     if(!ProcessNewBlock(chainparams, pblock, fForceProcessing, fNewBlock))
         return error("%s: ProcessNewBlock FAILED", __func__);
 
-    std::vector<uint256> vWorkQueue;
-    vWorkQueue.push_back(pblock->GetHash());
-    for (unsigned int i = 0; i < vWorkQueue.size(); i++)
+    // The orphans built on the block are taken in one go, parents before children, and
+    // connected without cs_main. An orphan is dropped when its parent fails.
+    std::vector<std::shared_ptr<const CBlock>> vOrphans;
     {
-        uint256 hashPrev = vWorkQueue[i];
-        for (std::multimap<uint256, COrphanBlock*>::iterator mi = mapOrphanBlocksByPrev.lower_bound(hashPrev);
-             mi != mapOrphanBlocksByPrev.upper_bound(hashPrev);
-             ++mi)
-        {
-            CBlock block;
-            {
-                CDataStream ss(mi->second->vchBlock, SER_DISK, CLIENT_VERSION);
-                ss >> block;
-            }
-            block.hashMerkleRoot = BlockMerkleRoot(block);
-
-            bool fNewBlockOrphan = false;
-            std::shared_ptr<const CBlock> shared_pblock = std::make_shared<const CBlock>(block);
-            if (ProcessNewBlock(chainparams, shared_pblock, fForceProcessing, &fNewBlockOrphan))
-                vWorkQueue.push_back(mi->second->hashBlock);
-
-            LOCK(cs_main);
-            mapOrphanBlocks.erase(mi->second->hashBlock);
-            setStakeSeenOrphan.erase(block.GetProofOfStake());
-            nOrphanBlocksSize -= mi->second->vchBlock.size();
-            delete mi->second;
-        }
-
         LOCK(cs_main);
-        mapOrphanBlocksByPrev.erase(hashPrev);
+        vOrphans = orphanBlocks.takeChildren(pblock->GetHash());
+    }
+    std::set<uint256> setConnected{pblock->GetHash()};
+    for (const std::shared_ptr<const CBlock>& pblockOrphan : vOrphans)
+    {
+        if (!setConnected.count(pblockOrphan->hashPrevBlock))
+            continue;
+        bool fNewBlockOrphan = false;
+        if (ProcessNewBlock(chainparams, pblockOrphan, fForceProcessing, &fNewBlockOrphan))
+            setConnected.insert(pblockOrphan->GetHash());
     }
 
     LogPrintf("ProcessNetBlock: ACCEPTED\n");
@@ -4573,9 +4699,7 @@ public:
         // orphan transactions
         mapOrphanTransactions.clear();
         mapOrphanTransactionsByPrev.clear();
-        mapOrphanBlocks.clear();
-        mapOrphanBlocksByPrev.clear();
-        setStakeSeenOrphan.clear();
+        orphanBlocks.clear();
     }
 };
 static CNetProcessingCleanup instance_of_cnetprocessingcleanup;
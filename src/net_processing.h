@@ -44,6 +44,8 @@ private:
     BanMan* const m_banman;
 
     bool SendRejectsAndCheckIfBanned(CNode* pnode, bool enable_bip61) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    /** Process one message of pnode, returns true if there is more work to be done */
+    bool HandleMessage(CNode* pnode, CNetMessage& msg, std::atomic<bool>& interrupt);
 public:
     PeerLogicValidation(CConnman* connman, BanMan* banman, CScheduler &scheduler, bool enable_bip61);
 
@@ -102,11 +104,21 @@ struct CNodeStateStats {
     int nSyncHeight = -1;
     int nCommonHeight = -1;
     std::vector<int> vHeightInFlight;
+    uint64_t nCmpctTxPrefilled = 0;
+    uint64_t nCmpctRoundTripsSaved = 0;
+    int nBlockWindow = 0;
+    int64_t nBlockServiceTime = 0;
+    uint64_t nBlocksDownloaded = 0;
+    int64_t nBlockDownloadTime = 0;
+    int nBlocksReassigned = 0;
 };
 
 /** Get statistics from node state */
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats);
 
+/** Number, serialized size and memory usage of the orphan blocks */
+void GetOrphanBlocksInfo(size_t& count, size_t& bytes, size_t& usage);
+
 /** Relay transaction to every node */
 void RelayTransaction(const uint256&, const CConnman& connman);
 
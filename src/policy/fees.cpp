@@ -482,6 +482,10 @@ bool CBlockPolicyEstimator::removeTx(uint256 hash, bool inBlock)
         feeStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
         shortStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
         longStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
+        if (pos->second.gasClass >= 0) {
+            gasStats[pos->second.gasClass]->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.gasBucketIndex, inBlock);
+            shortGasStats[pos->second.gasClass]->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.gasBucketIndex, inBlock);
+        }
         mapMemPoolTxs.erase(hash);
         return true;
     } else {
@@ -505,6 +509,21 @@ CBlockPolicyEstimator::CBlockPolicyEstimator()
     feeStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
     shortStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, SHORT_BLOCK_PERIODS, SHORT_DECAY, SHORT_SCALE));
     longStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, LONG_BLOCK_PERIODS, LONG_DECAY, LONG_SCALE));
+
+    static_assert(MIN_BUCKET_GASPRICE > 0, "Min gas price must be nonzero");
+    bucketIndex = 0;
+    for (double bucketBoundary = MIN_BUCKET_GASPRICE; bucketBoundary <= MAX_BUCKET_GASPRICE; bucketBoundary *= GAS_PRICE_SPACING, bucketIndex++) {
+        gasBuckets.push_back(bucketBoundary);
+        gasBucketMap[bucketBoundary] = bucketIndex;
+    }
+    gasBuckets.push_back(INF_FEERATE);
+    gasBucketMap[INF_FEERATE] = bucketIndex;
+    assert(gasBucketMap.size() == gasBuckets.size());
+
+    for (unsigned int i = 0; i < GAS_LIMIT_CLASSES; i++) {
+        gasStats.emplace_back(new TxConfirmStats(gasBuckets, gasBucketMap, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
+        shortGasStats.emplace_back(new TxConfirmStats(gasBuckets, gasBucketMap, SHORT_BLOCK_PERIODS, SHORT_DECAY, SHORT_SCALE));
+    }
 }
 
 CBlockPolicyEstimator::~CBlockPolicyEstimator()
@@ -548,6 +567,26 @@ void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, boo
     assert(bucketIndex == bucketIndex2);
     unsigned int bucketIndex3 = longStats->NewTx(txHeight, (double)feeRate.GetFeePerK());
     assert(bucketIndex == bucketIndex3);
+
+    // Contract txs are ordered by gas price when blocks are assembled, track them by it too
+    if (entry.GetTx().HasCreateOrCall() && entry.GetMinGasPrice() > 0) {
+        unsigned int gasClass = GasLimitClass(entry.GetGasLimit(), entry.GetBlockGasLimit());
+        mapMemPoolTxs[hash].gasClass = gasClass;
+        unsigned int gasBucketIndex = gasStats[gasClass]->NewTx(txHeight, (double)entry.GetMinGasPrice());
+        mapMemPoolTxs[hash].gasBucketIndex = gasBucketIndex;
+        unsigned int gasBucketIndex2 = shortGasStats[gasClass]->NewTx(txHeight, (double)entry.GetMinGasPrice());
+        assert(gasBucketIndex == gasBucketIndex2);
+    }
+}
+
+unsigned int CBlockPolicyEstimator::GasLimitClass(uint64_t nGasLimit, uint64_t nBlockGasLimit)
+{
+    // The more of the block gas limit a tx takes, the fewer blocks it fits into beside the others
+    if (nGasLimit <= nBlockGasLimit / 64)
+        return 0;
+    if (nGasLimit <= nBlockGasLimit / 8)
+        return 1;
+    return 2;
 }
 
 bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry)
@@ -557,11 +596,6 @@ bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxM
         return false;
     }
 
-    if(entry->GetTx().HasCreateOrCall()){
-    	//Exclude contract transactions
-    	return false;
-    }
-
     // How many blocks did it take for miners to include this transaction?
     // blocksToConfirm is 1-based, so a transaction included in the earliest
     // possible block has confirmation count of 1
@@ -582,6 +616,28 @@ bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxM
     return true;
 }
 
+bool CBlockPolicyEstimator::processBlockGasTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry)
+{
+    std::map<uint256, TxStatsInfo>::const_iterator pos = mapMemPoolTxs.find(entry->GetTx().GetHash());
+    if (pos == mapMemPoolTxs.end() || pos->second.gasClass < 0) {
+        // Still stop tracking its feerate
+        removeTx(entry->GetTx().GetHash(), true);
+        return false;
+    }
+    unsigned int gasClass = pos->second.gasClass;
+    removeTx(entry->GetTx().GetHash(), true);
+
+    int blocksToConfirm = nBlockHeight - entry->GetHeight();
+    if (blocksToConfirm <= 0) {
+        LogPrint(BCLog::ESTIMATEFEE, "Blockpolicy error Transaction had negative blocksToConfirm\n");
+        return false;
+    }
+
+    gasStats[gasClass]->Record(blocksToConfirm, (double)entry->GetMinGasPrice());
+    shortGasStats[gasClass]->Record(blocksToConfirm, (double)entry->GetMinGasPrice());
+    return true;
+}
+
 void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
                                          std::vector<const CTxMemPoolEntry*>& entries)
 {
@@ -604,27 +660,39 @@ void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
     feeStats->ClearCurrent(nBlockHeight);
     shortStats->ClearCurrent(nBlockHeight);
     longStats->ClearCurrent(nBlockHeight);
+    for (unsigned int i = 0; i < GAS_LIMIT_CLASSES; i++) {
+        gasStats[i]->ClearCurrent(nBlockHeight);
+        shortGasStats[i]->ClearCurrent(nBlockHeight);
+    }
 
     // Decay all exponential averages
     feeStats->UpdateMovingAverages();
     shortStats->UpdateMovingAverages();
     longStats->UpdateMovingAverages();
+    for (unsigned int i = 0; i < GAS_LIMIT_CLASSES; i++) {
+        gasStats[i]->UpdateMovingAverages();
+        shortGasStats[i]->UpdateMovingAverages();
+    }
 
     unsigned int countedTxs = 0;
+    unsigned int countedGasTxs = 0;
     // Update averages with data points from current block
     for (const auto& entry : entries) {
-        if (processBlockTx(nBlockHeight, entry))
+        if (entry->GetTx().HasCreateOrCall()) {
+            if (processBlockGasTx(nBlockHeight, entry))
+                countedGasTxs++;
+        } else if (processBlockTx(nBlockHeight, entry))
             countedTxs++;
     }
 
-    if (firstRecordedHeight == 0 && countedTxs > 0) {
+    if (firstRecordedHeight == 0 && countedTxs + countedGasTxs > 0) {
         firstRecordedHeight = nBestSeenHeight;
         LogPrint(BCLog::ESTIMATEFEE, "Blockpolicy first recorded height %u\n", firstRecordedHeight);
     }
 
 
-    LogPrint(BCLog::ESTIMATEFEE, "Blockpolicy estimates updated by %u of %u block txs, since last block %u of %u tracked, mempool map size %u, max target %u from %s\n",
-             countedTxs, entries.size(), trackedTxs, trackedTxs + untrackedTxs, mapMemPoolTxs.size(),
+    LogPrint(BCLog::ESTIMATEFEE, "Blockpolicy estimates updated by %u of %u block txs and %u contract txs by gas price, since last block %u of %u tracked, mempool map size %u, max target %u from %s\n",
+             countedTxs, entries.size(), countedGasTxs, trackedTxs, trackedTxs + untrackedTxs, mapMemPoolTxs.size(),
              MaxUsableEstimate(), HistoricalBlockSpan() > BlockSpan() ? "historical" : "current");
 
     trackedTxs = 0;
@@ -697,6 +765,12 @@ unsigned int CBlockPolicyEstimator::HighestTargetTracked(FeeEstimateHorizon hori
     }
 }
 
+unsigned int CBlockPolicyEstimator::HighestGasTargetTracked() const
+{
+    LOCK(m_cs_fee_estimator);
+    return gasStats[0]->GetMaxConfirms();
+}
+
 unsigned int CBlockPolicyEstimator::BlockSpan() const
 {
     if (firstRecordedHeight == 0) return 0;
@@ -866,6 +940,90 @@ CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, FeeCalculation
     return CFeeRate(llround(median));
 }
 
+/** Return a gas price estimate at the required successThreshold from the shortest
+ * time horizon which tracks confirmations up to the desired target, or from the
+ * short horizon at its highest target if that gives a lower answer */
+double CBlockPolicyEstimator::estimateCombinedGasPrice(unsigned int gasClass, unsigned int confTarget, double successThreshold, EstimationResult *result) const
+{
+    const TxConfirmStats& shortStats = *shortGasStats[gasClass];
+    const TxConfirmStats& medStats = *gasStats[gasClass];
+    double estimate = -1;
+    if (confTarget >= 1 && confTarget <= shortStats.GetMaxConfirms()) {
+        estimate = shortStats.EstimateMedianVal(confTarget, SUFFICIENT_TXS_SHORT, successThreshold, true, nBestSeenHeight, result);
+    } else if (confTarget >= 1 && confTarget <= medStats.GetMaxConfirms()) {
+        estimate = medStats.EstimateMedianVal(confTarget, SUFFICIENT_FEETXS, successThreshold, true, nBestSeenHeight, result);
+        EstimationResult tempResult;
+        double shortMax = shortStats.EstimateMedianVal(shortStats.GetMaxConfirms(), SUFFICIENT_TXS_SHORT, successThreshold, true, nBestSeenHeight, &tempResult);
+        if (shortMax > 0 && (estimate == -1 || shortMax < estimate)) {
+            estimate = shortMax;
+            if (result) *result = tempResult;
+        }
+    }
+    return estimate;
+}
+
+/** estimateSmartGasPrice returns the max of the gas prices calculated like
+ * estimateSmartFee does, with a 60% threshold required at target / 2, an 85%
+ * threshold required at target and a 95% threshold required at 2 * target,
+ * over the contract transactions of the same gas limit class only.
+ */
+CAmount CBlockPolicyEstimator::estimateSmartGasPrice(int confTarget, uint64_t nGasLimit, uint64_t nBlockGasLimit, FeeCalculation *feeCalc) const
+{
+    LOCK(m_cs_fee_estimator);
+
+    if (feeCalc) {
+        feeCalc->desiredTarget = confTarget;
+        feeCalc->returnedTarget = confTarget;
+    }
+
+    unsigned int gasClass = GasLimitClass(nGasLimit, nBlockGasLimit);
+    unsigned int maxTarget = gasStats[gasClass]->GetMaxConfirms();
+
+    // Return failure if trying to analyze a target we're not tracking
+    if (confTarget <= 0 || (unsigned int)confTarget > maxTarget) {
+        return 0;  // error condition
+    }
+
+    // It's not possible to get reasonable estimates for confTarget of 1
+    if (confTarget == 1) confTarget = 2;
+
+    // Block spans are divided by 2 to make sure there are enough potential failing data points for the estimate
+    unsigned int maxUsableEstimate = std::min(maxTarget, std::max(BlockSpan(), HistoricalBlockSpan()) / 2);
+    if ((unsigned int)confTarget > maxUsableEstimate) {
+        confTarget = maxUsableEstimate;
+    }
+    if (feeCalc) feeCalc->returnedTarget = confTarget;
+
+    if (confTarget <= 1) return 0; // error condition
+
+    EstimationResult tempResult;
+    double median = estimateCombinedGasPrice(gasClass, confTarget/2, HALF_SUCCESS_PCT, &tempResult);
+    if (feeCalc) {
+        feeCalc->est = tempResult;
+        feeCalc->reason = FeeReason::HALF_ESTIMATE;
+    }
+    double actualEst = estimateCombinedGasPrice(gasClass, confTarget, SUCCESS_PCT, &tempResult);
+    if (actualEst > median) {
+        median = actualEst;
+        if (feeCalc) {
+            feeCalc->est = tempResult;
+            feeCalc->reason = FeeReason::FULL_ESTIMATE;
+        }
+    }
+    double doubleEst = estimateCombinedGasPrice(gasClass, 2 * confTarget, DOUBLE_SUCCESS_PCT, &tempResult);
+    if (doubleEst > median) {
+        median = doubleEst;
+        if (feeCalc) {
+            feeCalc->est = tempResult;
+            feeCalc->reason = FeeReason::DOUBLE_ESTIMATE;
+        }
+    }
+
+    if (median < 0) return 0; // error condition
+
+    return llround(median);
+}
+
 
 bool CBlockPolicyEstimator::Write(CAutoFile& fileout) const
 {
@@ -884,6 +1042,12 @@ bool CBlockPolicyEstimator::Write(CAutoFile& fileout) const
         feeStats->Write(fileout);
         shortStats->Write(fileout);
         longStats->Write(fileout);
+        // Gas prices of contract txs follow, older versions stop reading before them
+        fileout << gasBuckets;
+        for (unsigned int i = 0; i < GAS_LIMIT_CLASSES; i++) {
+            gasStats[i]->Write(fileout);
+            shortGasStats[i]->Write(fileout);
+        }
     }
     catch (const std::exception&) {
         LogPrintf("CBlockPolicyEstimator::Write(): unable to write policy estimator data (non-fatal)\n");
@@ -927,6 +1091,26 @@ bool CBlockPolicyEstimator::Read(CAutoFile& filein)
             fileShortStats->Read(filein, nVersionThatWrote, numBuckets);
             fileLongStats->Read(filein, nVersionThatWrote, numBuckets);
 
+            // Files written before gas prices were tracked end here
+            std::vector<double> fileGasBuckets;
+            try {
+                filein >> fileGasBuckets;
+            } catch (const std::ios_base::failure&) {
+                LogPrint(BCLog::ESTIMATEFEE, "%s: no gas price estimation data\n", __func__);
+            }
+            std::vector<std::unique_ptr<TxConfirmStats>> fileGasStats, fileShortGasStats;
+            if (!fileGasBuckets.empty()) {
+                size_t numGasBuckets = fileGasBuckets.size();
+                if (numGasBuckets <= 1 || numGasBuckets > 1000)
+                    throw std::runtime_error("Corrupt estimates file. Must have between 2 and 1000 gas price buckets");
+                for (unsigned int i = 0; i < GAS_LIMIT_CLASSES; i++) {
+                    fileGasStats.emplace_back(new TxConfirmStats(gasBuckets, gasBucketMap, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
+                    fileShortGasStats.emplace_back(new TxConfirmStats(gasBuckets, gasBucketMap, SHORT_BLOCK_PERIODS, SHORT_DECAY, SHORT_SCALE));
+                    fileGasStats[i]->Read(filein, nVersionThatWrote, numGasBuckets);
+                    fileShortGasStats[i]->Read(filein, nVersionThatWrote, numGasBuckets);
+                }
+            }
+
             // Fee estimates file parsed correctly
             // Copy buckets from file and refresh our bucketmap
             buckets = fileBuckets;
@@ -940,6 +1124,16 @@ bool CBlockPolicyEstimator::Read(CAutoFile& filein)
             shortStats = std::move(fileShortStats);
             longStats = std::move(fileLongStats);
 
+            if (!fileGasBuckets.empty()) {
+                gasBuckets = fileGasBuckets;
+                gasBucketMap.clear();
+                for (unsigned int i = 0; i < gasBuckets.size(); i++) {
+                    gasBucketMap[gasBuckets[i]] = i;
+                }
+                gasStats = std::move(fileGasStats);
+                shortGasStats = std::move(fileShortGasStats);
+            }
+
             nBestSeenHeight = nFileBestSeenHeight;
             historicalFirst = nFileHistoricalFirst;
             historicalBest = nFileHistoricalBest;
@@ -127,6 +127,11 @@ struct FeeCalculation
  *  We want to be able to estimate feerates that are needed on tx's to be included in
  * a certain number of blocks.  Every time a block is added to the best chain, this class records
  * stats on the transactions included in that block
+ *
+ * Contract transactions are ordered by gas price rather than feerate when blocks are
+ * assembled, so they are tracked by gas price instead, over the short and medium horizons.
+ * A transaction with a gas limit taking a large share of the block gas limit is harder to
+ * fit into a block, so they are tracked apart for a few classes of that share.
  */
 class CBlockPolicyEstimator
 {
@@ -179,6 +184,15 @@ private:
      */
     static constexpr double FEE_SPACING = 1.05;
 
+    /** Minimum and Maximum values for tracking gas prices of contract transactions, in satoshis per gas */
+    static constexpr double MIN_BUCKET_GASPRICE = 1;
+    static constexpr double MAX_BUCKET_GASPRICE = 1e6;
+    /** Spacing of gas price buckets, gas prices are mostly picked by hand so coarser buckets do */
+    static constexpr double GAS_PRICE_SPACING = 1.1;
+    /** Contract transactions are tracked apart by the share of the block gas limit they take,
+     *  see GasLimitClass */
+    static constexpr unsigned int GAS_LIMIT_CLASSES = 3;
+
 public:
     /** Create new BlockPolicyEstimator and initialize stats tracking classes with default values */
     CBlockPolicyEstimator();
@@ -210,6 +224,20 @@ public:
      */
     CFeeRate estimateRawFee(int confTarget, double successThreshold, FeeEstimateHorizon horizon, EstimationResult *result = nullptr) const;
 
+    /** Estimate the gas price in satoshis per gas needed for a contract transaction with a total
+     *  gas limit of nGasLimit to be included in a block within confTarget blocks, from the contract
+     *  transactions that took a similar share of the block gas limit. If no answer can be given at
+     *  confTarget, return an estimate at the closest target where one can be given. Returns 0 if
+     *  there is not enough data.
+     */
+    CAmount estimateSmartGasPrice(int confTarget, uint64_t nGasLimit, uint64_t nBlockGasLimit, FeeCalculation *feeCalc) const;
+
+    /** Calculation of highest target that gas price estimates are tracked for */
+    unsigned int HighestGasTargetTracked() const;
+
+    /** Class of a contract transaction by the share of the block gas limit its gas limit takes */
+    static unsigned int GasLimitClass(uint64_t nGasLimit, uint64_t nBlockGasLimit);
+
     /** Write estimation data to a file */
     bool Write(CAutoFile& fileout) const;
 
@@ -234,7 +262,9 @@ private:
     {
         unsigned int blockHeight;
         unsigned int bucketIndex;
-        TxStatsInfo() : blockHeight(0), bucketIndex(0) {}
+        int gasClass; // -1 if the gas price of the transaction is not tracked
+        unsigned int gasBucketIndex;
+        TxStatsInfo() : blockHeight(0), bucketIndex(0), gasClass(-1), gasBucketIndex(0) {}
     };
 
     // map of txids to information about that transaction
@@ -251,13 +281,25 @@ private:
     std::vector<double> buckets GUARDED_BY(m_cs_fee_estimator); // The upper-bound of the range for the bucket (inclusive)
     std::map<double, unsigned int> bucketMap GUARDED_BY(m_cs_fee_estimator); // Map of bucket upper-bound to index into all vectors by bucket
 
+    /** Classes to track historical data on contract transaction confirmations by gas price,
+     *  one for each gas limit class */
+    std::vector<std::unique_ptr<TxConfirmStats>> gasStats GUARDED_BY(m_cs_fee_estimator);
+    std::vector<std::unique_ptr<TxConfirmStats>> shortGasStats GUARDED_BY(m_cs_fee_estimator);
+
+    std::vector<double> gasBuckets GUARDED_BY(m_cs_fee_estimator); // The upper-bound of the range for the gas price bucket (inclusive)
+    std::map<double, unsigned int> gasBucketMap GUARDED_BY(m_cs_fee_estimator); // Map of gas price bucket upper-bound to index
+
     /** Process a transaction confirmed in a block*/
     bool processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry) EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
+    /** Process a contract transaction confirmed in a block*/
+    bool processBlockGasTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry) EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
 
     /** Helper for estimateSmartFee */
     double estimateCombinedFee(unsigned int confTarget, double successThreshold, bool checkShorterHorizon, EstimationResult *result) const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
     /** Helper for estimateSmartFee */
     double estimateConservativeFee(unsigned int doubleTarget, EstimationResult *result) const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
+    /** Helper for estimateSmartGasPrice */
+    double estimateCombinedGasPrice(unsigned int gasClass, unsigned int confTarget, double successThreshold, EstimationResult *result) const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
     /** Number of blocks of data recorded while fee estimates have been running */
     unsigned int BlockSpan() const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
     /** Number of blocks of recorded fee estimate data represented in saved data file */
@@ -103,17 +103,14 @@ bool CheckStakeKernelHash(CBlockIndex* pindexPrev, unsigned int nBits, uint32_t
     return true;
 }
 
-// Check kernel hash target and coinstake signature
-bool CheckProofOfStake(CBlockIndex* pindexPrev, CValidationState& state, const CTransaction& tx, unsigned int nBits, uint32_t nTimeBlock, uint256& hashProofOfStake, uint256& targetProofOfStake, CCoinsViewCache& view)
+// Check that the stake prevout exists in the view and is mature
+bool CheckStakePrevout(CBlockIndex* pindexPrev, CValidationState& state, const CTransaction& tx, CCoinsViewCache& view, Coin& coinPrev)
 {
     if (!tx.IsCoinStake())
         return error("CheckProofOfStake() : called on non-coinstake %s", tx.GetHash().ToString());
 
-    // Kernel (input 0) must match the stake hash target (nBits)
     const CTxIn& txin = tx.vin[0];
 
-    Coin coinPrev;
-
     if(!view.GetCoin(txin.prevout, coinPrev)){
         return state.Invalid(ValidationInvalidReason::BLOCK_INVALID_HEADER, false, REJECT_INVALID, "stake-prevout-not-exist", strprintf("CheckProofOfStake() : Stake prevout does not exist %s", txin.prevout.hash.ToString()));
     }
@@ -121,6 +118,16 @@ bool CheckProofOfStake(CBlockIndex* pindexPrev, CValidationState& state, const C
     if(pindexPrev->nHeight + 1 - coinPrev.nHeight < COINBASE_MATURITY){
         return state.Invalid(ValidationInvalidReason::BLOCK_INVALID_HEADER, false, REJECT_INVALID, "stake-prevout-not-mature", strprintf("CheckProofOfStake() : Stake prevout is not mature, expecting %i and only matured to %i", COINBASE_MATURITY, pindexPrev->nHeight + 1 - coinPrev.nHeight));
     }
+
+    return true;
+}
+
+// Check kernel hash target and coinstake signature against the coin spent by the kernel
+bool CheckStakeKernel(CBlockIndex* pindexPrev, CValidationState& state, const CTransaction& tx, unsigned int nBits, uint32_t nTimeBlock, const Coin& coinPrev, uint256& hashProofOfStake, uint256& targetProofOfStake)
+{
+    // Kernel (input 0) must match the stake hash target (nBits)
+    const CTxIn& txin = tx.vin[0];
+
     CBlockIndex* blockFrom = pindexPrev->GetAncestor(coinPrev.nHeight);
     if(!blockFrom) {
         return state.Invalid(ValidationInvalidReason::BLOCK_INVALID_HEADER, false, REJECT_INVALID, "stake-prevout-not-loaded", strprintf("CheckProofOfStake() : Block at height %i for prevout can not be loaded", coinPrev.nHeight));
@@ -136,6 +143,14 @@ bool CheckProofOfStake(CBlockIndex* pindexPrev, CValidationState& state, const C
     return true;
 }
 
+// Check kernel hash target and coinstake signature
+bool CheckProofOfStake(CBlockIndex* pindexPrev, CValidationState& state, const CTransaction& tx, unsigned int nBits, uint32_t nTimeBlock, uint256& hashProofOfStake, uint256& targetProofOfStake, CCoinsViewCache& view)
+{
+    Coin coinPrev;
+    return CheckStakePrevout(pindexPrev, state, tx, view, coinPrev) &&
+           CheckStakeKernel(pindexPrev, state, tx, nBits, nTimeBlock, coinPrev, hashProofOfStake, targetProofOfStake);
+}
+
 // Check whether the coinstake timestamp meets protocol
 bool CheckCoinStakeTimestamp(uint32_t nTimeBlock)
 {
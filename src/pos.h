@@ -36,6 +36,15 @@ uint256 ComputeStakeModifier(const CBlockIndex* pindexPrev, const uint256& kerne
 // Sets hashProofOfStake on success return
 bool CheckStakeKernelHash(CBlockIndex* pindexPrev, unsigned int nBits, uint32_t blockFromTime, CAmount prevoutAmount, const COutPoint& prevout, unsigned int nTimeTx, uint256& hashProofOfStake, uint256& targetProofOfStake, bool fPrintProofOfStake=false);
 
+// Check that the stake prevout exists in the view and is mature
+// Sets coinPrev on success return
+bool CheckStakePrevout(CBlockIndex* pindexPrev, CValidationState& state, const CTransaction& tx, CCoinsViewCache& view, Coin& coinPrev);
+
+// Check kernel hash target and coinstake signature against the coin spent by the kernel,
+// without reading the view
+// Sets hashProofOfStake on success return
+bool CheckStakeKernel(CBlockIndex* pindexPrev, CValidationState& state, const CTransaction& tx, unsigned int nBits, uint32_t nTimeBlock, const Coin& coinPrev, uint256& hashProofOfStake, uint256& targetProofOfStake);
+
 // Check kernel hash target and coinstake signature
 // Sets hashProofOfStake on success return
 bool CheckProofOfStake(CBlockIndex* pindexPrev, CValidationState& state, const CTransaction& tx, unsigned int nBits, uint32_t nTimeBlock, uint256& hashProofOfStake, uint256& targetProofOfStake, CCoinsViewCache& view);
@@ -155,6 +155,7 @@ public:
 
     // memory only
     mutable bool fChecked;
+    mutable bool fCheckedSignature; // block signature checked ahead of CheckBlock
 
     CBlock()
     {
@@ -180,6 +181,7 @@ public:
         CBlockHeader::SetNull();
         vtx.clear();
         fChecked = false;
+        fCheckedSignature = false;
     }
 
     std::pair<COutPoint, unsigned int> GetProofOfStake() const //qtum
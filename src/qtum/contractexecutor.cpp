@@ -0,0 +1,99 @@
+#include <qtum/contractexecutor.h>
+#include <util/threadnames.h>
+
+ContractExecutor::ContractExecutor(bool _fThread) :
+    fThread(_fThread)
+{
+}
+
+ContractExecutor::~ContractExecutor()
+{
+    {
+        LOCK(cs);
+        fStop = true;
+        jobs.clear();
+    }
+    cond.notify_all();
+    if(thread.joinable())
+        thread.join();
+}
+
+bool ContractExecutor::run(std::function<bool()>& job)
+{
+    try{
+        return job();
+    }catch(...){
+        LOCK(cs);
+        exception = std::current_exception();
+        return false;
+    }
+}
+
+void ContractExecutor::push(std::function<bool()>&& job)
+{
+    if(!fThread){
+        {
+            LOCK(cs);
+            if(fFailed)
+                return;
+        }
+        bool fOk = run(job);
+        LOCK(cs);
+        fFailed = !fOk;
+        return;
+    }
+
+    {
+        LOCK(cs);
+        if(fFailed)
+            return;
+        jobs.push_back(std::move(job));
+    }
+    if(!thread.joinable())
+        thread = std::thread(&ContractExecutor::threadExec, this);
+    cond.notify_all();
+}
+
+void ContractExecutor::threadExec()
+{
+    util::ThreadRename("contractexec");
+    while(true){
+        std::function<bool()> job;
+        {
+            WAIT_LOCK(cs, lock);
+            while(jobs.empty() && !fStop){
+                cond.wait(lock);
+            }
+            if(fStop)
+                return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            fRunning = true;
+        }
+
+        bool fOk = run(job);
+        {
+            LOCK(cs);
+            fRunning = false;
+            if(!fOk){
+                fFailed = true;
+                jobs.clear();
+            }
+        }
+        cond.notify_all();
+    }
+}
+
+bool ContractExecutor::wait()
+{
+    WAIT_LOCK(cs, lock);
+    while(!jobs.empty() || fRunning){
+        cond.wait(lock);
+    }
+    if(exception){
+        std::exception_ptr e = exception;
+        exception = nullptr;
+        std::rethrow_exception(e);
+    }
+    return !fFailed;
+}
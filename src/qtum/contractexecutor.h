@@ -0,0 +1,62 @@
+#ifndef CONTRACTEXECUTOR_H
+#define CONTRACTEXECUTOR_H
+
+#include <sync.h>
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <thread>
+
+/** Whether ConnectBlock runs the contract executions of a block on a thread of their own, off until audited */
+static const bool DEFAULT_PIPELINED_CONNECT = false;
+
+/**
+ * Runs the jobs pushed to it in order on a thread of its own. ConnectBlock pushes the contract
+ * executions of a block in block order and goes on with the inputs and scripts of the next txs
+ * while they run, joining them before the state roots are compared.
+ *
+ * The jobs after a failing job are dropped. The thread starts with the first job, without a
+ * thread the jobs run in push().
+ */
+class ContractExecutor{
+
+public:
+
+    explicit ContractExecutor(bool _fThread);
+
+    /** Drops the jobs not started yet and waits for the running one */
+    ~ContractExecutor();
+
+    void push(std::function<bool()>&& job);
+
+    /** Wait for the pushed jobs, false if one of them failed. Rethrows an exception of a job */
+    bool wait();
+
+private:
+
+    void threadExec();
+
+    bool run(std::function<bool()>& job);
+
+    const bool fThread;
+
+    Mutex cs;
+
+    std::condition_variable cond;
+
+    std::deque<std::function<bool()>> jobs GUARDED_BY(cs);
+
+    bool fRunning GUARDED_BY(cs) = false;
+
+    bool fFailed GUARDED_BY(cs) = false;
+
+    bool fStop GUARDED_BY(cs) = false;
+
+    std::exception_ptr exception GUARDED_BY(cs);
+
+    std::thread thread;
+};
+
+#endif
@@ -0,0 +1,145 @@
+#include <qtum/contractpreexec.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <logging.h>
+#include <timedata.h>
+#include <txmempool.h>
+#include <util/system.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <mutex>
+
+#include <boost/thread/thread.hpp>
+
+ContractPreExecResult PreExecuteContractTx(const CTransaction& tx, CCoinsViewCache& view, const CBlock& block, CBlockIndex* pindexPrev)
+{
+    AssertLockHeld(cs_main);
+
+    ContractPreExecResult result;
+    int nHeight = pindexPrev->nHeight + 1;
+    QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
+    uint64_t minGasPrice = qtumDGP.getMinGasPrice(nHeight);
+    uint64_t blockGasLimit = qtumDGP.getBlockGasLimit(nHeight);
+
+    unsigned int contractflags = GetContractScriptFlags(nHeight, Params().GetConsensus());
+    QtumTxConverter convert(tx, &view, &block.vtx, contractflags);
+    ExtractQtumTX resultConverter;
+    if(!convert.extractionQtumTransactions(resultConverter)){
+        result.fFailed = true;
+        return result;
+    }
+
+    dev::u256 txGas = 0;
+    for(const QtumTransaction& qtumTransaction : resultConverter.first){
+        txGas += qtumTransaction.gas();
+        if(txGas > blockGasLimit || qtumTransaction.gasPrice() < minGasPrice){
+            result.fFailed = true;
+            return result;
+        }
+    }
+
+    // Reverted does not commit to the state DB, the guard puts the roots back even if the EVM throws
+    TemporaryState ts(globalState);
+    ByteCodeExec exec(block, std::move(resultConverter.first), blockGasLimit, pindexPrev);
+    ByteCodeExecResult execResult;
+    if(!exec.performByteCode(dev::eth::Permanence::Reverted) || !exec.processingResults(execResult)){
+        result.fFailed = true;
+    }else{
+        result.nGasUsed = execResult.usedGas;
+        result.nGasRefund = execResult.refundSender;
+    }
+    return result;
+}
+
+size_t PreExecuteMempoolContracts(CTxMemPool& pool, size_t nMax)
+{
+    CBlock block;
+    uint256 hashTip;
+    std::vector<uint256> hashes;
+    {
+        LOCK2(cs_main, pool.cs);
+        CBlockIndex* pindexPrev = ::ChainActive().Tip();
+        if(!pindexPrev || ::ChainstateActive().IsInitialBlockDownload())
+            return 0;
+        hashTip = pindexPrev->GetBlockHash();
+
+        // Contract txs sort after all other txs, walk back to the first of them
+        auto& index = pool.mapTx.get<ancestor_score_or_gas_price>();
+        auto mi = index.end();
+        while(mi != index.begin() && std::prev(mi)->GetTx().HasCreateOrCall()){
+            --mi;
+        }
+        for(; mi != index.end() && hashes.size() < nMax; ++mi){
+            if(mi->GetPreExecBlock() != hashTip)
+                hashes.push_back(mi->GetTx().GetHash());
+        }
+        if(hashes.empty())
+            return 0;
+
+        // The contracts see the time of the next block, the author is left empty
+        block.nTime = GetAdjustedTime();
+        block.nBits = pindexPrev->nBits;
+        CMutableTransaction coinbase;
+        coinbase.vin.resize(1);
+        coinbase.vin[0].prevout.SetNull();
+        coinbase.vout.resize(1);
+        block.vtx.push_back(MakeTransactionRef(std::move(coinbase)));
+    }
+
+    // cs_main is taken for one tx at a time so validation and block assembly are not held up
+    // for a whole batch. The pool may change in between, the txs gone or done are skipped
+    size_t nDone = 0, nFailed = 0;
+    for(const uint256& hash : hashes){
+        LOCK2(cs_main, pool.cs);
+        CBlockIndex* pindexPrev = ::ChainActive().Tip();
+        if(!pindexPrev || pindexPrev->GetBlockHash() != hashTip)
+            break;
+        CTxMemPool::txiter it = pool.mapTx.find(hash);
+        if(it == pool.mapTx.end() || it->GetPreExecBlock() == hashTip)
+            continue;
+
+        QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
+        globalSealEngine->setQtumSchedule(qtumDGP.getGasSchedule(pindexPrev->nHeight + 1));
+        CCoinsViewMemPool viewMemPool(&::ChainstateActive().CoinsTip(), pool);
+        CCoinsViewCache view(&viewMemPool);
+        ContractPreExecResult result = PreExecuteContractTx(it->GetTx(), view, block, pindexPrev);
+        pool.UpdatePreExecution(it, hashTip, result.nGasUsed, result.nGasRefund, result.fFailed);
+        nDone++;
+        if(result.fFailed)
+            nFailed++;
+    }
+    LogPrint(BCLog::MEMPOOL, "Pre-executed %u contract txs on top of %s, %u failed\n", nDone, hashTip.ToString(), nFailed);
+    return hashes.size();
+}
+
+static std::mutex g_preexec_mutex;
+
+void ThreadPreExecuteContracts()
+{
+    // Held for the life of the working thread, another staking wallet takes over when it stops
+    std::unique_lock<std::mutex> lock(g_preexec_mutex, std::defer_lock);
+    uint256 hashLastTip;
+    unsigned int nLastUpdated = 0;
+    while(true){
+        MilliSleep(CONTRACT_PREEXEC_INTERVAL);
+        if(!lock.owns_lock() && !lock.try_lock())
+            continue;
+        unsigned int nUpdated = mempool.GetTransactionsUpdated();
+        uint256 hashTip;
+        {
+            LOCK(cs_main);
+            if(::ChainActive().Tip())
+                hashTip = ::ChainActive().Tip()->GetBlockHash();
+        }
+        if(hashTip == hashLastTip && nUpdated == nLastUpdated)
+            continue;
+
+        // A full batch may leave more txs to pre-execute
+        while(PreExecuteMempoolContracts(mempool, CONTRACT_PREEXEC_BATCH) == CONTRACT_PREEXEC_BATCH){
+            boost::this_thread::interruption_point();
+        }
+        hashLastTip = hashTip;
+        nLastUpdated = nUpdated;
+    }
+}
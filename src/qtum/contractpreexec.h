@@ -0,0 +1,56 @@
+#ifndef CONTRACTPREEXEC_H
+#define CONTRACTPREEXEC_H
+
+#include <amount.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+#include <sync.h>
+
+#include <stdint.h>
+
+class CBlockIndex;
+class CCoinsViewCache;
+class CTxMemPool;
+
+extern CCriticalSection cs_main;
+
+/** Pre-execute the contract txs of the mempool in the background while staking by default */
+static const bool DEFAULT_STAKER_PREEXEC = true;
+/** Max contract txs picked from the mempool at a time, cs_main is released after each of them */
+static const size_t CONTRACT_PREEXEC_BATCH = 50;
+/** How often to look for contract txs without a pre-execution on the current tip, in milliseconds */
+static const int CONTRACT_PREEXEC_INTERVAL = 500;
+
+struct ContractPreExecResult{
+    uint64_t nGasUsed = 0;
+    CAmount nGasRefund = 0;
+    bool fFailed = false;
+};
+
+/**
+ * Execute the contract outputs of tx on top of the tip the way the block assembler does when
+ * it adds the tx first to the next block, without committing to the state DB, then restore the
+ * state roots. The result is failed when the assembler would reject the tx whatever its position
+ * in the block: outputs that cannot be converted, a gas price below the DGP minimum, a gas limit
+ * over the DGP block gas limit, an unknown VM version or results that cannot be processed.
+ * Exceptions in the EVM are not failures, those txs still go into blocks and pay for the gas
+ * they use.
+ * @param block  carries the time and author the contracts see, see PreExecuteMempoolContracts
+ */
+ContractPreExecResult PreExecuteContractTx(const CTransaction& tx, CCoinsViewCache& view, const CBlock& block, CBlockIndex* pindexPrev) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+/**
+ * Pre-execute up to nMax contract txs of the pool that have no result on the current tip, in
+ * the order the block assembler considers them, and record the results in their entries.
+ * Takes cs_main for one tx at a time and stops early when the tip changes.
+ * @return the number of txs picked, nMax when there may be more left
+ */
+size_t PreExecuteMempoolContracts(CTxMemPool& pool, size_t nMax);
+
+/**
+ * Keep the pre-execution results of the mempool up to date with the tip. Started next to the
+ * staker thread of every staking wallet, only one of these threads does the work at a time.
+ */
+void ThreadPreExecuteContracts();
+
+#endif
@@ -0,0 +1,122 @@
+#include <qtum/orphanblocks.h>
+#include <core_memusage.h>
+#include <memusage.h>
+#include <serialize.h>
+#include <version.h>
+
+bool OrphanBlocks::add(const std::shared_ptr<const CBlock>& pblock, int64_t nTime)
+{
+    uint256 hash = pblock->GetHash();
+    if(mapBlocks.count(hash))
+        return false;
+
+    OrphanBlock orphan;
+    orphan.block = pblock;
+    orphan.hashPrev = pblock->hashPrevBlock;
+    orphan.stake = pblock->GetProofOfStake();
+    orphan.nTime = nTime;
+    orphan.nSize = ::GetSerializeSize(*pblock, PROTOCOL_VERSION);
+    orphan.nUsage = memusage::DynamicUsage(pblock) + RecursiveDynamicUsage(*pblock);
+
+    mapByPrev.emplace(orphan.hashPrev, hash);
+    mapByTime.emplace(nTime, hash);
+    if(pblock->IsProofOfStake())
+        setStakes.insert(orphan.stake);
+    nBytes += orphan.nSize;
+    nUsage += orphan.nUsage;
+    mapBlocks.emplace(hash, std::move(orphan));
+    return true;
+}
+
+uint256 OrphanBlocks::root(const uint256& hash) const
+{
+    uint256 hashRoot = hash;
+    for(auto it = mapBlocks.find(hash); it != mapBlocks.end(); it = mapBlocks.find(it->second.hashPrev)){
+        hashRoot = it->first;
+    }
+    return hashRoot;
+}
+
+std::vector<std::shared_ptr<const CBlock>> OrphanBlocks::takeChildren(const uint256& hashPrev)
+{
+    std::vector<std::shared_ptr<const CBlock>> blocks;
+    std::vector<uint256> vWorkQueue{hashPrev};
+    for(size_t i = 0; i < vWorkQueue.size(); i++){
+        auto range = mapByPrev.equal_range(vWorkQueue[i]);
+        std::vector<uint256> children;
+        for(auto mi = range.first; mi != range.second; ++mi){
+            children.push_back(mi->second);
+        }
+        for(const uint256& hash : children){
+            OrphanIt it = mapBlocks.find(hash);
+            blocks.push_back(it->second.block);
+            vWorkQueue.push_back(hash);
+            unlink(it);
+        }
+    }
+    return blocks;
+}
+
+size_t OrphanBlocks::limit(size_t nMaxSize, int64_t nNow)
+{
+    size_t nErased = 0;
+    while(!mapByTime.empty() && mapByTime.begin()->first <= nNow - ORPHAN_BLOCK_EXPIRE_TIME){
+        nErased += erase(mapByTime.begin()->second);
+    }
+    while(nBytes > nMaxSize){
+        nErased += erase(mapByTime.begin()->second);
+    }
+    return nErased;
+}
+
+void OrphanBlocks::clear()
+{
+    mapBlocks.clear();
+    mapByPrev.clear();
+    mapByTime.clear();
+    setStakes.clear();
+    nBytes = 0;
+    nUsage = 0;
+}
+
+size_t OrphanBlocks::usage() const
+{
+    return nUsage + memusage::DynamicUsage(mapBlocks) + memusage::DynamicUsage(mapByPrev) +
+        memusage::DynamicUsage(mapByTime) + memusage::DynamicUsage(setStakes);
+}
+
+size_t OrphanBlocks::erase(const uint256& hashIn)
+{
+    // The hash may live in an index the orphan is unlinked from
+    const uint256 hash = hashIn;
+    OrphanIt it = mapBlocks.find(hash);
+    if(it == mapBlocks.end())
+        return 0;
+    unlink(it);
+    return 1 + takeChildren(hash).size();
+}
+
+void OrphanBlocks::unlink(OrphanIt it)
+{
+    const uint256& hash = it->first;
+    const OrphanBlock& orphan = it->second;
+    auto range = mapByPrev.equal_range(orphan.hashPrev);
+    for(auto mi = range.first; mi != range.second; ++mi){
+        if(mi->second == hash){
+            mapByPrev.erase(mi);
+            break;
+        }
+    }
+    auto timeRange = mapByTime.equal_range(orphan.nTime);
+    for(auto mi = timeRange.first; mi != timeRange.second; ++mi){
+        if(mi->second == hash){
+            mapByTime.erase(mi);
+            break;
+        }
+    }
+    if(orphan.block->IsProofOfStake())
+        setStakes.erase(setStakes.find(orphan.stake));
+    nBytes -= orphan.nSize;
+    nUsage -= orphan.nUsage;
+    mapBlocks.erase(it);
+}
@@ -0,0 +1,86 @@
+#ifndef ORPHANBLOCKS_H
+#define ORPHANBLOCKS_H
+
+#include <primitives/block.h>
+#include <uint256.h>
+
+#include <map>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
+/** Seconds an orphan block is kept waiting for its parent */
+static const int64_t ORPHAN_BLOCK_EXPIRE_TIME = 20 * 60;
+
+/**
+ * Blocks received before their parent, kept deserialized with their hash, parent and stake
+ * so that duplicate stake checks and the reconnection of an orphan chain never parse them
+ * again. Orphans older than ORPHAN_BLOCK_EXPIRE_TIME are dropped first, then the oldest
+ * orphans until the pool fits its size, each along with the orphans built on it since those
+ * can not be connected without it.
+ */
+class OrphanBlocks
+{
+public:
+    typedef std::pair<COutPoint, unsigned int> StakeKey;
+
+    /** Add a block whose parent is unknown, received at nTime. @return false if it is already in */
+    bool add(const std::shared_ptr<const CBlock>& pblock, int64_t nTime);
+
+    bool have(const uint256& hash) const { return mapBlocks.count(hash) > 0; }
+
+    /** Whether an orphan builds on hash */
+    bool haveChildren(const uint256& hash) const { return mapByPrev.count(hash) > 0; }
+
+    /** Whether an orphan uses the stake */
+    bool haveStake(const StakeKey& stake) const { return setStakes.count(stake) > 0; }
+
+    /** First block of the orphan chain hash belongs to, hash itself if it is not an orphan */
+    uint256 root(const uint256& hash) const;
+
+    /**
+     * Remove the orphans descending from hashPrev from the pool, parents before children,
+     * so the whole chain can be connected in one pass once hashPrev is.
+     */
+    std::vector<std::shared_ptr<const CBlock>> takeChildren(const uint256& hashPrev);
+
+    /** Drop the expired orphans and the oldest ones above nMaxSize serialized bytes. @return the number dropped */
+    size_t limit(size_t nMaxSize, int64_t nNow);
+
+    void clear();
+
+    size_t size() const { return mapBlocks.size(); }
+
+    /** Serialized size of the orphans */
+    size_t bytes() const { return nBytes; }
+
+    /** Memory held by the orphans and the indexes */
+    size_t usage() const;
+
+private:
+    struct OrphanBlock{
+        std::shared_ptr<const CBlock> block;
+        uint256 hashPrev;
+        StakeKey stake;
+        int64_t nTime;
+        size_t nSize;
+        size_t nUsage;
+    };
+
+    typedef std::map<uint256, OrphanBlock>::iterator OrphanIt;
+
+    /** Remove an orphan and its descendants. @return the number removed */
+    size_t erase(const uint256& hashIn);
+
+    void unlink(OrphanIt it);
+
+    std::map<uint256, OrphanBlock> mapBlocks;
+    std::multimap<uint256, uint256> mapByPrev;
+    std::multimap<int64_t, uint256> mapByTime;
+    std::multiset<StakeKey> setStakes;
+    size_t nBytes = 0;
+    size_t nUsage = 0;
+};
+
+#endif
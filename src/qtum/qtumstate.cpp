@@ -3,14 +3,15 @@
 #include <validation.h>
 #include <chainparams.h>
 #include <qtum/qtumstate.h>
+#include <libdevcore/DBFactory.h>
 
 using namespace std;
 using namespace dev;
 using namespace dev::eth;
 
-QtumState::QtumState(u256 const& _accountStartNonce, OverlayDB const& _db, const string& _path, BaseState _bs) :
-        State(_accountStartNonce, _db, _bs) {
-            dbUTXO = QtumState::openDB(_path + "/qtumDB", sha3(rlp("")), WithExisting::Trust);
+QtumState::QtumState(u256 const& _accountStartNonce, OverlayDB const& _db, const string& _path, BaseState _bs, db::DatabaseFace* _rawDB) :
+        State(_accountStartNonce, _db, _bs), rawState(_rawDB) {
+            dbUTXO = QtumState::openDB(_path + "/qtumDB", sha3(rlp("")), WithExisting::Trust, rawUTXO);
 	        stateUTXO = SecureTrieDB<Address, OverlayDB>(&dbUTXO);
 }
 
@@ -19,6 +20,18 @@ QtumState::QtumState() : dev::eth::State(dev::Invalid256, dev::OverlayDB(), dev:
     stateUTXO = SecureTrieDB<Address, OverlayDB>(&dbUTXO);
 }
 
+OverlayDB QtumState::openDB(std::string const& _path, h256 const& _genesisHash, WithExisting _we, db::DatabaseFace*& _rawDB){
+    // Same layout as State::openDB, so existing state directories keep working
+    boost::filesystem::path path = boost::filesystem::path(_path) / toHex(_genesisHash.ref().cropped(0, 4)) / toString(c_databaseVersion);
+    if(_we == WithExisting::Kill)
+        boost::filesystem::remove_all(path / "state");
+    boost::filesystem::create_directories(path);
+
+    std::unique_ptr<db::DatabaseFace> database = db::DBFactory::create(path / "state");
+    _rawDB = database.get();
+    return OverlayDB(std::move(database));
+}
+
 ResultExecute QtumState::execute(EnvInfo const& _envInfo, SealEngineFace const& _sealEngine, QtumTransaction const& _t, Permanence _p, OnOpFunc const& _onOp){
 
     assert(_t.getVersion().toRaw() == VersionVM::GetEVMDefault().toRaw());
@@ -48,6 +61,8 @@ ResultExecute QtumState::execute(EnvInfo const& _envInfo, SealEngineFace const&
     CTransactionRef tx;
     u256 startGasUsed;
     const Consensus::Params& consensusParams = Params().GetConsensus();
+    // The height of the parent of the block executed in, the active chain may be moving on another thread
+    const int64_t nHeight = _envInfo.number() - 1;
     try{
         if (_t.isCreation() && _t.value())
             BOOST_THROW_EXCEPTION(CreateWithValue());
@@ -57,7 +72,7 @@ ResultExecute QtumState::execute(EnvInfo const& _envInfo, SealEngineFace const&
         startGasUsed = _envInfo.gasUsed();
         if (!e.execute()){
             e.go(onOp);
-            if(ChainActive().Height() >= consensusParams.QIP7Height){
+            if(nHeight >= consensusParams.QIP7Height){
             	validateTransfersWithChangeLog();
             }
         } else {
@@ -94,7 +109,7 @@ ResultExecute QtumState::execute(EnvInfo const& _envInfo, SealEngineFace const&
         printfErrorLog(dev::eth::toTransactionException(_e));
         res.excepted = dev::eth::toTransactionException(_e);
         res.gasUsed = _t.gas();
-        if(ChainActive().Height() < consensusParams.nFixUTXOCacheHFHeight  && _p != Permanence::Reverted){
+        if(nHeight < consensusParams.nFixUTXOCacheHFHeight  && _p != Permanence::Reverted){
             deleteAccounts(_sealEngine.deleteAddresses);
             commit(CommitBehaviour::RemoveEmptyAccounts);
         } else {
@@ -127,7 +142,7 @@ ResultExecute QtumState::execute(EnvInfo const& _envInfo, SealEngineFace const&
         return ResultExecute{
             ex,
             QtumTransactionReceipt(oldStateRoot, oldUTXORoot, gas, e.logs(), {}, {}),
-            refund.vout.empty() ? CTransaction() : CTransaction(refund)
+            refund.vout.empty() ? CTransactionRef() : MakeTransactionRef(std::move(refund))
         };
     }else{
         if (res.excepted == dev::eth::TransactionException::None) {
@@ -140,13 +155,13 @@ ResultExecute QtumState::execute(EnvInfo const& _envInfo, SealEngineFace const&
                     std::move(m_createdContracts),
                     std::move(m_destructedContracts)
                 ),
-                tx ? *tx : CTransaction()
+                tx
             };
         } else {
             return ResultExecute{
                 res,
                 QtumTransactionReceipt(rootHash(), rootHashUTXO(), startGasUsed + e.gasUsed(), e.logs(), {}, {}),
-                tx ? *tx : CTransaction()
+                tx
             };
         }
     }
@@ -61,7 +61,7 @@ private:
 struct ResultExecute{
     dev::eth::ExecutionResult execRes;
     QtumTransactionReceipt txRec;
-    CTransaction tx;
+    CTransactionRef tx;
 };
 
 namespace qtum{
@@ -91,7 +91,12 @@ public:
 
     QtumState();
 
-    QtumState(dev::u256 const& _accountStartNonce, dev::OverlayDB const& _db, const std::string& _path, dev::eth::BaseState _bs = dev::eth::BaseState::PreExisting);
+    QtumState(dev::u256 const& _accountStartNonce, dev::OverlayDB const& _db, const std::string& _path, dev::eth::BaseState _bs = dev::eth::BaseState::PreExisting, dev::db::DatabaseFace* _rawDB = nullptr);
+
+    /** Like State::openDB, but also hands out the database behind the overlay so unreachable trie nodes can be deleted from it */
+    static dev::OverlayDB openDB(std::string const& _path, dev::h256 const& _genesisHash, dev::WithExisting _we, dev::db::DatabaseFace*& _rawDB);
+
+    using dev::eth::State::openDB;
 
     ResultExecute execute(dev::eth::EnvInfo const& _envInfo, dev::eth::SealEngineFace const& _sealEngine, QtumTransaction const& _t, dev::eth::Permanence _p = dev::eth::Permanence::Committed, dev::eth::OnOpFunc const& _onOp = OnOpFunc());
 
@@ -107,6 +112,11 @@ public:
 
     dev::OverlayDB& dbUtxo() { return dbUTXO; }
 
+    /** The databases behind db() and dbUtxo(), owned by the overlays. rawDB() is null if the state was opened with State::openDB */
+    dev::db::DatabaseFace* rawDB() const { return rawState; }
+
+    dev::db::DatabaseFace* rawDBUtxo() const { return rawUTXO; }
+
     static const dev::Address createQtumAddress(dev::h256 hashTx, uint32_t voutNumber){
         uint256 hashTXid(h256Touint(hashTx));
         std::vector<unsigned char> txIdAndVout(hashTXid.begin(), hashTXid.end());
@@ -154,6 +164,10 @@ private:
 
     dev::OverlayDB dbUTXO;
 
+    dev::db::DatabaseFace* rawState = nullptr;
+
+    dev::db::DatabaseFace* rawUTXO = nullptr;
+
 	dev::eth::SecureTrieDB<dev::Address, dev::OverlayDB> stateUTXO;
 
 	std::unordered_map<dev::Address, Vin> cacheUTXO;
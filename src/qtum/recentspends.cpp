@@ -0,0 +1,102 @@
+#include <qtum/recentspends.h>
+#include <chain.h>
+#include <primitives/block.h>
+#include <undo.h>
+
+#include <algorithm>
+
+RecentSpends::RecentSpends(int _nDepth, size_t _nMaxEntries) :
+    nDepth(_nDepth),
+    nMaxEntries(_nMaxEntries)
+{}
+
+void RecentSpends::connectBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    // Start over from this block when the index missed the blocks below it
+    if(!pindex->pprev || pindex->pprev->GetBlockHash() != hashBest){
+        clear();
+        nCoveredFrom = pindex->nHeight;
+    }
+    hashBest = pindex->GetBlockHash();
+    nBestHeight = pindex->nHeight;
+
+    if(blockundo.vtxundo.size() + 1 != block.vtx.size()){
+        clear();
+        hashBest = pindex->GetBlockHash();
+        nBestHeight = pindex->nHeight;
+        nCoveredFrom = nBestHeight + 1;
+        return;
+    }
+
+    SpendingBlock spending;
+    spending.hashBlock = hashBest;
+    spending.nHeight = nBestHeight;
+    for(size_t i = 1; i < block.vtx.size(); i++){
+        const CTransaction& tx = *block.vtx[i];
+        const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+        for(size_t k = 0; k < tx.vin.size() && k < txundo.vprevout.size(); k++){
+            mapSpends[tx.vin[k].prevout] = SpentCoin{nBestHeight, txundo.vprevout[k]};
+            spending.vSpent.push_back(tx.vin[k].prevout);
+        }
+    }
+    blocks.push_back(std::move(spending));
+
+    // Keep the newest block even when it alone goes over the max entries
+    while(blocks.size() > (size_t)nDepth || (mapSpends.size() > nMaxEntries && blocks.size() > 1)){
+        evictOldest();
+    }
+}
+
+void RecentSpends::disconnectBlock(const uint256& hashBlock, const uint256& hashPrev)
+{
+    if(hashBlock != hashBest){
+        clear();
+        return;
+    }
+
+    if(!blocks.empty() && blocks.back().hashBlock == hashBlock){
+        for(const COutPoint& prevout : blocks.back().vSpent){
+            mapSpends.erase(prevout);
+        }
+        blocks.pop_back();
+    }
+    hashBest = hashPrev;
+    nBestHeight--;
+    nCoveredFrom = std::min(nCoveredFrom, nBestHeight + 1);
+}
+
+bool RecentSpends::lookup(const uint256& hashTip, int nForkHeight, const COutPoint& prevout, Coin* coin, bool& fSpent) const
+{
+    fSpent = false;
+    if(hashBest.IsNull() || hashTip != hashBest || nForkHeight + 1 < nCoveredFrom)
+        return false;
+
+    auto it = mapSpends.find(prevout);
+    if(it != mapSpends.end() && it->second.nHeight > nForkHeight){
+        if(coin)
+            *coin = it->second.coin;
+        fSpent = true;
+    }
+    return true;
+}
+
+void RecentSpends::clear()
+{
+    mapSpends.clear();
+    blocks.clear();
+    hashBest.SetNull();
+    nBestHeight = -1;
+    nCoveredFrom = 0;
+}
+
+void RecentSpends::evictOldest()
+{
+    const SpendingBlock& oldest = blocks.front();
+    for(const COutPoint& prevout : oldest.vSpent){
+        auto it = mapSpends.find(prevout);
+        if(it != mapSpends.end() && it->second.nHeight == oldest.nHeight)
+            mapSpends.erase(it);
+    }
+    nCoveredFrom = oldest.nHeight + 1;
+    blocks.pop_front();
+}
@@ -0,0 +1,82 @@
+#ifndef RECENTSPENDS_H
+#define RECENTSPENDS_H
+
+#include <coins.h>
+#include <primitives/transaction.h>
+#include <uint256.h>
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+class CBlock;
+class CBlockIndex;
+class CBlockUndo;
+
+/** Max outpoints kept in the recent spends index, bounds its memory when blocks are full */
+static const size_t DEFAULT_RECENT_SPENDS_MAX = 500000;
+
+/**
+ * In-memory index of the outpoints spent by the last blocks of the active chain, with the
+ * height of the spending block and the coin from the undo data. It answers whether a stake
+ * of a fork was spent on the main chain above the fork base without reading the undo data
+ * of every block back to the fork base from disk.
+ *
+ * The index follows the tip through connectBlock and disconnectBlock. It covers the blocks
+ * connected since it was last in sync with the chain, the last nDepth of them at most, and
+ * lookup reports when a query reaches below that so the caller can fall back to the disk.
+ */
+class RecentSpends
+{
+public:
+    explicit RecentSpends(int _nDepth, size_t _nMaxEntries = DEFAULT_RECENT_SPENDS_MAX);
+
+    /** Record the spends of a block connected on top of the tip, with its undo data */
+    void connectBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex);
+
+    /** Forget the spends of the tip when it is disconnected */
+    void disconnectBlock(const uint256& hashBlock, const uint256& hashPrev);
+
+    /**
+     * Look up whether prevout was spent on the active chain above nForkHeight.
+     * @param[out] coin    the spent coin, when found
+     * @param[out] fSpent  whether the prevout was spent above nForkHeight
+     * @return false when the index cannot answer: it is not in sync with hashTip or does
+     *         not cover all the blocks above nForkHeight
+     */
+    bool lookup(const uint256& hashTip, int nForkHeight, const COutPoint& prevout, Coin* coin, bool& fSpent) const;
+
+    void clear();
+
+    /** Number of outpoints in the index */
+    size_t size() const { return mapSpends.size(); }
+
+    /** Lowest height whose spends are all in the index */
+    int coveredFrom() const { return nCoveredFrom; }
+
+    const uint256& bestBlock() const { return hashBest; }
+
+private:
+    struct SpentCoin{
+        int nHeight;
+        Coin coin;
+    };
+
+    struct SpendingBlock{
+        uint256 hashBlock;
+        int nHeight;
+        std::vector<COutPoint> vSpent;
+    };
+
+    void evictOldest();
+
+    int nDepth;
+    size_t nMaxEntries;
+    uint256 hashBest;
+    int nBestHeight = -1;
+    int nCoveredFrom = 0;
+    std::unordered_map<COutPoint, SpentCoin, SaltedOutpointHasher> mapSpends;
+    std::deque<SpendingBlock> blocks;
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include <qtum/stakeprefetch.h>
+#include <consensus/validation.h>
+#include <pos.h>
+#include <validation.h>
+
+#include <boost/thread/thread.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+std::unique_ptr<StakePrefetcher> pstakeprefetcher;
+
+static bool SameCoin(const Coin& a, const Coin& b)
+{
+    return a.out == b.out && a.nHeight == b.nHeight && a.fCoinBase == b.fCoinBase && a.fCoinStake == b.fCoinStake;
+}
+
+StakePrefetcher::StakePrefetcher(const Consensus::Params& _consensusParams) :
+    consensusParams(_consensusParams)
+{
+}
+
+void StakePrefetcher::push(std::vector<StakePrefetchJob>&& _jobs)
+{
+    {
+        LOCK(cs);
+        jobs.assign(std::make_move_iterator(_jobs.begin()), std::make_move_iterator(_jobs.end()));
+        results.clear();
+    }
+    cond.notify_all();
+}
+
+void StakePrefetcher::run(const StakePrefetchJob& job, StakePrefetchResult& result) const
+{
+    std::shared_ptr<CBlock> block = std::make_shared<CBlock>();
+    if(!ReadBlockFromDisk(*block, job.pos, consensusParams) || block->GetHash() != job.hash)
+        return;
+
+    block->fCheckedSignature = CheckBlockSignature(*block);
+
+    // The kernel is only checked for the stake coin of the header, CheckBlock rejects the others
+    if(block->IsProofOfStake() && job.fHaveCoin && block->vtx.size() > 1 && block->vtx[1]->IsCoinStake() &&
+            !block->vtx[1]->vin.empty() && block->vtx[1]->vin[0].prevout == block->prevoutStake){
+        CValidationState state;
+        uint256 targetProofOfStake;
+        result.fStake = CheckStakeKernel(job.pindexPrev, state, *block->vtx[1], block->nBits, block->nTime, job.coinStake, result.hashProof, targetProofOfStake);
+        result.coinStake = job.coinStake;
+    }
+    result.block = block;
+}
+
+std::shared_ptr<const CBlock> StakePrefetcher::getBlock(const uint256& hash)
+{
+    StakePrefetchJob job;
+    {
+        WAIT_LOCK(cs, lock);
+        while(running.count(hash)){
+            cond.wait(lock);
+        }
+
+        auto itResult = results.find(hash);
+        if(itResult != results.end()){
+            std::shared_ptr<const CBlock> block = std::move(itResult->second.block);
+            if(!itResult->second.fStake)
+                results.erase(itResult);
+            return block;
+        }
+
+        auto itJob = std::find_if(jobs.begin(), jobs.end(), [&hash](const StakePrefetchJob& j){ return j.hash == hash; });
+        if(itJob == jobs.end())
+            return nullptr;
+        job = std::move(*itJob);
+        jobs.erase(itJob);
+    }
+
+    StakePrefetchResult result;
+    run(job, result);
+    std::shared_ptr<const CBlock> block = std::move(result.block);
+    if(result.fStake){
+        LOCK(cs);
+        results[hash] = std::move(result);
+    }
+    return block;
+}
+
+bool StakePrefetcher::getStake(const uint256& hash, const Coin& coin, uint256& hashProof)
+{
+    LOCK(cs);
+    auto it = results.find(hash);
+    if(it == results.end())
+        return false;
+    bool fStake = it->second.fStake && SameCoin(it->second.coinStake, coin);
+    if(fStake)
+        hashProof = it->second.hashProof;
+    results.erase(it);
+    return fStake;
+}
+
+void StakePrefetcher::ThreadPrefetch()
+{
+    while(true){
+        StakePrefetchJob job;
+        {
+            WAIT_LOCK(cs, lock);
+            while(jobs.empty()){
+                cond.wait_for(lock, std::chrono::milliseconds(100));
+                boost::this_thread::interruption_point();
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            running.insert(job.hash);
+        }
+
+        StakePrefetchResult result;
+        run(job, result);
+        {
+            LOCK(cs);
+            running.erase(job.hash);
+            results[job.hash] = std::move(result);
+        }
+        cond.notify_all();
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef STAKEPREFETCH_H
+#define STAKEPREFETCH_H
+
+#include <coins.h>
+#include <flatfile.h>
+#include <primitives/block.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+class CBlockIndex;
+namespace Consensus { struct Params; }
+
+/** Read the blocks ahead of the tip and check their PoS kernels and signatures in parallel during IBD */
+static const bool DEFAULT_STAKE_PREFETCH = true;
+
+/**
+ * A block to read ahead of the tip. coinStake is a snapshot of the coin spent by the kernel,
+ * taken from the coins tip when the block was queued, fHaveCoin is false when it was not in it.
+ */
+struct StakePrefetchJob{
+    uint256 hash;
+    FlatFilePos pos;
+    CBlockIndex* pindexPrev = nullptr;
+    bool fHaveCoin = false;
+    Coin coinStake;
+};
+
+/** A block read ahead, fStake is set when its coinstake passed the kernel checks with coinStake */
+struct StakePrefetchResult{
+    std::shared_ptr<const CBlock> block;
+    bool fStake = false;
+    Coin coinStake;
+    uint256 hashProof;
+};
+
+/**
+ * Reads the blocks ActivateBestChainStep is about to connect and checks what does not depend on
+ * the UTXO set of their parent on worker threads: the block signature, and for PoS blocks the
+ * coinstake signature and the kernel hash against the snapshot of the stake coin. ConnectTip takes
+ * the blocks from here, and UpdateHashProof skips the kernel checks when the coin it finds in the
+ * view is the one the kernel was checked with. The checks a job did not do, or that failed, are
+ * done again by the validation thread.
+ *
+ * The MPoS outputs checked by CheckReward are left to the validation thread: nFirstMPoSBlock
+ * disables MPoS on every network, so CheckReward returns before GetMPoSOutputScripts. Once it is
+ * enabled they could move here, reading ChainActive() under cs_main and with a lock on the
+ * script cache of pos.cpp, which is not safe to use from several threads.
+ */
+class StakePrefetcher{
+
+public:
+
+    StakePrefetcher(const Consensus::Params& _consensusParams);
+
+    /** Queue the blocks to read, dropping the jobs and results of the previous ones */
+    void push(std::vector<StakePrefetchJob>&& _jobs);
+
+    /** The block read ahead, nullptr when it was not queued or could not be read. Runs the job when no thread started it yet */
+    std::shared_ptr<const CBlock> getBlock(const uint256& hash);
+
+    /** Whether the coinstake of the block was checked ahead with coin as the stake, sets hashProof */
+    bool getStake(const uint256& hash, const Coin& coin, uint256& hashProof);
+
+    /** Worker thread running the queued jobs */
+    void ThreadPrefetch();
+
+private:
+
+    void run(const StakePrefetchJob& job, StakePrefetchResult& result) const;
+
+    const Consensus::Params& consensusParams;
+
+    Mutex cs;
+
+    std::condition_variable cond;
+
+    std::deque<StakePrefetchJob> jobs GUARDED_BY(cs);
+
+    std::set<uint256> running GUARDED_BY(cs);
+
+    std::map<uint256, StakePrefetchResult> results GUARDED_BY(cs);
+};
+
+extern std::unique_ptr<StakePrefetcher> pstakeprefetcher;
+
+#endif
@@ -0,0 +1,307 @@
+#include <qtum/statediff.h>
+#include <libdevcore/SHA3.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace dev;
+
+static const h256& EmptyTrieRoot()
+{
+    static const h256 root = sha3(rlp(""));
+    return root;
+}
+
+bool TrieDiff::diff(h256 const& _rootBefore, h256 const& _rootAfter, Visitor const& _visitor, h256 const& _start)
+{
+    visitor = &_visitor;
+    start.clear();
+    for(byte b : _start.asBytes()){
+        start.push_back(b >> 4);
+        start.push_back(b & 0x0f);
+    }
+
+    Ref before, after;
+    if(_rootBefore != EmptyTrieRoot()){
+        before.kind = Ref::Hash;
+        before.hash = _rootBefore;
+    }
+    if(_rootAfter != EmptyTrieRoot()){
+        after.kind = Ref::Hash;
+        after.hash = _rootAfter;
+    }
+
+    bytes path;
+    path.reserve(64);
+    bool ret = diffRefs(before, after, path);
+    visitor = nullptr;
+    return ret;
+}
+
+bool TrieDiff::diffRefs(Ref const& _a, Ref const& _b, bytes& _path)
+{
+    // Identical references cover identical subtrees, there is nothing to load below them
+    if(_a.kind == _b.kind){
+        if(_a.kind == Ref::Null)
+            return true;
+        if(_a.kind == Ref::Hash && _a.hash == _b.hash)
+            return true;
+        if(_a.kind == Ref::Inline && _a.rlp == _b.rlp)
+            return true;
+    }
+
+    if(beforeStart(_path))
+        return true;
+
+    return diffNodes(load(_a), load(_b), _path);
+}
+
+bool TrieDiff::diffNodes(Node const& _a, Node const& _b, bytes& _path)
+{
+    bool leafA = _a.kind == Node::Leaf;
+    bool leafB = _b.kind == Node::Leaf;
+    if((leafA || _a.kind == Node::Empty) && (leafB || _b.kind == Node::Empty)){
+        bytes keyA(_path), keyB(_path);
+        keyA.insert(keyA.end(), _a.path.begin(), _a.path.end());
+        keyB.insert(keyB.end(), _b.path.begin(), _b.path.end());
+
+        if(leafA && leafB && keyA == keyB)
+            return _a.value == _b.value || emit(keyA, _a.value, _b.value);
+
+        // Report the two single leaves in key order
+        if(leafA && (!leafB || keyA < keyB)){
+            if(!emit(keyA, _a.value, std::string()))
+                return false;
+            return !leafB || emit(keyB, std::string(), _b.value);
+        }
+        if(leafB){
+            if(!emit(keyB, std::string(), _b.value))
+                return false;
+            return !leafA || emit(keyA, _a.value, std::string());
+        }
+        return true;
+    }
+
+    Node branchA = asBranch(_a);
+    Node branchB = asBranch(_b);
+    if(branchA.value != branchB.value && !emit(_path, branchA.value, branchB.value))
+        return false;
+
+    for(byte n = 0; n < 16; n++){
+        _path.push_back(n);
+        bool ret = diffRefs(branchA.children[n], branchB.children[n], _path);
+        _path.pop_back();
+        if(!ret)
+            return false;
+    }
+    return true;
+}
+
+bool TrieDiff::emit(bytes const& _key, std::string const& _before, std::string const& _after)
+{
+    if(_key < start)
+        return true;
+
+    if(_key.size() != h256::size * 2)
+        throw std::runtime_error("TrieDiff: unexpected key length in secure trie");
+
+    h256 key;
+    for(size_t i = 0; i < h256::size; i++){
+        key[i] = (_key[i * 2] << 4) | _key[i * 2 + 1];
+    }
+    return (*visitor)(key, _before, _after);
+}
+
+TrieDiff::Node TrieDiff::load(Ref const& _ref)
+{
+    switch(_ref.kind){
+    case Ref::Hash:
+    {
+        std::string rlp = db.lookup(_ref.hash);
+        if(rlp.empty())
+            throw std::runtime_error("TrieDiff: missing trie node " + _ref.hash.hex());
+        loaded++;
+        return decode(RLP(rlp));
+    }
+    case Ref::Inline:
+        return decode(RLP(_ref.rlp));
+    case Ref::Virtual:
+        return *_ref.node;
+    default:
+        return Node();
+    }
+}
+
+TrieDiff::Node TrieDiff::decode(RLP const& _rlp) const
+{
+    Node node;
+    if(_rlp.isData() && _rlp.payload().size() == 0)
+        return node;
+
+    if(_rlp.isList() && _rlp.itemCount() == 2){
+        // Leaf or extension, the first item is the hex-prefix encoded path
+        bytesConstRef encoded = _rlp[0].payload();
+        if(encoded.size() == 0)
+            throw std::runtime_error("TrieDiff: malformed trie node path");
+
+        byte flags = encoded[0] >> 4;
+        if(flags & 1)
+            node.path.push_back(encoded[0] & 0x0f);
+        for(size_t i = 1; i < encoded.size(); i++){
+            node.path.push_back(encoded[i] >> 4);
+            node.path.push_back(encoded[i] & 0x0f);
+        }
+
+        if(flags & 2){
+            node.kind = Node::Leaf;
+            node.value = _rlp[1].payload().toString();
+        } else {
+            node.kind = Node::Extension;
+            node.child = childRef(_rlp[1]);
+        }
+        return node;
+    }
+
+    if(_rlp.isList() && _rlp.itemCount() == 17){
+        node.kind = Node::Branch;
+        for(unsigned i = 0; i < 16; i++){
+            node.children[i] = childRef(_rlp[i]);
+        }
+        node.value = _rlp[16].payload().toString();
+        return node;
+    }
+
+    throw std::runtime_error("TrieDiff: malformed trie node");
+}
+
+TrieDiff::Ref TrieDiff::childRef(RLP const& _rlp) const
+{
+    Ref ref;
+    if(_rlp.isList()){
+        ref.kind = Ref::Inline;
+        ref.rlp = _rlp.data().toString();
+    } else if(_rlp.isData() && _rlp.payload().size() == h256::size){
+        ref.kind = Ref::Hash;
+        ref.hash = _rlp.toHash<h256>();
+    } else if(!_rlp.isData() || _rlp.payload().size() != 0){
+        throw std::runtime_error("TrieDiff: malformed trie node reference");
+    }
+    return ref;
+}
+
+TrieDiff::Node TrieDiff::asBranch(Node const& _node) const
+{
+    if(_node.kind == Node::Branch)
+        return _node;
+
+    Node branch;
+    branch.kind = Node::Branch;
+    if(_node.kind == Node::Empty)
+        return branch;
+
+    if(_node.kind == Node::Leaf && _node.path.empty()){
+        branch.value = _node.value;
+        return branch;
+    }
+
+    if(_node.path.empty())
+        throw std::runtime_error("TrieDiff: extension node with empty path");
+
+    // Split off the first nibble, the rest of the leaf or extension hangs below it
+    Ref& child = branch.children[_node.path[0]];
+    if(_node.kind == Node::Extension && _node.path.size() == 1){
+        child = _node.child;
+    } else {
+        auto rest = std::make_shared<Node>(_node);
+        rest->path.erase(rest->path.begin());
+        child.kind = Ref::Virtual;
+        child.node = rest;
+    }
+    return branch;
+}
+
+bool TrieDiff::beforeStart(bytes const& _path) const
+{
+    size_t len = std::min(_path.size(), start.size());
+    return std::lexicographical_compare(_path.begin(), _path.begin() + len, start.begin(), start.begin() + len);
+}
+
+bool StateDiff::diff(h256 const& _rootBefore, h256 const& _rootAfter, AccountVisitor const& _onAccount, StorageVisitor const& _onStorage, StateDiffCursor const* _cursor)
+{
+    return accounts.diff(_rootBefore, _rootAfter, [&](h256 const& key, std::string const& before, std::string const& after){
+        return visitAccount(key, nullptr, before, after, _onAccount, _onStorage, _cursor);
+    }, _cursor ? _cursor->account : h256());
+}
+
+bool StateDiff::diffAccount(Address const& _address, h256 const& _rootBefore, h256 const& _rootAfter, AccountVisitor const& _onAccount, StorageVisitor const& _onStorage, StateDiffCursor const* _cursor)
+{
+    // promise we won't alter the overlay
+    OverlayDB* overlay = const_cast<OverlayDB*>(&db);
+    std::string before = eth::SecureTrieDB<Address, OverlayDB>(overlay, _rootBefore).at(_address);
+    std::string after = eth::SecureTrieDB<Address, OverlayDB>(overlay, _rootAfter).at(_address);
+    if(before == after)
+        return true;
+
+    h256 key = sha3(_address);
+    if(_cursor && _cursor->account > key)
+        return true;
+    return visitAccount(key, &_address, before, after, _onAccount, _onStorage, _cursor);
+}
+
+bool StateDiff::visitAccount(h256 const& _key, Address const* _address, std::string const& _before, std::string const& _after, AccountVisitor const& _onAccount, StorageVisitor const& _onStorage, StateDiffCursor const* _cursor)
+{
+    AccountDiff account;
+    account.key = _key;
+    if(_address){
+        account.address = *_address;
+    } else {
+        bytes preimage = db.lookupAux(_key);
+        if(preimage.size() == Address::size)
+            account.address = Address(preimage);
+    }
+
+    // Accounts are stored as RLP [nonce, balance, storageRoot, codeHash]
+    account.existedBefore = !_before.empty();
+    account.storageRootBefore = EmptyTrieRoot();
+    if(account.existedBefore){
+        RLP state(_before);
+        account.nonceBefore = state[0].toInt<u256>();
+        account.balanceBefore = state[1].toInt<u256>();
+        account.storageRootBefore = state[2].toHash<h256>();
+        account.codeHashBefore = state[3].toHash<h256>();
+    }
+    account.existsAfter = !_after.empty();
+    account.storageRootAfter = EmptyTrieRoot();
+    if(account.existsAfter){
+        RLP state(_after);
+        account.nonceAfter = state[0].toInt<u256>();
+        account.balanceAfter = state[1].toInt<u256>();
+        account.storageRootAfter = state[2].toHash<h256>();
+        account.codeHashAfter = state[3].toHash<h256>();
+    }
+
+    // The account entry itself was already reported if the cursor points into this account
+    bool resume = _cursor && _cursor->account == _key;
+    if(!resume && !_onAccount(account))
+        return false;
+
+    if(account.storageRootBefore == account.storageRootAfter)
+        return true;
+
+    bool skipSlot = resume && _cursor->hasSlot;
+    return storage.diff(account.storageRootBefore, account.storageRootAfter, [&](h256 const& key, std::string const& before, std::string const& after){
+        if(skipSlot && key == _cursor->slot)
+            return true;
+
+        StorageDiff slot;
+        slot.key = key;
+        bytes preimage = db.lookupAux(key);
+        if(preimage.size() == h256::size){
+            slot.slot = h256(preimage);
+            slot.hasSlot = true;
+        }
+        slot.before = before.empty() ? u256(0) : RLP(before).toInt<u256>();
+        slot.after = after.empty() ? u256(0) : RLP(after).toInt<u256>();
+        return _onStorage(account, slot);
+    }, skipSlot ? _cursor->slot : h256());
+}
@@ -0,0 +1,155 @@
+#ifndef STATEDIFF_H
+#define STATEDIFF_H
+
+#include <libdevcore/OverlayDB.h>
+#include <libdevcore/RLP.h>
+#include <libethereum/SecureTrieDB.h>
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * TrieDiff walks two roots of a (secure) Merkle Patricia trie stored in the same
+ * OverlayDB side by side and reports the leaves that differ between them, in trie
+ * key order. Subtrees that are referenced by the same hash on both sides are
+ * skipped without being loaded, so the cost of a diff is proportional to the
+ * size of the change and not to the size of the trie.
+ *
+ * Diffing a root against the empty trie root (sha3(rlp(""))) yields every leaf,
+ * which is how storage range scans are implemented.
+ */
+class TrieDiff{
+
+public:
+
+    /** Called for every changed key. An empty string means the key is absent on that side.
+     *  Returning false stops the walk. */
+    using Visitor = std::function<bool(dev::h256 const& key, std::string const& before, std::string const& after)>;
+
+    explicit TrieDiff(dev::OverlayDB const& _db) : db(_db) {}
+
+    /** Report the keys >= _start that differ between the two roots.
+     *  @returns false if the visitor stopped the walk early.
+     *  @throws std::runtime_error if a referenced trie node is not in the database. */
+    bool diff(dev::h256 const& _rootBefore, dev::h256 const& _rootAfter, Visitor const& _visitor, dev::h256 const& _start = dev::h256());
+
+    /** Number of trie nodes read from the database by the previous walks */
+    uint64_t nodesLoaded() const { return loaded; }
+
+private:
+
+    struct Node;
+
+    /** A reference to a child node: by hash, embedded RLP, or a node synthesized while splitting
+     *  extensions and leaves into branch form (which can never be skipped by comparison). */
+    struct Ref{
+        enum Kind { Null, Hash, Inline, Virtual } kind = Null;
+        dev::h256 hash;
+        std::string rlp;
+        std::shared_ptr<const Node> node;
+    };
+
+    struct Node{
+        enum Kind { Empty, Leaf, Extension, Branch } kind = Empty;
+        dev::bytes path;
+        std::string value;
+        Ref child;
+        std::array<Ref, 16> children;
+    };
+
+    bool diffRefs(Ref const& _a, Ref const& _b, dev::bytes& _path);
+
+    bool diffNodes(Node const& _a, Node const& _b, dev::bytes& _path);
+
+    bool emit(dev::bytes const& _key, std::string const& _before, std::string const& _after);
+
+    Node load(Ref const& _ref);
+
+    Node decode(dev::RLP const& _rlp) const;
+
+    Ref childRef(dev::RLP const& _rlp) const;
+
+    Node asBranch(Node const& _node) const;
+
+    bool beforeStart(dev::bytes const& _path) const;
+
+    dev::OverlayDB const& db;
+
+    const Visitor* visitor = nullptr;
+
+    dev::bytes start;
+
+    uint64_t loaded = 0;
+};
+
+/** The account fields that changed between two state roots */
+struct AccountDiff{
+    dev::h256 key;
+    dev::Address address;
+    bool existedBefore = false;
+    bool existsAfter = false;
+    dev::u256 nonceBefore;
+    dev::u256 nonceAfter;
+    dev::u256 balanceBefore;
+    dev::u256 balanceAfter;
+    dev::h256 storageRootBefore;
+    dev::h256 storageRootAfter;
+    dev::h256 codeHashBefore;
+    dev::h256 codeHashAfter;
+};
+
+/** A storage slot that changed between two state roots */
+struct StorageDiff{
+    dev::h256 key;
+    dev::h256 slot;
+    bool hasSlot = false;
+    dev::u256 before;
+    dev::u256 after;
+};
+
+/** Position of the last entry reported by StateDiff, so a walk can be resumed after it */
+struct StateDiffCursor{
+    dev::h256 account;
+    dev::h256 slot;
+    bool hasSlot = false;
+};
+
+/**
+ * StateDiff streams the accounts and storage slots that changed between two
+ * contract state roots (hashStateRoot of two blocks). For every changed account
+ * an account entry is reported first, followed by its changed storage slots.
+ */
+class StateDiff{
+
+public:
+
+    using AccountVisitor = std::function<bool(AccountDiff const& account)>;
+
+    using StorageVisitor = std::function<bool(AccountDiff const& account, StorageDiff const& storage)>;
+
+    explicit StateDiff(dev::OverlayDB const& _db) : db(_db), accounts(_db), storage(_db) {}
+
+    /** Walk all changed accounts, resuming strictly after _cursor when given.
+     *  @returns false if one of the visitors stopped the walk early. */
+    bool diff(dev::h256 const& _rootBefore, dev::h256 const& _rootAfter, AccountVisitor const& _onAccount, StorageVisitor const& _onStorage, StateDiffCursor const* _cursor = nullptr);
+
+    /** Like diff() but restricted to a single account, looked up directly instead of walking the account trie */
+    bool diffAccount(dev::Address const& _address, dev::h256 const& _rootBefore, dev::h256 const& _rootAfter, AccountVisitor const& _onAccount, StorageVisitor const& _onStorage, StateDiffCursor const* _cursor = nullptr);
+
+    uint64_t nodesLoaded() const { return accounts.nodesLoaded() + storage.nodesLoaded(); }
+
+private:
+
+    bool visitAccount(dev::h256 const& _key, dev::Address const* _address, std::string const& _before, std::string const& _after, AccountVisitor const& _onAccount, StorageVisitor const& _onStorage, StateDiffCursor const* _cursor);
+
+    dev::OverlayDB const& db;
+
+    TrieDiff accounts;
+
+    TrieDiff storage;
+};
+
+#endif
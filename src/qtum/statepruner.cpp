@@ -0,0 +1,280 @@
+#include <qtum/statepruner.h>
+#include <util/convert.h>
+#include <util/system.h>
+#include <util/time.h>
+#include <validation.h>
+#include <libdevcore/SHA3.h>
+
+#include <boost/thread/thread.hpp>
+
+using namespace dev;
+
+std::unique_ptr<StatePruner> pstatepruner;
+
+static db::Slice ToSlice(h256 const& _hash)
+{
+    return db::Slice(reinterpret_cast<char const*>(_hash.data()), h256::size);
+}
+
+void StatePruner::markState(h256 const& _root)
+{
+    markNode(state, _root, true);
+}
+
+void StatePruner::markUTXO(h256 const& _root)
+{
+    markNode(utxo, _root, false);
+}
+
+void StatePruner::markNode(Database& _db, h256 const& _hash, bool _accounts)
+{
+    if(fOverflow)
+        return;
+    if(liveNodes() >= maxLive){
+        fOverflow = true;
+        return;
+    }
+
+    // Everything below a marked node is marked too
+    if(!_db.live.insert(_hash).second)
+        return;
+
+    if(_db.live.size() % 10000 == 0)
+        boost::this_thread::interruption_point();
+
+    std::string node = _db.db.lookup(ToSlice(_hash));
+    if(node.empty())
+        return;
+    markRLP(_db, RLP(node), _accounts);
+}
+
+void StatePruner::markRLP(Database& _db, RLP const& _node, bool _accounts)
+{
+    if(!_node.isList())
+        return;
+
+    if(_node.itemCount() == 2){
+        // Leaf or extension, the hex-prefix flag of the path tells them apart
+        bytesConstRef path = _node[0].payload();
+        if(path.size() && (path[0] & 0x20))
+            markLeaf(_db, _node[1].payload(), _accounts);
+        else
+            markChild(_db, _node[1], _accounts);
+    } else if(_node.itemCount() == 17){
+        for(unsigned i = 0; i < 16; i++){
+            markChild(_db, _node[i], _accounts);
+        }
+        if(_node[16].payload().size())
+            markLeaf(_db, _node[16].payload(), _accounts);
+    }
+}
+
+void StatePruner::markChild(Database& _db, RLP const& _child, bool _accounts)
+{
+    if(_child.isList())
+        markRLP(_db, _child, _accounts);
+    else if(_child.isData() && _child.payload().size() == h256::size)
+        markNode(_db, _child.toHash<h256>(), _accounts);
+}
+
+void StatePruner::markLeaf(Database& _db, bytesConstRef _value, bool _accounts)
+{
+    if(!_accounts)
+        return;
+
+    // Accounts are stored as RLP [nonce, balance, storageRoot, codeHash]
+    RLP account(_value);
+    if(!account.isList() || account.itemCount() < 4)
+        return;
+    markNode(_db, account[2].toHash<h256>(), false);
+    // The code is stored under its hash as is, there is nothing to walk below it
+    _db.live.insert(account[3].toHash<h256>());
+}
+
+size_t StatePruner::collect(size_t _max)
+{
+    size_t count = collect(state, _max);
+    return count + collect(utxo, _max);
+}
+
+size_t StatePruner::collect(Database& _db, size_t _max)
+{
+    _db.candidates.clear();
+    if(_max == 0)
+        return 0;
+
+    size_t scanned = 0;
+    _db.db.forEach([&](db::Slice _key, db::Slice _value){
+        if(++scanned % 100000 == 0)
+            boost::this_thread::interruption_point();
+
+        // Only trie nodes and code are keyed by a plain hash, aux entries carry a suffix
+        if(_key.size() != h256::size)
+            return true;
+        h256 key(reinterpret_cast<byte const*>(_key.data()), h256::ConstructFromPointer);
+        if(!_db.live.count(key))
+            _db.candidates.push_back({key, _key.size() + _value.size()});
+        return _db.candidates.size() < _max;
+    });
+    return _db.candidates.size();
+}
+
+uint64_t StatePruner::sweep(size_t _max)
+{
+    uint64_t bytes = sweep(state, _max);
+    return bytes + sweep(utxo, _max);
+}
+
+uint64_t StatePruner::sweep(Database& _db, size_t& _max)
+{
+    if(fOverflow){
+        _db.candidates.clear();
+        return 0;
+    }
+
+    std::unique_ptr<db::WriteBatchFace> batch = _db.db.createWriteBatch();
+    uint64_t bytes = 0;
+    size_t removed = 0;
+    while(_max && !_db.candidates.empty()){
+        Candidate candidate = _db.candidates.back();
+        _db.candidates.pop_back();
+        // Marked again since it was collected, a newer block refers to it
+        if(_db.live.count(candidate.key))
+            continue;
+        batch->kill(ToSlice(candidate.key));
+        bytes += candidate.size;
+        removed++;
+        _max--;
+    }
+    if(removed)
+        _db.db.commit(std::move(batch));
+
+    nodesRemoved += removed;
+    bytesReclaimed += bytes;
+    return bytes;
+}
+
+void StatePruner::clear()
+{
+    state.live.clear();
+    state.candidates.clear();
+    utxo.live.clear();
+    utxo.candidates.clear();
+    fOverflow = false;
+
+    // Opening a trie at the empty root expects its node in the database
+    const h256 emptyTrie = sha3(rlp(""));
+    state.live.insert(emptyTrie);
+    utxo.live.insert(emptyTrie);
+}
+
+std::vector<std::pair<h256, h256>> StatePruner::retainedRoots() const
+{
+    AssertLockHeld(cs_main);
+
+    std::vector<std::pair<h256, h256>> roots;
+    const CBlockIndex* pindex = ::ChainActive().Tip();
+    if(!pindex)
+        return roots;
+    int nMinHeight = pindex->nHeight - keepBlocks + 1;
+
+    // A restart resumes from the block the coins database was last flushed at, keep its state
+    // and the state of the blocks on its branch if it was disconnected since. While a flush is
+    // written in the background the database is in transition and the restart rolls forward
+    // from the old block to the new one, keep the state of both.
+    std::vector<uint256> hashFlushed = ::ChainstateActive().CoinsDB().GetHeadBlocks();
+    if(hashFlushed.empty())
+        hashFlushed.push_back(::ChainstateActive().CoinsDB().GetBestBlock());
+    hashFlushed.push_back(::ChainstateActive().CoinsWriteBehind().GetBestBlock());
+    for(const uint256& hash : hashFlushed){
+        const CBlockIndex* pflushed = LookupBlockIndex(hash);
+        if(!pflushed)
+            continue;
+        const CBlockIndex* pfork = ::ChainActive().FindFork(pflushed);
+        for(; pflushed && pflushed != pfork; pflushed = pflushed->pprev){
+            roots.emplace_back(uintToh256(pflushed->hashStateRoot), uintToh256(pflushed->hashUTXORoot));
+        }
+        if(pfork)
+            nMinHeight = std::min(nMinHeight, pfork->nHeight);
+    }
+
+    for(; pindex && pindex->nHeight >= nMinHeight; pindex = pindex->pprev){
+        roots.emplace_back(uintToh256(pindex->hashStateRoot), uintToh256(pindex->hashUTXORoot));
+    }
+    return roots;
+}
+
+void StatePruner::markRoots(std::vector<std::pair<h256, h256>> const& _roots)
+{
+    for(auto const& root : _roots){
+        markState(root.first);
+        markUTXO(root.second);
+    }
+}
+
+void StatePruner::prune()
+{
+    int64_t nStart = GetTimeMillis();
+    uint64_t nRemoved = nodesRemoved;
+    uint64_t nBytes = bytesReclaimed;
+
+    clear();
+    std::vector<std::pair<h256, h256>> roots;
+    int nHeight = 0;
+    {
+        LOCK(cs_main);
+        roots = retainedRoots();
+        nHeight = ::ChainActive().Height();
+    }
+    if(roots.empty())
+        return;
+
+    // The nodes of connected blocks are committed and never change, so the bulk of
+    // the marking and the scan can run without blocking validation
+    markRoots(roots);
+    if(!fOverflow)
+        collect();
+
+    while(pending()){
+        {
+            LOCK(cs_main);
+            if(nHolds == 0){
+                markRoots(retainedRoots());
+                sweep();
+                continue;
+            }
+        }
+        // The state is being read without cs_main, wait for it to be released
+        MilliSleep(100);
+        boost::this_thread::interruption_point();
+    }
+
+    if(fOverflow){
+        LogPrintf("Contract state has more than %u live trie nodes, skipped pruning below height %d\n", maxLive, nHeight - keepBlocks + 1);
+        clear();
+        lastPruneHeight = nHeight;
+        return;
+    }
+
+    size_t nLive = liveNodes();
+    clear();
+    lastPruneHeight = nHeight;
+    LogPrintf("Pruned contract state below height %d: removed %u trie nodes, reclaimed %u bytes, %u nodes live (%dms)\n",
+        nHeight - keepBlocks + 1, nodesRemoved - nRemoved, bytesReclaimed - nBytes, nLive, GetTimeMillis() - nStart);
+}
+
+void StatePruner::ThreadPrune()
+{
+    while(true){
+        MilliSleep(60 * 1000);
+        int nHeight = 0;
+        {
+            LOCK(cs_main);
+            if(::ChainstateActive().IsInitialBlockDownload() || ::ChainActive().Tip() == nullptr)
+                continue;
+            nHeight = ::ChainActive().Height();
+        }
+        if(nHeight - lastPruneHeight >= STATE_PRUNE_INTERVAL)
+            prune();
+    }
+}
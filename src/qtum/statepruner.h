@@ -0,0 +1,166 @@
+#ifndef STATEPRUNER_H
+#define STATEPRUNER_H
+
+#include <consensus/consensus.h>
+#include <libdevcore/db.h>
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/RLP.h>
+
+#include <atomic>
+#include <memory>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/** Prune the contract state of old blocks, off by default so the state of every block stays queryable */
+static const bool DEFAULT_STATE_PRUNE = false;
+/** Keep the contract state of this many blocks below the tip by default */
+static const int DEFAULT_STATE_KEEP_BLOCKS = 2000;
+/** A proof of stake reorg can disconnect up to COINBASE_MATURITY blocks, their parents' state must be kept */
+static const int MIN_STATE_KEEP_BLOCKS = COINBASE_MATURITY;
+/** Run a pruning pass once the tip moved this many blocks since the previous pass */
+static const int STATE_PRUNE_INTERVAL = 500;
+/** Max trie nodes deleted while holding cs_main */
+static const size_t STATE_PRUNE_BATCH = 10000;
+/** Max trie nodes collected for deletion in one pass, the rest is left for the next pass */
+static const size_t STATE_PRUNE_MAX_COLLECT = 2000000;
+/** Max trie nodes marked live in one pass, a larger state is not pruned rather than exhausting memory */
+static const size_t STATE_PRUNE_MAX_LIVE = 10000000;
+
+/**
+ * StatePruner removes trie nodes from the contract state database (stateQtum/.../state)
+ * and the UTXO database (stateQtum/qtumDB) that are no longer reachable from the state
+ * of any retained block. The OverlayDB commits new nodes for every block but never deletes
+ * any, so without pruning the databases only grow.
+ *
+ * Pruning is mark and sweep: everything reachable from hashStateRoot/hashUTXORoot of the
+ * retained blocks (account tries, storage tries and contract code) is marked live, the
+ * databases are scanned for trie nodes that are not marked, and those are deleted in
+ * batches. Marking skips subtrees that are already marked, so re-marking the roots of
+ * newly connected blocks before every batch only costs the size of their changes.
+ * Preimages stored with insertAux are not trie nodes and are kept.
+ */
+class StatePruner{
+
+public:
+
+    StatePruner(dev::db::DatabaseFace& _state, dev::db::DatabaseFace& _utxo, int _keepBlocks, size_t _maxLive = STATE_PRUNE_MAX_LIVE) :
+        state(_state), utxo(_utxo), keepBlocks(_keepBlocks), maxLive(_maxLive) { clear(); }
+
+    /** Mark all nodes reachable from a state root, including storage tries and code */
+    void markState(dev::h256 const& _root);
+
+    /** Mark all nodes reachable from a UTXO root */
+    void markUTXO(dev::h256 const& _root);
+
+    /** Scan both databases for unmarked trie nodes, collecting at most _max of them.
+     *  Only reads the databases, so it can run without holding cs_main. */
+    size_t collect(size_t _max = STATE_PRUNE_MAX_COLLECT);
+
+    /** Delete up to _max collected nodes that are still unmarked. The roots of blocks
+     *  connected since collect() must be marked first, under the same lock.
+     *  @returns the number of bytes reclaimed */
+    uint64_t sweep(size_t _max = STATE_PRUNE_BATCH);
+
+    /** Whether collected nodes are left to sweep */
+    bool pending() const { return !state.candidates.empty() || !utxo.candidates.empty(); }
+
+    /** Forget all marks and candidates before a new pass */
+    void clear();
+
+    size_t liveNodes() const { return state.live.size() + utxo.live.size(); }
+
+    /** Whether marking stopped at maxLive nodes. The marks are then incomplete and nothing may be swept. */
+    bool overflowed() const { return fOverflow; }
+
+    /** Run one full pass over the active chain, keeping the state of the last keepBlocks blocks */
+    void prune();
+
+    /** Background thread, runs prune() every STATE_PRUNE_INTERVAL blocks outside of initial block download */
+    void ThreadPrune();
+
+    int getKeepBlocks() const { return keepBlocks; }
+
+    int getLastPruneHeight() const { return lastPruneHeight; }
+
+    uint64_t getNodesRemoved() const { return nodesRemoved; }
+
+    uint64_t getBytesReclaimed() const { return bytesReclaimed; }
+
+    /** Keep pruning passes from sweeping until release(). Checked under cs_main before every batch,
+     *  so the state of a retained block can be read without cs_main once it is looked up with it. */
+    void hold() { nHolds++; }
+
+    void release() { nHolds--; }
+
+private:
+
+    struct Candidate{
+        dev::h256 key;
+        uint64_t size;
+    };
+
+    struct Database{
+        Database(dev::db::DatabaseFace& _db) : db(_db) {}
+        dev::db::DatabaseFace& db;
+        std::unordered_set<dev::h256> live;
+        std::vector<Candidate> candidates;
+    };
+
+    void markNode(Database& _db, dev::h256 const& _hash, bool _accounts);
+
+    void markRLP(Database& _db, dev::RLP const& _node, bool _accounts);
+
+    void markLeaf(Database& _db, dev::bytesConstRef _value, bool _accounts);
+
+    void markChild(Database& _db, dev::RLP const& _child, bool _accounts);
+
+    size_t collect(Database& _db, size_t _max);
+
+    uint64_t sweep(Database& _db, size_t& _max);
+
+    /** hashStateRoot and hashUTXORoot of the blocks whose state is kept, requires cs_main */
+    std::vector<std::pair<dev::h256, dev::h256>> retainedRoots() const;
+
+    void markRoots(std::vector<std::pair<dev::h256, dev::h256>> const& _roots);
+
+    Database state;
+
+    Database utxo;
+
+    const int keepBlocks;
+
+    const size_t maxLive;
+
+    bool fOverflow = false;
+
+    std::atomic<int> lastPruneHeight{0};
+
+    std::atomic<uint64_t> nodesRemoved{0};
+
+    std::atomic<uint64_t> bytesReclaimed{0};
+
+    std::atomic<int> nHolds{0};
+};
+
+/** Holds off state pruning for its lifetime, does nothing if pruning is disabled */
+class StatePruneHold{
+
+public:
+
+    explicit StatePruneHold(StatePruner* _pruner) : pruner(_pruner) { if(pruner) pruner->hold(); }
+
+    ~StatePruneHold() { if(pruner) pruner->release(); }
+
+    StatePruneHold(StatePruneHold const&) = delete;
+
+    StatePruneHold& operator=(StatePruneHold const&) = delete;
+
+private:
+
+    StatePruner* pruner;
+};
+
+extern std::unique_ptr<StatePruner> pstatepruner;
+
+#endif
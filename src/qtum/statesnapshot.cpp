@@ -0,0 +1,302 @@
+#include <qtum/statesnapshot.h>
+#include <tinyformat.h>
+#include <util/convert.h>
+#include <libdevcore/RLP.h>
+#include <libdevcore/SHA3.h>
+
+#include <boost/thread/thread.hpp>
+
+#include <cstring>
+#include <functional>
+#include <ios>
+#include <memory>
+#include <stdexcept>
+#include <unordered_set>
+
+using namespace dev;
+
+static const char STATE_SNAPSHOT_MAGIC[4] = {'m', 'r', 'x', 's'};
+
+static db::Slice ToSlice(bytesConstRef _data)
+{
+    return db::Slice(reinterpret_cast<char const*>(_data.data()), _data.size());
+}
+
+static bytes AuxKey(h256 const& _hash)
+{
+    // OverlayDB stores aux entries under the hash followed by 255
+    bytes key = _hash.asBytes();
+    key.push_back(255);
+    return key;
+}
+
+/**
+ * Walks every node reachable from a state or UTXO root, keeping track of the key
+ * path so the preimages of the hashed keys can be reported along with the leaves.
+ */
+class SnapshotWalker{
+
+public:
+
+    using Visitor = std::function<void(std::string const& data)>;
+
+    SnapshotWalker(db::DatabaseFace& _db, Visitor const& _onNode, Visitor const& _onPreimage) :
+        db(_db), onNode(_onNode), onPreimage(_onPreimage) {}
+
+    void walk(h256 const& _root, bool _accounts){
+        bytes path;
+        node(_root, path, _accounts);
+    }
+
+private:
+
+    void node(h256 const& _hash, bytes& _path, bool _accounts){
+        if(!visited.insert(_hash).second)
+            return;
+        if(visited.size() % 10000 == 0)
+            boost::this_thread::interruption_point();
+
+        std::string data = db.lookup(ToSlice(_hash.ref()));
+        if(data.empty() && _hash == emptyTrie)
+            return;
+        if(data.empty())
+            throw std::runtime_error("missing trie node " + _hash.hex());
+        onNode(data);
+        rlp(RLP(data), _path, _accounts);
+    }
+
+    void rlp(RLP const& _node, bytes& _path, bool _accounts){
+        if(!_node.isList())
+            return;
+
+        size_t size = _path.size();
+        if(_node.itemCount() == 2){
+            bytesConstRef encoded = _node[0].payload();
+            if(encoded.empty())
+                throw std::runtime_error("malformed trie node");
+            if(encoded[0] & 0x10)
+                _path.push_back(encoded[0] & 0x0f);
+            for(size_t i = 1; i < encoded.size(); i++){
+                _path.push_back(encoded[i] >> 4);
+                _path.push_back(encoded[i] & 0x0f);
+            }
+            if(encoded[0] & 0x20)
+                leaf(_path, _node[1].payload(), _accounts);
+            else
+                child(_node[1], _path, _accounts);
+        } else if(_node.itemCount() == 17){
+            for(byte i = 0; i < 16; i++){
+                _path.push_back(i);
+                child(_node[i], _path, _accounts);
+                _path.pop_back();
+            }
+            if(_node[16].payload().size())
+                leaf(_path, _node[16].payload(), _accounts);
+        }
+        _path.resize(size);
+    }
+
+    void child(RLP const& _child, bytes& _path, bool _accounts){
+        if(_child.isList())
+            rlp(_child, _path, _accounts);
+        else if(_child.isData() && _child.payload().size() == h256::size)
+            node(_child.toHash<h256>(), _path, _accounts);
+    }
+
+    void leaf(bytes const& _path, bytesConstRef _value, bool _accounts){
+        if(_path.size() == h256::size * 2){
+            h256 key;
+            for(size_t i = 0; i < h256::size; i++){
+                key[i] = (_path[i * 2] << 4) | _path[i * 2 + 1];
+            }
+            bytes auxKey = AuxKey(key);
+            std::string preimage = db.lookup(ToSlice(&auxKey));
+            if(!preimage.empty())
+                onPreimage(preimage);
+        }
+
+        if(!_accounts)
+            return;
+
+        // Accounts are stored as RLP [nonce, balance, storageRoot, codeHash]
+        RLP account(_value);
+        if(!account.isList() || account.itemCount() < 4)
+            throw std::runtime_error("malformed account");
+        bytes storagePath;
+        node(account[2].toHash<h256>(), storagePath, false);
+
+        h256 codeHash = account[3].toHash<h256>();
+        if(codeHash != EmptySHA3 && visited.insert(codeHash).second){
+            std::string code = db.lookup(ToSlice(codeHash.ref()));
+            if(code.empty())
+                throw std::runtime_error("missing contract code " + codeHash.hex());
+            onNode(code);
+        }
+    }
+
+    db::DatabaseFace& db;
+
+    Visitor const& onNode;
+
+    Visitor const& onPreimage;
+
+    std::unordered_set<h256> visited;
+
+    const h256 emptyTrie = sha3(rlp(""));
+};
+
+/** Collects the walked entries into chunks and writes them out */
+class SnapshotChunkWriter{
+
+public:
+
+    explicit SnapshotChunkWriter(CAutoFile& _file) : file(_file) {}
+
+    void add(uint8_t _database, std::string const& _data, bool _preimage){
+        if(chunk.nDatabase != _database || size >= STATE_SNAPSHOT_CHUNK_SIZE){
+            flush();
+            chunk.nDatabase = _database;
+        }
+        std::vector<std::vector<unsigned char>>& entries = _preimage ? chunk.vPreimages : chunk.vNodes;
+        entries.emplace_back(_data.begin(), _data.end());
+        size += _data.size();
+        stats.nBytes += _data.size();
+        if(_preimage)
+            stats.nPreimages++;
+        else
+            stats.nNodes++;
+    }
+
+    void flush(){
+        if(chunk.vNodes.empty() && chunk.vPreimages.empty())
+            return;
+        file << chunk << chunk.GetChecksum();
+        stats.nChunks++;
+        chunk = StateSnapshotChunk();
+        size = 0;
+    }
+
+    void finish(){
+        flush();
+        file << chunk << chunk.GetChecksum();
+    }
+
+    StateSnapshotStats stats;
+
+private:
+
+    CAutoFile& file;
+
+    StateSnapshotChunk chunk;
+
+    size_t size = 0;
+};
+
+static void WalkSnapshot(StateSnapshotHeader const& _header, db::DatabaseFace& _state, db::DatabaseFace& _utxo, std::function<void(uint8_t, std::string const&, bool)> const& _visitor)
+{
+    SnapshotWalker::Visitor stateNode = [&](std::string const& data){ _visitor(StateSnapshotChunk::STATE, data, false); };
+    SnapshotWalker::Visitor statePreimage = [&](std::string const& data){ _visitor(StateSnapshotChunk::STATE, data, true); };
+    SnapshotWalker(_state, stateNode, statePreimage).walk(uintToh256(_header.hashStateRoot), true);
+
+    SnapshotWalker::Visitor utxoNode = [&](std::string const& data){ _visitor(StateSnapshotChunk::UTXO, data, false); };
+    SnapshotWalker::Visitor utxoPreimage = [&](std::string const& data){ _visitor(StateSnapshotChunk::UTXO, data, true); };
+    SnapshotWalker(_utxo, utxoNode, utxoPreimage).walk(uintToh256(_header.hashUTXORoot), false);
+}
+
+StateSnapshotStats WriteStateSnapshot(CAutoFile& _file, StateSnapshotHeader const& _header, db::DatabaseFace& _state, db::DatabaseFace& _utxo)
+{
+    _file.write(STATE_SNAPSHOT_MAGIC, sizeof(STATE_SNAPSHOT_MAGIC));
+    _file << _header;
+
+    SnapshotChunkWriter writer(_file);
+    WalkSnapshot(_header, _state, _utxo, [&](uint8_t database, std::string const& data, bool preimage){
+        writer.add(database, data, preimage);
+    });
+    writer.finish();
+    return writer.stats;
+}
+
+StateSnapshotHeader ReadStateSnapshotHeader(CAutoFile& _file)
+{
+    char magic[sizeof(STATE_SNAPSHOT_MAGIC)];
+    _file.read(magic, sizeof(magic));
+    if(memcmp(magic, STATE_SNAPSHOT_MAGIC, sizeof(magic)) != 0)
+        throw std::runtime_error("not a contract state snapshot");
+
+    StateSnapshotHeader header;
+    _file >> header;
+    if(header.nVersion != STATE_SNAPSHOT_VERSION)
+        throw std::runtime_error(strprintf("unsupported snapshot version %u", header.nVersion));
+    return header;
+}
+
+bool ReadStateSnapshotChunk(CAutoFile& _file, StateSnapshotChunk& _chunk)
+{
+    uint256 checksum;
+    _file >> _chunk >> checksum;
+    if(_chunk.GetChecksum() != checksum)
+        throw std::runtime_error("checksum mismatch");
+    if(_chunk.nDatabase == StateSnapshotChunk::END)
+        return false;
+    if(_chunk.nDatabase != StateSnapshotChunk::STATE && _chunk.nDatabase != StateSnapshotChunk::UTXO)
+        throw std::runtime_error("unknown database");
+    return true;
+}
+
+StateSnapshotStats LoadStateSnapshot(CAutoFile& _file, StateSnapshotHeader const& _header, db::DatabaseFace& _state, db::DatabaseFace& _utxo)
+{
+    StateSnapshotStats stats;
+    StateSnapshotChunk chunk;
+    while(true){
+        boost::this_thread::interruption_point();
+        try {
+            if(!ReadStateSnapshotChunk(_file, chunk))
+                break;
+        } catch(const std::ios_base::failure&) {
+            throw std::runtime_error(strprintf("truncated snapshot after chunk %u", stats.nChunks));
+        } catch(const std::runtime_error& e) {
+            throw std::runtime_error(strprintf("%s in chunk %u", e.what(), stats.nChunks));
+        }
+
+        db::DatabaseFace& database = chunk.nDatabase == StateSnapshotChunk::STATE ? _state : _utxo;
+        std::unique_ptr<db::WriteBatchFace> batch = database.createWriteBatch();
+        for(std::vector<unsigned char> const& node : chunk.vNodes){
+            h256 key = sha3(node);
+            batch->insert(ToSlice(key.ref()), ToSlice(&node));
+            stats.nBytes += node.size();
+        }
+        for(std::vector<unsigned char> const& preimage : chunk.vPreimages){
+            bytes key = AuxKey(sha3(preimage));
+            batch->insert(ToSlice(&key), ToSlice(&preimage));
+            stats.nBytes += preimage.size();
+        }
+        database.commit(std::move(batch));
+
+        stats.nNodes += chunk.vNodes.size();
+        stats.nPreimages += chunk.vPreimages.size();
+        stats.nChunks++;
+    }
+
+    if(!VerifyStateSnapshot(_header, _state, _utxo))
+        throw std::runtime_error("the snapshot does not hold the complete state at its roots");
+    return stats;
+}
+
+bool VerifyStateSnapshot(StateSnapshotHeader const& _header, db::DatabaseFace& _state, db::DatabaseFace& _utxo)
+{
+    try {
+        WalkSnapshot(_header, _state, _utxo, [](uint8_t, std::string const&, bool){});
+    } catch(const std::runtime_error&) {
+        return false;
+    }
+    return true;
+}
+
+bool HaveStateSnapshotRoots(StateSnapshotHeader const& _header, db::DatabaseFace& _state, db::DatabaseFace& _utxo)
+{
+    const h256 emptyTrie = sha3(rlp(""));
+    h256 stateRoot = uintToh256(_header.hashStateRoot);
+    h256 utxoRoot = uintToh256(_header.hashUTXORoot);
+    return (stateRoot == emptyTrie || !_state.lookup(ToSlice(stateRoot.ref())).empty()) &&
+           (utxoRoot == emptyTrie || !_utxo.lookup(ToSlice(utxoRoot.ref())).empty());
+}
@@ -0,0 +1,104 @@
+#ifndef STATESNAPSHOT_H
+#define STATESNAPSHOT_H
+
+#include <hash.h>
+#include <serialize.h>
+#include <streams.h>
+#include <uint256.h>
+
+#include <libdevcore/db.h>
+
+#include <stdint.h>
+#include <vector>
+
+/** Version of the snapshot file format */
+static const uint32_t STATE_SNAPSHOT_VERSION = 1;
+/** Start a new chunk once the current one holds this many bytes */
+static const size_t STATE_SNAPSHOT_CHUNK_SIZE = 1 << 20;
+
+/** Identifies the block whose contract state a snapshot holds */
+struct StateSnapshotHeader{
+    uint32_t nVersion = STATE_SNAPSHOT_VERSION;
+    uint256 hashBlock;
+    int32_t nHeight = 0;
+    uint256 hashStateRoot;
+    uint256 hashUTXORoot;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nVersion);
+        READWRITE(hashBlock);
+        READWRITE(nHeight);
+        READWRITE(hashStateRoot);
+        READWRITE(hashUTXORoot);
+    }
+};
+
+/**
+ * A chunk of trie nodes and key preimages of one of the two databases. Nodes and
+ * preimages are stored without their keys, which are the sha3 of the stored data,
+ * so every entry is verified by construction when it is loaded. The chunk itself
+ * is followed by its checksum in the file, so corruption is reported early.
+ */
+struct StateSnapshotChunk{
+    enum Database : uint8_t { STATE = 0, UTXO = 1, END = 0xff };
+
+    uint8_t nDatabase = END;
+    std::vector<std::vector<unsigned char>> vNodes;
+    std::vector<std::vector<unsigned char>> vPreimages;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nDatabase);
+        READWRITE(vNodes);
+        READWRITE(vPreimages);
+    }
+
+    uint256 GetChecksum() const { return SerializeHash(*this); }
+};
+
+struct StateSnapshotStats{
+    uint64_t nChunks = 0;
+    uint64_t nNodes = 0;
+    uint64_t nPreimages = 0;
+    uint64_t nBytes = 0;
+};
+
+/**
+ * Write the contract state trie (accounts, storage and code) and the UTXO trie at the
+ * roots in _header to _file. The roots must stay in the databases while writing.
+ * @throws std::runtime_error if a node reachable from the roots is missing
+ */
+StateSnapshotStats WriteStateSnapshot(CAutoFile& _file, StateSnapshotHeader const& _header, dev::db::DatabaseFace& _state, dev::db::DatabaseFace& _utxo);
+
+/** @throws std::runtime_error if the file is not a snapshot of a known version */
+StateSnapshotHeader ReadStateSnapshotHeader(CAutoFile& _file);
+
+/**
+ * Read the next chunk and check it against its checksum. The nodes and preimages of a
+ * chunk are stored under their sha3 in the database of the chunk.
+ * @returns false once the end marker is read
+ * @throws std::runtime_error on a checksum mismatch or an unknown database
+ */
+bool ReadStateSnapshotChunk(CAutoFile& _file, StateSnapshotChunk& _chunk);
+
+/**
+ * Load the chunks following the header into the databases, then check that the
+ * tries at the header roots are complete. Entries are content addressed, so a bad
+ * snapshot can add unreachable data but never alter existing state. The caller
+ * checks the header roots against the block they belong to.
+ * @throws std::runtime_error on a checksum mismatch or an incomplete state
+ */
+StateSnapshotStats LoadStateSnapshot(CAutoFile& _file, StateSnapshotHeader const& _header, dev::db::DatabaseFace& _state, dev::db::DatabaseFace& _utxo);
+
+/** Check that every node reachable from the roots is in the databases */
+bool VerifyStateSnapshot(StateSnapshotHeader const& _header, dev::db::DatabaseFace& _state, dev::db::DatabaseFace& _utxo);
+
+/** Check that the root nodes are in the databases, without walking the tries */
+bool HaveStateSnapshotRoots(StateSnapshotHeader const& _header, dev::db::DatabaseFace& _state, dev::db::DatabaseFace& _utxo);
+
+#endif
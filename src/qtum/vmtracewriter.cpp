@@ -0,0 +1,295 @@
+#include <qtum/vmtracewriter.h>
+#include <clientversion.h>
+#include <crypto/common.h>
+#include <logging.h>
+#include <streams.h>
+#include <tinyformat.h>
+#include <util/strencodings.h>
+
+#include <boost/thread/thread.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+
+std::unique_ptr<VMTraceWriter> pvmtracewriter;
+
+static const char VMTRACE_MAGIC[4] = {'m', 'r', 'x', 't'};
+static const size_t VMTRACE_HEADER_SIZE = sizeof(VMTRACE_MAGIC) + 4;
+static const size_t VMTRACE_INDEX_ENTRY_SIZE = 12;
+
+// The size of the complete records at the start of a segment with its header, 0 without a complete header
+static uint64_t CompleteSegmentSize(const fs::path& path)
+{
+    uint64_t nFileSize = fs::file_size(path);
+    if(nFileSize < VMTRACE_HEADER_SIZE)
+        return 0;
+    FILE* in = fsbridge::fopen(path, "rb");
+    if(!in)
+        throw std::runtime_error(strprintf("unable to open %s", path.string()));
+    uint64_t nPos = VMTRACE_HEADER_SIZE;
+    unsigned char buf[4];
+    while(nPos + sizeof(buf) <= nFileSize && fseek(in, nPos, SEEK_SET) == 0 && fread(buf, 1, sizeof(buf), in) == sizeof(buf)){
+        uint64_t nNext = nPos + sizeof(buf) + ReadLE32(buf);
+        if(nNext > nFileSize)
+            break;
+        nPos = nNext;
+    }
+    fclose(in);
+    return nPos;
+}
+
+VMTraceWriter::VMTraceWriter(const fs::path& _dir, uint64_t _segmentSize, unsigned int _keepSegments, size_t _maxQueue) :
+    dir(_dir),
+    segmentSize(_segmentSize),
+    keepSegments(_keepSegments),
+    maxQueue(_maxQueue)
+{
+    fs::create_directories(dir);
+
+    // Append to the last segment of a previous run
+    std::vector<uint32_t> segments = listSegments();
+    uint32_t nLast = segments.empty() ? 0 : *std::max_element(segments.begin(), segments.end());
+    if(!segments.empty())
+        truncateIncomplete(nLast);
+
+    LOCK(cs_file);
+    index = fsbridge::fopen(dir / "index.dat", "ab");
+    if(!index)
+        throw std::runtime_error(strprintf("unable to open %s", (dir / "index.dat").string()));
+    openSegment(nLast);
+}
+
+VMTraceWriter::~VMTraceWriter()
+{
+    flush();
+    LOCK(cs_file);
+    if(file)
+        fclose(file);
+    if(index)
+        fclose(index);
+}
+
+void VMTraceWriter::openSegment(uint32_t nSegment)
+{
+    AssertLockHeld(cs_file);
+    if(file)
+        fclose(file);
+    segment = nSegment;
+    file = fsbridge::fopen(segmentPath(segment), "ab");
+    if(!file)
+        throw std::runtime_error(strprintf("unable to open %s", segmentPath(segment).string()));
+    fseek(file, 0, SEEK_END);
+    segmentPos = ftell(file);
+    if(segmentPos == 0){
+        unsigned char version[4];
+        WriteLE32(version, VMTRACE_VERSION);
+        fwrite(VMTRACE_MAGIC, 1, sizeof(VMTRACE_MAGIC), file);
+        fwrite(version, 1, sizeof(version), file);
+        segmentPos = sizeof(VMTRACE_MAGIC) + sizeof(version);
+    }
+
+    // Rotate out the oldest segments, including those left by a previous run
+    if(keepSegments){
+        for(uint32_t n : listSegments()){
+            if(n + keepSegments <= segment){
+                boost::system::error_code ec;
+                fs::remove(segmentPath(n), ec);
+            }
+        }
+    }
+}
+
+void VMTraceWriter::truncateIncomplete(uint32_t nLast)
+{
+    // A previous run may have stopped in the middle of a record, appending after it would make
+    // the rest of the segment unreadable
+    fs::path path = segmentPath(nLast);
+    uint64_t nComplete = CompleteSegmentSize(path);
+    if(nComplete < fs::file_size(path)){
+        LogPrintf("Truncating %s to its last complete record\n", path.string());
+        fs::resize_file(path, nComplete);
+    }
+
+    // Drop the index entries of the records that are gone, and a partly written entry
+    fs::path pathIndex = dir / "index.dat";
+    if(!fs::exists(pathIndex))
+        return;
+    uint64_t nIndexSize = fs::file_size(pathIndex);
+    uint64_t nKeep = nIndexSize - nIndexSize % VMTRACE_INDEX_ENTRY_SIZE;
+    FILE* in = fsbridge::fopen(pathIndex, "rb");
+    if(!in)
+        throw std::runtime_error(strprintf("unable to open %s", pathIndex.string()));
+    unsigned char entry[VMTRACE_INDEX_ENTRY_SIZE];
+    for(uint64_t nPos = 0; nPos < nKeep && fread(entry, 1, sizeof(entry), in) == sizeof(entry); nPos += sizeof(entry)){
+        uint32_t nSegment = ReadLE32(entry + 4);
+        if(nSegment > nLast || (nSegment == nLast && ReadLE32(entry + 8) >= nComplete)){
+            nKeep = nPos;
+            break;
+        }
+    }
+    fclose(in);
+    if(nKeep < nIndexSize)
+        fs::resize_file(pathIndex, nKeep);
+}
+
+std::vector<uint32_t> VMTraceWriter::listSegments() const
+{
+    // Segment numbers are zero padded to 5 digits and may have more
+    static const std::string prefix = "vmtrace", suffix = ".dat";
+    std::vector<uint32_t> segments;
+    for(fs::directory_iterator it(dir); it != fs::directory_iterator(); ++it){
+        std::string name = it->path().filename().string();
+        if(name.size() <= prefix.size() + suffix.size() || name.compare(0, prefix.size(), prefix) != 0 ||
+                name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)
+            continue;
+        std::string number = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+        uint32_t n = 0;
+        if(std::all_of(number.begin(), number.end(), IsDigit) && ParseUInt32(number, &n))
+            segments.push_back(n);
+    }
+    return segments;
+}
+
+fs::path VMTraceWriter::segmentPath(uint32_t nSegment) const
+{
+    return dir / strprintf("vmtrace%05u.dat", nSegment);
+}
+
+uint32_t VMTraceWriter::getSegment()
+{
+    LOCK(cs_file);
+    return segment;
+}
+
+void VMTraceWriter::push(VMTraceRecord&& record)
+{
+    std::deque<VMTraceRecord> records;
+    {
+        WAIT_LOCK(cs_queue, lock);
+        while(queue.size() >= maxQueue && fWriterRunning){
+            condQueue.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        queue.push_back(std::move(record));
+        // Without the writer thread the records are written by the caller
+        if(!fWriterRunning && queue.size() >= maxQueue)
+            records.swap(queue);
+    }
+    condQueue.notify_all();
+    if(!records.empty())
+        writeRecords(records);
+}
+
+void VMTraceWriter::flush()
+{
+    std::deque<VMTraceRecord> records;
+    {
+        LOCK(cs_queue);
+        records.swap(queue);
+    }
+    writeRecords(records);
+}
+
+void VMTraceWriter::writeRecords(std::deque<VMTraceRecord>& records)
+{
+    LOCK(cs_file);
+    for(const VMTraceRecord& record : records){
+        if(segmentPos >= segmentSize)
+            openSegment(segment + 1);
+
+        if(record.nHeight != lastHeight){
+            unsigned char entry[12];
+            WriteLE32(entry, record.nHeight);
+            WriteLE32(entry + 4, segment);
+            WriteLE32(entry + 8, segmentPos);
+            fwrite(entry, 1, sizeof(entry), index);
+            lastHeight = record.nHeight;
+        }
+
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << record;
+        unsigned char size[4];
+        WriteLE32(size, ss.size());
+        if(fwrite(size, 1, sizeof(size), file) != sizeof(size) || fwrite(ss.data(), 1, ss.size(), file) != ss.size()){
+            LogPrintf("%s: failed to write to %s\n", __func__, segmentPath(segment).string());
+        }
+        segmentPos += sizeof(size) + ss.size();
+    }
+    fflush(file);
+    fflush(index);
+}
+
+bool VMTraceWriter::findHeight(int nHeight, uint32_t& nSegment, uint32_t& nOffset)
+{
+    LOCK(cs_file);
+    fflush(index);
+    FILE* in = fsbridge::fopen(dir / "index.dat", "rb");
+    if(!in)
+        return false;
+
+    bool found = false;
+    unsigned char entry[VMTRACE_INDEX_ENTRY_SIZE];
+    while(!found && fread(entry, 1, sizeof(entry), in) == sizeof(entry)){
+        nSegment = ReadLE32(entry + 4);
+        nOffset = ReadLE32(entry + 8);
+        // Entries of rotated out segments are skipped
+        found = (int32_t)ReadLE32(entry) >= nHeight && fs::exists(segmentPath(nSegment));
+    }
+    fclose(in);
+    return found;
+}
+
+void VMTraceWriter::ThreadWrite()
+{
+    fWriterRunning = true;
+    try{
+        while(true){
+            std::deque<VMTraceRecord> records;
+            {
+                WAIT_LOCK(cs_queue, lock);
+                while(queue.empty()){
+                    condQueue.wait_for(lock, std::chrono::milliseconds(100));
+                    boost::this_thread::interruption_point();
+                }
+                records.swap(queue);
+            }
+            condQueue.notify_all();
+            writeRecords(records);
+        }
+    }catch(...){
+        // What is left in the queue is written by flush() on shutdown
+        fWriterRunning = false;
+        condQueue.notify_all();
+        throw;
+    }
+}
+
+std::vector<VMTraceRecord> ReadVMTraceSegment(const fs::path& path)
+{
+    FILE* in = fsbridge::fopen(path, "rb");
+    if(!in)
+        throw std::runtime_error(strprintf("unable to open %s", path.string()));
+
+    std::vector<VMTraceRecord> records;
+    char magic[sizeof(VMTRACE_MAGIC)];
+    unsigned char buf[4];
+    if(fread(magic, 1, sizeof(magic), in) != sizeof(magic) || memcmp(magic, VMTRACE_MAGIC, sizeof(magic)) != 0 ||
+            fread(buf, 1, sizeof(buf), in) != sizeof(buf) || ReadLE32(buf) != VMTRACE_VERSION){
+        fclose(in);
+        throw std::runtime_error(strprintf("%s is not a trace segment", path.string()));
+    }
+
+    while(fread(buf, 1, sizeof(buf), in) == sizeof(buf)){
+        std::vector<char> data(ReadLE32(buf));
+        if(fread(data.data(), 1, data.size(), in) != data.size()){
+            fclose(in);
+            throw std::runtime_error(strprintf("truncated record in %s", path.string()));
+        }
+        CDataStream ss(data, SER_DISK, CLIENT_VERSION);
+        VMTraceRecord record;
+        ss >> record;
+        records.push_back(std::move(record));
+    }
+    fclose(in);
+    return records;
+}
@@ -0,0 +1,146 @@
+#ifndef VMTRACEWRITER_H
+#define VMTRACEWRITER_H
+
+#include <fs.h>
+#include <serialize.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+/** Version of the trace segment format */
+static const uint32_t VMTRACE_VERSION = 1;
+/** Max records waiting for the writer before the validation thread waits for it */
+static const size_t DEFAULT_VMTRACE_QUEUE = 10000;
+/** Start a new segment once the current one reaches this size, in MiB */
+static const unsigned int DEFAULT_VMTRACE_SEGMENT_SIZE = 128;
+/** Segments kept on disk, the oldest are deleted as new ones start, 0 keeps all of them */
+static const unsigned int DEFAULT_VMTRACE_SEGMENTS = 0;
+
+/** A LOG opcode of an execution */
+struct VMTraceLog{
+    uint160 address;
+    std::vector<uint256> topics;
+    std::vector<unsigned char> data;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(address);
+        READWRITE(topics);
+        READWRITE(data);
+    }
+};
+
+/**
+ * The LOG opcodes of one execution, recorded with -record-log-opcodes. Addresses and topics
+ * keep the byte order of the EVM. txid is null for a callcontract, blockHash is null when the
+ * execution is not part of a block.
+ */
+struct VMTraceRecord{
+    uint256 txid;
+    uint256 blockHash;
+    int32_t nHeight = 0;
+    int64_t nTime = 0;
+    uint160 address;
+    std::vector<VMTraceLog> entries;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(txid);
+        READWRITE(blockHash);
+        READWRITE(nHeight);
+        READWRITE(nTime);
+        READWRITE(address);
+        READWRITE(entries);
+    }
+};
+
+/**
+ * Writes the records of -record-log-opcodes from a background thread so the validation thread
+ * only queues them. Records go to numbered segments vmtraceNNNNN.dat in a directory, each one
+ * starting with a magic and VMTRACE_VERSION, followed by records prefixed with their size as
+ * a uint32. A new segment starts once the current one reaches the segment size.
+ *
+ * index.dat in the same directory holds the segment and offset of the first record of every
+ * height seen, as an int32 height and two uint32. contrib/vmtrace/vmtrace2json.py converts
+ * the segments to the JSON of the former vmExecLogs.json.
+ */
+class VMTraceWriter{
+
+public:
+
+    VMTraceWriter(const fs::path& _dir, uint64_t _segmentSize, unsigned int _keepSegments, size_t _maxQueue = DEFAULT_VMTRACE_QUEUE);
+
+    ~VMTraceWriter();
+
+    /** Queue a record, waits for the writer while the queue is full */
+    void push(VMTraceRecord&& record);
+
+    /** Write all queued records and flush the files */
+    void flush();
+
+    /** The segment and offset of the first record at nHeight or above */
+    bool findHeight(int nHeight, uint32_t& nSegment, uint32_t& nOffset);
+
+    fs::path segmentPath(uint32_t nSegment) const;
+
+    uint32_t getSegment();
+
+    /** Background thread writing the queued records */
+    void ThreadWrite();
+
+private:
+
+    void writeRecords(std::deque<VMTraceRecord>& records);
+
+    void openSegment(uint32_t nSegment);
+
+    /** Cut the segment nLast and the index back to the last complete record of a previous run */
+    void truncateIncomplete(uint32_t nLast);
+
+    /** The numbers of the segments in the directory */
+    std::vector<uint32_t> listSegments() const;
+
+    const fs::path dir;
+
+    const uint64_t segmentSize;
+
+    const unsigned int keepSegments;
+
+    const size_t maxQueue;
+
+    Mutex cs_queue;
+
+    std::condition_variable condQueue;
+
+    std::deque<VMTraceRecord> queue GUARDED_BY(cs_queue);
+
+    std::atomic<bool> fWriterRunning{false};
+
+    Mutex cs_file;
+
+    FILE* file GUARDED_BY(cs_file) = nullptr;
+
+    FILE* index GUARDED_BY(cs_file) = nullptr;
+
+    uint32_t segment GUARDED_BY(cs_file) = 0;
+
+    uint64_t segmentPos GUARDED_BY(cs_file) = 0;
+
+    int lastHeight GUARDED_BY(cs_file) = -1;
+};
+
+/** Read the records of a segment */
+std::vector<VMTraceRecord> ReadVMTraceSegment(const fs::path& path);
+
+extern std::unique_ptr<VMTraceWriter> pvmtracewriter;
+
+#endif
@@ -0,0 +1,101 @@
+// Copyright (c) 2020 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rawblockcache.h>
+#include <primitives/block.h>
+#include <streams.h>
+#include <version.h>
+
+std::unique_ptr<RawBlockCache> prawblockcache;
+
+bool RawBlockHasWitness(const std::vector<unsigned char>& data)
+{
+    // Walk the transactions without deserializing them, only the marker of the
+    // extended format is looked at
+    try{
+        VectorReader s(SER_NETWORK, PROTOCOL_VERSION, data, 0);
+        CBlockHeader header;
+        s >> header;
+        uint64_t nTx = ReadCompactSize(s);
+        for(uint64_t i = 0; i < nTx; i++){
+            s.ignore(4); // nVersion
+            uint64_t nIn = ReadCompactSize(s);
+            if(nIn == 0){
+                // An empty input vector is the marker, a non-zero flag follows it
+                unsigned char flags = 0;
+                s >> flags;
+                if(flags != 0)
+                    return true;
+            }else{
+                for(uint64_t n = 0; n < nIn; n++){
+                    s.ignore(36); // prevout
+                    s.ignore(ReadCompactSize(s)); // scriptSig
+                    s.ignore(4); // nSequence
+                }
+                uint64_t nOut = ReadCompactSize(s);
+                for(uint64_t n = 0; n < nOut; n++){
+                    s.ignore(8); // nValue
+                    s.ignore(ReadCompactSize(s)); // scriptPubKey
+                }
+            }
+            s.ignore(4); // nLockTime
+        }
+        return !s.empty();
+    }catch(const std::exception&){
+        return true;
+    }
+}
+
+std::shared_ptr<const RawBlock> RawBlockCache::get(const uint256& hash)
+{
+    LOCK(cs);
+    auto it = mapBlocks.find(hash);
+    if(it == mapBlocks.end()){
+        nMisses++;
+        return nullptr;
+    }
+    nHits++;
+    listBlocks.splice(listBlocks.begin(), listBlocks, it->second);
+    return it->second->second;
+}
+
+void RawBlockCache::insert(const uint256& hash, const std::shared_ptr<const RawBlock>& block)
+{
+    LOCK(cs);
+    if(mapBlocks.count(hash) || block->data.size() > nMaxSize)
+        return;
+
+    listBlocks.emplace_front(hash, block);
+    mapBlocks.emplace(hash, listBlocks.begin());
+    nBytes += block->data.size();
+    while(nBytes > nMaxSize){
+        nBytes -= listBlocks.back().second->data.size();
+        mapBlocks.erase(listBlocks.back().first);
+        listBlocks.pop_back();
+    }
+}
+
+size_t RawBlockCache::size() const
+{
+    LOCK(cs);
+    return mapBlocks.size();
+}
+
+size_t RawBlockCache::bytes() const
+{
+    LOCK(cs);
+    return nBytes;
+}
+
+uint64_t RawBlockCache::hits() const
+{
+    LOCK(cs);
+    return nHits;
+}
+
+uint64_t RawBlockCache::misses() const
+{
+    LOCK(cs);
+    return nMisses;
+}
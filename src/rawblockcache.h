@@ -0,0 +1,76 @@
+// Copyright (c) 2020 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RAWBLOCKCACHE_H
+#define BITCOIN_RAWBLOCKCACHE_H
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/** Default for -rawblockcache, MiB of blocks kept as stored on disk for serving them to peers */
+static const int64_t DEFAULT_RAW_BLOCK_CACHE = 32;
+
+/** A block as stored on disk, which is its network serialization with witness data */
+struct RawBlock
+{
+    std::vector<unsigned char> data;
+
+    //! Hash of data, the checksum of the block message
+    uint256 hash;
+
+    //! Some transaction has a witness, peers that want no witness can not be sent data as is
+    bool fWitness = false;
+};
+
+/** Whether a serialized block has a transaction in the extended format, true if it can not be parsed */
+bool RawBlockHasWitness(const std::vector<unsigned char>& data);
+
+/**
+ * Least recently used raw blocks served to peers, bounded by their size. Peers syncing
+ * from this node mostly request the same range of blocks, those are sent without reading,
+ * parsing or hashing them again. Safe to use from several threads.
+ */
+class RawBlockCache
+{
+public:
+    explicit RawBlockCache(size_t _nMaxSize) : nMaxSize(_nMaxSize) {}
+
+    /** The cached block with this hash, nullptr if it is not in */
+    std::shared_ptr<const RawBlock> get(const uint256& hash);
+
+    /** Add a block, the least recently used ones are dropped to fit the size */
+    void insert(const uint256& hash, const std::shared_ptr<const RawBlock>& block);
+
+    size_t size() const;
+
+    /** Serialized size of the cached blocks */
+    size_t bytes() const;
+
+    uint64_t hits() const;
+    uint64_t misses() const;
+
+private:
+    typedef std::list<std::pair<uint256, std::shared_ptr<const RawBlock>>> BlockList;
+
+    const size_t nMaxSize;
+
+    mutable Mutex cs;
+
+    //! Most recently used first
+    BlockList listBlocks GUARDED_BY(cs);
+    std::map<uint256, BlockList::iterator> mapBlocks GUARDED_BY(cs);
+    size_t nBytes GUARDED_BY(cs) = 0;
+    uint64_t nHits GUARDED_BY(cs) = 0;
+    uint64_t nMisses GUARDED_BY(cs) = 0;
+};
+
+extern std::unique_ptr<RawBlockCache> prawblockcache;
+
+#endif // BITCOIN_RAWBLOCKCACHE_H
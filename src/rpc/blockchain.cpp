@@ -9,6 +9,7 @@
 #include <blockfilter.h>
 #include <chain.h>
 #include <chainparams.h>
+#include <clientversion.h>
 #include <coins.h>
 #include <node/coinstats.h>
 #include <consensus/validation.h>
@@ -40,6 +41,10 @@
 #include <pos.h>
 #include <txdb.h>
 #include <util/convert.h>
+#include <optional.h>
+#include <qtum/statediff.h>
+#include <qtum/statepruner.h>
+#include <qtum/statesnapshot.h>
 
 #include <assert.h>
 #include <stdint.h>
@@ -1098,6 +1103,181 @@ static UniValue getstorage(const JSONRPCRequest& request)
     return result;
 }
 
+static std::string StateDiffCursorToString(const StateDiffCursor& cursor)
+{
+    std::string ret = cursor.account.hex();
+    if (cursor.hasSlot)
+        ret += ":" + cursor.slot.hex();
+    return ret;
+}
+
+static StateDiffCursor ParseStateDiffCursor(const std::string& str)
+{
+    StateDiffCursor cursor;
+    std::string account = str.substr(0, str.find(':'));
+    if (account.size() != 64 || !IsHex(account))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    cursor.account = dev::h256(account);
+    if (account.size() < str.size()) {
+        std::string slot = str.substr(account.size() + 1);
+        if (slot.size() != 64 || !IsHex(slot))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+        cursor.slot = dev::h256(slot);
+        cursor.hasSlot = true;
+    }
+    return cursor;
+}
+
+static UniValue getstatediff(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"getstatediff",
+                "\nGet the contract accounts and storage slots that changed between two blocks.\n"
+                "Only the parts of the state trie that differ are visited. The result is paginated,\n"
+                "pass the returned cursor to continue after the last reported entry.\n",
+                {
+                    {"fromBlock", RPCArg::Type::NUM, RPCArg::Optional::NO, "The block number of the old state"},
+                    {"toBlock", RPCArg::Type::NUM, RPCArg::Optional::NO, "The block number of the new state"},
+                    {"address", RPCArg::Type::STR_HEX, /* default */ "", "Only report changes of this contract"},
+                    {"cursor", RPCArg::Type::STR, /* default */ "", "The cursor returned by the previous call"},
+                    {"count", RPCArg::Type::NUM, /* default */ "100", "Max entries to return (max 10000)"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"fromBlock\": n,                     (numeric) the block number of the old state\n"
+            "  \"toBlock\": n,                       (numeric) the block number of the new state\n"
+            "  \"changes\": [                        (array) the changed entries in state trie order\n"
+            "    {\n"
+            "      \"type\": \"account\",              (string) an account entry, followed by its storage entries\n"
+            "      \"address\": \"hex\",               (string) the contract address\n"
+            "      \"status\": \"modified\",           (string) created, deleted or modified\n"
+            "      \"balance\": {\"from\": \"hex\", \"to\": \"hex\"}, (object) the old and new balance in satoshis, as 256 bit hex\n"
+            "      \"nonce\": {\"from\": \"hex\", \"to\": \"hex\"},   (object) the old and new nonce, as 256 bit hex\n"
+            "      \"codeChanged\": true|false       (boolean) whether the code hash changed\n"
+            "    },\n"
+            "    {\n"
+            "      \"type\": \"storage\",\n"
+            "      \"address\": \"hex\",               (string) the contract address\n"
+            "      \"key\": \"hex\",                   (string) the hashed storage key\n"
+            "      \"slot\": \"hex\",                  (string) the storage key, when known\n"
+            "      \"from\": \"hex\",                  (string) the old value\n"
+            "      \"to\": \"hex\"                     (string) the new value\n"
+            "    }, ...\n"
+            "  ],\n"
+            "  \"nodesLoaded\": n,                   (numeric) trie nodes read to produce this page\n"
+            "  \"cursor\": \"str\"                     (string, optional) present when there are more entries\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getstatediff", "1000 1001")
+            + HelpExampleCli("getstatediff", "1000 2000 \"eb23c0b3e6042821da281a2e2364feb22dd543e3\"")
+            + HelpExampleRpc("getstatediff", "1000, 1001")
+                },
+            }.Check(request);
+
+    int fromBlock = request.params[0].get_int();
+    int toBlock = request.params[1].get_int();
+    dev::h256 rootBefore, rootAfter;
+    // Taken before the roots are read, so the tries below them are not swept during the walk
+    StatePruneHold hold(pstatepruner.get());
+    {
+        LOCK(cs_main);
+        if (fromBlock < 0 || fromBlock > ::ChainActive().Height() || toBlock < 0 || toBlock > ::ChainActive().Height())
+            throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
+        rootBefore = uintToh256(::ChainActive()[fromBlock]->hashStateRoot);
+        rootAfter = uintToh256(::ChainActive()[toBlock]->hashStateRoot);
+    }
+
+    bool fAddress = false;
+    dev::Address addrAccount;
+    if (!request.params[2].isNull() && !request.params[2].get_str().empty()) {
+        std::string strAddr = request.params[2].get_str();
+        if (strAddr.size() != 40 || !CheckHex(strAddr))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect address");
+        addrAccount = dev::Address(strAddr);
+        fAddress = true;
+    }
+
+    Optional<StateDiffCursor> cursor;
+    if (!request.params[3].isNull() && !request.params[3].get_str().empty())
+        cursor = ParseStateDiffCursor(request.params[3].get_str());
+
+    int count = 100;
+    if (!request.params[4].isNull()) {
+        count = request.params[4].get_int();
+        if (count <= 0 || count > 10000)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid count");
+    }
+
+    UniValue changes(UniValue::VARR);
+    StateDiffCursor last;
+    bool fMore = false;
+
+    auto onAccount = [&](const AccountDiff& account) {
+        if ((int)changes.size() == count) {
+            fMore = true;
+            return false;
+        }
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("type", "account");
+        entry.pushKV("address", account.address.hex());
+        entry.pushKV("status", !account.existedBefore ? "created" : !account.existsAfter ? "deleted" : "modified");
+        UniValue balance(UniValue::VOBJ);
+        balance.pushKV("from", dev::toHex(dev::h256(account.balanceBefore)));
+        balance.pushKV("to", dev::toHex(dev::h256(account.balanceAfter)));
+        entry.pushKV("balance", balance);
+        UniValue nonce(UniValue::VOBJ);
+        nonce.pushKV("from", dev::toHex(dev::h256(account.nonceBefore)));
+        nonce.pushKV("to", dev::toHex(dev::h256(account.nonceAfter)));
+        entry.pushKV("nonce", nonce);
+        entry.pushKV("codeChanged", account.codeHashBefore != account.codeHashAfter);
+        changes.push_back(entry);
+
+        last.account = account.key;
+        last.hasSlot = false;
+        return true;
+    };
+    auto onStorage = [&](const AccountDiff& account, const StorageDiff& storage) {
+        if ((int)changes.size() == count) {
+            fMore = true;
+            return false;
+        }
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("type", "storage");
+        entry.pushKV("address", account.address.hex());
+        entry.pushKV("key", storage.key.hex());
+        if (storage.hasSlot)
+            entry.pushKV("slot", storage.slot.hex());
+        entry.pushKV("from", dev::toHex(dev::h256(storage.before)));
+        entry.pushKV("to", dev::toHex(dev::h256(storage.after)));
+        changes.push_back(entry);
+
+        last.account = account.key;
+        last.slot = storage.key;
+        last.hasSlot = true;
+        return true;
+    };
+
+    // Trie nodes are stored under their hash and never rewritten, blocks connected meanwhile only add new ones
+    StateDiff stateDiff(globalState->db());
+    try {
+        if (fAddress)
+            stateDiff.diffAccount(addrAccount, rootBefore, rootAfter, onAccount, onStorage, cursor.get_ptr());
+        else
+            stateDiff.diff(rootBefore, rootAfter, onAccount, onStorage, cursor.get_ptr());
+    } catch (const std::exception& e) {
+        throw JSONRPCError(RPC_DATABASE_ERROR, std::string("Unable to read the state trie: ") + e.what());
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("fromBlock", fromBlock);
+    result.pushKV("toBlock", toBlock);
+    result.pushKV("changes", changes);
+    result.pushKV("nodesLoaded", stateDiff.nodesLoaded());
+    if (fMore)
+        result.pushKV("cursor", StateDiffCursorToString(last));
+    return result;
+}
+
 static UniValue getblockheader(const JSONRPCRequest& request)
 {
             RPCHelpMan{"getblockheader",
@@ -2462,6 +2642,11 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
             "  \"pruneheight\": xxxxxx,        (numeric) lowest-height complete block stored (only present if pruning is enabled)\n"
             "  \"automatic_pruning\": xx,      (boolean) whether automatic pruning is enabled (only present if pruning is enabled)\n"
             "  \"prune_target_size\": xxxxxx,  (numeric) the target size used by pruning (only present if automatic pruning is enabled)\n"
+            "  \"state_pruned\": xx,           (boolean) if the contract state of old blocks is subject to pruning\n"
+            "  \"state_keep_blocks\": xxxxxx,  (numeric) the number of blocks below the tip whose contract state is kept (only present if state pruning is enabled)\n"
+            "  \"state_prune_height\": xxxxxx, (numeric) the tip height at the last state pruning pass (only present if state pruning is enabled)\n"
+            "  \"state_pruned_nodes\": xxxxxx, (numeric) the number of state trie nodes removed since startup (only present if state pruning is enabled)\n"
+            "  \"state_reclaimed_bytes\": xxx, (numeric) the bytes reclaimed by state pruning since startup (only present if state pruning is enabled)\n"
             "  \"softforks\": {                (object) status of softforks\n"
             "     \"xxxx\" : {                 (string) name of the softfork\n"
             "        \"type\": \"xxxx\",         (string) one of \"buried\", \"bip9\"\n"
@@ -2524,6 +2709,13 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
             obj.pushKV("prune_target_size",  nPruneTarget);
         }
     }
+    obj.pushKV("state_pruned",          pstatepruner != nullptr);
+    if (pstatepruner) {
+        obj.pushKV("state_keep_blocks",     pstatepruner->getKeepBlocks());
+        obj.pushKV("state_prune_height",    pstatepruner->getLastPruneHeight());
+        obj.pushKV("state_pruned_nodes",    pstatepruner->getNodesRemoved());
+        obj.pushKV("state_reclaimed_bytes", pstatepruner->getBytesReclaimed());
+    }
 
     const Consensus::Params& consensusParams = Params().GetConsensus();
     UniValue softforks(UniValue::VOBJ);
@@ -3224,6 +3416,90 @@ static UniValue savemempool(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
+static UniValue dumpcontractstate(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"dumpcontractstate",
+                "\nWrite the contract state and the contract UTXO set at a block to a snapshot file.\n"
+                "Trie nodes are written without their keys, which are the sha3 of the node, and every chunk\n"
+                "of the file is followed by its checksum. A node at the same chain tip can import it at startup with\n"
+                "-loadcontractstate=<file>, which checks the roots against the tip header and that the state is complete.\n"
+                "With -prunestate, only the state of the last -statekeepblocks blocks is available.\n",
+                {
+                    {"path", RPCArg::Type::STR, RPCArg::Optional::NO, "The snapshot file, relative paths are prefixed by the data directory"},
+                    {"height", RPCArg::Type::NUM, /* default */ "tip", "The height of the block to export"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"blockhash\": \"hex\",     (string) the block whose state was written\n"
+            "  \"height\": n,              (numeric) the block height\n"
+            "  \"hashStateRoot\": \"hex\", (string) the contract state root\n"
+            "  \"hashUTXORoot\": \"hex\",  (string) the contract UTXO root\n"
+            "  \"chunks\": n,              (numeric) the number of chunks written\n"
+            "  \"nodes\": n,               (numeric) the number of trie nodes and contract codes written\n"
+            "  \"preimages\": n,           (numeric) the number of address and storage key preimages written\n"
+            "  \"path\": \"str\"           (string) the absolute path of the snapshot\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("dumpcontractstate", "\"state.dat\"")
+            + HelpExampleRpc("dumpcontractstate", "\"state.dat\", 1000")
+                },
+            }.Check(request);
+
+    fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    if (fs::exists(path)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+    }
+
+    // Pruning passes check the hold under cs_main, none sweeps once the block is looked up below
+    StateSnapshotHeader header;
+    StatePruneHold hold(pstatepruner.get());
+    {
+        LOCK(cs_main);
+        int nHeight = request.params[1].isNull() ? ::ChainActive().Height() : request.params[1].get_int();
+        if (nHeight < 0 || nHeight > ::ChainActive().Height())
+            throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
+        if (!globalState->rawDB() || !globalState->rawDBUtxo())
+            throw JSONRPCError(RPC_MISC_ERROR, "The contract state database is not available");
+
+        const CBlockIndex* pindex = ::ChainActive()[nHeight];
+        header.hashBlock = pindex->GetBlockHash();
+        header.nHeight = pindex->nHeight;
+        header.hashStateRoot = pindex->hashStateRoot;
+        header.hashUTXORoot = pindex->hashUTXORoot;
+    }
+
+    // The nodes of a connected block never change and pruning is held off, so the state can be read without holding cs_main
+    fs::path temppath = path.string() + ".incomplete";
+    CAutoFile file(fsbridge::fopen(temppath, "wb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Unable to open " + temppath.string() + " for writing");
+    }
+    StateSnapshotStats stats;
+    try {
+        stats = WriteStateSnapshot(file, header, *globalState->rawDB(), *globalState->rawDBUtxo());
+        if (!FileCommit(file.Get()))
+            throw std::runtime_error("unable to flush the file");
+    } catch (const std::exception& e) {
+        file.fclose();
+        fs::remove(temppath);
+        throw JSONRPCError(RPC_MISC_ERROR, strprintf("Unable to export the contract state at height %d: %s", header.nHeight, e.what()));
+    }
+    file.fclose();
+    RenameOver(temppath, path);
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("blockhash", header.hashBlock.GetHex());
+    result.pushKV("height", header.nHeight);
+    result.pushKV("hashStateRoot", header.hashStateRoot.GetHex());
+    result.pushKV("hashUTXORoot", header.hashUTXORoot.GetHex());
+    result.pushKV("chunks", stats.nChunks);
+    result.pushKV("nodes", stats.nNodes);
+    result.pushKV("preimages", stats.nPreimages);
+    result.pushKV("path", path.string());
+    return result;
+}
+
 //! Search for a given set of pubkey scripts
 bool FindScriptPubKey(std::atomic<int>& scan_progress, const std::atomic<bool>& should_abort, int64_t& count, CCoinsViewCursor* cursor, const std::set<CScript>& needles, std::map<COutPoint, Coin>& out_results) {
     scan_progress = 0;
@@ -3531,10 +3807,12 @@ static const CRPCCommand commands[] = {
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        {"height"} },
     { "blockchain",         "savemempool",            &savemempool,            {} },
+    { "blockchain",         "dumpcontractstate",      &dumpcontractstate,      {"path", "height"} },
     { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"} },
     { "blockchain",         "getaccountinfo",         &getaccountinfo,         {"contract_address"} },
     { "blockchain",         "getcontractcode",        &getcontractcode,        {"address", "blockNum"} },
     { "blockchain",         "getstorage",             &getstorage,             {"address", "index", "blockNum"} },
+    { "blockchain",         "getstatediff",           &getstatediff,           {"fromBlock", "toBlock", "address", "cursor", "count"} },
 
     { "blockchain",         "preciousblock",          &preciousblock,          {"blockhash"} },
     { "blockchain",         "scantxoutset",           &scantxoutset,           {"action", "scanobjects"} },
@@ -172,6 +172,8 @@ static const CRPCConvertParam vRPCConvertParams[] = {
     { "keypoolrefill", 0, "newsize" },
     { "getrawmempool", 0, "verbose" },
     { "estimatesmartfee", 0, "conf_target" },
+    { "estimatesmartgasprice", 0, "conf_target" },
+    { "estimatesmartgasprice", 1, "gas_limit" },
     { "estimaterawfee", 0, "conf_target" },
     { "estimaterawfee", 1, "threshold" },
     { "prioritisetransaction", 1, "dummy" },
@@ -214,6 +216,10 @@ static const CRPCConvertParam vRPCConvertParams[] = {
     { "getstorage", 0, "address" },
     { "getstorage", 1, "index" },
     { "getstorage", 2, "blockNum" },
+    { "getstatediff", 0, "fromBlock" },
+    { "getstatediff", 1, "toBlock" },
+    { "getstatediff", 4, "count" },
+    { "dumpcontractstate", 1, "height" },
     { "preciousblock", 0, "blockhash" },
     { "getblockfilter", 0, "blockhash" },
     { "getblockfilter", 1, "filtertype" },
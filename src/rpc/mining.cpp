@@ -974,6 +974,77 @@ static UniValue estimatesmartfee(const JSONRPCRequest& request)
     return result;
 }
 
+static UniValue estimatesmartgasprice(const JSONRPCRequest& request)
+{
+            RPCHelpMan{"estimatesmartgasprice",
+                "\nEstimates the approximate gas price needed for a contract transaction to begin\n"
+                "confirmation within conf_target blocks if possible and return the number of blocks\n"
+                "for which the estimate is valid. The estimate is made from the contract transactions\n"
+                "whose gas limit took a similar share of the block gas limit, and is never below\n"
+                "the minimum gas price.\n",
+                {
+                    {"conf_target", RPCArg::Type::NUM, RPCArg::Optional::NO, "Confirmation target in blocks (1 - 48)"},
+                    {"gas_limit", RPCArg::Type::NUM, /* default */ std::to_string(DEFAULT_GAS_LIMIT_OP_SEND), "Total gas limit of the contract outputs of the transaction"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"gasprice\" : x.x,    (numeric, optional) estimate gas price in " + CURRENCY_UNIT + " per gas\n"
+            "  \"mingasprice\" : x.x, (numeric) minimum gas price in " + CURRENCY_UNIT + " per gas\n"
+            "  \"errors\": [ str... ] (json array of strings, optional) Errors encountered during processing\n"
+            "  \"blocks\" : n         (numeric) block number where estimate was found\n"
+            "}\n"
+            "\n"
+            "The request target will be clamped between 2 and the highest target\n"
+            "gas price estimation is able to return based on how long it has been running.\n"
+            "An error is returned if not enough contract transactions and blocks\n"
+            "have been observed to make an estimate for any number of blocks.\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("estimatesmartgasprice", "6")
+            + HelpExampleCli("estimatesmartgasprice", "6 2500000")
+            + HelpExampleRpc("estimatesmartgasprice", "6, 2500000")
+                },
+            }.Check(request);
+
+    RPCTypeCheck(request.params, {UniValue::VNUM, UniValue::VNUM}, true);
+    RPCTypeCheckArgument(request.params[0], UniValue::VNUM);
+    unsigned int max_target = ::feeEstimator.HighestGasTargetTracked();
+    unsigned int conf_target = ParseConfirmTarget(request.params[0], max_target);
+    uint64_t gas_limit = DEFAULT_GAS_LIMIT_OP_SEND;
+    if (!request.params[1].isNull()) {
+        int64_t value = request.params[1].get_int64();
+        if (value <= 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid gas_limit, must be positive");
+        }
+        gas_limit = value;
+    }
+
+    uint64_t blockGasLimit, minGasPrice;
+    {
+        LOCK(cs_main);
+        QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
+        blockGasLimit = qtumDGP.getBlockGasLimit(::ChainActive().Height());
+        minGasPrice = qtumDGP.getMinGasPrice(::ChainActive().Height());
+    }
+    if (gas_limit > blockGasLimit) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Invalid gas_limit, must not be above the block gas limit %u", blockGasLimit));
+    }
+
+    UniValue result(UniValue::VOBJ);
+    UniValue errors(UniValue::VARR);
+    FeeCalculation feeCalc;
+    CAmount gasPrice = ::feeEstimator.estimateSmartGasPrice(conf_target, gas_limit, blockGasLimit, &feeCalc);
+    if (gasPrice != 0) {
+        result.pushKV("gasprice", ValueFromAmount(std::max<CAmount>(gasPrice, minGasPrice)));
+    } else {
+        errors.push_back("Insufficient data or no gas price found");
+        result.pushKV("errors", errors);
+    }
+    result.pushKV("mingasprice", ValueFromAmount(minGasPrice));
+    result.pushKV("blocks", feeCalc.returnedTarget);
+    return result;
+}
+
 static UniValue estimaterawfee(const JSONRPCRequest& request)
 {
             RPCHelpMan{"estimaterawfee",
@@ -1095,6 +1166,7 @@ static const CRPCCommand commands[] = {
     { "generating",         "generatetoaddress",      &generatetoaddress,      {"nblocks","address","maxtries"} },
 
     { "util",               "estimatesmartfee",       &estimatesmartfee,       {"conf_target", "estimate_mode"} },
+    { "util",               "estimatesmartgasprice",  &estimatesmartgasprice,  {"conf_target", "gas_limit"} },
 
     { "hidden",             "estimaterawfee",         &estimaterawfee,         {"conf_target", "threshold"} },
 };
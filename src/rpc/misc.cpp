@@ -6,7 +6,9 @@
 #include <crypto/ripemd160.h>
 #include <key_io.h>
 #include <httpserver.h>
+#include <net_processing.h>
 #include <outputtype.h>
+#include <rawblockcache.h>
 #include <rpc/blockchain.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
@@ -1062,6 +1064,27 @@ static UniValue RPCLockedMemoryInfo()
     return obj;
 }
 
+static UniValue RPCOrphanBlocksInfo()
+{
+    size_t count = 0, bytes = 0, usage = 0;
+    GetOrphanBlocksInfo(count, bytes, usage);
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("count", uint64_t(count));
+    obj.pushKV("bytes", uint64_t(bytes));
+    obj.pushKV("usage", uint64_t(usage));
+    return obj;
+}
+
+static UniValue RPCRawBlockCacheInfo()
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("count", uint64_t(prawblockcache->size()));
+    obj.pushKV("bytes", uint64_t(prawblockcache->bytes()));
+    obj.pushKV("hits", prawblockcache->hits());
+    obj.pushKV("misses", prawblockcache->misses());
+    return obj;
+}
+
 #ifdef HAVE_MALLOC_INFO
 static std::string RPCMallocInfo()
 {
@@ -1103,6 +1126,17 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
             "    \"locked\": xxxxxx,       (numeric) Amount of bytes that succeeded locking. If this number is smaller than total, locking pages failed at some point and key data could be swapped to disk.\n"
             "    \"chunks_used\": xxxxx,   (numeric) Number allocated chunks\n"
             "    \"chunks_free\": xxxxx,   (numeric) Number unused chunks\n"
+            "  },\n"
+            "  \"orphanblocks\": {         (json object) Information about the blocks received before their parent\n"
+            "    \"count\": xxxxx,         (numeric) Number of orphan blocks\n"
+            "    \"bytes\": xxxxx,         (numeric) Serialized size of the orphan blocks, bounded by -maxorphanblocksmib\n"
+            "    \"usage\": xxxxx,         (numeric) Memory held by the orphan blocks and their indexes\n"
+            "  },\n"
+            "  \"rawblockcache\": {        (json object) Information about the blocks cached for serving them to peers, if -rawblockcache is enabled\n"
+            "    \"count\": xxxxx,         (numeric) Number of cached blocks\n"
+            "    \"bytes\": xxxxx,         (numeric) Size of the cached blocks, bounded by -rawblockcache\n"
+            "    \"hits\": xxxxx,          (numeric) Blocks served from the cache\n"
+            "    \"misses\": xxxxx,        (numeric) Blocks read from disk\n"
             "  }\n"
             "}\n"
                     },
@@ -1120,6 +1154,10 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
     if (mode == "stats") {
         UniValue obj(UniValue::VOBJ);
         obj.pushKV("locked", RPCLockedMemoryInfo());
+        obj.pushKV("orphanblocks", RPCOrphanBlocksInfo());
+        if (prawblockcache) {
+            obj.pushKV("rawblockcache", RPCRawBlockCacheInfo());
+        }
         return obj;
     } else if (mode == "mallocinfo") {
 #ifdef HAVE_MALLOC_INFO
@@ -108,6 +108,13 @@ static UniValue getpeerinfo(const JSONRPCRequest& request)
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
             "    ],\n"
+            "    \"cmpctprefilled\": n,      (numeric) The txs this peer prefilled in its compact blocks, the coinbase and the coinstake included\n"
+            "    \"cmpctroundtripssaved\": n, (numeric) The compact blocks from this peer completed without a getblocktxn\n"
+            "    \"blockwindow\": n,         (numeric) The number of blocks kept in flight from this peer, adapted to its measured download\n"
+            "    \"blocktime\": n,           (numeric) The average time in seconds this peer takes to deliver a block\n"
+            "    \"blocksdownloaded\": n,    (numeric) The blocks requested from and delivered by this peer\n"
+            "    \"blockdownloadtime\": n,   (numeric) The total time in seconds spent downloading blocks from this peer\n"
+            "    \"blocksreassigned\": n,    (numeric) The blocks requested from this peer because a slower peer held them back\n"
             "    \"whitelisted\": true|false, (boolean) Whether the peer is whitelisted\n"
             "    \"minfeefilter\": n,         (numeric) The minimum fee rate for transactions this peer accepts\n"
             "    \"bytessent_per_msg\": {\n"
@@ -182,6 +189,13 @@ static UniValue getpeerinfo(const JSONRPCRequest& request)
                 heights.push_back(height);
             }
             obj.pushKV("inflight", heights);
+            obj.pushKV("cmpctprefilled", statestats.nCmpctTxPrefilled);
+            obj.pushKV("cmpctroundtripssaved", statestats.nCmpctRoundTripsSaved);
+            obj.pushKV("blockwindow", statestats.nBlockWindow);
+            obj.pushKV("blocktime", ((double)statestats.nBlockServiceTime) / 1e6);
+            obj.pushKV("blocksdownloaded", statestats.nBlocksDownloaded);
+            obj.pushKV("blockdownloadtime", ((double)statestats.nBlockDownloadTime) / 1e6);
+            obj.pushKV("blocksreassigned", statestats.nBlocksReassigned);
         }
         obj.pushKV("whitelisted", stats.m_legacyWhitelisted);
         UniValue permissions(UniValue::VARR);
@@ -193,6 +193,15 @@ public:
         memcpy(dst, m_data.data() + m_pos, n);
         m_pos = pos_next;
     }
+
+    void ignore(size_t n)
+    {
+        size_t pos_next = m_pos + n;
+        if (pos_next > m_data.size()) {
+            throw std::ios_base::failure("VectorReader::ignore(): end of data");
+        }
+        m_pos = pos_next;
+    }
 };
 
 /** Double ended buffer combining vector and stream-like interfaces.
@@ -0,0 +1,54 @@
+// Copyright (c) 2020 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockdownload.h>
+#include <test/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockdownload_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(blockdownload_window_size){
+    // Unmeasured peers have the default window
+    BlockDownloadWindow window(16);
+    BOOST_CHECK(!window.measured());
+    BOOST_CHECK_EQUAL(window.size(), 16);
+
+    // A peer on the local network, 1ms round trip and 100us per block, covers the round trip twice
+    window.received(100, 1000, 1000);
+    BOOST_CHECK(window.measured());
+    BOOST_CHECK_EQUAL(window.serviceTime(), 100);
+    BOOST_CHECK_EQUAL(window.size(), 22);
+    BOOST_CHECK_EQUAL(window.expectedDelivery(3), 1000 + 4 * 100);
+
+    // A slow peer keeps few blocks
+    BlockDownloadWindow slow(16);
+    slow.received(2000000, 1000, 200000);
+    BOOST_CHECK_EQUAL(slow.size(), 4);
+
+    // Without a round trip time the window only covers the block being delivered
+    BlockDownloadWindow noRtt(16);
+    noRtt.received(1000, 1000, 0);
+    BOOST_CHECK_EQUAL(noRtt.size(), MIN_BLOCK_DOWNLOAD_WINDOW);
+
+    // A fast peer far away is bounded
+    BlockDownloadWindow fast(16);
+    fast.received(10, 1000, 50000);
+    BOOST_CHECK_EQUAL(fast.size(), MAX_BLOCK_DOWNLOAD_WINDOW);
+}
+
+BOOST_AUTO_TEST_CASE(blockdownload_window_average){
+    BlockDownloadWindow window(16);
+    window.received(1000, 100, 10000);
+    window.received(9000, 300, 0);
+    // Each sample moves the average by an eighth, the last known round trip time is kept
+    BOOST_CHECK_EQUAL(window.serviceTime(), 2000);
+    BOOST_CHECK_EQUAL(window.rtt(), 10000);
+    BOOST_CHECK_EQUAL(window.size(), 2 * (5 + 1));
+    BOOST_CHECK_EQUAL(window.blocks(), 2U);
+    BOOST_CHECK_EQUAL(window.bytes(), 400U);
+    BOOST_CHECK_EQUAL(window.downloadTime(), 10000);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
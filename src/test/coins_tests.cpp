@@ -80,7 +80,7 @@ public:
     void SelfTest() const
     {
         // Manually recompute the dynamic usage of the whole data, and compare it.
-        size_t ret = memusage::DynamicUsage(cacheCoins);
+        size_t ret = cacheCoins.DynamicMemoryUsage();
         size_t count = 0;
         for (const auto& entry : cacheCoins) {
             ret += entry.second.coin.DynamicMemoryUsage();
@@ -109,7 +109,7 @@ static const unsigned int NUM_SIMULATION_ITERATIONS = 40000;
 //
 // During the process, booleans are kept to make sure that the randomized
 // operation hits all branches.
-BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
+static void CoinsCacheSimulation()
 {
     // Various coverage trackers.
     bool removed_all_caches = false;
@@ -256,6 +256,65 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
     BOOST_CHECK(uncached_an_entry);
 }
 
+BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
+{
+    CoinsCacheSimulation();
+}
+
+// The same simulation with all the caches in the flat backend
+BOOST_AUTO_TEST_CASE(coins_cache_flat_simulation_test)
+{
+    CCoinsMap::SetDefaultBackend(CoinsCacheBackend::FLAT);
+    CoinsCacheSimulation();
+    CCoinsMap::SetDefaultBackend(CoinsCacheBackend::NODE);
+}
+
+// Compare the flat backend to the node backend on random insertions and erasures
+BOOST_AUTO_TEST_CASE(ccoins_map_flat)
+{
+    CCoinsMap node(CoinsCacheBackend::NODE);
+    CCoinsMap flat(CoinsCacheBackend::FLAT);
+    BOOST_CHECK(flat.GetBackend() == CoinsCacheBackend::FLAT);
+    std::vector<uint256> txids(100);
+    for (uint256& txid : txids) {
+        txid = InsecureRand256();
+    }
+
+    for (int i = 0; i < 100000; i++) {
+        COutPoint outpoint(txids[InsecureRandRange(txids.size())], InsecureRandRange(20));
+        CCoinsMap::iterator it = flat.find(outpoint);
+        BOOST_CHECK((it == flat.end()) == (node.find(outpoint) == node.end()));
+        if (it != flat.end()) {
+            BOOST_CHECK(it->second.flags == node.find(outpoint)->second.flags);
+        }
+        if (InsecureRandBool()) {
+            char flags = InsecureRandRange(4);
+            bool inserted = flat.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::tuple<>()).second;
+            BOOST_CHECK(inserted == node.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::tuple<>()).second);
+            flat[outpoint].flags = flags;
+            node[outpoint].flags = flags;
+        } else if (it != flat.end()) {
+            flat.erase(it);
+            node.erase(node.find(outpoint));
+        }
+        BOOST_CHECK_EQUAL(flat.size(), node.size());
+    }
+
+    // Erasing while iterating visits every entry once
+    size_t count = 0;
+    for (CCoinsMap::iterator it = flat.begin(); it != flat.end(); it = flat.erase(it)) {
+        BOOST_CHECK(node.find(it->first) != node.end());
+        count++;
+    }
+    BOOST_CHECK_EQUAL(count, node.size());
+    BOOST_CHECK(flat.empty());
+
+    // clear() releases the chunks of the erased entries
+    BOOST_CHECK(flat.DynamicMemoryUsage() > 0);
+    flat.clear();
+    BOOST_CHECK_EQUAL(flat.DynamicMemoryUsage(), 0U);
+}
+
 // Store of all necessary tx and undo data for next test
 typedef std::map<COutPoint, std::tuple<CTransaction,CTxUndo,Coin>> UtxoData;
 UtxoData utxoData;
@@ -0,0 +1,106 @@
+// Copyright (c) 2020 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <coinswriter.h>
+#include <test/setup_common.h>
+#include <txdb.h>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace coinsWriterTest{
+
+COutPoint outpoint(uint32_t n){
+    return COutPoint(uint256S("01"), n);
+}
+
+Coin coin(CAmount nValue){
+    return Coin(CTxOut(nValue, CScript() << OP_TRUE), 1, false, false);
+}
+
+void addCoins(CCoinsViewCache& cache, uint32_t nCoins, const uint256& hashBlock){
+    for(uint32_t n = 0; n < nCoins; n++){
+        cache.AddCoin(outpoint(n), coin(n + 1), false);
+    }
+    cache.SetBestBlock(hashBlock);
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(coinswriter_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(coinswriter_inline){
+    CCoinsViewDB db(GetDataDir() / "coinswriter_inline", 1 << 20, true, false);
+    CCoinsViewWriteBehind writer(&db, &db, 2);
+    CCoinsViewCache tip(&writer);
+
+    // Without a worker the flush is written in batches before it returns
+    coinsWriterTest::addCoins(tip, 5, uint256S("0a"));
+    BOOST_CHECK(tip.Flush());
+    BOOST_CHECK_EQUAL(writer.pendingCount(), 0U);
+    BOOST_CHECK(db.GetBestBlock() == uint256S("0a"));
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    for(uint32_t n = 0; n < 5; n++){
+        BOOST_CHECK(db.HaveCoin(coinsWriterTest::outpoint(n)));
+    }
+
+    BOOST_CHECK(tip.SpendCoin(coinsWriterTest::outpoint(0)));
+    tip.SetBestBlock(uint256S("0b"));
+    BOOST_CHECK(tip.Flush());
+    BOOST_CHECK(!db.HaveCoin(coinsWriterTest::outpoint(0)));
+    BOOST_CHECK(db.GetBestBlock() == uint256S("0b"));
+}
+
+BOOST_AUTO_TEST_CASE(coinswriter_transition){
+    CCoinsViewDB db(GetDataDir() / "coinswriter_transition", 1 << 20, true, false);
+    CCoinsMap coins;
+    coins[coinsWriterTest::outpoint(0)] = CCoinsCacheEntry(coinsWriterTest::coin(1));
+    coins[coinsWriterTest::outpoint(0)].flags = CCoinsCacheEntry::DIRTY;
+    BOOST_CHECK(db.BatchWrite(coins, uint256S("0a")));
+
+    // The database stays in transition until the last part of the write
+    coins[coinsWriterTest::outpoint(1)] = CCoinsCacheEntry(coinsWriterTest::coin(2));
+    coins[coinsWriterTest::outpoint(1)].flags = CCoinsCacheEntry::DIRTY;
+    BOOST_CHECK(db.WriteCoins(coins, uint256S("0b"), false));
+    BOOST_CHECK(db.GetBestBlock().IsNull());
+    BOOST_CHECK(db.GetHeadBlocks() == std::vector<uint256>({uint256S("0b"), uint256S("0a")}));
+    BOOST_CHECK(db.WriteCoins(coins, uint256S("0b"), false));
+    BOOST_CHECK(db.GetHeadBlocks() == std::vector<uint256>({uint256S("0b"), uint256S("0a")}));
+    BOOST_CHECK(db.WriteCoins(coins, uint256S("0b"), true));
+    BOOST_CHECK(db.GetBestBlock() == uint256S("0b"));
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    BOOST_CHECK(db.HaveCoin(coinsWriterTest::outpoint(1)));
+}
+
+BOOST_AUTO_TEST_CASE(coinswriter_thread){
+    CCoinsViewDB db(GetDataDir() / "coinswriter_thread", 1 << 20, true, false);
+    CCoinsViewWriteBehind writer(&db, &db, 3);
+    CCoinsViewCache tip(&writer);
+    boost::thread thread(&CCoinsViewWriteBehind::ThreadWrite, &writer);
+    while(!writer.hasWorkers()){
+        MilliSleep(1);
+    }
+
+    // The flushed coins are served by the writer until they are on disk
+    coinsWriterTest::addCoins(tip, 10, uint256S("0a"));
+    BOOST_CHECK(tip.Flush());
+    BOOST_CHECK(tip.GetBestBlock() == uint256S("0a"));
+    BOOST_CHECK(tip.AccessCoin(coinsWriterTest::outpoint(9)).out.nValue == 10);
+    BOOST_CHECK(tip.SpendCoin(coinsWriterTest::outpoint(9)));
+    tip.SetBestBlock(uint256S("0b"));
+    BOOST_CHECK(tip.Flush());
+    BOOST_CHECK(!tip.HaveCoin(coinsWriterTest::outpoint(9)));
+
+    BOOST_CHECK(writer.Sync());
+    BOOST_CHECK_EQUAL(writer.pendingCount(), 0U);
+    BOOST_CHECK(db.GetBestBlock() == uint256S("0b"));
+    BOOST_CHECK(db.HaveCoin(coinsWriterTest::outpoint(8)));
+    BOOST_CHECK(!db.HaveCoin(coinsWriterTest::outpoint(9)));
+
+    thread.interrupt();
+    thread.join();
+    BOOST_CHECK(!writer.hasWorkers());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
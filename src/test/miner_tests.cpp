@@ -308,6 +308,39 @@ static void TestPackageSelection(const CChainParams& chainparams, const CScript&
     mempool.addUnchecked(entry.Fee(4000000).FromTx(tx));
     pblocktemplate = AssemblerForTest(chainparams).CreateNewBlock(scriptPubKey);
     BOOST_CHECK(pblocktemplate->block.vtx[8]->GetHash() == hashLowFeeTx2);
+
+    // Test that the prioritisation of a parent is taken off the package of
+    // its child once the parent is in the block. The child is worth its own
+    // fee alone then, and is selected after a tx paying a higher fee rate.
+    tx.vin[0].prevout.hash = hashMediumFeeTx;
+    tx.vin[0].prevout.n = 0;
+    size_t txSize = ::GetSerializeSize(tx, PROTOCOL_VERSION);
+    CAmount feeBase = blockMinFeeRate.GetFee(txSize);
+    tx.vout[0].nValue = 5000000000LL - 4000000 - feeBase;
+    uint256 hashPrioritisedTx = tx.GetHash();
+    mempool.addUnchecked(entry.Fee(feeBase).SpendsCoinbase(false).FromTx(tx));
+    mempool.PrioritiseTransaction(hashPrioritisedTx, 100 * feeBase);
+
+    tx.vin[0].prevout.hash = hashPrioritisedTx;
+    tx.vout[0].nValue -= 2 * feeBase;
+    uint256 hashChildTx = tx.GetHash();
+    mempool.addUnchecked(entry.Fee(2 * feeBase).FromTx(tx));
+
+    tx.vin[0].prevout.hash = txFirst[3]->GetHash();
+    tx.vout[0].nValue = 5000000000LL - 4 * feeBase;
+    uint256 hashHigherFeeTx = tx.GetHash();
+    mempool.addUnchecked(entry.Fee(4 * feeBase).SpendsCoinbase(true).FromTx(tx));
+
+    pblocktemplate = AssemblerForTest(chainparams).CreateNewBlock(scriptPubKey);
+    std::map<uint256, size_t> blockPos;
+    for (size_t i = 0; i < pblocktemplate->block.vtx.size(); ++i) {
+        blockPos[pblocktemplate->block.vtx[i]->GetHash()] = i;
+    }
+    BOOST_REQUIRE(blockPos.count(hashPrioritisedTx) && blockPos.count(hashChildTx) && blockPos.count(hashHigherFeeTx));
+    BOOST_CHECK(blockPos[hashPrioritisedTx] < blockPos[hashHigherFeeTx]);
+    // Taking off the base fee of the parent instead would leave its
+    // prioritisation on the child, which would then come first
+    BOOST_CHECK(blockPos[hashHigherFeeTx] < blockPos[hashChildTx]);
 }
 
 CAmount calculateReward(const CBlock& block){
@@ -4,6 +4,8 @@
 
 #include <policy/policy.h>
 #include <policy/fees.h>
+#include <clientversion.h>
+#include <streams.h>
 #include <txmempool.h>
 #include <uint256.h>
 #include <util/system.h>
@@ -181,4 +183,95 @@ BOOST_AUTO_TEST_CASE(BlockPolicyEstimates)
     }
 }
 
+BOOST_AUTO_TEST_CASE(GasPriceEstimates)
+{
+    CBlockPolicyEstimator feeEst;
+    CTxMemPool mpool(&feeEst);
+    LOCK2(cs_main, mpool.cs);
+    TestMemPoolEntryHelper entry;
+    const uint64_t blockGasLimit = 40000000;
+    const uint64_t gasLimit = 250000;
+    CAmount baseGasPrice(5000);
+    std::vector<CAmount> gasPriceV;
+    for (int j = 0; j < 10; j++) {
+        gasPriceV.push_back(baseGasPrice * (j+1));
+    }
+    std::vector<uint256> txHashes[10];
+
+    // The gas values are taken from the entry, the contract output only marks a contract tx
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << CScriptNum(4) << CScriptNum(gasLimit) << CScriptNum(baseGasPrice) << ParseHex("00") << std::vector<unsigned char>(20, 0) << OP_CALL;
+    std::vector<CTransactionRef> block;
+    int blocknum = 0;
+
+    BOOST_CHECK_EQUAL(feeEst.estimateSmartGasPrice(2, gasLimit, blockGasLimit, nullptr), 0);
+
+    // As for the feerates, higher gas price txs are included more often
+    while (blocknum < 200) {
+        for (int j = 0; j < 10; j++) {
+            for (int k = 0; k < 4; k++) {
+                tx.vin[0].prevout.n = 10000*blocknum+100*j+k;
+                uint256 hash = tx.GetHash();
+                mpool.addUnchecked(entry.Fee(gasPriceV[j] * gasLimit).MinGasPrice(gasPriceV[j]).GasLimit(gasLimit, blockGasLimit).Height(blocknum).FromTx(tx));
+                txHashes[j].push_back(hash);
+            }
+        }
+        for (int h = 0; h <= blocknum%10; h++) {
+            while (txHashes[9-h].size()) {
+                CTransactionRef ptx = mpool.get(txHashes[9-h].back());
+                if (ptx)
+                    block.push_back(ptx);
+                txHashes[9-h].pop_back();
+            }
+        }
+        mpool.removeForBlock(block, ++blocknum);
+        block.clear();
+    }
+
+    // Contract txs do not count towards the feerate estimates
+    BOOST_CHECK(feeEst.estimateFee(2) == CFeeRate(0));
+
+    std::vector<CAmount> origGasEst;
+    FeeCalculation feeCalc;
+    for (int i = 2; i <= 10; i++) {
+        origGasEst.push_back(feeEst.estimateSmartGasPrice(i, gasLimit, blockGasLimit, &feeCalc));
+        BOOST_CHECK_EQUAL(feeCalc.returnedTarget, i);
+        BOOST_CHECK(origGasEst.back() >= gasPriceV[0]);
+        BOOST_CHECK(origGasEst.back() <= gasPriceV[9] * 11 / 10);
+        if (i > 2) { // Gas price estimates should be monotonically decreasing
+            BOOST_CHECK(origGasEst[i-2] <= origGasEst[i-3]);
+        }
+    }
+    // Only the highest gas prices are confirmed within 2 blocks, only the lowest take 10
+    BOOST_CHECK(origGasEst.front() > gasPriceV[6]);
+    BOOST_CHECK(origGasEst.back() < origGasEst.front());
+
+    // Nothing is known about the txs taking a larger share of the block gas limit
+    BOOST_CHECK_EQUAL(feeEst.estimateSmartGasPrice(2, blockGasLimit / 2, blockGasLimit, nullptr), 0);
+    // Targets beyond the medium horizon are not tracked
+    BOOST_CHECK_EQUAL(feeEst.estimateSmartGasPrice(feeEst.HighestGasTargetTracked() + 1, gasLimit, blockGasLimit, nullptr), 0);
+
+    // The gas price estimates are saved with the feerate estimates, the txs still in the
+    // mempool are recorded as failures first like on shutdown
+    feeEst.FlushUnconfirmed();
+    for (int i = 2; i <= 10; i++) {
+        origGasEst[i-2] = feeEst.estimateSmartGasPrice(i, gasLimit, blockGasLimit, nullptr);
+    }
+    fs::path path = GetDataDir() / "fee_estimates_gas.dat";
+    {
+        CAutoFile fileout(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+        BOOST_CHECK(feeEst.Write(fileout));
+    }
+    CBlockPolicyEstimator feeEstRead;
+    {
+        CAutoFile filein(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+        BOOST_CHECK(feeEstRead.Read(filein));
+    }
+    for (int i = 2; i <= 10; i++) {
+        BOOST_CHECK_EQUAL(feeEstRead.estimateSmartGasPrice(i, gasLimit, blockGasLimit, nullptr), origGasEst[i-2]);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
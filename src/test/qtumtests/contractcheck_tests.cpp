@@ -0,0 +1,114 @@
+#include <boost/test/unit_test.hpp>
+#include <qtumtests/test_utils.h>
+#include <script/standard.h>
+
+namespace contractCheckTest{
+
+const std::vector<unsigned char> code(ParseHex("6060604052346000575b60398060166000396000f30060606040525b600b5b5b565b0000a165627a7a72305820a5e02d6fa08a384e067a4c1f749729c502e7597980b427d287386aa006e49d6d0029"));
+
+const ContractCheckParams params{SCRIPT_EXEC_BYTE_CODE, 40, 40000000};
+
+// A deploy of 100000 gas at a gas price of 40, funded by a coin of the sender
+CTransaction createTX(const COutPoint& prevout){
+    CMutableTransaction tx;
+    tx.vin.push_back(CTxIn(prevout));
+    tx.vout.push_back(CTxOut(0, CScript() << CScriptNum(VersionVM::GetEVMDefault().toRaw()) << CScriptNum(100000) << CScriptNum(40) << code << OP_CREATE));
+    return CTransaction(tx);
+}
+
+void addCoin(CCoinsViewCache& view, const COutPoint& prevout, CAmount nValue, const CScript& script){
+    view.AddCoin(prevout, Coin(CTxOut(nValue, script), 1, false, false), false);
+}
+
+std::string checkReason(const CTransaction& tx, const CCoinsViewCache& view, const ContractCheckParams& checkParams = params){
+    CValidationState state;
+    ExtractQtumTX extracted;
+    if(CheckContractTx(tx, view, nullptr, checkParams, state, extracted))
+        return "";
+    return state.GetRejectReason();
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(contractcheck_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(contractcheck_reasons){
+    CCoinsView viewDummy;
+    CCoinsViewCache view(&viewDummy);
+    CScript senderScript = GetScriptForDestination(PKHash(uint160(ParseHex("abababababababababababababababababababab"))));
+    COutPoint funded(uint256S("01"), 0), poor(uint256S("02"), 0), script(uint256S("03"), 0);
+    addCoin(view, funded, COIN, senderScript);
+    addCoin(view, poor, 100000 * 40 - 1, senderScript);
+    addCoin(view, script, COIN, GetScriptForDestination(ScriptHash(senderScript)));
+
+    CValidationState state;
+    ExtractQtumTX extracted;
+    BOOST_CHECK(CheckContractTx(contractCheckTest::createTX(funded), view, nullptr, contractCheckTest::params, state, extracted));
+    BOOST_CHECK(extracted.first.size() == 1);
+    BOOST_CHECK(extracted.first[0].data() == contractCheckTest::code);
+
+    BOOST_CHECK(contractCheckTest::checkReason(contractCheckTest::createTX(poor), view) == "bad-txns-fee-notenough");
+    BOOST_CHECK(contractCheckTest::checkReason(contractCheckTest::createTX(script), view) == "bad-txns-invalid-sender-script");
+    ContractCheckParams expensive{SCRIPT_EXEC_BYTE_CODE, 41, 40000000};
+    BOOST_CHECK(contractCheckTest::checkReason(contractCheckTest::createTX(funded), view, expensive) == "bad-tx-low-gas-price");
+    ContractCheckParams limited{SCRIPT_EXEC_BYTE_CODE, 40, 99999};
+    BOOST_CHECK(contractCheckTest::checkReason(contractCheckTest::createTX(funded), view, limited) == "bad-txns-gas-exceeds-blockgaslimit");
+}
+
+BOOST_AUTO_TEST_CASE(contractcheck_closure_and_cache){
+    CScript senderScript = GetScriptForDestination(PKHash(uint160(ParseHex("abababababababababababababababababababab"))));
+    COutPoint funded(uint256S("01"), 0);
+    std::vector<CTransactionRef> blockTxs{MakeTransactionRef(contractCheckTest::createTX(funded))};
+
+    // The closure checks against its own copies of the coins
+    ContractCheckResults results(2);
+    std::vector<std::pair<COutPoint, Coin>> coins{{funded, Coin(CTxOut(COIN, senderScript), 1, false, false)}};
+    CContractCheck check(*blockTxs[0], blockTxs, contractCheckTest::params, std::move(coins), false, &results, 0);
+    BOOST_CHECK(check());
+    results.wait(0);
+    BOOST_CHECK(results[0].fValid);
+    BOOST_CHECK(results[0].extracted.first.size() == 1);
+
+    // A failure is left for ConnectBlock to report, the result is done all the same
+    std::vector<std::pair<COutPoint, Coin>> coinsPoor{{funded, Coin(CTxOut(1000, senderScript), 1, false, false)}};
+    CContractCheck checkPoor(*blockTxs[0], blockTxs, contractCheckTest::params, std::move(coinsPoor), false, &results, 1);
+    BOOST_CHECK(checkPoor());
+    results.wait(1);
+    BOOST_CHECK(!results[1].fValid);
+
+    // Entries only match the values they were checked with
+    LOCK(cs_main);
+    BOOST_CHECK(!IsContractCheckCached(*blockTxs[0], contractCheckTest::params, false));
+    AddContractCheckCache(*blockTxs[0], contractCheckTest::params);
+    BOOST_CHECK(IsContractCheckCached(*blockTxs[0], contractCheckTest::params, false));
+    ContractCheckParams expensive{SCRIPT_EXEC_BYTE_CODE, 41, 40000000};
+    BOOST_CHECK(!IsContractCheckCached(*blockTxs[0], expensive, false));
+}
+
+BOOST_AUTO_TEST_CASE(contractcheck_cache_bypass){
+    LOCK(cs_main);
+    CTransaction tx = contractCheckTest::createTX(COutPoint(uint256S("01"), 0));
+    AddContractCheckCache(tx, contractCheckTest::params);
+    BOOST_CHECK(IsContractCheckCached(tx, contractCheckTest::params, false));
+
+    // A DGP change of the block gas limit
+    ContractCheckParams limited{SCRIPT_EXEC_BYTE_CODE, 40, 20000000};
+    BOOST_CHECK(!IsContractCheckCached(tx, limited, false));
+
+    // A height past a fork that changes the contract flags
+    Consensus::Params consensus = Params().GetConsensus();
+    consensus.QIP5Height = 100;
+    ContractCheckParams before{GetContractScriptFlags(99, consensus), 40, 40000000};
+    ContractCheckParams after{GetContractScriptFlags(100, consensus), 40, 40000000};
+    BOOST_CHECK(before.contractflags != after.contractflags);
+    AddContractCheckCache(tx, before);
+    BOOST_CHECK(IsContractCheckCached(tx, before, false));
+    BOOST_CHECK(!IsContractCheckCached(tx, after, false));
+
+    // The entry does not read the coins, spending another coin makes another txid
+    CTransaction txOther = contractCheckTest::createTX(COutPoint(uint256S("01"), 1));
+    BOOST_CHECK(txOther.GetHash() != tx.GetHash());
+    BOOST_CHECK(!IsContractCheckCached(txOther, contractCheckTest::params, false));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,55 @@
+#include <boost/test/unit_test.hpp>
+#include <qtumtests/test_utils.h>
+#include <qtum/contractexecutor.h>
+
+#include <atomic>
+#include <stdexcept>
+
+BOOST_FIXTURE_TEST_SUITE(contractexecutor_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(contractexecutor_order){
+    for(bool fThread : {false, true}){
+        ContractExecutor executor(fThread);
+        std::vector<int> order;
+        for(int i = 0; i < 100; i++){
+            executor.push([&order, i](){ order.push_back(i); return true; });
+        }
+        BOOST_CHECK(executor.wait());
+        BOOST_CHECK(order.size() == 100);
+        for(int i = 0; i < 100; i++){
+            BOOST_CHECK(order[i] == i);
+        }
+
+        // The executor can be waited for again after more jobs
+        executor.push([&order](){ order.push_back(100); return true; });
+        BOOST_CHECK(executor.wait());
+        BOOST_CHECK(order.size() == 101);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(contractexecutor_failure){
+    for(bool fThread : {false, true}){
+        ContractExecutor executor(fThread);
+        std::atomic<int> count{0};
+        for(int i = 0; i < 10; i++){
+            executor.push([&count, i](){ count++; return i != 4; });
+        }
+        // The jobs after the failing one are dropped
+        BOOST_CHECK(!executor.wait());
+        BOOST_CHECK(count == 5);
+        executor.push([&count](){ count++; return true; });
+        BOOST_CHECK(!executor.wait());
+        BOOST_CHECK(count == 5);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(contractexecutor_exception){
+    for(bool fThread : {false, true}){
+        ContractExecutor executor(fThread);
+        executor.push([](){ return true; });
+        executor.push([]() -> bool { throw std::runtime_error("execution"); });
+        BOOST_CHECK_THROW(executor.wait(), std::runtime_error);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
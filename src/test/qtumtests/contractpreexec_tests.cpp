@@ -0,0 +1,160 @@
+#include <boost/test/unit_test.hpp>
+#include <qtumtests/test_utils.h>
+#include <qtum/contractpreexec.h>
+#include <miner.h>
+#include <script/interpreter.h>
+#include <txmempool.h>
+
+namespace contractPreExecTest{
+
+CTransactionRef makeTx(uint32_t n, bool contract){
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(uint256S("01"), n);
+    tx.vin[0].scriptSig = CScript() << OP_1;
+    if(contract){
+        tx.vout.push_back(CTxOut(0, CScript() << CScriptNum(VersionVM::GetEVMDefault().toRaw()) << CScriptNum(100000) << CScriptNum(40) << ParseHex("00") << ParseHex("0000000000000000000000000000000000000001") << OP_CALL));
+    } else {
+        tx.vout.push_back(CTxOut(COIN, CScript() << OP_TRUE));
+    }
+    return MakeTransactionRef(tx);
+}
+
+const std::vector<unsigned char> code(ParseHex("6060604052346000575b60398060166000396000f30060606040525b600b5b5b565b0000a165627a7a72305820a5e02d6fa08a384e067a4c1f749729c502e7597980b427d287386aa006e49d6d0029"));
+
+// A deploy spending the first output of coinbase, signed with key when given
+CMutableTransaction makeDeploy(const CTransactionRef& coinbase, uint64_t gasLimit, uint64_t gasPrice, const CKey* key = nullptr){
+    CMutableTransaction tx;
+    tx.vin.push_back(CTxIn(COutPoint(coinbase->GetHash(), 0)));
+    tx.vout.push_back(CTxOut(0, CScript() << CScriptNum(VersionVM::GetEVMDefault().toRaw()) << CScriptNum(gasLimit) << CScriptNum(gasPrice) << code << OP_CREATE));
+    tx.vout.push_back(CTxOut(coinbase->vout[0].nValue - 10 * COIN, coinbase->vout[0].scriptPubKey));
+    if(key){
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(coinbase->vout[0].scriptPubKey, tx, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+        BOOST_CHECK(key->Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        tx.vin[0].scriptSig << vchSig;
+    }
+    return tx;
+}
+
+ContractPreExecResult preExecute(const CTransaction& tx){
+    LOCK(cs_main);
+    CBlockIndex* pindexPrev = ::ChainActive().Tip();
+    QtumDGP qtumDGP(globalState.get(), fGettingValuesDGP);
+    globalSealEngine->setQtumSchedule(qtumDGP.getGasSchedule(pindexPrev->nHeight + 1));
+    CCoinsViewCache view(&::ChainstateActive().CoinsTip());
+    return PreExecuteContractTx(tx, view, generateBlock(), pindexPrev);
+}
+
+std::vector<uint256> order(CTxMemPool& pool){
+    std::vector<uint256> hashes;
+    for(auto const& entry : pool.mapTx.get<ancestor_score_or_gas_price>()){
+        hashes.push_back(entry.GetTx().GetHash());
+    }
+    return hashes;
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(contractpreexec_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(contractpreexec_ordering){
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+    LOCK2(cs_main, pool.cs);
+
+    CTransactionRef payment = contractPreExecTest::makeTx(0, false);
+    CTransactionRef cheap = contractPreExecTest::makeTx(1, true);
+    CTransactionRef refunded = contractPreExecTest::makeTx(2, true);
+    CTransactionRef failing = contractPreExecTest::makeTx(3, true);
+    pool.addUnchecked(entry.Fee(10000).FromTx(payment));
+    entry.MinGasPrice(40).GasLimit(100000, 40000000);
+    pool.addUnchecked(entry.Fee(4000000).FromTx(cheap));
+    pool.addUnchecked(entry.Fee(10000000).FromTx(refunded));
+    pool.addUnchecked(entry.Fee(10000000).FromTx(failing));
+
+    // Not pre-executed yet, the whole gas limit is assumed to be used
+    CTxMemPool::txiter itCheap = *pool.GetIter(cheap->GetHash());
+    BOOST_CHECK(itCheap->GetGasPriceScore() == 40);
+    BOOST_CHECK((*pool.GetIter(refunded->GetHash()))->GetGasPriceScore() == 100);
+    BOOST_CHECK((*pool.GetIter(payment->GetHash()))->GetGasPriceScore() == 0);
+    BOOST_CHECK(pool.mapTx.get<ancestor_score_or_gas_price>().begin()->GetTx().GetHash() == payment->GetHash());
+
+    uint256 hashTip = uint256S("02");
+    pool.UpdatePreExecution(itCheap, hashTip, 100000, 0, false);
+    pool.UpdatePreExecution(*pool.GetIter(refunded->GetHash()), hashTip, 50000, 5000000, false);
+    pool.UpdatePreExecution(*pool.GetIter(failing->GetHash()), hashTip, 0, 0, true);
+
+    // The fee kept per unit of gas decides, the failed tx goes last
+    BOOST_CHECK(itCheap->GetGasPriceScore() == 40);
+    BOOST_CHECK((*pool.GetIter(refunded->GetHash()))->GetGasPriceScore() == 100);
+    std::vector<uint256> expected = {payment->GetHash(), refunded->GetHash(), cheap->GetHash(), failing->GetHash()};
+    BOOST_CHECK(contractPreExecTest::order(pool) == expected);
+
+    // A failure is only known for the tip it was pre-executed on
+    CTxMemPool::txiter itFailing = *pool.GetIter(failing->GetHash());
+    BOOST_CHECK(itFailing->PreExecFailed(hashTip));
+    BOOST_CHECK(!itFailing->PreExecFailed(uint256S("03")));
+    BOOST_CHECK(!itCheap->PreExecFailed(hashTip));
+
+    // A fee delta counts towards the fee kept
+    pool.PrioritiseTransaction(cheap->GetHash(), 8000000);
+    expected = {payment->GetHash(), cheap->GetHash(), refunded->GetHash(), failing->GetHash()};
+    BOOST_CHECK(contractPreExecTest::order(pool) == expected);
+
+    // The failure is kept while the tip stays, forgotten once it changes
+    pool.ClearPreExecFailures(hashTip);
+    BOOST_CHECK(itFailing->PreExecFailed());
+    pool.ClearPreExecFailures(uint256S("03"));
+    BOOST_CHECK(!itFailing->PreExecFailed());
+    BOOST_CHECK(itFailing->GetGasPriceScore() == 100);
+}
+
+BOOST_FIXTURE_TEST_CASE(contractpreexec_execute, TestChain100Setup){
+    const CTransactionRef& coinbase = m_coinbase_txns[0];
+    dev::h256 oldHashStateRoot(globalState->rootHash());
+    dev::h256 oldHashUTXORoot(globalState->rootHashUTXO());
+
+    // A deploy runs and the sender gets the gas it did not use back
+    ContractPreExecResult result = contractPreExecTest::preExecute(CTransaction(contractPreExecTest::makeDeploy(coinbase, 100000, DEFAULT_MIN_GAS_PRICE_DGP)));
+    BOOST_CHECK(!result.fFailed);
+    BOOST_CHECK(result.nGasUsed > 0 && result.nGasUsed < 100000);
+    BOOST_CHECK(result.nGasRefund == CAmount(100000 - result.nGasUsed) * (CAmount)DEFAULT_MIN_GAS_PRICE_DGP);
+
+    // Nothing of it is left in the state
+    BOOST_CHECK(globalState->rootHash() == oldHashStateRoot);
+    BOOST_CHECK(globalState->rootHashUTXO() == oldHashUTXORoot);
+
+    // The assembler would reject these whatever their position in the block
+    BOOST_CHECK(contractPreExecTest::preExecute(CTransaction(contractPreExecTest::makeDeploy(coinbase, 100000, DEFAULT_MIN_GAS_PRICE_DGP - 1))).fFailed);
+    BOOST_CHECK(contractPreExecTest::preExecute(CTransaction(contractPreExecTest::makeDeploy(coinbase, DEFAULT_BLOCK_GAS_LIMIT_DGP + 1, DEFAULT_MIN_GAS_PRICE_DGP))).fFailed);
+}
+
+BOOST_FIXTURE_TEST_CASE(contractpreexec_assembler_skip, TestChain100Setup){
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CTransactionRef deploy = MakeTransactionRef(contractPreExecTest::makeDeploy(m_coinbase_txns[0], 100000, DEFAULT_MIN_GAS_PRICE_DGP, &coinbaseKey));
+    TestMemPoolEntryHelper entry;
+    uint256 hashTip;
+    {
+        LOCK2(cs_main, mempool.cs);
+        hashTip = ::ChainActive().Tip()->GetBlockHash();
+        mempool.addUnchecked(entry.Fee(10 * COIN).MinGasPrice(DEFAULT_MIN_GAS_PRICE_DGP).GasLimit(100000, DEFAULT_BLOCK_GAS_LIMIT_DGP).FromTx(deploy));
+        mempool.UpdatePreExecution(*mempool.GetIter(deploy->GetHash()), hashTip, 0, 0, true);
+    }
+
+    // Failed on top of the tip, the assembler does not try it again
+    std::unique_ptr<CBlockTemplate> pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptPubKey);
+    BOOST_CHECK(pblocktemplate->block.vtx.size() == 1);
+
+    // A failure on another tip does not count
+    {
+        LOCK(mempool.cs);
+        mempool.UpdatePreExecution(*mempool.GetIter(deploy->GetHash()), uint256S("01"), 0, 0, true);
+    }
+    pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptPubKey);
+    BOOST_CHECK(pblocktemplate->block.vtx.size() > 1);
+    BOOST_CHECK(pblocktemplate->block.vtx[1]->GetHash() == deploy->GetHash());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
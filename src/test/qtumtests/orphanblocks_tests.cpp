@@ -0,0 +1,76 @@
+#include <boost/test/unit_test.hpp>
+#include <qtumtests/test_utils.h>
+#include <qtum/orphanblocks.h>
+
+namespace orphanBlocksTest{
+
+std::shared_ptr<const CBlock> block(const uint256& hashPrev, uint32_t nNonce, bool fProofOfStake = false){
+    CBlock block;
+    block.hashPrevBlock = hashPrev;
+    block.nNonce = nNonce;
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vout.resize(1);
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+    if(fProofOfStake)
+        block.prevoutStake = COutPoint(uint256S("0a"), nNonce);
+    return std::make_shared<const CBlock>(block);
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(orphanblocks_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(orphanblocks_chain){
+    OrphanBlocks orphans;
+    std::shared_ptr<const CBlock> a = orphanBlocksTest::block(uint256S("01"), 1, true);
+    std::shared_ptr<const CBlock> b = orphanBlocksTest::block(a->GetHash(), 2, true);
+    std::shared_ptr<const CBlock> c = orphanBlocksTest::block(b->GetHash(), 3);
+    std::shared_ptr<const CBlock> d = orphanBlocksTest::block(a->GetHash(), 4);
+
+    // The chain is received tip first
+    BOOST_CHECK(orphans.add(c, 100));
+    BOOST_CHECK(orphans.add(d, 100));
+    BOOST_CHECK(orphans.add(b, 100));
+    BOOST_CHECK(orphans.add(a, 100));
+    BOOST_CHECK(!orphans.add(a, 100));
+    BOOST_CHECK_EQUAL(orphans.size(), 4U);
+    BOOST_CHECK(orphans.root(c->GetHash()) == a->GetHash());
+    BOOST_CHECK(orphans.haveChildren(a->GetHash()));
+    BOOST_CHECK(orphans.haveStake(b->GetProofOfStake()));
+    BOOST_CHECK(!orphans.haveStake(c->GetProofOfStake()));
+    BOOST_CHECK(orphans.usage() > orphans.bytes());
+
+    // The whole chain is taken at once, parents before children
+    std::vector<std::shared_ptr<const CBlock>> blocks = orphans.takeChildren(uint256S("01"));
+    BOOST_CHECK_EQUAL(blocks.size(), 4U);
+    BOOST_CHECK(blocks[0] == a);
+    BOOST_CHECK(blocks[3] == c);
+    BOOST_CHECK_EQUAL(orphans.size(), 0U);
+    BOOST_CHECK_EQUAL(orphans.bytes(), 0U);
+    BOOST_CHECK(!orphans.haveStake(a->GetProofOfStake()));
+}
+
+BOOST_AUTO_TEST_CASE(orphanblocks_limit){
+    OrphanBlocks orphans;
+    std::shared_ptr<const CBlock> a = orphanBlocksTest::block(uint256S("01"), 1);
+    std::shared_ptr<const CBlock> b = orphanBlocksTest::block(a->GetHash(), 2);
+    std::shared_ptr<const CBlock> c = orphanBlocksTest::block(uint256S("02"), 3);
+    std::shared_ptr<const CBlock> d = orphanBlocksTest::block(uint256S("03"), 4);
+    orphans.add(a, 100);
+    orphans.add(c, 200);
+    orphans.add(b, 300);
+    orphans.add(d, 400);
+    size_t nBlockSize = orphans.bytes() / 4;
+
+    // Expired orphans go first, then the oldest ones along with the orphans built on them
+    BOOST_CHECK_EQUAL(orphans.limit(nBlockSize * 4, 100 + ORPHAN_BLOCK_EXPIRE_TIME), 2U);
+    BOOST_CHECK(!orphans.have(b->GetHash()));
+    BOOST_CHECK(orphans.have(c->GetHash()));
+    BOOST_CHECK_EQUAL(orphans.limit(nBlockSize, 200), 1U);
+    BOOST_CHECK(orphans.have(d->GetHash()));
+    BOOST_CHECK_EQUAL(orphans.bytes(), nBlockSize);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
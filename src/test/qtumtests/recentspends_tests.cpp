@@ -0,0 +1,152 @@
+#include <boost/test/unit_test.hpp>
+#include <qtumtests/test_utils.h>
+#include <arith_uint256.h>
+#include <chain.h>
+#include <qtum/recentspends.h>
+#include <undo.h>
+
+namespace recentSpendsTest{
+
+struct Chain{
+    std::deque<uint256> hashes;
+    std::deque<CBlockIndex> indexes;
+
+    // Blocks of a branch get different hashes for the same height
+    const CBlockIndex* add(const CBlockIndex* pprev, unsigned branch){
+        int nHeight = pprev ? pprev->nHeight + 1 : 0;
+        hashes.push_back(ArithToUint256(arith_uint256((uint64_t)branch << 32 | nHeight)));
+        indexes.emplace_back();
+        CBlockIndex& index = indexes.back();
+        index.phashBlock = &hashes.back();
+        index.pprev = const_cast<CBlockIndex*>(pprev);
+        index.nHeight = nHeight;
+        return &index;
+    }
+};
+
+COutPoint outpoint(uint32_t n){
+    return COutPoint(uint256S("01"), n);
+}
+
+// A block with a coinbase and one tx spending each of the prevouts
+void connect(RecentSpends& spends, const CBlockIndex* pindex, const std::vector<uint32_t>& prevouts){
+    CBlock block;
+    CBlockUndo undo;
+    block.vtx.push_back(MakeTransactionRef(CMutableTransaction()));
+    CMutableTransaction tx;
+    CTxUndo txundo;
+    for(uint32_t n : prevouts){
+        tx.vin.push_back(CTxIn(outpoint(n)));
+        txundo.vprevout.push_back(Coin(CTxOut(n * COIN, CScript() << OP_TRUE), 1, false));
+    }
+    block.vtx.push_back(MakeTransactionRef(tx));
+    undo.vtxundo.push_back(txundo);
+    spends.connectBlock(block, undo, pindex);
+}
+
+bool spent(const RecentSpends& spends, const CBlockIndex* tip, int nForkHeight, uint32_t n, Coin* coin = nullptr){
+    bool fSpent = false;
+    BOOST_CHECK(spends.lookup(tip->GetBlockHash(), nForkHeight, outpoint(n), coin, fSpent));
+    return fSpent;
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(recentspends_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(recentspends_lookup){
+    recentSpendsTest::Chain chain;
+    RecentSpends spends(10);
+    const CBlockIndex* pindex = chain.add(nullptr, 0);
+    recentSpendsTest::connect(spends, pindex, {});
+    for(uint32_t n = 1; n <= 5; n++){
+        pindex = chain.add(pindex, 0);
+        recentSpendsTest::connect(spends, pindex, {n});
+    }
+    BOOST_CHECK(spends.size() == 5);
+    BOOST_CHECK(spends.coveredFrom() == 0);
+
+    // Only the spends above the fork height count
+    Coin coin;
+    BOOST_CHECK(recentSpendsTest::spent(spends, pindex, 2, 3, &coin));
+    BOOST_CHECK(coin.out.nValue == 3 * COIN);
+    BOOST_CHECK(!recentSpendsTest::spent(spends, pindex, 2, 2));
+    BOOST_CHECK(!recentSpendsTest::spent(spends, pindex, 2, 6));
+    BOOST_CHECK(!recentSpendsTest::spent(spends, pindex, 5, 5));
+
+    // Not in sync with the tip asked for
+    bool fSpent = false;
+    BOOST_CHECK(!spends.lookup(pindex->pprev->GetBlockHash(), 2, recentSpendsTest::outpoint(3), nullptr, fSpent));
+}
+
+BOOST_AUTO_TEST_CASE(recentspends_reorg){
+    recentSpendsTest::Chain chain;
+    RecentSpends spends(10);
+    const CBlockIndex* pindex = chain.add(nullptr, 0);
+    recentSpendsTest::connect(spends, pindex, {});
+    for(uint32_t n = 1; n <= 5; n++){
+        pindex = chain.add(pindex, 0);
+        recentSpendsTest::connect(spends, pindex, {n});
+    }
+
+    // Reorg the last two blocks to a branch spending other prevouts
+    const CBlockIndex* pindexFork = pindex->pprev->pprev;
+    spends.disconnectBlock(pindex->GetBlockHash(), pindex->pprev->GetBlockHash());
+    spends.disconnectBlock(pindex->pprev->GetBlockHash(), pindexFork->GetBlockHash());
+    BOOST_CHECK(spends.size() == 3);
+    pindex = chain.add(pindexFork, 1);
+    recentSpendsTest::connect(spends, pindex, {7});
+    pindex = chain.add(pindex, 1);
+    recentSpendsTest::connect(spends, pindex, {4, 8});
+
+    BOOST_CHECK(spends.bestBlock() == pindex->GetBlockHash());
+    BOOST_CHECK(!recentSpendsTest::spent(spends, pindex, 0, 5));
+    BOOST_CHECK(recentSpendsTest::spent(spends, pindex, 3, 4));
+    BOOST_CHECK(recentSpendsTest::spent(spends, pindex, 3, 7));
+    BOOST_CHECK(recentSpendsTest::spent(spends, pindex, 0, 3));
+
+    // Disconnecting a block the index does not have at its tip resets it
+    spends.disconnectBlock(pindexFork->GetBlockHash(), pindexFork->pprev->GetBlockHash());
+    BOOST_CHECK(spends.size() == 0);
+    BOOST_CHECK(spends.bestBlock().IsNull());
+}
+
+BOOST_AUTO_TEST_CASE(recentspends_coverage){
+    recentSpendsTest::Chain chain;
+    RecentSpends spends(3, 3);
+    const CBlockIndex* pindex = chain.add(nullptr, 0);
+    for(uint32_t n = 1; n <= 5; n++){
+        pindex = chain.add(pindex, 0);
+        if(n == 2){
+            // Connected while the index was behind, it covers from here on
+            recentSpendsTest::connect(spends, pindex, {n});
+            BOOST_CHECK(spends.coveredFrom() == 2);
+        } else if(n > 2){
+            recentSpendsTest::connect(spends, pindex, {n});
+        }
+    }
+
+    // Only the last 3 blocks are kept
+    BOOST_CHECK(spends.size() == 3);
+    BOOST_CHECK(spends.coveredFrom() == 3);
+    bool fSpent = false;
+    BOOST_CHECK(!spends.lookup(pindex->GetBlockHash(), 1, recentSpendsTest::outpoint(2), nullptr, fSpent));
+    BOOST_CHECK(recentSpendsTest::spent(spends, pindex, 2, 3));
+
+    // The max entries evicts the oldest blocks first
+    pindex = chain.add(pindex, 0);
+    recentSpendsTest::connect(spends, pindex, {10, 11, 12});
+    BOOST_CHECK(spends.size() == 3);
+    BOOST_CHECK(spends.coveredFrom() == 6);
+    BOOST_CHECK(recentSpendsTest::spent(spends, pindex, 5, 11));
+    BOOST_CHECK(!spends.lookup(pindex->GetBlockHash(), 4, recentSpendsTest::outpoint(5), nullptr, fSpent));
+
+    // Disconnecting below the covered blocks leaves nothing to look up above the tip
+    spends.disconnectBlock(pindex->GetBlockHash(), pindex->pprev->GetBlockHash());
+    pindex = pindex->pprev;
+    BOOST_CHECK(spends.size() == 0);
+    BOOST_CHECK(!recentSpendsTest::spent(spends, pindex, 5, 5));
+    BOOST_CHECK(!spends.lookup(pindex->GetBlockHash(), 4, recentSpendsTest::outpoint(5), nullptr, fSpent));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
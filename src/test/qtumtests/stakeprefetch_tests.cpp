@@ -0,0 +1,172 @@
+#include <boost/test/unit_test.hpp>
+#include <qtumtests/test_utils.h>
+#include <arith_uint256.h>
+#include <chain.h>
+#include <clientversion.h>
+#include <consensus/validation.h>
+#include <key.h>
+#include <pos.h>
+#include <qtum/stakeprefetch.h>
+#include <script/interpreter.h>
+#include <streams.h>
+
+#include <boost/thread/thread.hpp>
+
+namespace stakePrefetchTest{
+
+const unsigned int nBits = 0x1c00ffff;
+
+struct StakeChain{
+    std::vector<uint256> hashes;
+    std::vector<CBlockIndex> indexes;
+    CKey key;
+    COutPoint prevout;
+    Coin coin;
+
+    StakeChain() : hashes(COINBASE_MATURITY + 10), indexes(COINBASE_MATURITY + 10){
+        for(size_t i = 0; i < indexes.size(); i++){
+            hashes[i] = ArithToUint256(arith_uint256(i + 1));
+            indexes[i].phashBlock = &hashes[i];
+            indexes[i].pprev = i ? &indexes[i - 1] : nullptr;
+            indexes[i].nHeight = i;
+            indexes[i].nTime = 1000000 + i * 16;
+        }
+        tip()->nStakeModifier = uint256S("abcdef");
+        key.MakeNewKey(true);
+        prevout = COutPoint(uint256S("01"), 0);
+        coin = Coin(CTxOut(1000 * COIN, CScript() << ToByteVector(key.GetPubKey()) << OP_CHECKSIG), 1, false, false);
+    }
+
+    CBlockIndex* tip(){
+        return &indexes.back();
+    }
+
+    // A signed PoS block at the first time its kernel meets nBits
+    CBlock createBlock(){
+        uint32_t nTime = tip()->nTime + 16;
+        uint256 hashProof, target;
+        while(!CheckStakeKernelHash(tip(), nBits, indexes[coin.nHeight].nTime, coin.out.nValue, prevout, nTime, hashProof, target)){
+            nTime += 16;
+        }
+
+        CMutableTransaction coinstake;
+        coinstake.vin.push_back(CTxIn(prevout));
+        coinstake.vout.resize(2);
+        coinstake.vout[0].SetEmpty();
+        coinstake.vout[1] = coin.out;
+        uint256 sighash = SignatureHash(coin.out.scriptPubKey, coinstake, 0, SIGHASH_ALL, coin.out.nValue, SigVersion::BASE);
+        std::vector<unsigned char> sig;
+        BOOST_CHECK(key.Sign(sighash, sig));
+        sig.push_back(SIGHASH_ALL);
+        coinstake.vin[0].scriptSig = CScript() << sig;
+
+        CBlock block;
+        block.hashPrevBlock = tip()->GetBlockHash();
+        block.nTime = nTime;
+        block.nBits = nBits;
+        block.prevoutStake = prevout;
+        block.vtx.push_back(MakeTransactionRef(CMutableTransaction()));
+        block.vtx.push_back(MakeTransactionRef(coinstake));
+        BOOST_CHECK(key.Sign(block.GetHashWithoutSign(), block.vchBlockSig));
+        return block;
+    }
+};
+
+FlatFilePos writeBlock(const CBlock& block, int nFile){
+    FlatFilePos pos(nFile, 0);
+    CAutoFile fileout(OpenBlockFile(pos), SER_DISK, CLIENT_VERSION);
+    fileout << block;
+    return pos;
+}
+
+StakePrefetchJob createJob(StakeChain& chain, const CBlock& block, const FlatFilePos& pos, bool fHaveCoin){
+    StakePrefetchJob job;
+    job.hash = block.GetHash();
+    job.pos = pos;
+    job.pindexPrev = chain.tip();
+    job.fHaveCoin = fHaveCoin;
+    job.coinStake = chain.coin;
+    return job;
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(stakeprefetch_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(stakeprefetch_kernel){
+    stakePrefetchTest::StakeChain chain;
+    CBlock block = chain.createBlock();
+
+    // The split checks agree with CheckProofOfStake
+    CCoinsView viewDummy;
+    CCoinsViewCache view(&viewDummy);
+    view.AddCoin(chain.prevout, Coin(chain.coin), false);
+    CValidationState state;
+    Coin coinPrev;
+    uint256 hashProof, hashProofKernel, target;
+    BOOST_CHECK(CheckProofOfStake(chain.tip(), state, *block.vtx[1], block.nBits, block.nTime, hashProof, target, view));
+    BOOST_CHECK(CheckStakePrevout(chain.tip(), state, *block.vtx[1], view, coinPrev));
+    BOOST_CHECK(CheckStakeKernel(chain.tip(), state, *block.vtx[1], block.nBits, block.nTime, coinPrev, hashProofKernel, target));
+    BOOST_CHECK(hashProof == hashProofKernel);
+
+    // An immature stake fails the prevout checks only
+    BOOST_CHECK(!CheckStakePrevout(&chain.indexes[COINBASE_MATURITY - 2], state, *block.vtx[1], view, coinPrev));
+    BOOST_CHECK(state.GetRejectReason() == "stake-prevout-not-mature");
+}
+
+BOOST_AUTO_TEST_CASE(stakeprefetch_results){
+    stakePrefetchTest::StakeChain chain;
+    CBlock block = chain.createBlock();
+    CBlock badSig = block;
+    badSig.vchBlockSig.back() ^= 1;
+    FlatFilePos pos = stakePrefetchTest::writeBlock(block, 0);
+    FlatFilePos posBadSig = stakePrefetchTest::writeBlock(badSig, 1);
+
+    StakePrefetcher prefetcher(Params().GetConsensus());
+    prefetcher.push({stakePrefetchTest::createJob(chain, block, pos, true), stakePrefetchTest::createJob(chain, badSig, posBadSig, true)});
+    BOOST_CHECK(prefetcher.getBlock(uint256S("02")) == nullptr);
+
+    // Without threads the jobs are run by the caller
+    std::shared_ptr<const CBlock> pblock = prefetcher.getBlock(block.GetHash());
+    BOOST_CHECK(pblock && pblock->GetHash() == block.GetHash());
+    BOOST_CHECK(pblock->fCheckedSignature);
+    BOOST_CHECK(prefetcher.getBlock(block.GetHash()) == nullptr);
+    std::shared_ptr<const CBlock> pbadSig = prefetcher.getBlock(badSig.GetHash());
+    BOOST_CHECK(pbadSig && !pbadSig->fCheckedSignature);
+
+    // The kernel is only taken for the coin it was checked with, and only once
+    uint256 hashProof, hashProofExpected, target;
+    BOOST_CHECK(CheckStakeKernelHash(chain.tip(), block.nBits, chain.indexes[1].nTime, chain.coin.out.nValue, chain.prevout, block.nTime, hashProofExpected, target));
+    Coin other(CTxOut(chain.coin.out.nValue + 1, chain.coin.out.scriptPubKey), 1, false, false);
+    BOOST_CHECK(!prefetcher.getStake(badSig.GetHash(), other, hashProof));
+    BOOST_CHECK(prefetcher.getStake(block.GetHash(), chain.coin, hashProof));
+    BOOST_CHECK(hashProof == hashProofExpected);
+    BOOST_CHECK(!prefetcher.getStake(block.GetHash(), chain.coin, hashProof));
+
+    // Without a snapshot of the coin only the block is read ahead
+    prefetcher.push({stakePrefetchTest::createJob(chain, block, pos, false)});
+    BOOST_CHECK(prefetcher.getBlock(block.GetHash()) != nullptr);
+    BOOST_CHECK(!prefetcher.getStake(block.GetHash(), chain.coin, hashProof));
+
+    // A job at the position of another block gives nothing
+    prefetcher.push({stakePrefetchTest::createJob(chain, block, posBadSig, true)});
+    BOOST_CHECK(prefetcher.getBlock(block.GetHash()) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(stakeprefetch_thread){
+    stakePrefetchTest::StakeChain chain;
+    CBlock block = chain.createBlock();
+    FlatFilePos pos = stakePrefetchTest::writeBlock(block, 0);
+
+    StakePrefetcher prefetcher(Params().GetConsensus());
+    boost::thread thread(&StakePrefetcher::ThreadPrefetch, &prefetcher);
+    prefetcher.push({stakePrefetchTest::createJob(chain, block, pos, true)});
+    std::shared_ptr<const CBlock> pblock = prefetcher.getBlock(block.GetHash());
+    BOOST_CHECK(pblock && pblock->fCheckedSignature);
+    uint256 hashProof;
+    BOOST_CHECK(prefetcher.getStake(block.GetHash(), chain.coin, hashProof));
+    thread.interrupt();
+    thread.join();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
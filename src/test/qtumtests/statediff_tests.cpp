@@ -0,0 +1,173 @@
+#include <boost/test/unit_test.hpp>
+#include <qtumtests/test_utils.h>
+#include <qtum/statediff.h>
+
+namespace statediffTest{
+
+typedef dev::eth::SecureTrieDB<dev::h256, dev::OverlayDB> StorageTrie;
+typedef dev::eth::SecureTrieDB<dev::Address, dev::OverlayDB> AccountTrie;
+
+const dev::h256 emptyRoot = dev::sha3(dev::rlp(""));
+
+struct Change{
+    dev::h256 key;
+    std::string before;
+    std::string after;
+};
+
+std::vector<Change> diffTrie(dev::OverlayDB& db, dev::h256 rootBefore, dev::h256 rootAfter, dev::h256 start = dev::h256()){
+    std::vector<Change> changes;
+    TrieDiff(db).diff(rootBefore, rootAfter, [&](dev::h256 const& key, std::string const& before, std::string const& after){
+        changes.push_back({key, before, after});
+        return true;
+    }, start);
+    return changes;
+}
+
+dev::h256 putAccount(AccountTrie& trie, dev::OverlayDB& db, dev::Address address, dev::u256 balance, std::map<dev::h256, dev::u256> const& storage){
+    StorageTrie storageTrie(&db);
+    storageTrie.init();
+    for(auto const& slot : storage){
+        storageTrie.insert(slot.first, dev::rlp(slot.second));
+    }
+    dev::RLPStream account(4);
+    account << dev::u256(0) << balance << storageTrie.root() << dev::sha3(dev::bytes());
+    trie.insert(address, &account.out());
+    return trie.root();
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(statediff_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(triediff_changed_inserted_removed){
+    dev::OverlayDB db;
+    statediffTest::StorageTrie trie(&db);
+    trie.init();
+    for(unsigned i = 0; i < 100; i++){
+        trie.insert(dev::h256(i), dev::rlp(dev::u256(i + 1)));
+    }
+    dev::h256 rootBefore = trie.root();
+
+    trie.insert(dev::h256(5), dev::rlp(dev::u256(500)));
+    trie.insert(dev::h256(100), dev::rlp(dev::u256(101)));
+    trie.remove(dev::h256(42));
+    dev::h256 rootAfter = trie.root();
+
+    std::vector<statediffTest::Change> changes = statediffTest::diffTrie(db, rootBefore, rootAfter);
+    BOOST_CHECK(changes.size() == 3);
+    for(size_t i = 1; i < changes.size(); i++){
+        BOOST_CHECK(changes[i - 1].key < changes[i].key);
+    }
+    for(auto const& change : changes){
+        if(change.key == dev::sha3(dev::h256(5))){
+            BOOST_CHECK(dev::RLP(change.before).toInt<dev::u256>() == 6);
+            BOOST_CHECK(dev::RLP(change.after).toInt<dev::u256>() == 500);
+        } else if(change.key == dev::sha3(dev::h256(100))){
+            BOOST_CHECK(change.before.empty());
+            BOOST_CHECK(dev::RLP(change.after).toInt<dev::u256>() == 101);
+        } else {
+            BOOST_CHECK(change.key == dev::sha3(dev::h256(42)));
+            BOOST_CHECK(dev::RLP(change.before).toInt<dev::u256>() == 43);
+            BOOST_CHECK(change.after.empty());
+        }
+    }
+
+    // Reversed direction reports the same keys with before and after swapped
+    std::vector<statediffTest::Change> reversed = statediffTest::diffTrie(db, rootAfter, rootBefore);
+    BOOST_CHECK(reversed.size() == changes.size());
+    for(size_t i = 0; i < reversed.size(); i++){
+        BOOST_CHECK(reversed[i].key == changes[i].key);
+        BOOST_CHECK(reversed[i].before == changes[i].after);
+        BOOST_CHECK(reversed[i].after == changes[i].before);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(triediff_range_scan_and_identical_roots){
+    dev::OverlayDB db;
+    statediffTest::StorageTrie trie(&db);
+    trie.init();
+    for(unsigned i = 0; i < 50; i++){
+        trie.insert(dev::h256(i), dev::rlp(dev::u256(i + 1)));
+    }
+    dev::h256 root = trie.root();
+
+    // Diffing against the empty trie is a full range scan
+    std::vector<statediffTest::Change> all = statediffTest::diffTrie(db, statediffTest::emptyRoot, root);
+    BOOST_CHECK(all.size() == 50);
+
+    // Resuming from a key reports that key and everything after it
+    std::vector<statediffTest::Change> tail = statediffTest::diffTrie(db, statediffTest::emptyRoot, root, all[20].key);
+    BOOST_CHECK(tail.size() == 30);
+    BOOST_CHECK(tail.front().key == all[20].key);
+
+    // Identical roots are skipped without loading anything
+    TrieDiff diff(db);
+    BOOST_CHECK(diff.diff(root, root, [](dev::h256 const&, std::string const&, std::string const&){ return true; }));
+    BOOST_CHECK(diff.nodesLoaded() == 0);
+
+    // The visitor can stop the walk
+    unsigned visited = 0;
+    BOOST_CHECK(!diff.diff(statediffTest::emptyRoot, root, [&](dev::h256 const&, std::string const&, std::string const&){ return ++visited < 5; }));
+    BOOST_CHECK(visited == 5);
+}
+
+BOOST_AUTO_TEST_CASE(statediff_accounts_and_cursor){
+    dev::OverlayDB db;
+    statediffTest::AccountTrie trie(&db);
+    trie.init();
+    dev::Address addr1("0101010101010101010101010101010101010101");
+    dev::Address addr2("0202020202020202020202020202020202020202");
+    dev::Address addr3("0303030303030303030303030303030303030303");
+    statediffTest::putAccount(trie, db, addr1, 10, {{dev::h256(1), 1}, {dev::h256(2), 2}});
+    dev::h256 rootBefore = statediffTest::putAccount(trie, db, addr2, 20, {{dev::h256(1), 1}});
+
+    statediffTest::putAccount(trie, db, addr1, 10, {{dev::h256(1), 1}, {dev::h256(2), 3}, {dev::h256(3), 4}});
+    dev::h256 rootAfter = statediffTest::putAccount(trie, db, addr3, 30, {});
+
+    struct Entry{ dev::h256 account; dev::h256 slot; bool hasSlot; };
+    std::vector<Entry> entries;
+    StateDiff stateDiff(db);
+    auto onAccount = [&](AccountDiff const& account){
+        entries.push_back({account.key, dev::h256(), false});
+        return true;
+    };
+    auto onStorage = [&](AccountDiff const& account, StorageDiff const& storage){
+        BOOST_CHECK(account.address == addr1);
+        BOOST_CHECK(storage.hasSlot);
+        entries.push_back({account.key, storage.key, true});
+        return true;
+    };
+    BOOST_CHECK(stateDiff.diff(rootBefore, rootAfter, onAccount, onStorage));
+
+    // addr1 with two changed slots and the new addr3, addr2 is unchanged
+    BOOST_CHECK(entries.size() == 4);
+
+    // Resuming after every entry yields exactly the remaining entries
+    for(size_t i = 0; i < entries.size(); i++){
+        StateDiffCursor cursor;
+        cursor.account = entries[i].account;
+        cursor.slot = entries[i].slot;
+        cursor.hasSlot = entries[i].hasSlot;
+
+        std::vector<Entry> all;
+        all.swap(entries);
+        BOOST_CHECK(StateDiff(db).diff(rootBefore, rootAfter, onAccount, onStorage, &cursor));
+        BOOST_CHECK(entries.size() == all.size() - i - 1);
+        for(size_t j = 0; j < entries.size(); j++){
+            BOOST_CHECK(entries[j].account == all[i + 1 + j].account);
+            BOOST_CHECK(entries[j].slot == all[i + 1 + j].slot);
+        }
+        entries.swap(all);
+    }
+
+    // A single account is looked up directly
+    entries.clear();
+    BOOST_CHECK(stateDiff.diffAccount(addr1, rootBefore, rootAfter, onAccount, onStorage));
+    BOOST_CHECK(entries.size() == 3);
+    entries.clear();
+    BOOST_CHECK(stateDiff.diffAccount(addr2, rootBefore, rootAfter, onAccount, onStorage));
+    BOOST_CHECK(entries.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,148 @@
+#include <boost/test/unit_test.hpp>
+#include <qtumtests/test_utils.h>
+#include <qtum/statediff.h>
+#include <qtum/statepruner.h>
+
+namespace statePrunerTest{
+
+typedef dev::eth::SecureTrieDB<dev::h256, dev::OverlayDB> StorageTrie;
+typedef dev::eth::SecureTrieDB<dev::Address, dev::OverlayDB> AccountTrie;
+
+const dev::Address contract("0101010101010101010101010101010101010101");
+
+const dev::bytes code = ParseHex("6060604052600080fd");
+
+struct PrunerSetup : public BasicTestingSetup {
+    dev::db::DatabaseFace* rawState = nullptr;
+    dev::db::DatabaseFace* rawUTXO = nullptr;
+    dev::OverlayDB state;
+    dev::OverlayDB utxo;
+
+    PrunerSetup(){
+        const dev::h256 hashDB(dev::sha3(dev::rlp("")));
+        state = QtumState::openDB((GetDataDir() / "state").string(), hashDB, dev::WithExisting::Trust, rawState);
+        utxo = QtumState::openDB((GetDataDir() / "utxo").string(), hashDB, dev::WithExisting::Trust, rawUTXO);
+    }
+
+    /** Commit a contract whose storage maps slot i to i + offset for i < slots */
+    dev::h256 commitState(unsigned slots, unsigned offset){
+        StorageTrie storage(&state);
+        storage.init();
+        for(unsigned i = 0; i < slots; i++){
+            storage.insert(dev::h256(i), dev::rlp(dev::u256(i + offset)));
+        }
+        state.insert(dev::sha3(code), &code);
+
+        AccountTrie accounts(&state);
+        accounts.init();
+        dev::RLPStream account(4);
+        account << dev::u256(1) << dev::u256(0) << storage.root() << dev::sha3(code);
+        accounts.insert(contract, &account.out());
+        state.commit();
+        return accounts.root();
+    }
+
+    dev::h256 commitUTXO(unsigned vins){
+        AccountTrie trie(&utxo);
+        trie.init();
+        for(unsigned i = 0; i < vins; i++){
+            dev::RLPStream vin(4);
+            vin << dev::h256(i) << 0 << dev::u256(1000) << 1;
+            trie.insert(dev::Address(i + 1), &vin.out());
+        }
+        utxo.commit();
+        return trie.root();
+    }
+
+    size_t countLeaves(dev::h256 const& root){
+        size_t leaves = 0;
+        StateDiff(state).diff(dev::sha3(dev::rlp("")), root, [&](AccountDiff const&){
+            leaves++;
+            return true;
+        }, [&](AccountDiff const&, StorageDiff const&){
+            leaves++;
+            return true;
+        });
+        return leaves;
+    }
+};
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(statepruner_tests, statePrunerTest::PrunerSetup)
+
+BOOST_AUTO_TEST_CASE(statepruner_removes_unreachable_nodes){
+    dev::h256 rootOld = commitState(200, 1);
+    dev::h256 rootNew = commitState(200, 2);
+    dev::h256 utxoOld = commitUTXO(50);
+    dev::h256 utxoNew = commitUTXO(60);
+    BOOST_CHECK(rootOld != rootNew);
+    BOOST_CHECK(countLeaves(rootOld) == 201);
+
+    StatePruner pruner(*rawState, *rawUTXO, DEFAULT_STATE_KEEP_BLOCKS);
+    pruner.markState(rootNew);
+    pruner.markUTXO(utxoNew);
+    BOOST_CHECK(pruner.collect() > 0);
+    BOOST_CHECK(pruner.sweep(std::numeric_limits<size_t>::max()) > 0);
+    BOOST_CHECK(!pruner.pending());
+    BOOST_CHECK(pruner.getBytesReclaimed() > 0);
+
+    // The retained state is complete, the old roots are gone
+    BOOST_CHECK(countLeaves(rootNew) == 201);
+    BOOST_CHECK(state.lookup(rootOld).empty());
+    BOOST_CHECK(!state.lookup(dev::sha3(code)).empty());
+    BOOST_CHECK(utxo.lookup(utxoOld).empty());
+    BOOST_CHECK(AccountTrie(&utxo, utxoNew).at(dev::Address(60)).size());
+
+    // Preimages are not trie nodes and survive
+    BOOST_CHECK(state.lookupAux(dev::sha3(dev::h256(1))) == dev::h256(1).asBytes());
+
+    // A second pass has nothing left to do
+    uint64_t removed = pruner.getNodesRemoved();
+    pruner.clear();
+    pruner.markState(rootNew);
+    pruner.markUTXO(utxoNew);
+    BOOST_CHECK(pruner.collect() == 0);
+    BOOST_CHECK(pruner.sweep() == 0);
+    BOOST_CHECK(pruner.getNodesRemoved() == removed);
+}
+
+BOOST_AUTO_TEST_CASE(statepruner_keeps_nodes_marked_after_collect){
+    dev::h256 root = commitState(100, 1);
+    dev::h256 utxoRoot = commitUTXO(10);
+
+    // Nothing is marked at scan time, as if the roots were committed by a block connected during the scan
+    StatePruner pruner(*rawState, *rawUTXO, DEFAULT_STATE_KEEP_BLOCKS);
+    BOOST_CHECK(pruner.collect() > 0);
+    pruner.markState(root);
+    pruner.markUTXO(utxoRoot);
+    while(pruner.pending()){
+        pruner.sweep(10);
+    }
+    BOOST_CHECK(pruner.getNodesRemoved() == 0);
+    BOOST_CHECK(countLeaves(root) == 101);
+}
+
+BOOST_AUTO_TEST_CASE(statepruner_stops_marking_at_max_live){
+    dev::h256 rootOld = commitState(100, 1);
+    dev::h256 root = commitState(100, 2);
+    dev::h256 utxoRoot = commitUTXO(10);
+
+    // Marking stops once the bound is reached, the incomplete marks must not be swept
+    StatePruner pruner(*rawState, *rawUTXO, DEFAULT_STATE_KEEP_BLOCKS, 10);
+    pruner.markState(root);
+    pruner.markUTXO(utxoRoot);
+    BOOST_CHECK(pruner.overflowed());
+    BOOST_CHECK(pruner.liveNodes() <= 10);
+    BOOST_CHECK(pruner.collect() > 0);
+    BOOST_CHECK(pruner.sweep(std::numeric_limits<size_t>::max()) == 0);
+    BOOST_CHECK(!pruner.pending());
+    BOOST_CHECK(pruner.getNodesRemoved() == 0);
+    BOOST_CHECK(countLeaves(rootOld) == 101);
+    BOOST_CHECK(countLeaves(root) == 101);
+
+    pruner.clear();
+    BOOST_CHECK(!pruner.overflowed());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
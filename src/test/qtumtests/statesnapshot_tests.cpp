@@ -0,0 +1,191 @@
+#include <boost/test/unit_test.hpp>
+#include <qtumtests/test_utils.h>
+#include <clientversion.h>
+#include <qtum/statediff.h>
+#include <qtum/statesnapshot.h>
+
+namespace stateSnapshotTest{
+
+typedef dev::eth::SecureTrieDB<dev::h256, dev::OverlayDB> StorageTrie;
+typedef dev::eth::SecureTrieDB<dev::Address, dev::OverlayDB> AccountTrie;
+
+const dev::bytes code = ParseHex("6060604052600080fd");
+
+struct Databases{
+    dev::db::DatabaseFace* rawState = nullptr;
+    dev::db::DatabaseFace* rawUTXO = nullptr;
+    dev::OverlayDB state;
+    dev::OverlayDB utxo;
+
+    Databases(std::string const& name){
+        const dev::h256 hashDB(dev::sha3(dev::rlp("")));
+        state = QtumState::openDB((GetDataDir() / name / "state").string(), hashDB, dev::WithExisting::Trust, rawState);
+        utxo = QtumState::openDB((GetDataDir() / name / "utxo").string(), hashDB, dev::WithExisting::Trust, rawUTXO);
+    }
+
+    size_t countLeaves(dev::h256 const& root){
+        size_t leaves = 0;
+        StateDiff(state).diff(dev::sha3(dev::rlp("")), root, [&](AccountDiff const& account){
+            BOOST_CHECK(account.address != dev::Address());
+            leaves++;
+            return true;
+        }, [&](AccountDiff const&, StorageDiff const& storage){
+            BOOST_CHECK(storage.hasSlot);
+            leaves++;
+            return true;
+        });
+        return leaves;
+    }
+};
+
+StateSnapshotHeader buildState(Databases& dbs){
+    AccountTrie accounts(&dbs.state);
+    accounts.init();
+    for(unsigned n = 1; n <= 10; n++){
+        StorageTrie storage(&dbs.state);
+        storage.init();
+        for(unsigned i = 0; i < 20; i++){
+            storage.insert(dev::h256(i), dev::rlp(dev::u256(i * n + 1)));
+        }
+        dbs.state.insert(dev::sha3(code), &code);
+        dev::RLPStream account(4);
+        account << dev::u256(1) << dev::u256(n) << storage.root() << dev::sha3(code);
+        accounts.insert(dev::Address(n), &account.out());
+    }
+    dbs.state.commit();
+
+    AccountTrie vins(&dbs.utxo);
+    vins.init();
+    for(unsigned n = 1; n <= 10; n++){
+        dev::RLPStream vin(4);
+        vin << dev::h256(n) << 0 << dev::u256(n) << 1;
+        vins.insert(dev::Address(n), &vin.out());
+    }
+    dbs.utxo.commit();
+
+    StateSnapshotHeader header;
+    header.hashBlock = uint256S("01");
+    header.nHeight = 1;
+    header.hashStateRoot = h256Touint(accounts.root());
+    header.hashUTXORoot = h256Touint(vins.root());
+    return header;
+}
+
+fs::path writeSnapshot(Databases& dbs, StateSnapshotHeader const& header, StateSnapshotStats& stats, std::string const& name = "snapshot.dat"){
+    fs::path path = GetDataDir() / name;
+    CAutoFile file(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+    stats = WriteStateSnapshot(file, header, *dbs.rawState, *dbs.rawUTXO);
+    return path;
+}
+
+/** Whether the state at the header roots is complete, the snapshot writer walks all of it */
+bool hasState(Databases& dbs, StateSnapshotHeader const& header){
+    StateSnapshotStats stats;
+    try{
+        writeSnapshot(dbs, header, stats, "check.dat");
+    }catch(const std::runtime_error&){
+        return false;
+    }
+    return true;
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(statesnapshot_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(statesnapshot_roundtrip){
+    stateSnapshotTest::Databases source("source");
+    StateSnapshotHeader header = stateSnapshotTest::buildState(source);
+    StateSnapshotStats written;
+    fs::path path = stateSnapshotTest::writeSnapshot(source, header, written);
+    BOOST_CHECK(written.nNodes > 0);
+    BOOST_CHECK(written.nPreimages >= 40);
+
+    stateSnapshotTest::Databases target("target");
+    BOOST_CHECK(!stateSnapshotTest::hasState(target, header));
+
+    BOOST_CHECK(!HaveStateSnapshotRoots(header, *target.rawState, *target.rawUTXO));
+    BOOST_CHECK(!VerifyStateSnapshot(header, *target.rawState, *target.rawUTXO));
+
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    StateSnapshotHeader read = ReadStateSnapshotHeader(file);
+    BOOST_CHECK(read.hashBlock == header.hashBlock);
+    BOOST_CHECK(read.hashStateRoot == header.hashStateRoot);
+    BOOST_CHECK(read.hashUTXORoot == header.hashUTXORoot);
+    StateSnapshotStats loaded = LoadStateSnapshot(file, read, *target.rawState, *target.rawUTXO);
+    BOOST_CHECK(loaded.nNodes == written.nNodes);
+    BOOST_CHECK(loaded.nPreimages == written.nPreimages);
+    BOOST_CHECK(loaded.nChunks == written.nChunks);
+    BOOST_CHECK(loaded.nBytes == written.nBytes);
+
+    BOOST_CHECK(HaveStateSnapshotRoots(header, *target.rawState, *target.rawUTXO));
+    BOOST_CHECK(VerifyStateSnapshot(header, *target.rawState, *target.rawUTXO));
+    BOOST_CHECK(stateSnapshotTest::hasState(target, header));
+    BOOST_CHECK(target.countLeaves(uintToh256(header.hashStateRoot)) == 210);
+    BOOST_CHECK(stateSnapshotTest::AccountTrie(&target.utxo, uintToh256(header.hashUTXORoot)).at(dev::Address(10)).size());
+}
+
+BOOST_AUTO_TEST_CASE(statesnapshot_rejects_corruption){
+    stateSnapshotTest::Databases source("source");
+    StateSnapshotHeader header = stateSnapshotTest::buildState(source);
+    StateSnapshotStats written;
+    fs::path path = stateSnapshotTest::writeSnapshot(source, header, written);
+
+    // Flip a byte in the middle of the chunks
+    {
+        FILE* file = fsbridge::fopen(path, "r+b");
+        fseek(file, fs::file_size(path) / 2, SEEK_SET);
+        int c = fgetc(file);
+        fseek(file, -1, SEEK_CUR);
+        fputc(c ^ 0xff, file);
+        fclose(file);
+    }
+
+    stateSnapshotTest::Databases target("target");
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    StateSnapshotHeader read = ReadStateSnapshotHeader(file);
+    BOOST_CHECK_THROW(LoadStateSnapshot(file, read, *target.rawState, *target.rawUTXO), std::runtime_error);
+    BOOST_CHECK(!VerifyStateSnapshot(header, *target.rawState, *target.rawUTXO));
+}
+
+BOOST_AUTO_TEST_CASE(statesnapshot_rejects_other_roots){
+    stateSnapshotTest::Databases source("source");
+    StateSnapshotHeader header = stateSnapshotTest::buildState(source);
+    StateSnapshotStats written;
+    fs::path path = stateSnapshotTest::writeSnapshot(source, header, written);
+
+    // A snapshot that does not hold the state at the roots it is loaded for is incomplete
+    stateSnapshotTest::Databases target("target");
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    StateSnapshotHeader read = ReadStateSnapshotHeader(file);
+    read.hashStateRoot = uint256S("02");
+    BOOST_CHECK_THROW(LoadStateSnapshot(file, read, *target.rawState, *target.rawUTXO), std::runtime_error);
+
+    // The nodes it did hold are stored under their own hashes and are still usable
+    BOOST_CHECK(VerifyStateSnapshot(header, *target.rawState, *target.rawUTXO));
+}
+
+BOOST_AUTO_TEST_CASE(statesnapshot_rejects_truncation){
+    stateSnapshotTest::Databases source("source");
+    StateSnapshotHeader header = stateSnapshotTest::buildState(source);
+    StateSnapshotStats written;
+    fs::path path = stateSnapshotTest::writeSnapshot(source, header, written);
+    fs::resize_file(path, fs::file_size(path) - 1);
+
+    stateSnapshotTest::Databases target("target");
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    StateSnapshotHeader read = ReadStateSnapshotHeader(file);
+    BOOST_CHECK_THROW(LoadStateSnapshot(file, read, *target.rawState, *target.rawUTXO), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(statesnapshot_missing_node){
+    stateSnapshotTest::Databases source("source");
+    StateSnapshotHeader header = stateSnapshotTest::buildState(source);
+    dev::h256 root = uintToh256(header.hashStateRoot);
+    source.rawState->kill(dev::db::Slice(reinterpret_cast<char const*>(root.data()), root.size));
+
+    StateSnapshotStats written;
+    BOOST_CHECK_THROW(stateSnapshotTest::writeSnapshot(source, header, written), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,128 @@
+#include <boost/test/unit_test.hpp>
+#include <qtumtests/test_utils.h>
+#include <clientversion.h>
+#include <crypto/common.h>
+#include <qtum/vmtracewriter.h>
+#include <streams.h>
+
+namespace vmTraceWriterTest{
+
+VMTraceRecord makeRecord(int nHeight, unsigned n){
+    VMTraceRecord record;
+    record.txid = uint256S(std::to_string(n + 1));
+    record.nHeight = nHeight;
+    record.nTime = 1500000000 + n;
+    VMTraceLog log;
+    log.topics.push_back(uint256S("ff"));
+    log.data = std::vector<unsigned char>(100, n);
+    record.entries.push_back(log);
+    return record;
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(vmtracewriter_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(vmtracewriter_segments){
+    fs::path dir = GetDataDir() / "vmtrace";
+    {
+        // Two records for each of 200 heights, 255 bytes each and 1000 bytes a segment
+        VMTraceWriter writer(dir, 1000, 0, 5);
+        for(unsigned n = 0; n < 400; n++){
+            writer.push(vmTraceWriterTest::makeRecord(n / 2, n));
+        }
+        writer.flush();
+        BOOST_CHECK(writer.getSegment() > 40);
+
+        std::vector<VMTraceRecord> records;
+        for(uint32_t segment = 0; segment <= writer.getSegment(); segment++){
+            std::vector<VMTraceRecord> read = ReadVMTraceSegment(writer.segmentPath(segment));
+            BOOST_CHECK(!read.empty());
+            records.insert(records.end(), read.begin(), read.end());
+        }
+        BOOST_CHECK(records.size() == 400);
+        BOOST_CHECK(records[123].txid == uint256S("124"));
+        BOOST_CHECK(records[123].nHeight == 61);
+        BOOST_CHECK(records[123].entries[0].topics[0] == uint256S("ff"));
+        BOOST_CHECK(records[123].entries[0].data == std::vector<unsigned char>(100, 123));
+
+        // The index leads to the first record of a height
+        uint32_t nSegment = 0, nOffset = 0;
+        BOOST_CHECK(writer.findHeight(150, nSegment, nOffset));
+        FILE* file = fsbridge::fopen(writer.segmentPath(nSegment), "rb");
+        fseek(file, nOffset + 4, SEEK_SET);
+        VMTraceRecord record;
+        CAutoFile(file, SER_DISK, CLIENT_VERSION) >> record;
+        BOOST_CHECK(record.nHeight == 150);
+        BOOST_CHECK(record.txid == uint256S("301"));
+        BOOST_CHECK(!writer.findHeight(200, nSegment, nOffset));
+    }
+
+    // A restart appends to the last segment and rotates out the old ones
+    VMTraceWriter writer(dir, 1000, 3);
+    uint32_t nLast = writer.getSegment();
+    for(unsigned n = 400; n < 440; n++){
+        writer.push(vmTraceWriterTest::makeRecord(n / 2, n));
+    }
+    writer.flush();
+    BOOST_CHECK(writer.getSegment() > nLast);
+    BOOST_CHECK(fs::exists(writer.segmentPath(writer.getSegment() - 2)));
+    BOOST_CHECK(!fs::exists(writer.segmentPath(writer.getSegment() - 3)));
+    uint32_t nSegment = 0, nOffset = 0;
+    BOOST_CHECK(writer.findHeight(0, nSegment, nOffset));
+    BOOST_CHECK(nSegment == writer.getSegment() - 2);
+}
+
+BOOST_AUTO_TEST_CASE(vmtracewriter_resume){
+    fs::path dir = GetDataDir() / "vmtrace";
+    {
+        VMTraceWriter writer(dir, 1 << 20, 0);
+        for(unsigned n = 0; n < 10; n++){
+            writer.push(vmTraceWriterTest::makeRecord(n, n));
+        }
+    }
+
+    // A run stopped in the middle of a record and of an index entry
+    FILE* file = fsbridge::fopen(dir / "vmtrace00000.dat", "ab");
+    unsigned char partial[14] = {};
+    WriteLE32(partial, 300);
+    fwrite(partial, 1, sizeof(partial), file);
+    fclose(file);
+    file = fsbridge::fopen(dir / "index.dat", "ab");
+    fwrite(partial, 1, 5, file);
+    fclose(file);
+
+    // The next run appends after the last complete record
+    {
+        VMTraceWriter writer(dir, 1 << 20, 0);
+        BOOST_CHECK(writer.getSegment() == 0);
+        writer.push(vmTraceWriterTest::makeRecord(10, 10));
+        writer.flush();
+        std::vector<VMTraceRecord> records = ReadVMTraceSegment(writer.segmentPath(0));
+        BOOST_CHECK(records.size() == 11);
+        BOOST_CHECK(records.back().txid == uint256S("11"));
+        BOOST_CHECK(fs::file_size(dir / "index.dat") == 11 * 12);
+        uint32_t nSegment = 0, nOffset = 0;
+        BOOST_CHECK(writer.findHeight(10, nSegment, nOffset));
+        file = fsbridge::fopen(writer.segmentPath(nSegment), "rb");
+        fseek(file, nOffset + 4, SEEK_SET);
+        VMTraceRecord record;
+        CAutoFile(file, SER_DISK, CLIENT_VERSION) >> record;
+        BOOST_CHECK(record.txid == uint256S("11"));
+    }
+
+    // Segment numbers past 5 digits are parsed as numbers, other names are ignored
+    file = fsbridge::fopen(dir / "vmtrace100000.dat", "ab");
+    fclose(file);
+    for(const char* name : {"vmtrace.dat", "vmtrace1x.dat", "vmtrace99999.dat.old"}){
+        file = fsbridge::fopen(dir / name, "ab");
+        fclose(file);
+    }
+    VMTraceWriter writer(dir, 1 << 20, 0);
+    BOOST_CHECK(writer.getSegment() == 100000);
+    writer.push(vmTraceWriterTest::makeRecord(11, 11));
+    writer.flush();
+    BOOST_CHECK(ReadVMTraceSegment(writer.segmentPath(100000)).size() == 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
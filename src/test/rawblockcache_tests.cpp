@@ -0,0 +1,88 @@
+// Copyright (c) 2020 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rawblockcache.h>
+#include <streams.h>
+#include <test/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+namespace rawBlockCacheTest{
+
+std::vector<unsigned char> serialize(const CBlock& block){
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
+    return std::vector<unsigned char>(ss.begin(), ss.end());
+}
+
+CBlock block(bool fWitness){
+    CBlock block;
+    block.nNonce = 1;
+    block.vchBlockSig = std::vector<unsigned char>(72, 0x30);
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vin[0].scriptSig = CScript() << OP_1 << OP_1;
+    coinbase.vout.resize(2);
+    coinbase.vout[0].SetEmpty();
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+    CMutableTransaction tx;
+    tx.vin.resize(2);
+    tx.vin[0].prevout = COutPoint(uint256S("01"), 0);
+    tx.vin[1].prevout = COutPoint(uint256S("02"), 1);
+    if(fWitness)
+        tx.vin[1].scriptWitness.stack.push_back(std::vector<unsigned char>(33, 0x02));
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 10;
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    block.vtx.push_back(MakeTransactionRef(tx));
+    return block;
+}
+
+std::shared_ptr<const RawBlock> raw(size_t nSize){
+    std::shared_ptr<RawBlock> raw = std::make_shared<RawBlock>();
+    raw->data.resize(nSize);
+    return raw;
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(rawblockcache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(rawblockcache_witness){
+    BOOST_CHECK(!RawBlockHasWitness(rawBlockCacheTest::serialize(rawBlockCacheTest::block(false))));
+    BOOST_CHECK(RawBlockHasWitness(rawBlockCacheTest::serialize(rawBlockCacheTest::block(true))));
+
+    // A block that does not parse is never sent as is
+    std::vector<unsigned char> data = rawBlockCacheTest::serialize(rawBlockCacheTest::block(false));
+    data.pop_back();
+    BOOST_CHECK(RawBlockHasWitness(data));
+    data.resize(data.size() + 2);
+    BOOST_CHECK(RawBlockHasWitness(data));
+}
+
+BOOST_AUTO_TEST_CASE(rawblockcache_lru){
+    RawBlockCache cache(1000);
+    cache.insert(uint256S("01"), rawBlockCacheTest::raw(400));
+    cache.insert(uint256S("02"), rawBlockCacheTest::raw(400));
+    BOOST_CHECK_EQUAL(cache.bytes(), 800U);
+
+    // The least recently used block is dropped for the new one
+    BOOST_CHECK(cache.get(uint256S("01")));
+    cache.insert(uint256S("03"), rawBlockCacheTest::raw(400));
+    BOOST_CHECK_EQUAL(cache.size(), 2U);
+    BOOST_CHECK(cache.get(uint256S("01")));
+    BOOST_CHECK(!cache.get(uint256S("02")));
+    BOOST_CHECK(cache.get(uint256S("03")));
+    BOOST_CHECK_EQUAL(cache.bytes(), 800U);
+    BOOST_CHECK_EQUAL(cache.hits(), 3U);
+    BOOST_CHECK_EQUAL(cache.misses(), 1U);
+
+    // A block larger than the cache is not kept
+    cache.insert(uint256S("04"), rawBlockCacheTest::raw(1001));
+    BOOST_CHECK(!cache.get(uint256S("04")));
+    BOOST_CHECK_EQUAL(cache.size(), 2U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
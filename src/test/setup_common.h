@@ -105,10 +105,14 @@ struct TestMemPoolEntryHelper
     bool spendsCoinbase;
     unsigned int sigOpCost;
     LockPoints lp;
+    CAmount nMinGasPrice;
+    uint64_t nGasLimit;
+    uint64_t nBlockGasLimit;
 
     TestMemPoolEntryHelper() :
         nFee(0), nTime(0), nHeight(1),
-        spendsCoinbase(false), sigOpCost(4) { }
+        spendsCoinbase(false), sigOpCost(4),
+        nMinGasPrice(0), nGasLimit(0), nBlockGasLimit(0) { }
 
     CTxMemPoolEntry FromTx(const CMutableTransaction& tx);
     CTxMemPoolEntry FromTx(const CTransactionRef& tx);
@@ -119,6 +123,8 @@ struct TestMemPoolEntryHelper
     TestMemPoolEntryHelper &Height(unsigned int _height) { nHeight = _height; return *this; }
     TestMemPoolEntryHelper &SpendsCoinbase(bool _flag) { spendsCoinbase = _flag; return *this; }
     TestMemPoolEntryHelper &SigOpsCost(unsigned int _sigopsCost) { sigOpCost = _sigopsCost; return *this; }
+    TestMemPoolEntryHelper &MinGasPrice(CAmount _minGasPrice) { nMinGasPrice = _minGasPrice; return *this; }
+    TestMemPoolEntryHelper &GasLimit(uint64_t _gasLimit, uint64_t _blockGasLimit) { nGasLimit = _gasLimit; nBlockGasLimit = _blockGasLimit; return *this; }
 };
 
 CBlock getBlock13b8a();
@@ -0,0 +1,113 @@
+// Copyright (c) 2020 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <utxoprefetch.h>
+#include <test/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+namespace utxoPrefetchTest{
+
+COutPoint outpoint(uint32_t n){
+    return COutPoint(uint256S("01"), n);
+}
+
+Coin coin(CAmount nValue){
+    return Coin(CTxOut(nValue, CScript() << OP_TRUE), 1, false, false);
+}
+
+// Counts the reads that reach the database
+class CountingView : public CCoinsViewCache{
+public:
+    mutable int reads = 0;
+    explicit CountingView(CCoinsView* baseIn) : CCoinsViewCache(baseIn) {}
+    bool GetCoin(const COutPoint& outpoint, Coin& coin) const override {
+        reads++;
+        return CCoinsViewCache::GetCoin(outpoint, coin);
+    }
+};
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(utxoprefetch_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(utxoprefetch_staging){
+    CCoinsView viewDummy;
+    utxoPrefetchTest::CountingView db(&viewDummy);
+    db.AddCoin(utxoPrefetchTest::outpoint(0), utxoPrefetchTest::coin(10), false);
+    CCoinsViewPrefetch prefetch(&db);
+    CCoinsViewCache tip(&prefetch);
+
+    prefetch.prefetch({utxoPrefetchTest::outpoint(0), utxoPrefetchTest::outpoint(1)});
+    BOOST_CHECK_EQUAL(prefetch.readQueued(10), 2U);
+    BOOST_CHECK_EQUAL(prefetch.stagedCount(), 2U);
+    BOOST_CHECK_EQUAL(db.reads, 2);
+
+    // Connect time lookups are served by the staging layer and hand the coins over to the tip
+    BOOST_CHECK(tip.AccessCoin(utxoPrefetchTest::outpoint(0)).out.nValue == 10);
+    BOOST_CHECK(!tip.HaveCoin(utxoPrefetchTest::outpoint(1)));
+    BOOST_CHECK_EQUAL(db.reads, 2);
+    BOOST_CHECK_EQUAL(prefetch.stagedCount(), 0U);
+
+    // A write drops what is staged
+    prefetch.prefetch({utxoPrefetchTest::outpoint(0)});
+    BOOST_CHECK_EQUAL(prefetch.readQueued(10), 1U);
+    BOOST_CHECK(tip.SpendCoin(utxoPrefetchTest::outpoint(0)));
+    BOOST_CHECK(tip.Flush());
+    BOOST_CHECK_EQUAL(prefetch.stagedCount(), 0U);
+    BOOST_CHECK(!tip.HaveCoin(utxoPrefetchTest::outpoint(0)));
+}
+
+BOOST_AUTO_TEST_CASE(utxoprefetch_limits){
+    CCoinsView viewDummy;
+    utxoPrefetchTest::CountingView db(&viewDummy);
+    CCoinsViewPrefetch prefetch(&db, 4);
+
+    // The queue and the staged coins stay below the limit, the oldest coins are evicted
+    std::vector<COutPoint> outpoints;
+    for(uint32_t n = 0; n < 10; n++){
+        outpoints.push_back(utxoPrefetchTest::outpoint(n));
+    }
+    prefetch.prefetch(outpoints);
+    BOOST_CHECK_EQUAL(prefetch.readQueued(10), 4U);
+    BOOST_CHECK_EQUAL(prefetch.stagedCount(), 4U);
+    prefetch.prefetch({utxoPrefetchTest::outpoint(20)});
+    BOOST_CHECK_EQUAL(prefetch.readQueued(10), 0U);
+    BOOST_CHECK_EQUAL(prefetch.stagedCount(), 4U);
+
+    Coin coin;
+    BOOST_CHECK(!prefetch.GetCoin(utxoPrefetchTest::outpoint(3), coin));
+    prefetch.prefetch({utxoPrefetchTest::outpoint(20), utxoPrefetchTest::outpoint(21)});
+    BOOST_CHECK_EQUAL(prefetch.readQueued(10), 1U);
+    BOOST_CHECK_EQUAL(prefetch.stagedCount(), 4U);
+}
+
+BOOST_AUTO_TEST_CASE(utxoprefetch_block){
+    CCoinsView viewDummy;
+    utxoPrefetchTest::CountingView db(&viewDummy);
+    CCoinsViewPrefetch prefetch(&db);
+    CCoinsViewCache tip(&prefetch);
+    tip.AddCoin(utxoPrefetchTest::outpoint(5), utxoPrefetchTest::coin(5), false);
+
+    CBlock block;
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+    CMutableTransaction spend;
+    spend.vin.push_back(CTxIn(utxoPrefetchTest::outpoint(0)));
+    spend.vin.push_back(CTxIn(utxoPrefetchTest::outpoint(5)));
+    spend.vout.push_back(CTxOut(1, CScript() << OP_TRUE));
+    block.vtx.push_back(MakeTransactionRef(spend));
+    CMutableTransaction child;
+    child.vin.push_back(CTxIn(COutPoint(block.vtx[1]->GetHash(), 0)));
+    block.vtx.push_back(MakeTransactionRef(child));
+
+    // Only the coin neither created by the block nor in the tip is read
+    prefetch.prefetchBlock(block, tip);
+    BOOST_CHECK_EQUAL(prefetch.readQueued(10), 1U);
+    BOOST_CHECK_EQUAL(db.reads, 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
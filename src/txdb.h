@@ -104,6 +104,10 @@ public:
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
 
+    //! Write the coins of a transition to hashBlock, which may take several calls. The
+    //! database stays marked as in transition until the call with fFinal set.
+    bool WriteCoins(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fFinal);
+
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
@@ -23,10 +23,11 @@
 
 CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& _tx, const CAmount& _nFee,
                                  int64_t _nTime, unsigned int _entryHeight,
-                                 bool _spendsCoinbase, int64_t _sigOpsCost, LockPoints lp, CAmount _nMinGasPrice)
+                                 bool _spendsCoinbase, int64_t _sigOpsCost, LockPoints lp, CAmount _nMinGasPrice,
+                                 uint64_t _nGasLimit, uint64_t _nBlockGasLimit)
     : tx(_tx), nFee(_nFee), nTxWeight(GetTransactionWeight(*tx)), nUsageSize(RecursiveDynamicUsage(tx)), nTime(_nTime), entryHeight(_entryHeight),
     spendsCoinbase(_spendsCoinbase), sigOpCost(_sigOpsCost), lockPoints(lp),
-    nMinGasPrice(_nMinGasPrice)
+    nMinGasPrice(_nMinGasPrice), nGasLimit(_nGasLimit), nBlockGasLimit(_nBlockGasLimit), nEstimatedGas(0), nGasRefund(0), fPreExecFailed(false)
 {
     nCountWithDescendants = 1;
     nSizeWithDescendants = GetTxSize();
@@ -52,6 +53,25 @@ void CTxMemPoolEntry::UpdateLockPoints(const LockPoints& lp)
     lockPoints = lp;
 }
 
+void CTxMemPoolEntry::UpdatePreExecution(const uint256& hashBlock, uint64_t estimatedGas, CAmount gasRefund, bool failed)
+{
+    hashPreExecBlock = hashBlock;
+    nEstimatedGas = estimatedGas;
+    nGasRefund = gasRefund;
+    fPreExecFailed = failed;
+}
+
+CAmount CTxMemPoolEntry::GetGasPriceScore() const
+{
+    // Before the pre-execution the whole gas limit is assumed to be used and nothing refunded
+    if(hashPreExecBlock.IsNull() || fPreExecFailed || nEstimatedGas == 0){
+        if(nGasLimit == 0)
+            return nMinGasPrice;
+        return GetModifiedFee() / (CAmount)nGasLimit;
+    }
+    return std::max<CAmount>(GetModifiedFee() - nGasRefund, 0) / (CAmount)nEstimatedGas;
+}
+
 size_t CTxMemPoolEntry::GetTxSize() const
 {
     return GetVirtualTransactionSize(nTxWeight, sigOpCost);
@@ -799,6 +819,20 @@ std::vector<TxMempoolInfo> CTxMemPool::infoAll() const
     return ret;
 }
 
+std::vector<CTxMemPoolEntry> CTxMemPool::entryAll() const
+{
+    LOCK(cs);
+    auto iters = GetSortedDepthAndScore();
+
+    std::vector<CTxMemPoolEntry> ret;
+    ret.reserve(mapTx.size());
+    for (auto it : iters) {
+        ret.push_back(*it);
+    }
+
+    return ret;
+}
+
 CTransactionRef CTxMemPool::get(const uint256& hash) const
 {
     LOCK(cs);
@@ -817,6 +851,30 @@ TxMempoolInfo CTxMemPool::info(const uint256& hash) const
     return GetInfo(i);
 }
 
+void CTxMemPool::UpdatePreExecution(txiter it, const uint256& hashBlock, uint64_t estimatedGas, CAmount gasRefund, bool failed)
+{
+    AssertLockHeld(cs);
+    mapTx.modify(it, update_pre_execution(hashBlock, estimatedGas, gasRefund, failed));
+}
+
+void CTxMemPool::ClearPreExecFailures(const uint256& hashTip)
+{
+    LOCK(cs);
+    // Contract txs sort after all other txs and the failed ones go last among them
+    std::vector<txiter> failed;
+    auto& index = mapTx.get<ancestor_score_or_gas_price>();
+    for(auto mi = index.end(); mi != index.begin() && std::prev(mi)->GetTx().HasCreateOrCall(); --mi){
+        const CTxMemPoolEntry& entry = *std::prev(mi);
+        if(entry.PreExecFailed() && entry.GetPreExecBlock() != hashTip)
+            failed.push_back(mapTx.project<0>(std::prev(mi)));
+    }
+    for(txiter it : failed){
+        // update_pre_execution keeps a reference, copy the hash out of the entry it modifies
+        const uint256 hashBlock = it->GetPreExecBlock();
+        mapTx.modify(it, update_pre_execution(hashBlock, it->GetEstimatedGas(), it->GetGasRefund(), false));
+    }
+}
+
 void CTxMemPool::PrioritiseTransaction(const uint256& hash, const CAmount& nFeeDelta)
 {
     {
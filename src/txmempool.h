@@ -11,6 +11,7 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -163,6 +164,12 @@ private:
     int64_t feeDelta;          //!< Used for determining the priority of the transaction for mining in a block
     LockPoints lockPoints;     //!< Track the height and time at which tx was final
     CAmount nMinGasPrice;      //!< The minimum gas price among the contract outputs of the tx
+    uint64_t nGasLimit;        //!< ... and their total gas limit
+    uint64_t nBlockGasLimit;   //!< Block gas limit of the chain tip when entering the mempool
+    uint256 hashPreExecBlock;  //!< Block the contract outputs were last pre-executed on top of, null if never
+    uint64_t nEstimatedGas;    //!< Gas used by the contract outputs in that pre-execution
+    CAmount nGasRefund;        //!< ... and the amount refunded to the sender for unused gas
+    bool fPreExecFailed;       //!< ... and whether the block assembler would reject the tx
 
     // Information about descendants of this transaction that are in the
     // mempool; if we remove this transaction we must remove all of these
@@ -181,7 +188,8 @@ public:
     CTxMemPoolEntry(const CTransactionRef& _tx, const CAmount& _nFee,
                     int64_t _nTime, unsigned int _entryHeight,
                     bool spendsCoinbase,
-                    int64_t nSigOpsCost, LockPoints lp, CAmount _nMinGasPrice = 0);
+                    int64_t nSigOpsCost, LockPoints lp, CAmount _nMinGasPrice = 0,
+                    uint64_t _nGasLimit = 0, uint64_t _nBlockGasLimit = 0);
 
     const CTransaction& GetTx() const { return *this->tx; }
     CTransactionRef GetSharedTx() const { return this->tx; }
@@ -195,6 +203,19 @@ public:
     size_t DynamicMemoryUsage() const { return nUsageSize; }
     const LockPoints& GetLockPoints() const { return lockPoints; }
     const CAmount& GetMinGasPrice() const { return nMinGasPrice; }
+    uint64_t GetGasLimit() const { return nGasLimit; }
+    uint64_t GetBlockGasLimit() const { return nBlockGasLimit; }
+    const uint256& GetPreExecBlock() const { return hashPreExecBlock; }
+    uint64_t GetEstimatedGas() const { return nEstimatedGas; }
+    CAmount GetGasRefund() const { return nGasRefund; }
+    // Only set for the current tip, CTxMemPool::ClearPreExecFailures drops the failures of older tips
+    bool PreExecFailed() const { return fPreExecFailed; }
+    // The pre-execution on top of hashTip showed the tx cannot go into the next block
+    bool PreExecFailed(const uint256& hashTip) const { return fPreExecFailed && hashPreExecBlock == hashTip; }
+    // The gas price used to order contract txs: the fee kept by the staker per unit of gas. Once the tx
+    // was pre-executed that is the modified fee minus the gas refund per unit of gas used, before that
+    // the modified fee per unit of the gas limit. The minimum gas price of its outputs without a gas limit
+    CAmount GetGasPriceScore() const;
 
     // Adjusts the descendant state.
     void UpdateDescendantState(int64_t modifySize, CAmount modifyFee, int64_t modifyCount);
@@ -205,6 +226,8 @@ public:
     void UpdateFeeDelta(int64_t feeDelta);
     // Update the LockPoints after a reorg
     void UpdateLockPoints(const LockPoints& lp);
+    // Update the result of pre-executing the contract outputs on top of a block
+    void UpdatePreExecution(const uint256& hashBlock, uint64_t estimatedGas, CAmount gasRefund, bool failed);
 
     uint64_t GetCountWithDescendants() const { return nCountWithDescendants; }
     uint64_t GetSizeWithDescendants() const { return nSizeWithDescendants; }
@@ -262,6 +285,21 @@ private:
     int64_t feeDelta;
 };
 
+struct update_pre_execution
+{
+    update_pre_execution(const uint256& _hashBlock, uint64_t _estimatedGas, CAmount _gasRefund, bool _failed) :
+        hashBlock(_hashBlock), estimatedGas(_estimatedGas), gasRefund(_gasRefund), failed(_failed)
+    {}
+
+    void operator() (CTxMemPoolEntry &e) { e.UpdatePreExecution(hashBlock, estimatedGas, gasRefund, failed); }
+
+private:
+    const uint256& hashBlock;
+    uint64_t estimatedGas;
+    CAmount gasRefund;
+    bool failed;
+};
+
 struct update_lock_points
 {
     explicit update_lock_points(const LockPoints& _lp) : lp(_lp) { }
@@ -431,12 +469,19 @@ public:
                 return a.GetCountWithAncestors() < b.GetCountWithAncestors();
             }
 
-            // Otherwise, prioritize the contract tx with the highest (minimum among its outputs) gas price
-            // The reason for using the gas price of the output that sets the minimum gas price is that there
-            // otherwise it may be possible to game the prioritization by setting a large gas price in one output
-            // that does no execution, while the real execution has a very low gas price
-            if(a.GetMinGasPrice() != b.GetMinGasPrice()) {
-                return a.GetMinGasPrice() > b.GetMinGasPrice();
+            // Deprioritize the contract txs that failed their pre-execution on the tip, the block assembler
+            // skips them. The flag cannot be stale, failures on older tips are cleared when the tip changes
+            if(a.PreExecFailed() != b.PreExecFailed()) {
+                return b.PreExecFailed();
+            }
+
+            // Otherwise, prioritize the contract tx with the highest gas price score
+            // That is the fee kept by the staker per unit of gas, so pre-executed txs and txs still waiting
+            // for it compare in the same unit. The reason for not using the largest gas price of the outputs
+            // is that otherwise it may be possible to game the prioritization by setting a large gas price in
+            // one output that does no execution, while the real execution has a very low gas price
+            if(a.GetGasPriceScore() != b.GetGasPriceScore()) {
+                return a.GetGasPriceScore() > b.GetGasPriceScore();
             }
 
             // Otherwise, prioritize the tx with the minimum size
@@ -683,7 +728,15 @@ private:
         setEntries children;
     };
 
-    typedef std::map<txiter, TxLinks, CompareIteratorByHash> txlinksMap;
+    //! Hashes an entry by its address. Every step of an ancestor or descendant walk looks up
+    //! the links of an entry, which a map ordered by txid does with a comparison of hashes per level.
+    struct IteratorHasher {
+        size_t operator()(const txiter &it) const {
+            return std::hash<const CTxMemPoolEntry*>()(&*it);
+        }
+    };
+
+    typedef std::unordered_map<txiter, TxLinks, IteratorHasher> txlinksMap;
     txlinksMap mapLinks;
 
 #ifdef ENABLE_BITCORE_RPC
@@ -770,6 +823,12 @@ public:
     void ApplyDelta(const uint256 hash, CAmount &nFeeDelta) const;
     void ClearPrioritisation(const uint256 hash);
 
+    /** Record the result of pre-executing the contract outputs of a tx, see contractpreexec.h */
+    void UpdatePreExecution(txiter it, const uint256& hashBlock, uint64_t estimatedGas, CAmount gasRefund, bool failed) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Forget the pre-execution failures on blocks other than hashTip. The index orders by the failure
+     *  flag alone, so it must not outlive the tip it was found on. Called whenever the tip changes. */
+    void ClearPreExecFailures(const uint256& hashTip);
+
     /** Get the transaction in the pool that spends the same prevout */
     const CTransaction* GetConflictTx(const COutPoint& prevout) const EXCLUSIVE_LOCKS_REQUIRED(cs);
 
@@ -873,6 +932,8 @@ public:
     CTransactionRef get(const uint256& hash) const;
     TxMempoolInfo info(const uint256& hash) const;
     std::vector<TxMempoolInfo> infoAll() const;
+    /** Copies of all entries, every tx after its in-mempool parents */
+    std::vector<CTxMemPoolEntry> entryAll() const;
 
     size_t DynamicMemoryUsage() const;
 
@@ -0,0 +1,158 @@
+// Copyright (c) 2020 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <utxoprefetch.h>
+#include <primitives/block.h>
+
+#include <boost/thread/thread.hpp>
+
+#include <chrono>
+#include <set>
+
+/** Outpoints read by a worker at a time */
+static const size_t PREFETCH_BATCH = 64;
+
+CCoinsViewPrefetch::CCoinsViewPrefetch(CCoinsView* viewIn, size_t _maxStaged) :
+    CCoinsViewBacked(viewIn),
+    maxStaged(_maxStaged)
+{
+}
+
+bool CCoinsViewPrefetch::GetCoin(const COutPoint& outpoint, Coin& coin) const
+{
+    {
+        LOCK(cs);
+        auto it = staged.find(outpoint);
+        if(it != staged.end()){
+            coin = std::move(it->second);
+            staged.erase(it);
+            return !coin.IsSpent();
+        }
+    }
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewPrefetch::HaveCoin(const COutPoint& outpoint) const
+{
+    {
+        LOCK(cs);
+        auto it = staged.find(outpoint);
+        if(it != staged.end())
+            return !it->second.IsSpent();
+    }
+    return base->HaveCoin(outpoint);
+}
+
+bool CCoinsViewPrefetch::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
+{
+    // The reads that overlap the write may see either version, they are dropped
+    {
+        LOCK(cs);
+        generation++;
+        staged.clear();
+        order.clear();
+    }
+    bool ret = base->BatchWrite(mapCoins, hashBlock);
+    {
+        LOCK(cs);
+        generation++;
+        staged.clear();
+        order.clear();
+    }
+    return ret;
+}
+
+void CCoinsViewPrefetch::prefetchBlock(const CBlock& block, const CCoinsViewCache& tip)
+{
+    std::set<uint256> txids;
+    for(const CTransactionRef& tx : block.vtx){
+        txids.insert(tx->GetHash());
+    }
+
+    // The stake prevout and the inputs of the contract txs are inputs like the others
+    std::vector<COutPoint> outpoints;
+    for(const CTransactionRef& tx : block.vtx){
+        if(tx->IsCoinBase())
+            continue;
+        for(const CTxIn& txin : tx->vin){
+            if(!txids.count(txin.prevout.hash) && !tip.HaveCoinInCache(txin.prevout))
+                outpoints.push_back(txin.prevout);
+        }
+    }
+    prefetch(outpoints);
+}
+
+void CCoinsViewPrefetch::prefetch(const std::vector<COutPoint>& outpoints)
+{
+    {
+        LOCK(cs);
+        for(const COutPoint& outpoint : outpoints){
+            if(queue.size() + staged.size() >= maxStaged)
+                break;
+            queue.push_back(outpoint);
+        }
+    }
+    cond.notify_all();
+}
+
+size_t CCoinsViewPrefetch::readQueued(size_t nMax)
+{
+    std::vector<COutPoint> batch;
+    uint64_t nGeneration;
+    {
+        LOCK(cs);
+        while(batch.size() < nMax && !queue.empty()){
+            if(!staged.count(queue.front()))
+                batch.push_back(queue.front());
+            queue.pop_front();
+        }
+        nGeneration = generation;
+    }
+
+    std::vector<Coin> coins(batch.size());
+    for(size_t i = 0; i < batch.size(); i++){
+        if(!base->GetCoin(batch[i], coins[i]))
+            coins[i].Clear();
+    }
+
+    LOCK(cs);
+    if(nGeneration != generation)
+        return batch.size();
+    for(size_t i = 0; i < batch.size(); i++){
+        if(staged.emplace(batch[i], std::move(coins[i])).second)
+            order.push_back(batch[i]);
+    }
+    // Coins of blocks that were never connected, or found in the tip, make way for new ones
+    while(!order.empty() && (staged.size() > maxStaged || order.size() > 2 * maxStaged)){
+        staged.erase(order.front());
+        order.pop_front();
+    }
+    return batch.size();
+}
+
+size_t CCoinsViewPrefetch::stagedCount() const
+{
+    LOCK(cs);
+    return staged.size();
+}
+
+void CCoinsViewPrefetch::ThreadPrefetch()
+{
+    nWorkers++;
+    try{
+        while(true){
+            {
+                WAIT_LOCK(cs, lock);
+                while(queue.empty()){
+                    cond.wait_for(lock, std::chrono::milliseconds(100));
+                    boost::this_thread::interruption_point();
+                }
+            }
+            readQueued(PREFETCH_BATCH);
+        }
+    }catch(...){
+        nWorkers--;
+        throw;
+    }
+}
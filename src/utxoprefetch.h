@@ -0,0 +1,78 @@
+// Copyright (c) 2020 The Metrix Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTXOPREFETCH_H
+#define BITCOIN_UTXOPREFETCH_H
+
+#include <coins.h>
+#include <sync.h>
+
+#include <atomic>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+class CBlock;
+
+/** Threads reading the coins spent by incoming blocks, 0 disables the prefetch */
+static const int DEFAULT_UTXO_PREFETCH_THREADS = 4;
+/** Max coins staged or queued for reading */
+static const size_t DEFAULT_UTXO_PREFETCH_MAX_STAGED = 100000;
+
+/**
+ * Staging layer between the coins tip and the database. The coins spent by a block are
+ * queued as soon as the block is received, read from the database by worker threads and
+ * staged here, so the lookups of ConnectBlock that miss the coins tip are served from
+ * memory. A staged coin is handed over to the tip on its first read, a spent coin
+ * stands for an outpoint the database does not have.
+ *
+ * The database only changes through BatchWrite of this view, which drops the staged
+ * coins and the reads that were in flight while it wrote.
+ */
+class CCoinsViewPrefetch : public CCoinsViewBacked
+{
+public:
+    CCoinsViewPrefetch(CCoinsView* viewIn, size_t _maxStaged = DEFAULT_UTXO_PREFETCH_MAX_STAGED);
+
+    bool GetCoin(const COutPoint& outpoint, Coin& coin) const override;
+    bool HaveCoin(const COutPoint& outpoint) const override;
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock) override;
+
+    /** Queue the outpoints spent by the block, but not those it creates or the tip already has */
+    void prefetchBlock(const CBlock& block, const CCoinsViewCache& tip);
+
+    /** Queue outpoints to read, those above the limit are dropped */
+    void prefetch(const std::vector<COutPoint>& outpoints);
+
+    /** Read up to nMax queued outpoints into the staging area, returns how many were read */
+    size_t readQueued(size_t nMax);
+
+    size_t stagedCount() const;
+
+    bool hasWorkers() const { return nWorkers > 0; }
+
+    /** Worker thread reading the queued outpoints */
+    void ThreadPrefetch();
+
+private:
+    const size_t maxStaged;
+
+    mutable Mutex cs;
+
+    std::condition_variable cond;
+
+    std::deque<COutPoint> queue GUARDED_BY(cs);
+
+    mutable std::unordered_map<COutPoint, Coin, SaltedOutpointHasher> staged GUARDED_BY(cs);
+
+    //! Staging order, the oldest coins are evicted first
+    mutable std::deque<COutPoint> order GUARDED_BY(cs);
+
+    //! Changed before and after every write to the base view
+    uint64_t generation GUARDED_BY(cs) = 0;
+
+    std::atomic<int> nWorkers{0};
+};
+
+#endif // BITCOIN_UTXOPREFETCH_H
@@ -55,6 +55,9 @@
 #include <key.h>
 #include <wallet/wallet.h>
 #include <util/convert.h>
+#include <qtum/vmtracewriter.h>
+#include <qtum/contractexecutor.h>
+#include <qtum/stakeprefetch.h>
 
 #include <algorithm>
 #include <future>
@@ -80,7 +83,7 @@
 std::unique_ptr<QtumState> globalState;
 std::shared_ptr<dev::eth::SealEngineFace> globalSealEngine;
 bool fRecordLogOpcodes = false;
-bool fIsVMlogFile = false;
+bool fPipelinedConnect = DEFAULT_PIPELINED_CONNECT;
 bool fGettingValuesDGP = false;
  //////////////////////////////
 
@@ -737,6 +740,8 @@ bool MemPoolAccept::PreChecks(ATMPArgs& args, Workspace& ws)
     int64_t nSigOpsCost = GetTransactionSigOpCost(tx, m_view, STANDARD_SCRIPT_VERIFY_FLAGS);
 
     dev::u256 txMinGasPrice = 0;
+    uint64_t txGasLimit = 0;
+    uint64_t txBlockGasLimit = 0;
 
     //////////////////////////////////////////////////////////// // qtum
     if(!CheckOpSender(tx, chainparams, GetSpendHeight(m_view))){
@@ -760,8 +765,8 @@ bool MemPoolAccept::PreChecks(ATMPArgs& args, Workspace& ws)
         if(!converter.extractionQtumTransactions(resultConverter)){
             return state.Invalid(ValidationInvalidReason::CONSENSUS, error("AcceptToMempool(): Contract transaction of the wrong format"), REJECT_INVALID, "bad-tx-bad-contract-format");
         }
-        std::vector<QtumTransaction> qtumTransactions = resultConverter.first;
-        std::vector<EthTransactionParams> qtumETP = resultConverter.second;
+        const std::vector<QtumTransaction>& qtumTransactions = resultConverter.first;
+        const std::vector<EthTransactionParams>& qtumETP = resultConverter.second;
 
         dev::u256 sumGas = dev::u256(0);
         dev::u256 gasAllTxs = dev::u256(0);
@@ -817,10 +822,26 @@ bool MemPoolAccept::PreChecks(ATMPArgs& args, Workspace& ws)
         if(count > qtumTransactions.size())
             return state.Invalid(ValidationInvalidReason::CONSENSUS, false, REJECT_INVALID, "bad-txns-incorrect-format");
 
+        // Bounded by the block gas limit above
+        txGasLimit = uint64_t(gasAllTxs);
+        txBlockGasLimit = blockGasLimit;
+
         if (rawTx && nAbsurdFee && dev::u256(nFees) > dev::u256(nAbsurdFee) + sumGas)
             return state.Invalid(ValidationInvalidReason::TX_NOT_STANDARD, false,
                 REJECT_HIGHFEE, "absurdly-high-fee",
                 strprintf("%d > %d", nFees, nAbsurdFee));
+
+        // Run the contract checks of ConnectBlock for the next block now, so it only has to
+        // extract the executions of the tx
+        int nHeight = ::ChainActive().Tip()->nHeight + 1;
+        int nHeightDGP = nHeight + (nHeight+1 >= chainparams.GetConsensus().QIP7Height ? 0 : 1);
+        ContractCheckParams contractParams{contractflags, qtumDGP.getMinGasPrice(nHeightDGP), qtumDGP.getBlockGasLimit(nHeightDGP)};
+        if(!IsContractCheckCached(tx, contractParams, false)){
+            CValidationState stateContract;
+            ExtractQtumTX extracted;
+            if(CheckContractTx(tx, m_view, nullptr, contractParams, stateContract, extracted))
+                AddContractCheckCache(tx, contractParams);
+        }
     }
     ////////////////////////////////////////////////////////////
 
@@ -841,7 +862,7 @@ bool MemPoolAccept::PreChecks(ATMPArgs& args, Workspace& ws)
     }
 
     entry.reset(new CTxMemPoolEntry(ptx, nFees, nAcceptTime, ::ChainActive().Height(),
-            fSpendsCoinbase, nSigOpsCost, lp, CAmount(txMinGasPrice)));
+            fSpendsCoinbase, nSigOpsCost, lp, CAmount(txMinGasPrice), txGasLimit, txBlockGasLimit));
     unsigned int nSize = entry->GetTxSize();
 
     if (nSigOpsCost > dgpMaxTxSigOps)
@@ -1576,11 +1597,13 @@ CoinsViews::CoinsViews(
     bool in_memory,
     bool should_wipe) : m_dbview(
                             GetDataDir() / ldb_name, cache_size_bytes, in_memory, should_wipe),
-                        m_catcherview(&m_dbview) {}
+                        m_catcherview(&m_dbview),
+                        m_writeview(&m_catcherview, &m_dbview),
+                        m_prefetchview(&m_writeview) {}
 
 void CoinsViews::InitCache()
 {
-    m_cacheview = MakeUnique<CCoinsViewCache>(&m_catcherview);
+    m_cacheview = MakeUnique<CCoinsViewCache>(&m_prefetchview);
 }
 
 // NOTE: for now m_blockman is set to a global, but this will be changed
@@ -1805,6 +1828,8 @@ int GetSpendHeight(const CCoinsViewCache& inputs)
 
 static CuckooCache::cache<uint256, SignatureCacheHasher> scriptExecutionCache;
 static uint256 scriptExecutionCacheNonce(GetRandHash());
+static CuckooCache::cache<uint256, SignatureCacheHasher> contractCheckCache;
+static uint256 contractCheckCacheNonce(GetRandHash());
 
 void InitScriptExecutionCache() {
     // nMaxCacheSize is unsigned. If -maxsigcachesize is set to zero,
@@ -1813,6 +1838,11 @@ void InitScriptExecutionCache() {
     size_t nElems = scriptExecutionCache.setup_bytes(nMaxCacheSize);
     LogPrintf("Using %zu MiB out of %zu/2 requested for script execution cache, able to store %zu elements\n",
             (nElems*sizeof(uint256)) >>20, (nMaxCacheSize*2)>>20, nElems);
+
+    // Contract txs are a small part of the txs, they get an eighth of the script execution cache
+    nElems = contractCheckCache.setup_bytes(nMaxCacheSize / 8);
+    LogPrintf("Using %zu MiB for contract check cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nElems);
 }
 
 /**
@@ -2220,6 +2250,13 @@ void ThreadScriptCheck(int worker_num) {
     scriptcheckqueue.Thread();
 }
 
+static CCheckQueue<CContractCheck> contractcheckqueue(16);
+
+void ThreadContractCheck(int worker_num) {
+    util::ThreadRename(strprintf("contractch.%i", worker_num));
+    contractcheckqueue.Thread();
+}
+
 VersionBitsCache versionbitscache GUARDED_BY(cs_main);
 
 int32_t ComputeBlockVersion(const CBlockIndex* pindexPrev, const Consensus::Params& params)
@@ -2403,6 +2440,12 @@ bool GetSpentCoinFromMainChain(const CBlockIndex* pforkPrev, COutPoint prevoutSt
         }
     }
 
+    // Look up the spends of the blocks above the forkbase in memory, when they are all indexed
+    bool fSpent = false;
+    if(::ChainstateActive().m_recent_spends.lookup(ChainActive().Tip()->GetBlockHash(), pforkBase->nHeight, prevoutStake, coin, fSpent)) {
+        return fSpent;
+    }
+
     // Scan through blocks until we reach the forkbase to check if the prevoutStake has been spent in one of those blocks
     // If it not in any of those blocks, and not in the utxo set, it can't be spendable in the orphan chain.
     {
@@ -2535,14 +2578,147 @@ std::vector<ResultExecute> CallContract(const dev::Address& addrContract, std::v
     return exec.getResult();
 }
 
-bool CheckMinGasPrice(std::vector<EthTransactionParams>& etps, const uint64_t& minGasPrice){
-    for(EthTransactionParams& etp : etps){
+bool CheckMinGasPrice(const std::vector<EthTransactionParams>& etps, const uint64_t& minGasPrice){
+    for(const EthTransactionParams& etp : etps){
         if(etp.gasPrice < dev::u256(minGasPrice))
             return false;
     }
     return true;
 }
 
+bool CheckContractTx(const CTransaction& tx, const CCoinsViewCache& view, const std::vector<CTransactionRef>* blockTxs, const ContractCheckParams& params, CValidationState& state, ExtractQtumTX& extracted){
+    if(!CheckSenderScript(view, tx)){
+        return state.Invalid(ValidationInvalidReason::CONSENSUS, false, REJECT_INVALID, "bad-txns-invalid-sender-script");
+    }
+
+    QtumTxConverter convert(tx, &view, blockTxs, params.contractflags);
+    if(!convert.extractionQtumTransactions(extracted)){
+        return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Contract transaction of the wrong format"), REJECT_INVALID, "bad-tx-bad-contract-format");
+    }
+    if(!CheckMinGasPrice(extracted.second, params.minGasPrice))
+        return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Contract execution has lower gas price than allowed"), REJECT_INVALID, "bad-tx-low-gas-price");
+
+    //validate VM version and other ETH params before execution
+    //Reject anything unknown (could be changed later by DGP)
+    //TODO evaluate if this should be relaxed for soft-fork purposes
+    bool nonZeroVersion=false;
+    dev::u256 sumGas = dev::u256(0);
+    dev::u256 gasAllTxs = dev::u256(0);
+    CAmount nTxFee = view.GetValueIn(tx)-tx.GetValueOut();
+    for(const QtumTransaction& qtx : extracted.first){
+        sumGas += qtx.gas() * qtx.gasPrice();
+
+        if(sumGas > dev::u256(INT64_MAX)) {
+            return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Transaction's gas stipend overflows"), REJECT_INVALID, "bad-tx-gas-stipend-overflow");
+        }
+
+        if(sumGas > dev::u256(nTxFee)) {
+            return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Transaction fee does not cover the gas stipend"), REJECT_INVALID, "bad-txns-fee-notenough");
+        }
+
+        VersionVM v = qtx.getVersion();
+        if(v.format!=0)
+            return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Contract execution uses unknown version format"), REJECT_INVALID, "bad-tx-version-format");
+        if(v.rootVM != 0){
+            nonZeroVersion=true;
+        }else{
+            if(nonZeroVersion){
+                //If an output is version 0, then do not allow any other versions in the same tx
+                return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Contract tx has mixed version 0 and non-0 VM executions"), REJECT_INVALID, "bad-tx-mixed-zero-versions");
+            }
+        }
+        if(!(v.rootVM == 0 || v.rootVM == 1))
+            return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Contract execution uses unknown root VM"), REJECT_INVALID, "bad-tx-version-rootvm");
+        if(v.vmVersion != 0)
+            return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Contract execution uses unknown VM version"), REJECT_INVALID, "bad-tx-version-vmversion");
+        if(v.flagOptions != 0)
+            return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Contract execution uses unknown flag options"), REJECT_INVALID, "bad-tx-version-flags");
+
+        //check gas limit is not less than minimum gas limit (unless it is a no-exec tx)
+        if(qtx.gas() < MINIMUM_GAS_LIMIT && v.rootVM != 0)
+            return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Contract execution has lower gas limit than allowed"), REJECT_INVALID, "bad-tx-too-little-gas");
+
+        if(qtx.gas() > UINT32_MAX)
+            return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Contract execution can not specify greater gas limit than can fit in 32-bits"), REJECT_INVALID, "bad-tx-too-much-gas");
+
+        gasAllTxs += qtx.gas();
+        if(gasAllTxs > dev::u256(params.blockGasLimit))
+            return state.Invalid(ValidationInvalidReason::TX_GAS_EXCEEDS_LIMIT, false, REJECT_INVALID, "bad-txns-gas-exceeds-blockgaslimit");
+
+        //don't allow less than DGP set minimum gas price to prevent MPoS greedy mining/spammers
+        if(v.rootVM!=0 && (uint64_t)qtx.gasPrice() < params.minGasPrice)
+            return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Contract execution has lower gas price than allowed"), REJECT_INVALID, "bad-tx-low-gas-price");
+    }
+
+    if(!nonZeroVersion){
+        //if tx is 0 version, then the tx must already have been added by a previous contract execution
+        if(!tx.HasOpSpend()){
+            return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Version 0 contract executions are not allowed unless created by the AAL "), REJECT_INVALID, "bad-tx-improper-version-0");
+        }
+    }
+    return true;
+}
+
+static uint256 ContractCheckCacheEntry(const CTransaction& tx, const ContractCheckParams& params){
+    // The checks read the value and the script of the coins the tx spends, for the fee and the
+    // sender. The entry is keyed with the txid only, which commits to the prevouts and not to the
+    // coins. That is enough as long as an outpoint names the same coin on every chain the tx can
+    // be connected to: a txid is the hash of the outputs that create the coin, and BIP30/BIP34
+    // rule out a second tx with the same txid while the first one has unspent outputs. The
+    // values of the block that change with the height or the DGP are keyed as well.
+    uint256 hashCacheEntry;
+    CSHA256().Write(contractCheckCacheNonce.begin(), 32).Write(tx.GetHash().begin(), 32)
+        .Write((const unsigned char*)&params.contractflags, sizeof(params.contractflags))
+        .Write((const unsigned char*)&params.minGasPrice, sizeof(params.minGasPrice))
+        .Write((const unsigned char*)&params.blockGasLimit, sizeof(params.blockGasLimit))
+        .Finalize(hashCacheEntry.begin());
+    return hashCacheEntry;
+}
+
+bool IsContractCheckCached(const CTransaction& tx, const ContractCheckParams& params, bool fErase){
+    AssertLockHeld(cs_main); // CuckooCache requires external locks for inserts
+    return contractCheckCache.contains(ContractCheckCacheEntry(tx, params), fErase);
+}
+
+void AddContractCheckCache(const CTransaction& tx, const ContractCheckParams& params){
+    AssertLockHeld(cs_main);
+    contractCheckCache.insert(ContractCheckCacheEntry(tx, params));
+}
+
+void ContractCheckResults::setDone(size_t i){
+    {
+        LOCK(cs_done);
+        done[i] = true;
+    }
+    condDone.notify_all();
+}
+
+void ContractCheckResults::wait(size_t i){
+    WAIT_LOCK(cs_done, lock);
+    condDone.wait(lock, [&]{ return done[i]; });
+}
+
+bool CContractCheck::operator()() {
+    CCoinsView viewDummy;
+    CCoinsViewCache view(&viewDummy);
+    for(const std::pair<COutPoint, Coin>& coin : coins){
+        view.AddCoin(coin.first, Coin(coin.second), false);
+    }
+
+    // A failure is not reported to the queue, ConnectBlock checks the tx again for the reject reason.
+    // The queue skips the remaining checks after a failure, which would leave ConnectBlock waiting
+    ContractCheckResult& result = (*presults)[nIndex];
+    if(fCached){
+        QtumTxConverter convert(*ptx, &view, pblockTxs, params.contractflags);
+        result.fValid = convert.extractionQtumTransactions(result.extracted);
+    }else{
+        CValidationState state;
+        result.fValid = CheckContractTx(*ptx, view, pblockTxs, params, state, result.extracted);
+    }
+    presults->setDone(nIndex);
+    return true;
+}
+
 ///////////////////////////////////////////////// metrix
 bool GetDGPVout(std::vector<CTxOut> vTempVouts, std::vector<unsigned char> vContractAddr, std::vector<unsigned char> vContractData, CTxOut& vout, uint32_t& n)
 {
@@ -2658,7 +2834,7 @@ void MineDGPContracts(std::shared_ptr<CBlock> pblock)
 
     std::vector<QtumTransaction> qtumTransactions = GetDGPTransactions(*pblock, qtumDGP, nHeight);
 
-    ByteCodeExec exec(*pblock, qtumTransactions, hardBlockGasLimit, ::ChainActive().Tip());
+    ByteCodeExec exec(*pblock, std::move(qtumTransactions), hardBlockGasLimit, ::ChainActive().Tip());
     if (exec.performByteCode())
     {
         ByteCodeExecResult testExecResult;
@@ -2787,7 +2963,7 @@ valtype GetSenderAddress(const CTransaction& tx, const CCoinsViewCache* coinsVie
 
     // Check the current (or in-progress) block for zero-confirmation change spending that won't yet be in txindex
     if(!scriptFilled && blockTxs){
-        for(auto btx : *blockTxs){
+        for(const auto& btx : *blockTxs){
             if(btx->GetHash() == tx.vin[0].prevout.hash){
                 script = btx->vout[tx.vin[0].prevout.n].scriptPubKey;
                 scriptFilled=true;
@@ -2824,66 +3000,91 @@ valtype GetSenderAddress(const CTransaction& tx, const CCoinsViewCache* coinsVie
     return valtype();
 }
 
-UniValue vmLogToJSON(const ResultExecute& execRes, const CTransaction& tx, const CBlock& block){
-    UniValue result(UniValue::VOBJ);
-    if(tx != CTransaction())
-        result.pushKV("txid", tx.GetHash().GetHex());
-    result.pushKV("address", execRes.execRes.newAddress.hex());
-    if(block.GetHash() != CBlock().GetHash()){
-        result.pushKV("time", block.GetBlockTime());
-        result.pushKV("blockhash", block.GetHash().GetHex());
-        result.pushKV("blockheight", ::ChainActive().Tip()->nHeight + 1);
-    } else {
-        result.pushKV("time", GetAdjustedTime());
-        result.pushKV("blockheight", ::ChainActive().Tip()->nHeight);
-    }
-    UniValue logEntries(UniValue::VARR);
-    dev::eth::LogEntries logs = execRes.txRec.log();
-    for(const dev::eth::LogEntry& log : logs){
-        UniValue logEntrie(UniValue::VOBJ);
-        logEntrie.pushKV("address", log.address.hex());
-        UniValue topics(UniValue::VARR);
-        for(dev::h256 l : log.topics){
-            UniValue topicPair(UniValue::VOBJ);
-            topicPair.pushKV("raw", l.hex());
-            topics.push_back(topicPair);
-            //TODO add "pretty" field for human readable data
-        }
-        UniValue dataPair(UniValue::VOBJ);
-        dataPair.pushKV("raw", HexStr(log.data));
-        logEntrie.pushKV("data", dataPair);
-        logEntrie.pushKV("topics", topics);
-        logEntries.push_back(logEntrie);
-    }
-    result.pushKV("entries", logEntries);
-    return result;
-}
-
 void writeVMlog(const std::vector<ResultExecute>& res, const CTransaction& tx, const CBlock& block){
-    boost::filesystem::path qtumDir = GetDataDir() / "vmExecLogs.json";
-    std::stringstream ss;
-    if(fIsVMlogFile){
-        ss << ",";
-    } else {
-        std::ofstream file(qtumDir.string(), std::ios::out | std::ios::app);
-        file << "{\"logs\":[]}";
-        file.close();
-    }
+    if(!pvmtracewriter)
+        return;
 
-    for(size_t i = 0; i < res.size(); i++){
-        ss << vmLogToJSON(res[i], tx, block).write();
-        if(i != res.size() - 1){
-            ss << ",";
+    for(const ResultExecute& execRes : res){
+        VMTraceRecord record;
+        if(tx != CTransaction())
+            record.txid = tx.GetHash();
+        record.address = uint160(execRes.execRes.newAddress.asBytes());
+        if(block.GetHash() != CBlock().GetHash()){
+            record.nTime = block.GetBlockTime();
+            record.blockHash = block.GetHash();
+            record.nHeight = ::ChainActive().Tip()->nHeight + 1;
         } else {
-            ss << "]}";
+            record.nTime = GetAdjustedTime();
+            record.nHeight = ::ChainActive().Tip()->nHeight;
+        }
+        for(const dev::eth::LogEntry& log : execRes.txRec.log()){
+            VMTraceLog entry;
+            entry.address = uint160(log.address.asBytes());
+            for(const dev::h256& topic : log.topics){
+                entry.topics.push_back(uint256(topic.asBytes()));
+            }
+            entry.data = log.data;
+            record.entries.push_back(std::move(entry));
         }
+        pvmtracewriter->push(std::move(record));
     }
-    
-    std::ofstream file(qtumDir.string(), std::ios::in | std::ios::out);
-    file.seekp(-2, std::ios::end);
-    file << ss.str();
-    file.close();
-    fIsVMlogFile = true;
+}
+
+EVMEnvironmentCache evmEnvironmentCache;
+
+std::shared_ptr<const dev::h256s> EVMEnvironmentCache::lastHashes(const CBlockIndex* tip)
+{
+    LOCK(cs_cache);
+    if(tip && tipHashes && *tip->phashBlock == hashTip)
+        return tipHashes;
+
+    auto hashes = std::make_shared<dev::h256s>(256);
+    if(tip && tipHashes && tip->pprev && *tip->pprev->phashBlock == hashTip){
+        // The tip moved by one block, shift the hashes of the previous tip
+        (*hashes)[0] = uintToh256(*tip->phashBlock);
+        std::copy(tipHashes->begin(), tipHashes->end() - 1, hashes->begin() + 1);
+    }else{
+        const CBlockIndex* pindex = tip;
+        for(int i=0;i<256;i++){
+            if(!pindex)
+                break;
+            (*hashes)[i]= uintToh256(*pindex->phashBlock);
+            pindex = pindex->pprev;
+        }
+    }
+
+    hashTip = tip ? *tip->phashBlock : uint256();
+    tipHashes = hashes;
+    blockHeader.reset();
+    return tipHashes;
+}
+
+std::shared_ptr<const dev::eth::BlockHeader> EVMEnvironmentCache::header(const CBlockIndex* tip, uint32_t nTime, uint32_t nBits, uint64_t gasLimit, const dev::Address& author)
+{
+    LOCK(cs_cache);
+    const int64_t number = tip->nHeight + 1;
+    if(blockHeader && *tip->phashBlock == hashTip && blockHeader->number() == number && blockHeader->timestamp() == nTime &&
+            blockHeader->difficulty() == dev::u256(nBits) && blockHeader->gasLimit() == gasLimit && blockHeader->author() == author)
+        return blockHeader;
+
+    auto header = std::make_shared<dev::eth::BlockHeader>();
+    header->setNumber(number);
+    header->setTimestamp(nTime);
+    header->setDifficulty(dev::u256(nBits));
+    header->setGasLimit(gasLimit);
+    header->setAuthor(author);
+    // Only kept for the tip the hashes are cached for
+    if(*tip->phashBlock == hashTip)
+        blockHeader = header;
+    return header;
+}
+
+void EVMEnvironmentCache::clear()
+{
+    LOCK(cs_cache);
+    hashTip.SetNull();
+    tipHashes.reset();
+    blockHeader.reset();
 }
 
 LastHashes::LastHashes()
@@ -2891,25 +3092,17 @@ LastHashes::LastHashes()
 
 void LastHashes::set(const CBlockIndex *tip)
 {
-    clear();
-
-    m_lastHashes.resize(256);
-    for(int i=0;i<256;i++){
-        if(!tip)
-            break;
-        m_lastHashes[i]= uintToh256(*tip->phashBlock);
-        tip = tip->pprev;
-    }
+    m_lastHashes = evmEnvironmentCache.lastHashes(tip);
 }
 
 dev::h256s LastHashes::precedingHashes(const dev::h256 &) const
 {
-    return m_lastHashes;
+    return m_lastHashes ? *m_lastHashes : dev::h256s();
 }
 
 void LastHashes::clear()
 {
-    m_lastHashes.clear();
+    m_lastHashes.reset();
 }
 
 bool ByteCodeExec::performByteCode(dev::eth::Permanence type){
@@ -2925,7 +3118,7 @@ bool ByteCodeExec::performByteCode(dev::eth::Permanence type){
             result.push_back(ResultExecute{
                 execRes,
                 QtumTransactionReceipt(dev::h256(), dev::h256(), dev::u256(), dev::eth::LogEntries(), {}, {}),
-                CTransaction()
+                CTransactionRef()
             });
             continue;
         }
@@ -2951,12 +3144,12 @@ bool ByteCodeExec::processingResults(ByteCodeExecResult& resultBCE){
         		tx.vout.push_back(CTxOut(CAmount(txs[i].value()), script));
         		resultBCE.valueTransfers.push_back(CTransaction(tx));
         	}
-        	if(!(::ChainActive().Height() >= consensusParams.QIP7Height && result[i].execRes.excepted == dev::eth::TransactionException::RevertInstruction)){
+        	if(!(pindex->nHeight >= consensusParams.QIP7Height && result[i].execRes.excepted == dev::eth::TransactionException::RevertInstruction)){
         	resultBCE.usedGas += gasUsed;
         	}
         }
 
-        if(result[i].execRes.excepted == dev::eth::TransactionException::None || (::ChainActive().Height() >= consensusParams.QIP7Height && result[i].execRes.excepted == dev::eth::TransactionException::RevertInstruction)){
+        if(result[i].execRes.excepted == dev::eth::TransactionException::None || (pindex->nHeight >= consensusParams.QIP7Height && result[i].execRes.excepted == dev::eth::TransactionException::RevertInstruction)){
         	if(txs[i].gas() > UINT64_MAX ||
         			result[i].execRes.gasUsed > UINT64_MAX ||
 					txs[i].gasPrice() > UINT64_MAX){
@@ -2978,8 +3171,8 @@ bool ByteCodeExec::processingResults(ByteCodeExecResult& resultBCE){
         	}
         }
 
-        if(result[i].tx != CTransaction()){
-            resultBCE.valueTransfers.push_back(result[i].tx);
+        if(result[i].tx){
+            resultBCE.valueTransfers.push_back(*result[i].tx);
         }
     }
     return true;
@@ -2987,21 +3180,20 @@ bool ByteCodeExec::processingResults(ByteCodeExecResult& resultBCE){
 
 dev::eth::EnvInfo ByteCodeExec::BuildEVMEnvironment(){
     CBlockIndex* tip = pindex;
-    dev::eth::BlockHeader header;
-    header.setNumber(tip->nHeight + 1);
-    header.setTimestamp(block.nTime);
-    header.setDifficulty(dev::u256(block.nBits));
-    header.setGasLimit(blockGasLimit);
-
-    lastHashes.set(tip);
+    // The environment is the same for all the txs of the block
+    if(!header){
+        lastHashes.set(tip);
 
-    if(block.IsProofOfStake()){
-        header.setAuthor(EthAddrFromScript(block.vtx[1]->vout[1].scriptPubKey));
-    }else {
-        header.setAuthor(EthAddrFromScript(block.vtx[0]->vout[0].scriptPubKey));
+        dev::Address author;
+        if(block.IsProofOfStake()){
+            author = EthAddrFromScript(block.vtx[1]->vout[1].scriptPubKey);
+        }else {
+            author = EthAddrFromScript(block.vtx[0]->vout[0].scriptPubKey);
+        }
+        header = evmEnvironmentCache.header(tip, block.nTime, block.nBits, blockGasLimit, author);
     }
     dev::u256 gasUsed;
-    dev::eth::EnvInfo env(header, lastHashes, gasUsed);
+    dev::eth::EnvInfo env(*header, lastHashes, gasUsed);
     return env;
 }
 
@@ -3033,7 +3225,7 @@ bool QtumTxConverter::extractionQtumTransactions(ExtractQtumTX& qtumtx){
                 EthTransactionParams params;
                 if(parseEthTXParams(params)){
                     resultTX.push_back(createEthTX(params, i));
-                    resultETP.push_back(params);
+                    resultETP.push_back(std::move(params));
                 }else{
                     return false;
                 }
@@ -3042,7 +3234,7 @@ bool QtumTxConverter::extractionQtumTransactions(ExtractQtumTX& qtumtx){
             }
         }
     }
-    qtumtx = std::make_pair(resultTX, resultETP);
+    qtumtx = std::make_pair(std::move(resultTX), std::move(resultETP));
     return true;
 }
 
@@ -3082,7 +3274,7 @@ bool QtumTxConverter::parseEthTXParams(EthTransactionParams& params){
         if(stack.back().size() < 1){
             return false;
         }
-        valtype code(stack.back());
+        valtype code(std::move(stack.back()));
         stack.pop_back();
         uint64_t gasPrice = CScriptNum::vch_to_uint64(stack.back());
         stack.pop_back();
@@ -3104,7 +3296,7 @@ bool QtumTxConverter::parseEthTXParams(EthTransactionParams& params){
         params.version = version;
         params.gasPrice = dev::u256(gasPrice);
         params.receiveAddress = receiveAddress;
-        params.code = code;
+        params.code = std::move(code);
         params.gasLimit = dev::u256(gasLimit);
         return true;
     }
@@ -3115,13 +3307,10 @@ bool QtumTxConverter::parseEthTXParams(EthTransactionParams& params){
 }
 
 QtumTransaction QtumTxConverter::createEthTX(const EthTransactionParams& etp, uint32_t nOut){
-    QtumTransaction txEth;
-    if (etp.receiveAddress == dev::Address() && opcode != OP_CALL){
-        txEth = QtumTransaction(txBit.vout[nOut].nValue, etp.gasPrice, etp.gasLimit, etp.code, dev::u256(0));
-    }
-    else{
-        txEth = QtumTransaction(txBit.vout[nOut].nValue, etp.gasPrice, etp.gasLimit, etp.receiveAddress, etp.code, dev::u256(0));
-    }
+    // Constructed in place, assigning would copy the code once more
+    QtumTransaction txEth = (etp.receiveAddress == dev::Address() && opcode != OP_CALL) ?
+        QtumTransaction(txBit.vout[nOut].nValue, etp.gasPrice, etp.gasLimit, etp.code, dev::u256(0)) :
+        QtumTransaction(txBit.vout[nOut].nValue, etp.gasPrice, etp.gasLimit, etp.receiveAddress, etp.code, dev::u256(0));
     dev::Address sender(GetSenderAddress(txBit, view, blockTransactions, (int)nOut));
     txEth.forceSender(sender);
     txEth.setHashWith(uintToh256(txBit.GetHash()));
@@ -3138,11 +3327,17 @@ size_t QtumTxConverter::correctedStackSize(size_t size){
 }
 ///////////////////////////////////////////////////////////////////////
 
+/** The contract execution of a tx of a block, filled on the contract executor and read by ConnectBlock once it is done */
+struct ContractExecOutcome{
+    std::shared_ptr<ByteCodeExec> exec;
+    ByteCodeExecResult bcer;
+};
+
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins.
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
  *  can fail if those validity checks fail (among other reasons). */
 bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex,
-                  CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck)
+                  CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck, CBlockUndo* pblockundo)
 {
     AssertLockHeld(cs_main);
     assert(pindex);
@@ -3361,6 +3556,46 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
     CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : nullptr);
 
+    // Check the contract txs on the contract check threads while the block is connected, against
+    // copies of the coins they spend taken from the view or from earlier txs of the block
+    ContractCheckParams contractParams{contractflags, minGasPrice, blockGasLimit};
+    ContractCheckResults contractResults(block.vtx.size());
+    CCheckQueueControl<CContractCheck> contractControl(nScriptCheckThreads ? &contractcheckqueue : nullptr);
+    if(nScriptCheckThreads){
+        std::map<uint256, const CTransaction*> blockTxs;
+        std::vector<CContractCheck> vContractChecks;
+        for(size_t i = 0; i < block.vtx.size(); i++){
+            const CTransaction& tx = *(block.vtx[i]);
+            bool fQueued = false;
+            if(tx.HasCreateOrCall() && !tx.HasOpSpend() && !tx.IsCoinBase()){
+                std::vector<std::pair<COutPoint, Coin>> coins;
+                for(const CTxIn& txin : tx.vin){
+                    auto it = blockTxs.find(txin.prevout.hash);
+                    if(it != blockTxs.end()){
+                        const CTransaction& txPrev = *(it->second);
+                        if(txin.prevout.n < txPrev.vout.size())
+                            coins.emplace_back(txin.prevout, Coin(txPrev.vout[txin.prevout.n], pindex->nHeight, txPrev.IsCoinBase(), txPrev.IsCoinStake()));
+                    }else{
+                        const Coin& coin = view.AccessCoin(txin.prevout);
+                        if(!coin.IsSpent())
+                            coins.emplace_back(txin.prevout, coin);
+                    }
+                }
+                // A tx with missing inputs fails in CheckTxInputs before its contract checks
+                if(coins.size() == tx.vin.size()){
+                    vContractChecks.emplace_back(tx, block.vtx, contractParams, std::move(coins), IsContractCheckCached(tx, contractParams, !fJustCheck), &contractResults, i);
+                    fQueued = true;
+                }
+            }
+            if(!fQueued)
+                contractResults.setDone(i);
+            blockTxs[tx.GetHash()] = &tx;
+        }
+        // The queue hands out its last checks first, the checks of the first txs are needed first
+        std::reverse(vContractChecks.begin(), vContractChecks.end());
+        contractControl.Add(vContractChecks);
+    }
+
     std::vector<int> prevheights;
     CAmount nFees = 0;
     CAmount nActualStakeReward = 0;
@@ -3385,6 +3620,15 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     uint64_t nValueOut=0;
     uint64_t nValueIn=0;
 
+    // The contract executions run in block order on the executor while the inputs and scripts
+    // of the next txs are checked. They only fill their own slot of contractExecs, the receipts,
+    // gas, refunds and checkBlock are accumulated on this thread once they are done.
+    std::vector<ContractExecOutcome> contractExecs(block.vtx.size());
+    CValidationState stateExec;
+    // Only touched by the executions, to stop at the first one over the block gas limit
+    uint64_t nExecGasUsed = 0;
+    ContractExecutor executor(fPipelinedConnect);
+
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
         const CTransaction &tx = *(block.vtx[i]);
@@ -3513,153 +3757,39 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         if(!CheckOpSender(tx, chainparams, pindex->nHeight)){
             return state.Invalid(ValidationInvalidReason::CONSENSUS, false, REJECT_INVALID, "bad-txns-invalid-sender");
         }
-        if(!tx.HasOpSpend()){
-            checkBlock.vtx.push_back(block.vtx[i]);
-        }
         if(tx.HasCreateOrCall() && !hasOpSpend){
 
-            if(!CheckSenderScript(view, tx)){
-                return state.Invalid(ValidationInvalidReason::CONSENSUS, false, REJECT_INVALID, "bad-txns-invalid-sender-script");
+            if(nScriptCheckThreads){
+                contractResults.wait(i);
             }
-
-            QtumTxConverter convert(tx, &view, &block.vtx, contractflags);
-
             ExtractQtumTX resultConvertQtumTX;
-            if(!convert.extractionQtumTransactions(resultConvertQtumTX)){
-                return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Contract transaction of the wrong format"), REJECT_INVALID, "bad-tx-bad-contract-format");
-            }
-            if(!CheckMinGasPrice(resultConvertQtumTX.second, minGasPrice))
-                return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Contract execution has lower gas price than allowed"), REJECT_INVALID, "bad-tx-low-gas-price");
-
-
-            dev::u256 gasAllTxs = dev::u256(0);
-            ByteCodeExec exec(block, resultConvertQtumTX.first, blockGasLimit, pindex->pprev);
-            //validate VM version and other ETH params before execution
-            //Reject anything unknown (could be changed later by DGP)
-            //TODO evaluate if this should be relaxed for soft-fork purposes
-            bool nonZeroVersion=false;
-            dev::u256 sumGas = dev::u256(0);
-            CAmount nTxFee = view.GetValueIn(tx)-tx.GetValueOut();
-            for(QtumTransaction& qtx : resultConvertQtumTX.first){
-                sumGas += qtx.gas() * qtx.gasPrice();
-
-                if(sumGas > dev::u256(INT64_MAX)) {
-                    return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Transaction's gas stipend overflows"), REJECT_INVALID, "bad-tx-gas-stipend-overflow");
-                }
-
-                if(sumGas > dev::u256(nTxFee)) {
-                    return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Transaction fee does not cover the gas stipend"), REJECT_INVALID, "bad-txns-fee-notenough");
-                }
-
-                VersionVM v = qtx.getVersion();
-                if(v.format!=0)
-                    return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Contract execution uses unknown version format"), REJECT_INVALID, "bad-tx-version-format");
-                if(v.rootVM != 0){
-                    nonZeroVersion=true;
-                }else{
-                    if(nonZeroVersion){
-                        //If an output is version 0, then do not allow any other versions in the same tx
-                        return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Contract tx has mixed version 0 and non-0 VM executions"), REJECT_INVALID, "bad-tx-mixed-zero-versions");
-                    }
-                }
-                if(!(v.rootVM == 0 || v.rootVM == 1))
-                    return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Contract execution uses unknown root VM"), REJECT_INVALID, "bad-tx-version-rootvm");
-                if(v.vmVersion != 0)
-                    return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Contract execution uses unknown VM version"), REJECT_INVALID, "bad-tx-version-vmversion");
-                if(v.flagOptions != 0)
-                    return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Contract execution uses unknown flag options"), REJECT_INVALID, "bad-tx-version-flags");
-
-                //check gas limit is not less than minimum gas limit (unless it is a no-exec tx)
-                if(qtx.gas() < MINIMUM_GAS_LIMIT && v.rootVM != 0)
-                    return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Contract execution has lower gas limit than allowed"), REJECT_INVALID, "bad-tx-too-little-gas");
-
-                if(qtx.gas() > UINT32_MAX)
-                    return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Contract execution can not specify greater gas limit than can fit in 32-bits"), REJECT_INVALID, "bad-tx-too-much-gas");
-
-                gasAllTxs += qtx.gas();
-                if(gasAllTxs > dev::u256(blockGasLimit))
-                    return state.Invalid(ValidationInvalidReason::TX_GAS_EXCEEDS_LIMIT, false, REJECT_INVALID, "bad-txns-gas-exceeds-blockgaslimit");
-
-                //don't allow less than DGP set minimum gas price to prevent MPoS greedy mining/spammers
-                if(v.rootVM!=0 && (uint64_t)qtx.gasPrice() < minGasPrice)
-                    return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Contract execution has lower gas price than allowed"), REJECT_INVALID, "bad-tx-low-gas-price");
+            if(contractResults[i].fValid){
+                resultConvertQtumTX = std::move(contractResults[i].extracted);
+            }else if(!CheckContractTx(tx, view, &block.vtx, contractParams, state, resultConvertQtumTX)){
+                return false;
             }
-
-            if(!nonZeroVersion){
-                //if tx is 0 version, then the tx must already have been added by a previous contract execution
-                if(!tx.HasOpSpend()){
-                    return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Version 0 contract executions are not allowed unless created by the AAL "), REJECT_INVALID, "bad-tx-improper-version-0");
-                }
+            if(fJustCheck){
+                AddContractCheckCache(tx, contractParams);
             }
 
             if (!tx.IsCoinStake())
             {
-                if(!exec.performByteCode()){
-                    return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Unknown error during contract execution"), REJECT_INVALID, "bad-tx-unknown-error");
-                }
-
-                std::vector<ResultExecute> resultExec(exec.getResult());
-                ByteCodeExecResult bcer;
-                if(!exec.processingResults(bcer)){
-                    return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Error processing VM execution results"), REJECT_INVALID, "bad-vm-exec-processing");
-                }
-
-                std::vector<TransactionReceiptInfo> tri;
-                if (fLogEvents && !fJustCheck)
-                {
-                    uint64_t countCumulativeGasUsed = blockGasUsed;
-                    for(size_t k = 0; k < resultConvertQtumTX.first.size(); k ++){
-                        for(auto& log : resultExec[k].txRec.log()) {
-                            if(!heightIndexes.count(log.address)){
-                                heightIndexes[log.address].first = CHeightTxIndexKey(pindex->nHeight, log.address);
-                            }
-                            heightIndexes[log.address].second.push_back(tx.GetHash());
-                        }
-                        uint64_t gasUsed = uint64_t(resultExec[k].execRes.gasUsed);
-                        countCumulativeGasUsed += gasUsed;
-                        tri.push_back(TransactionReceiptInfo{
-                            block.GetHash(),
-                            uint32_t(pindex->nHeight),
-                            tx.GetHash(),
-                            uint32_t(i),
-                            resultConvertQtumTX.first[k].getNVout(),
-                            resultConvertQtumTX.first[k].from(),
-                            resultConvertQtumTX.first[k].to(),
-                            countCumulativeGasUsed,
-                            uint64_t(resultExec[k].execRes.gasUsed),
-                            resultExec[k].execRes.newAddress,
-                            resultExec[k].txRec.log(),
-                            resultExec[k].execRes.excepted,
-                            exceptedMessage(resultExec[k].execRes.excepted, resultExec[k].execRes.output),
-                            resultExec[k].txRec.stateRoot(),
-                            resultExec[k].txRec.utxoRoot(),
-                            resultExec[k].txRec.createdContracts(),
-                            resultExec[k].txRec.destructedContracts()
-                        });
+                std::shared_ptr<ByteCodeExec> exec = std::make_shared<ByteCodeExec>(block, std::move(resultConvertQtumTX.first), blockGasLimit, pindex->pprev);
+                ContractExecOutcome& outcome = contractExecs[i];
+                executor.push([&outcome, &stateExec, &nExecGasUsed, blockGasLimit, exec]() -> bool {
+                    if(!exec->performByteCode()){
+                        return stateExec.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Unknown error during contract execution"), REJECT_INVALID, "bad-tx-unknown-error");
                     }
-
-                    pstorageresult->addResult(uintToh256(tx.GetHash()), tri);
-                }
-
-                blockGasUsed += bcer.usedGas;
-                if(blockGasUsed > blockGasLimit){
-                    return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Block exceeds gas limit"), REJECT_INVALID, "bad-blk-gaslimit");
-                }
-                for(const CTxOut& refundVout : bcer.refundOutputs){
-                    gasRefunds += refundVout.nValue;
-                }
-                checkVouts.insert(checkVouts.end(), bcer.refundOutputs.begin(), bcer.refundOutputs.end());
-                for(CTransaction& t : bcer.valueTransfers){
-                    checkBlock.vtx.push_back(MakeTransactionRef(std::move(t)));
-                }
-                if(fRecordLogOpcodes && !fJustCheck){
-                    writeVMlog(resultExec, tx, block);
-                }
-
-                for(ResultExecute& re: resultExec){
-                    if(re.execRes.newAddress != dev::Address() && !fJustCheck)
-                        dev::g_logPost(std::string("Address : " + re.execRes.newAddress.hex()), NULL);
-                }
+                    if(!exec->processingResults(outcome.bcer)){
+                        return stateExec.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Error processing VM execution results"), REJECT_INVALID, "bad-vm-exec-processing");
+                    }
+                    nExecGasUsed += outcome.bcer.usedGas;
+                    if(nExecGasUsed > blockGasLimit){
+                        return stateExec.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Block exceeds gas limit"), REJECT_INVALID, "bad-blk-gaslimit");
+                    }
+                    outcome.exec = exec;
+                    return true;
+                });
             }
         }
 /////////////////////////////////////////////////////////////////////////////////////////
@@ -3697,6 +3827,77 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
     }
 
+    if (!executor.wait()) {
+        state = stateExec;
+        return false;
+    }
+    for (unsigned int i = 0; i < block.vtx.size(); i++) {
+        const CTransaction &tx = *(block.vtx[i]);
+        if(!tx.HasOpSpend()){
+            checkBlock.vtx.push_back(block.vtx[i]);
+        }
+        const std::shared_ptr<ByteCodeExec>& exec = contractExecs[i].exec;
+        if(!exec)
+            continue;
+        ByteCodeExecResult& bcer = contractExecs[i].bcer;
+        const std::vector<ResultExecute>& resultExec = exec->getResult();
+
+        std::vector<TransactionReceiptInfo> tri;
+        if (fLogEvents && !fJustCheck)
+        {
+            uint64_t countCumulativeGasUsed = blockGasUsed;
+            for(size_t k = 0; k < exec->getTxs().size(); k ++){
+                for(auto& log : resultExec[k].txRec.log()) {
+                    if(!heightIndexes.count(log.address)){
+                        heightIndexes[log.address].first = CHeightTxIndexKey(pindex->nHeight, log.address);
+                    }
+                    heightIndexes[log.address].second.push_back(tx.GetHash());
+                }
+                uint64_t gasUsed = uint64_t(resultExec[k].execRes.gasUsed);
+                countCumulativeGasUsed += gasUsed;
+                tri.push_back(TransactionReceiptInfo{
+                    block.GetHash(),
+                    uint32_t(pindex->nHeight),
+                    tx.GetHash(),
+                    uint32_t(i),
+                    exec->getTxs()[k].getNVout(),
+                    exec->getTxs()[k].from(),
+                    exec->getTxs()[k].to(),
+                    countCumulativeGasUsed,
+                    uint64_t(resultExec[k].execRes.gasUsed),
+                    resultExec[k].execRes.newAddress,
+                    resultExec[k].txRec.log(),
+                    resultExec[k].execRes.excepted,
+                    exceptedMessage(resultExec[k].execRes.excepted, resultExec[k].execRes.output),
+                    resultExec[k].txRec.stateRoot(),
+                    resultExec[k].txRec.utxoRoot(),
+                    resultExec[k].txRec.createdContracts(),
+                    resultExec[k].txRec.destructedContracts()
+                });
+            }
+
+            pstorageresult->addResult(uintToh256(tx.GetHash()), tri);
+        }
+
+        // The executions stopped at the first one over the limit, the sum is the same here
+        blockGasUsed += bcer.usedGas;
+        for(const CTxOut& refundVout : bcer.refundOutputs){
+            gasRefunds += refundVout.nValue;
+        }
+        checkVouts.insert(checkVouts.end(), bcer.refundOutputs.begin(), bcer.refundOutputs.end());
+        for(CTransaction& t : bcer.valueTransfers){
+            checkBlock.vtx.push_back(MakeTransactionRef(std::move(t)));
+        }
+        if(fRecordLogOpcodes && !fJustCheck){
+            writeVMlog(resultExec, tx, block);
+        }
+
+        for(const ResultExecute& re: resultExec){
+            if(re.execRes.newAddress != dev::Address() && !fJustCheck)
+                dev::g_logPost(std::string("Address : " + re.execRes.newAddress.hex()), NULL);
+        }
+    }
+
     /////////////////////////////////////////////////////////////////////////////////// // metrix
     // dgp contracts are executed as the final contracts of the block
     if (block.IsProofOfStake())
@@ -3706,13 +3907,13 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         std::vector<QtumTransaction> qtumTransactions = GetDGPTransactions(block, qtumDGP, pindex->nHeight);
         if (qtumTransactions.size() > 0)
         {
-            ByteCodeExec exec(block, qtumTransactions, blockGasLimit, pindex->pprev);
+            ByteCodeExec exec(block, std::move(qtumTransactions), blockGasLimit, pindex->pprev);
             if (!exec.performByteCode())
             {
                 return state.Invalid(ValidationInvalidReason::CONSENSUS, error("ConnectBlock(): Unknown error during contract execution"), REJECT_INVALID, "bad-tx-unknown-error");
             }
 
-            std::vector<ResultExecute> resultExec(exec.getResult());
+            const std::vector<ResultExecute>& resultExec = exec.getResult();
             ByteCodeExecResult bcer;
             if(!exec.processingResults(bcer))
             {
@@ -3723,7 +3924,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             if (fLogEvents && !fJustCheck)
             {
                 uint64_t countCumulativeGasUsed = blockGasUsed;
-                for(size_t k = 0; k < qtumTransactions.size(); k ++){
+                for(size_t k = 0; k < exec.getTxs().size(); k ++){
                     for(auto& log : resultExec[k].txRec.log()) {
                         if(!heightIndexes.count(log.address)){
                             heightIndexes[log.address].first = CHeightTxIndexKey(pindex->nHeight, log.address);
@@ -3737,9 +3938,9 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
                         uint32_t(pindex->nHeight),
                         tx.GetHash(),
                         uint32_t(i),
-                        qtumTransactions[k].getNVout(),
-                        qtumTransactions[k].from(),
-                        qtumTransactions[k].to(),
+                        exec.getTxs()[k].getNVout(),
+                        exec.getTxs()[k].from(),
+                        exec.getTxs()[k].to(),
                         countCumulativeGasUsed,
                         uint64_t(resultExec[k].execRes.gasUsed),
                         resultExec[k].execRes.newAddress,
@@ -3767,7 +3968,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
                 writeVMlog(resultExec, tx, block);
             }
 
-            for(ResultExecute& re: resultExec){
+            for(const ResultExecute& re: resultExec){
                 if(re.execRes.newAddress != dev::Address() && !fJustCheck)
                     dev::g_logPost(std::string("Address : " + re.execRes.newAddress.hex()), NULL);
             }
@@ -3873,6 +4074,9 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     if (!WriteUndoDataForBlock(blockundo, state, pindex, chainparams))
         return false;
 
+    if (pblockundo)
+        *pblockundo = std::move(blockundo);
+
     if (!pindex->IsValid(BLOCK_VALID_SCRIPTS)) {
         pindex->RaiseValidity(BLOCK_VALID_SCRIPTS);
         setDirtyBlockIndex.insert(pindex);
@@ -4048,6 +4252,10 @@ bool CChainState::FlushStateToDisk(
             // Flush the chainstate (which may refer to block index entries).
             if (!CoinsTip().Flush())
                 return AbortNode(state, "Failed to write to coin database");
+            // The coins are written in the background, unless the caller needs them on disk
+            // or the undo data of the blocks they were written for is about to be pruned.
+            if ((mode == FlushStateMode::ALWAYS || fFlushForPrune) && !CoinsWriteBehind().Sync())
+                return AbortNode(state, "Failed to write to coin database");
             nLastFlush = nNow;
             full_flush_completed = true;
         }
@@ -4153,6 +4361,7 @@ void static UpdateTip(const CBlockIndex* pindexNew, const CChainParams& chainPar
 {
     // New best block
     mempool.AddTransactionsUpdated(1);
+    mempool.ClearPreExecFailures(pindexNew->GetBlockHash());
 
     {
         LOCK(g_best_block_mutex);
@@ -4248,6 +4457,7 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
     }
 
     m_chain.SetTip(pindexDelete->pprev);
+    m_recent_spends.disconnectBlock(pindexDelete->GetBlockHash(), pindexDelete->pprev->GetBlockHash());
 
     UpdateTip(pindexDelete->pprev, chainparams);
     // Let wallets know transactions went from 1-confirmed to
@@ -4336,7 +4546,13 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     // Read block from disk.
     int64_t nTime1 = GetTimeMicros();
     std::shared_ptr<const CBlock> pthisBlock;
-    if (!pblock) {
+    std::shared_ptr<const CBlock> pblockAhead;
+    if (!pblock && pstakeprefetcher) {
+        pblockAhead = pstakeprefetcher->getBlock(pindexNew->GetBlockHash());
+    }
+    if (pblockAhead) {
+        pthisBlock = pblockAhead;
+    } else if (!pblock) {
         std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
         if (!ReadBlockFromDisk(*pblockNew, pindexNew, chainparams.GetConsensus()))
             return AbortNode(state, "Failed to read block");
@@ -4349,13 +4565,14 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
+    CBlockUndo blockundo;
     {
         CCoinsViewCache view(&CoinsTip());
 
         dev::h256 oldHashStateRoot(globalState->rootHash()); // qtum
         dev::h256 oldHashUTXORoot(globalState->rootHashUTXO()); // qtum
 
-        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams);
+        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams, false, &blockundo);
         GetMainSignals().BlockChecked(blockConnecting, state);
         if (!rv) {
             if (state.IsInvalid())
@@ -4383,6 +4600,7 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     disconnectpool.removeForBlock(blockConnecting.vtx);
     // Update m_chain & related variables.
     m_chain.SetTip(pindexNew);
+    m_recent_spends.connectBlock(blockConnecting, blockundo, pindexNew);
     UpdateTip(pindexNew, chainparams);
 
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
@@ -4512,6 +4730,25 @@ bool CChainState::ActivateBestChainStep(CValidationState& state, const CChainPar
         }
         nHeight = nTargetHeight;
 
+        // Read the blocks and check their signatures and PoS kernels ahead on the prefetch threads
+        if (pstakeprefetcher && IsInitialBlockDownload()) {
+            std::vector<StakePrefetchJob> jobs;
+            jobs.reserve(vpindexToConnect.size());
+            for (CBlockIndex *pindexConnect : reverse_iterate(vpindexToConnect)) {
+                if ((pindexConnect == pindexMostWork && pblock) || !(pindexConnect->nStatus & BLOCK_HAVE_DATA))
+                    continue;
+                StakePrefetchJob job;
+                job.hash = pindexConnect->GetBlockHash();
+                job.pos = pindexConnect->GetBlockPos();
+                job.pindexPrev = pindexConnect->pprev;
+                // A stake created by an earlier block of the batch is not in the tip yet, it is checked when connected
+                if (pindexConnect->IsProofOfStake())
+                    job.fHaveCoin = CoinsTip().GetCoin(pindexConnect->prevoutStake, job.coinStake);
+                jobs.push_back(std::move(job));
+            }
+            pstakeprefetcher->push(std::move(jobs));
+        }
+
         // Connect new blocks.
         for (CBlockIndex *pindexConnect : reverse_iterate(vpindexToConnect)) {
             if (!ConnectTip(state, chainparams, pindexConnect, pindexConnect == pindexMostWork ? pblock : std::shared_ptr<const CBlock>(), connectTrace, disconnectpool)) {
@@ -5293,7 +5530,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
     }
 
     // Check proof-of-stake block signature
-    if (fCheckSig && !CheckBlockSignature(block))
+    if (fCheckSig && !block.fCheckedSignature && !CheckBlockSignature(block))
         return state.Invalid(ValidationInvalidReason::CONSENSUS, false, REJECT_INVALID, "bad-blk-signature", "bad proof-of-stake block signature");
 
     bool lastWasContract=false;
@@ -5543,8 +5780,12 @@ bool CChainState::UpdateHashProof(const CBlock& block, CValidationState& state,
     // Verify hash target and signature of coinstake tx
     if (block.IsProofOfStake())
     {
+        // The kernel may have been checked ahead during IBD, with the same stake coin as the view
         uint256 targetProofOfStake;
-        if (!CheckProofOfStake(pindex->pprev, state, *block.vtx[1], block.nBits, block.nTime, hashProof, targetProofOfStake, view))
+        Coin coinPrev;
+        bool fCheckedAhead = pstakeprefetcher && CheckStakePrevout(pindex->pprev, state, *block.vtx[1], view, coinPrev) &&
+                             pstakeprefetcher->getStake(hash, coinPrev, hashProof);
+        if (!fCheckedAhead && !CheckProofOfStake(pindex->pprev, state, *block.vtx[1], block.nBits, block.nTime, hashProof, targetProofOfStake, view))
         {
             return error("UpdateHashProof() : check proof-of-stake failed for block %s", hash.ToString());
         }
@@ -5951,6 +6192,12 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
         // Therefore, the following critical section must include the CheckBlock() call as well.
         LOCK(cs_main);
 
+        // Read the coins the block spends from the database while it is checked and stored
+        CCoinsViewPrefetch& prefetch = ::ChainstateActive().CoinsPrefetch();
+        if (prefetch.hasWorkers()) {
+            prefetch.prefetchBlock(*pblock, ::ChainstateActive().CoinsTip());
+        }
+
         // Ensure that CheckBlock() passes before calling AcceptBlock, as
         // belt-and-suspenders.
         bool ret = CheckBlock(*pblock, state, chainparams.GetConsensus());
@@ -6752,6 +6999,7 @@ bool RewindBlockIndex(const CChainParams& params) {
 void CChainState::UnloadBlockIndex() {
     nBlockSequenceId = 1;
     setBlockIndexCandidates.clear();
+    m_recent_spends.clear();
 }
 
 // May NOT be used after any connections are up as much
@@ -7223,6 +7471,255 @@ int VersionBitsTipStateSinceHeight(const Consensus::Params& params, Consensus::D
 }
 
 static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+/** Dumps that store the validated entries with their cached metadata */
+static const uint64_t MEMPOOL_SNAPSHOT_VERSION = 2;
+/** Snapshot entries added to the mempool per hold of cs_main while loading */
+static const size_t MEMPOOL_LOAD_BATCH = 1000;
+
+namespace {
+
+/** A mempool entry as stored in a snapshot, with what was found validating it */
+struct MempoolSnapshotEntry
+{
+    CTransactionRef tx;
+    int64_t nTime;
+    int64_t nFeeDelta;
+    CAmount nFee;
+    int64_t nSigOpCost;
+    bool fSpendsCoinbase;
+    CAmount nMinGasPrice;
+    uint64_t nGasLimit;
+    uint64_t nBlockGasLimit;
+    uint256 hashPreExecBlock;
+    uint64_t nEstimatedGas;
+    CAmount nGasRefund;
+    bool fPreExecFailed;
+
+    MempoolSnapshotEntry() : nTime(0), nFeeDelta(0), nFee(0), nSigOpCost(0), fSpendsCoinbase(false), nMinGasPrice(0),
+        nGasLimit(0), nBlockGasLimit(0), nEstimatedGas(0), nGasRefund(0), fPreExecFailed(false) {}
+
+    explicit MempoolSnapshotEntry(const CTxMemPoolEntry& entry) : tx(entry.GetSharedTx()), nTime(entry.GetTime()),
+        nFeeDelta(entry.GetModifiedFee() - entry.GetFee()), nFee(entry.GetFee()), nSigOpCost(entry.GetSigOpCost()),
+        fSpendsCoinbase(entry.GetSpendsCoinbase()), nMinGasPrice(entry.GetMinGasPrice()), nGasLimit(entry.GetGasLimit()),
+        nBlockGasLimit(entry.GetBlockGasLimit()), hashPreExecBlock(entry.GetPreExecBlock()), nEstimatedGas(entry.GetEstimatedGas()),
+        nGasRefund(entry.GetGasRefund()), fPreExecFailed(entry.PreExecFailed()) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(tx);
+        READWRITE(nTime);
+        READWRITE(nFeeDelta);
+        READWRITE(nFee);
+        READWRITE(nSigOpCost);
+        READWRITE(fSpendsCoinbase);
+        READWRITE(nMinGasPrice);
+        READWRITE(nGasLimit);
+        READWRITE(nBlockGasLimit);
+        READWRITE(hashPreExecBlock);
+        READWRITE(nEstimatedGas);
+        READWRITE(nGasRefund);
+        READWRITE(fPreExecFailed);
+    }
+};
+
+struct MempoolLoadStats
+{
+    int64_t count = 0;
+    int64_t restored = 0;
+    int64_t expired = 0;
+    int64_t failed = 0;
+    int64_t already_there = 0;
+};
+
+} // anon namespace
+
+/**
+ * Hash of the node settings the acceptance of a tx depends on besides the chain state. A
+ * snapshot taken with other settings may hold entries this node would reject.
+ */
+static uint256 GetMempoolPolicyHash()
+{
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << ::minRelayTxFee.GetFeePerK() << ::incrementalRelayFee.GetFeePerK() << ::dustRelayFee.GetFeePerK();
+    ss << fRequireStandard << ::fIsBareMultisigStd << ::nBytesPerSigOp << fAcceptDatacarrier << nMaxDatacarrierBytes;
+    ss << gArgs.GetArg("-minmempoolgaslimit", MEMPOOL_MIN_GAS_LIMIT);
+    ss << gArgs.GetArg("-limitancestorcount", DEFAULT_ANCESTOR_LIMIT) << gArgs.GetArg("-limitancestorsize", DEFAULT_ANCESTOR_SIZE_LIMIT);
+    ss << gArgs.GetArg("-limitdescendantcount", DEFAULT_DESCENDANT_LIMIT) << gArgs.GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT);
+    return ss.GetHash();
+}
+
+/** Add a dumped transaction to the mempool through the full acceptance checks */
+static void AcceptMempoolDumpTx(const CChainParams& chainparams, CTxMemPool& pool, const CTransactionRef& tx, int64_t nTime, MempoolLoadStats& stats) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    CValidationState state;
+    AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, nullptr /* pfMissingInputs */, nTime,
+                               nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */,
+                               false /* test_accept */);
+    if (state.IsValid()) {
+        ++stats.count;
+    } else {
+        // mempool may contain the transaction already, e.g. from
+        // wallet(s) having loaded it while we were processing
+        // mempool transactions; consider these as valid, instead of
+        // failed, but mark them as 'already there'
+        if (pool.exists(tx->GetHash())) {
+            ++stats.already_there;
+        } else {
+            ++stats.failed;
+        }
+    }
+}
+
+/**
+ * Add a snapshot entry to the mempool without the contract checks. The snapshot was taken
+ * on the current tip by this version with the same policy settings, so the contract outputs,
+ * senders and gas prices of the tx were checked against the same chain state and DGP
+ * parameters. The checks that only depend on the coins spent are run again: the inputs must
+ * be unspent and not spent by another mempool tx, the lock times must be satisfied, the fee
+ * is recomputed from the inputs, the scripts are verified and the package limits are applied.
+ * @return false if the tx has to go through the full acceptance checks
+ */
+static bool RestoreMempoolEntry(CTxMemPool& pool, const MempoolSnapshotEntry& snap) EXCLUSIVE_LOCKS_REQUIRED(cs_main, pool.cs)
+{
+    const CTransaction& tx = *snap.tx;
+    CCoinsViewCache& coins = ::ChainstateActive().CoinsTip();
+    CCoinsViewMemPool viewMemPool(&coins, pool);
+    CCoinsViewCache view(&viewMemPool);
+    for (const CTxIn& txin : tx.vin) {
+        if (pool.GetConflictTx(txin.prevout))
+            return false;
+        if (!view.HaveCoin(txin.prevout))
+            return false;
+    }
+    if (!CheckFinalTx(tx, STANDARD_LOCKTIME_VERIFY_FLAGS))
+        return false;
+    LockPoints lp;
+    if (!CheckSequenceLocks(pool, tx, STANDARD_LOCKTIME_VERIFY_FLAGS, &lp))
+        return false;
+
+    // The contract checks compared the gas of the tx to this fee, a different one needs them again
+    CValidationState state;
+    CAmount nFee = 0;
+    if (!Consensus::CheckTxInputs(tx, state, view, GetSpendHeight(view), nFee) || nFee != snap.nFee)
+        return false;
+    int64_t nSigOpCost = GetTransactionSigOpCost(tx, view, STANDARD_SCRIPT_VERIFY_FLAGS);
+    bool fSpendsCoinbase = false;
+    for (const CTxIn& txin : tx.vin) {
+        const Coin& coin = view.AccessCoin(txin.prevout);
+        if (coin.IsCoinBase() || coin.IsCoinStake()) {
+            fSpendsCoinbase = true;
+            break;
+        }
+    }
+    PrecomputedTransactionData txdata(tx);
+    if (!CheckInputs(tx, state, view, STANDARD_SCRIPT_VERIFY_FLAGS, true, false, txdata))
+        return false;
+
+    CTxMemPoolEntry entry(snap.tx, nFee, snap.nTime, ::ChainActive().Height(), fSpendsCoinbase,
+                          nSigOpCost, lp, snap.nMinGasPrice, snap.nGasLimit, snap.nBlockGasLimit);
+    if (!snap.hashPreExecBlock.IsNull())
+        entry.UpdatePreExecution(snap.hashPreExecBlock, snap.nEstimatedGas, snap.nGasRefund, snap.fPreExecFailed);
+
+    // Entries that were let in before the restored ones are counted against the limits as well
+    CTxMemPool::setEntries setAncestors;
+    size_t nLimitAncestors = gArgs.GetArg("-limitancestorcount", DEFAULT_ANCESTOR_LIMIT);
+    size_t nLimitAncestorSize = gArgs.GetArg("-limitancestorsize", DEFAULT_ANCESTOR_SIZE_LIMIT)*1000;
+    size_t nLimitDescendants = gArgs.GetArg("-limitdescendantcount", DEFAULT_DESCENDANT_LIMIT);
+    size_t nLimitDescendantSize = gArgs.GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT)*1000;
+    std::string errString;
+    if (!pool.CalculateMemPoolAncestors(entry, setAncestors, nLimitAncestors, nLimitAncestorSize, nLimitDescendants, nLimitDescendantSize, errString))
+        return false;
+
+#ifdef ENABLE_BITCORE_RPC
+    if (fAddressIndex)
+    {
+        pool.addAddressIndex(entry, view);
+        pool.addSpentIndex(entry, view);
+    }
+#endif
+
+    pool.addUnchecked(entry, setAncestors, false);
+    GetMainSignals().TransactionAddedToMempool(snap.tx);
+    return true;
+}
+
+/**
+ * Load a snapshot taken by DumpMempool. If it was taken on the current tip by this version
+ * with the same policy settings, its entries are restored with their cached metadata in
+ * batches, the node keeps serving in between. A snapshot taken on another tip or with other
+ * settings, or an entry that can not be restored, goes through the full acceptance checks
+ * like the transactions of an older dump.
+ */
+static bool LoadMempoolSnapshot(CTxMemPool& pool, CAutoFile& file, MempoolLoadStats& stats)
+{
+    const CChainParams& chainparams = Params();
+    int64_t nExpiryTimeout = gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
+    int64_t nNow = GetTime();
+
+    int nVersionThatWrote;
+    uint256 hashTip;
+    uint256 hashPolicy;
+    file >> nVersionThatWrote >> hashTip >> hashPolicy;
+    bool fRestore;
+    bool fSamePolicy;
+    {
+        LOCK(cs_main);
+        fRestore = nVersionThatWrote == CLIENT_VERSION && ::ChainActive().Tip() && ::ChainActive().Tip()->GetBlockHash() == hashTip;
+        // The relay fees follow the DGP of the tip, they are only comparable on the same tip
+        fSamePolicy = fRestore && hashPolicy == GetMempoolPolicyHash();
+    }
+    if (!fRestore) {
+        LogPrintf("Mempool snapshot was taken on block %s by version %d, validating its transactions again\n", hashTip.ToString(), nVersionThatWrote);
+    } else if (!fSamePolicy) {
+        LogPrintf("Mempool snapshot was taken with other policy settings, validating its transactions again\n");
+        fRestore = false;
+    }
+
+    uint64_t num;
+    file >> num;
+    while (num) {
+        std::vector<MempoolSnapshotEntry> batch;
+        while (num && batch.size() < MEMPOOL_LOAD_BATCH) {
+            batch.emplace_back();
+            file >> batch.back();
+            num--;
+        }
+
+        LOCK2(cs_main, pool.cs);
+        // A block connected since the last batch changed the chain state the entries were checked against
+        if (fRestore && ::ChainActive().Tip()->GetBlockHash() != hashTip) {
+            LogPrintf("Tip changed while loading the mempool snapshot, validating the remaining transactions again\n");
+            fRestore = false;
+        }
+        for (const MempoolSnapshotEntry& snap : batch) {
+            if (snap.nTime + nExpiryTimeout <= nNow) {
+                ++stats.expired;
+                continue;
+            }
+            if (snap.nFeeDelta) {
+                pool.PrioritiseTransaction(snap.tx->GetHash(), snap.nFeeDelta);
+            }
+            if (pool.exists(snap.tx->GetHash())) {
+                ++stats.already_there;
+            } else if (fRestore && RestoreMempoolEntry(pool, snap)) {
+                ++stats.count;
+                ++stats.restored;
+            } else {
+                AcceptMempoolDumpTx(chainparams, pool, snap.tx, snap.nTime, stats);
+            }
+        }
+        if (ShutdownRequested())
+            return false;
+    }
+
+    if (stats.restored) {
+        LOCK2(cs_main, pool.cs);
+        LimitMempoolSize(pool, gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, nExpiryTimeout);
+    }
+    return true;
+}
 
 bool LoadMempool(CTxMemPool& pool)
 {
@@ -7235,56 +7732,42 @@ bool LoadMempool(CTxMemPool& pool)
         return false;
     }
 
-    int64_t count = 0;
-    int64_t expired = 0;
-    int64_t failed = 0;
-    int64_t already_there = 0;
+    MempoolLoadStats stats;
     int64_t nNow = GetTime();
+    int64_t nStart = GetTimeMillis();
 
     try {
         uint64_t version;
         file >> version;
-        if (version != MEMPOOL_DUMP_VERSION) {
-            return false;
-        }
-        uint64_t num;
-        file >> num;
-        while (num--) {
-            CTransactionRef tx;
-            int64_t nTime;
-            int64_t nFeeDelta;
-            file >> tx;
-            file >> nTime;
-            file >> nFeeDelta;
-
-            CAmount amountdelta = nFeeDelta;
-            if (amountdelta) {
-                pool.PrioritiseTransaction(tx->GetHash(), amountdelta);
-            }
-            CValidationState state;
-            if (nTime + nExpiryTimeout > nNow) {
-                LOCK(cs_main);
-                AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, nullptr /* pfMissingInputs */, nTime,
-                                           nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */,
-                                           false /* test_accept */);
-                if (state.IsValid()) {
-                    ++count;
+        if (version == MEMPOOL_SNAPSHOT_VERSION) {
+            if (!LoadMempoolSnapshot(pool, file, stats))
+                return false;
+        } else if (version == MEMPOOL_DUMP_VERSION) {
+            uint64_t num;
+            file >> num;
+            while (num--) {
+                CTransactionRef tx;
+                int64_t nTime;
+                int64_t nFeeDelta;
+                file >> tx;
+                file >> nTime;
+                file >> nFeeDelta;
+
+                CAmount amountdelta = nFeeDelta;
+                if (amountdelta) {
+                    pool.PrioritiseTransaction(tx->GetHash(), amountdelta);
+                }
+                if (nTime + nExpiryTimeout > nNow) {
+                    LOCK(cs_main);
+                    AcceptMempoolDumpTx(chainparams, pool, tx, nTime, stats);
                 } else {
-                    // mempool may contain the transaction already, e.g. from
-                    // wallet(s) having loaded it while we were processing
-                    // mempool transactions; consider these as valid, instead of
-                    // failed, but mark them as 'already there'
-                    if (pool.exists(tx->GetHash())) {
-                        ++already_there;
-                    } else {
-                        ++failed;
-                    }
+                    ++stats.expired;
                 }
-            } else {
-                ++expired;
+                if (ShutdownRequested())
+                    return false;
             }
-            if (ShutdownRequested())
-                return false;
+        } else {
+            return false;
         }
         std::map<uint256, CAmount> mapDeltas;
         file >> mapDeltas;
@@ -7297,7 +7780,8 @@ bool LoadMempool(CTxMemPool& pool)
         return false;
     }
 
-    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there\n", count, failed, expired, already_there);
+    LogPrintf("Imported mempool transactions from disk: %i succeeded (%i restored from the snapshot), %i failed, %i expired, %i already there (%dms)\n",
+              stats.count, stats.restored, stats.failed, stats.expired, stats.already_there, GetTimeMillis() - nStart);
     return true;
 }
 
@@ -7306,17 +7790,23 @@ bool DumpMempool(const CTxMemPool& pool)
     int64_t start = GetTimeMicros();
 
     std::map<uint256, CAmount> mapDeltas;
-    std::vector<TxMempoolInfo> vinfo;
+    std::vector<CTxMemPoolEntry> ventries;
+    uint256 hashTip;
+    uint256 hashPolicy;
 
     static Mutex dump_mutex;
     LOCK(dump_mutex);
 
     {
-        LOCK(pool.cs);
+        // The entries were checked against the chain state of this tip and these settings
+        LOCK2(cs_main, pool.cs);
+        if (::ChainActive().Tip())
+            hashTip = ::ChainActive().Tip()->GetBlockHash();
+        hashPolicy = GetMempoolPolicyHash();
         for (const auto &i : pool.mapDeltas) {
             mapDeltas[i.first] = i.second;
         }
-        vinfo = pool.infoAll();
+        ventries = pool.entryAll();
     }
 
     int64_t mid = GetTimeMicros();
@@ -7329,15 +7819,16 @@ bool DumpMempool(const CTxMemPool& pool)
 
         CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
 
-        uint64_t version = MEMPOOL_DUMP_VERSION;
+        uint64_t version = MEMPOOL_SNAPSHOT_VERSION;
         file << version;
-
-        file << (uint64_t)vinfo.size();
-        for (const auto& i : vinfo) {
-            file << *(i.tx);
-            file << (int64_t)i.nTime;
-            file << (int64_t)i.nFeeDelta;
-            mapDeltas.erase(i.tx->GetHash());
+        file << CLIENT_VERSION;
+        file << hashTip;
+        file << hashPolicy;
+
+        file << (uint64_t)ventries.size();
+        for (const CTxMemPoolEntry& entry : ventries) {
+            file << MempoolSnapshotEntry(entry);
+            mapDeltas.erase(entry.GetTx().GetHash());
         }
 
         file << mapDeltas;
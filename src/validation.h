@@ -12,6 +12,7 @@
 
 #include <amount.h>
 #include <coins.h>
+#include <coinswriter.h>
 #include <crypto/common.h> // for ReadLE64
 #include <fs.h>
 #include <policy/feerate.h>
@@ -20,6 +21,7 @@
 #include <sync.h>
 #include <txmempool.h> // For CTxMemPool::cs
 #include <txdb.h>
+#include <utxoprefetch.h>
 #include <versionbits.h>
 
 #include <algorithm>
@@ -46,12 +48,13 @@ class CWalletTx;
 #include <libethashseal/GenesisInfo.h>
 #include <script/standard.h>
 #include <qtum/storageresults.h>
+#include <qtum/recentspends.h>
 
 
 extern std::unique_ptr<QtumState> globalState;
 extern std::shared_ptr<dev::eth::SealEngineFace> globalSealEngine;
 extern bool fRecordLogOpcodes;
-extern bool fIsVMlogFile;
+extern bool fPipelinedConnect;
 extern bool fGettingValuesDGP;
 
 struct EthTransactionParams;
@@ -294,6 +297,8 @@ bool LoadBlockIndex(const CChainParams& chainparams) EXCLUSIVE_LOCKS_REQUIRED(cs
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck(int worker_num);
+/** Run an instance of the contract checking thread */
+void ThreadContractCheck(int worker_num);
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
 bool GetTransaction(const uint256& hash, CTransactionRef& tx, const Consensus::Params& params, uint256& hashBlock, const CBlockIndex* const blockIndex = nullptr, bool fAllowSlow = false);
 /**
@@ -455,6 +460,7 @@ bool CheckIndexProof(const CBlockIndex& block, const Consensus::Params& consensu
 /** Context-independent validity checks */
 bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckMerkleRoot = true, bool fCheckSig=true);
 bool GetBlockPublicKey(const CBlock& block, std::vector<unsigned char>& vchPubKey);
+bool CheckBlockSignature(const CBlock& block);
 bool SignBlock(std::shared_ptr<CBlock> pblock, CWallet& wallet, const CAmount& nTotalFees, uint32_t nTime, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoins);
 bool CheckCanonicalBlockSignature(const CBlockHeader* pblock);
 
@@ -510,7 +516,7 @@ bool CheckOpSender(const CTransaction& tx, const CChainParams& chainparams, int
 
 bool CheckSenderScript(const CCoinsViewCache& view, const CTransaction& tx);
 
-bool CheckMinGasPrice(std::vector<EthTransactionParams>& etps, const uint64_t& minGasPrice);
+bool CheckMinGasPrice(const std::vector<EthTransactionParams>& etps, const uint64_t& minGasPrice);
 
 void writeVMlog(const std::vector<ResultExecute>& res, const CTransaction& tx = CTransaction(), const CBlock& block = CBlock());
 
@@ -539,11 +545,101 @@ struct ByteCodeExecResult{
     std::vector<CTransaction> valueTransfers;
 };
 
+/** The values of a block the contract checks of its txs depend on */
+struct ContractCheckParams{
+    unsigned int contractflags = 0;
+    uint64_t minGasPrice = 0;
+    uint64_t blockGasLimit = 0;
+};
+
+/**
+ * The checks of ConnectBlock on a contract tx that only read the tx and the coins it spends: the
+ * sender script, the format of the contract outputs, the VM version, gas limit and gas price of
+ * each execution and that the fee covers the gas. extracted is left with the executions.
+ */
+bool CheckContractTx(const CTransaction& tx, const CCoinsViewCache& view, const std::vector<CTransactionRef>* blockTxs, const ContractCheckParams& params, CValidationState& state, ExtractQtumTX& extracted);
+
+/** Whether tx passed CheckContractTx with params at mempool acceptance or in a checked block template */
+bool IsContractCheckCached(const CTransaction& tx, const ContractCheckParams& params, bool fErase) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+void AddContractCheckCache(const CTransaction& tx, const ContractCheckParams& params) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+/** The result of a CContractCheck, fValid is false when ConnectBlock has to check the tx itself */
+struct ContractCheckResult{
+    bool fValid = false;
+    ExtractQtumTX extracted;
+};
+
+/**
+ * The results of the CContractChecks of a block by tx index. The checks read their own copies
+ * of the coins and do not depend on each other, so ConnectBlock only waits for the check of the
+ * tx it reaches instead of all the checks of the block.
+ */
+class ContractCheckResults
+{
+public:
+    explicit ContractCheckResults(size_t nTxs) : results(nTxs), done(nTxs, false) {}
+
+    ContractCheckResult& operator[](size_t i) { return results[i]; }
+
+    /** The result at i is final, set once its check ran or for a tx without a check */
+    void setDone(size_t i);
+
+    /** Wait until the result at i is final */
+    void wait(size_t i);
+
+private:
+    std::vector<ContractCheckResult> results;
+    Mutex cs_done;
+    std::condition_variable condDone;
+    std::vector<bool> done GUARDED_BY(cs_done);
+};
+
+/**
+ * Closure running CheckContractTx for a tx of a block on the contract check threads, against
+ * copies of the coins it spends. A tx found in the contract check cache is only extracted.
+ * The result goes to index nIndex of the results, which is then set done.
+ * Note that this stores references to the tx, the txs of the block and the results.
+ */
+class CContractCheck
+{
+private:
+    const CTransaction *ptx;
+    const std::vector<CTransactionRef> *pblockTxs;
+    ContractCheckParams params;
+    std::vector<std::pair<COutPoint, Coin>> coins;
+    bool fCached;
+    ContractCheckResults *presults;
+    size_t nIndex;
+
+public:
+    CContractCheck(): ptx(nullptr), pblockTxs(nullptr), fCached(false), presults(nullptr), nIndex(0) {}
+    CContractCheck(const CTransaction& txIn, const std::vector<CTransactionRef>& blockTxsIn, const ContractCheckParams& paramsIn,
+                   std::vector<std::pair<COutPoint, Coin>>&& coinsIn, bool fCachedIn, ContractCheckResults* presultsIn, size_t nIndexIn) :
+        ptx(&txIn), pblockTxs(&blockTxsIn), params(paramsIn), coins(std::move(coinsIn)), fCached(fCachedIn), presults(presultsIn), nIndex(nIndexIn) { }
+
+    bool operator()();
+
+    void swap(CContractCheck &check) {
+        std::swap(ptx, check.ptx);
+        std::swap(pblockTxs, check.pblockTxs);
+        std::swap(params, check.params);
+        coins.swap(check.coins);
+        std::swap(fCached, check.fCached);
+        std::swap(presults, check.presults);
+        std::swap(nIndex, check.nIndex);
+    }
+};
+
 class QtumTxConverter{
 
 public:
 
-    QtumTxConverter(CTransaction tx, CCoinsViewCache* v = NULL, const std::vector<CTransactionRef>* blockTxs = NULL, unsigned int flags = SCRIPT_EXEC_BYTE_CODE) : txBit(tx), view(v), blockTransactions(blockTxs), sender(false), nFlags(flags){}
+    /** tx is referenced, not copied, and must outlive the converter */
+    QtumTxConverter(const CTransaction& tx, const CCoinsViewCache* v = NULL, const std::vector<CTransactionRef>* blockTxs = NULL, unsigned int flags = SCRIPT_EXEC_BYTE_CODE) : txBit(tx), view(v), blockTransactions(blockTxs), sender(false), nFlags(flags){}
+
+    /** A temporary, including one converted from a CMutableTransaction, would not outlive it */
+    QtumTxConverter(CTransaction&& tx, const CCoinsViewCache* v = NULL, const std::vector<CTransactionRef>* blockTxs = NULL, unsigned int flags = SCRIPT_EXEC_BYTE_CODE) = delete;
 
     bool extractionQtumTransactions(ExtractQtumTX& qtumTx);
 
@@ -557,7 +653,7 @@ private:
 
     size_t correctedStackSize(size_t size);
 
-    const CTransaction txBit;
+    const CTransaction& txBit;
     const CCoinsViewCache* view;
     std::vector<valtype> stack;
     opcodetype opcode;
@@ -567,6 +663,31 @@ private:
     unsigned int nFlags;
 };
 
+/**
+ * The hashes of the last 256 blocks of the tip contracts execute on, and the header of the block
+ * they execute in, shared read-only by all the executions at that tip instead of rebuilt for each
+ * contract tx. When the tip moves by one block the hashes are derived from those of the previous tip.
+ */
+class EVMEnvironmentCache
+{
+public:
+    /** The hashes of tip and its 255 ancestors, newest first */
+    std::shared_ptr<const dev::h256s> lastHashes(const CBlockIndex* tip);
+
+    /** The header template of a block on top of tip */
+    std::shared_ptr<const dev::eth::BlockHeader> header(const CBlockIndex* tip, uint32_t nTime, uint32_t nBits, uint64_t gasLimit, const dev::Address& author);
+
+    void clear();
+
+private:
+    Mutex cs_cache;
+    uint256 hashTip GUARDED_BY(cs_cache);
+    std::shared_ptr<const dev::h256s> tipHashes GUARDED_BY(cs_cache);
+    std::shared_ptr<const dev::eth::BlockHeader> blockHeader GUARDED_BY(cs_cache);
+};
+
+extern EVMEnvironmentCache evmEnvironmentCache;
+
 class LastHashes: public dev::eth::LastBlockHashesFace
 {
 public:
@@ -579,14 +700,14 @@ public:
     void clear();
 
 private:
-    dev::h256s m_lastHashes;
+    std::shared_ptr<const dev::h256s> m_lastHashes;
 };
 
 class ByteCodeExec {
 
 public:
 
-    ByteCodeExec(const CBlock& _block, std::vector<QtumTransaction> _txs, const uint64_t _blockGasLimit, CBlockIndex* _pindex) : txs(_txs), block(_block), blockGasLimit(_blockGasLimit), pindex(_pindex) {}
+    ByteCodeExec(const CBlock& _block, std::vector<QtumTransaction> _txs, const uint64_t _blockGasLimit, CBlockIndex* _pindex) : txs(std::move(_txs)), block(_block), blockGasLimit(_blockGasLimit), pindex(_pindex) {}
 
     bool performByteCode(dev::eth::Permanence type = dev::eth::Permanence::Committed);
 
@@ -594,6 +715,8 @@ public:
 
     std::vector<ResultExecute>& getResult(){ return result; }
 
+    const std::vector<QtumTransaction>& getTxs() const { return txs; }
+
 private:
 
     dev::eth::EnvInfo BuildEVMEnvironment();
@@ -611,6 +734,8 @@ private:
     CBlockIndex* pindex;
 
     LastHashes lastHashes;
+
+    std::shared_ptr<const dev::eth::BlockHeader> header;
 };
 
 /** Find the last common block between the parameter chain and a locator. */
@@ -726,6 +851,14 @@ public:
     //! This view wraps access to the leveldb instance and handles read errors gracefully.
     CCoinsViewErrorCatcher m_catcherview GUARDED_BY(cs_main);
 
+    //! Holds the coins of a flush of m_cacheview until a background thread has written
+    //! them to m_dbview. Locks internally.
+    CCoinsViewWriteBehind m_writeview;
+
+    //! Staging layer the coins spent by incoming blocks are read into ahead of their
+    //! connection. Locks internally, the prefetch threads use it without cs_main.
+    CCoinsViewPrefetch m_prefetchview;
+
     //! This is the top layer of the cache hierarchy - it keeps as many coins in memory as
     //! can fit per the dbcache setting.
     std::unique_ptr<CCoinsViewCache> m_cacheview GUARDED_BY(cs_main);
@@ -835,6 +968,12 @@ public:
      */
     std::set<std::pair<COutPoint, unsigned int>> setStakeSeen;
 
+    /**
+     * The outpoints spent in the last COINBASE_MATURITY blocks of m_chain, used to check
+     * the stakes of fork blocks without reading the undo data of the main chain.
+     */
+    RecentSpends m_recent_spends{COINBASE_MATURITY};
+
     //! @returns A reference to the in-memory cache of the UTXO set.
     CCoinsViewCache& CoinsTip() EXCLUSIVE_LOCKS_REQUIRED(cs_main)
     {
@@ -855,6 +994,18 @@ public:
         return m_coins_views->m_catcherview;
     }
 
+    //! @returns A reference to the layer writing the flushed coins to disk.
+    CCoinsViewWriteBehind& CoinsWriteBehind()
+    {
+        return m_coins_views->m_writeview;
+    }
+
+    //! @returns A reference to the staging layer of the coins read ahead of the blocks.
+    CCoinsViewPrefetch& CoinsPrefetch()
+    {
+        return m_coins_views->m_prefetchview;
+    }
+
     //! Destructs all objects related to accessing the UTXO set.
     void ResetCoinsViews() { m_coins_views.reset(); }
 
@@ -906,7 +1057,7 @@ public:
     // Block (dis)connection on a given view:
     DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean);
     bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex,
-                      CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck = false) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+                      CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck = false, CBlockUndo* pblockundo = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     bool UpdateHashProof(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, CBlockIndex* pindex, CCoinsViewCache& view);
 
     // Apply the effects of a block disconnection on the UTXO set.
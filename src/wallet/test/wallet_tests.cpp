@@ -463,6 +463,43 @@ BOOST_FIXTURE_TEST_CASE(ListCoins, ListCoinsTestingSetup)
     BOOST_CHECK_EQUAL(list.begin()->second.size(), 2U);
 }
 
+static std::set<COutPoint> AvailableOutPoints(interfaces::Chain& chain, CWallet& wallet)
+{
+    auto locked_chain = chain.lock();
+    LOCK(wallet.cs_wallet);
+    std::vector<COutput> available;
+    wallet.AvailableCoins(*locked_chain, available);
+    std::set<COutPoint> outpoints;
+    for (const COutput& coin : available) {
+        outpoints.insert(COutPoint(coin.tx->GetHash(), coin.i));
+    }
+    return outpoints;
+}
+
+BOOST_FIXTURE_TEST_CASE(AvailableCoinsIncremental, ListCoinsTestingSetup)
+{
+    // The coins and balances kept up to date from the notifications match a walk of the
+    // whole wallet, which MarkDirty forces
+    for (int i = 0; i < 3; i++) {
+        std::set<COutPoint> available = AvailableOutPoints(*m_chain, *wallet);
+        CWallet::Balance balance = wallet->GetBalance();
+        BOOST_CHECK(!available.empty());
+        wallet->MarkDirty();
+        BOOST_CHECK(available == AvailableOutPoints(*m_chain, *wallet));
+        CWallet::Balance rebuilt = wallet->GetBalance();
+        BOOST_CHECK_EQUAL(balance.m_mine_trusted, rebuilt.m_mine_trusted);
+        BOOST_CHECK_EQUAL(balance.m_mine_immature, rebuilt.m_mine_immature);
+        BOOST_CHECK_EQUAL(balance.m_mine_stake, rebuilt.m_mine_stake);
+
+        // Spending a coin takes it out of the available ones
+        CWalletTx& wtx = AddTx(CRecipient{GetScriptForRawPubKey({}), 1 * COIN, false /* subtract fee */});
+        std::set<COutPoint> after = AvailableOutPoints(*m_chain, *wallet);
+        for (const CTxIn& txin : wtx.tx->vin) {
+            BOOST_CHECK(!after.count(txin.prevout));
+        }
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(wallet_disableprivkeys, TestChain100Setup)
 {
     auto chain = interfaces::MakeChain();
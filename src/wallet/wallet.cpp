@@ -829,6 +829,7 @@ bool CWallet::IsSpent(interfaces::Chain::Lock& locked_chain, const uint256& hash
 void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 {
     mapTxSpends.insert(std::make_pair(outpoint, wtxid));
+    MarkUnspentDirty(outpoint.hash);
 
     setLockedCoins.erase(outpoint);
 
@@ -847,6 +848,7 @@ void CWallet::RemoveFromSpends(const COutPoint& outpoint, const uint256& wtxid)
         if(it->second == wtxid)
         {
             mapTxSpends.erase(it);
+            MarkUnspentDirty(outpoint.hash);
             break;
         }
     }
@@ -878,6 +880,73 @@ void CWallet::RemoveFromSpends(const uint256& wtxid)
         RemoveFromSpends(txin.prevout, wtxid);
 }
 
+void CWallet::MarkUnspentDirty(const uint256& wtxid)
+{
+    // Everything is evaluated on the first walk after a reset
+    if (fUnspentTxsValid)
+        setUnspentDirty.insert(wtxid);
+}
+
+bool CWallet::IsUnspentCandidate(const CWalletTx& wtx) const
+{
+    const uint256& wtxid = wtx.GetHash();
+    for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+        if (IsMine(wtx.tx->vout[i]) == ISMINE_NO)
+            continue;
+        bool fSpentConfirmed = false;
+        std::pair<TxSpends::const_iterator, TxSpends::const_iterator> range = mapTxSpends.equal_range(COutPoint(wtxid, i));
+        for (TxSpends::const_iterator it = range.first; it != range.second && !fSpentConfirmed; ++it) {
+            auto mit = mapWallet.find(it->second);
+            fSpentConfirmed = mit != mapWallet.end() && mit->second.m_confirm.status == CWalletTx::CONFIRMED;
+        }
+        if (!fSpentConfirmed)
+            return true;
+    }
+    return false;
+}
+
+bool CWallet::IsStakeMature(interfaces::Chain::Lock& locked_chain, const CWalletTx& wtx) const
+{
+    return wtx.GetDepthInMainChain(locked_chain) >= COINBASE_MATURITY && wtx.GetBlocksToMaturity(locked_chain) == 0;
+}
+
+void CWallet::UpdateUnspentTxs(interfaces::Chain::Lock& locked_chain) const
+{
+    AssertLockHeld(cs_wallet);
+
+    std::vector<uint256> vUpdate;
+    if (!fUnspentTxsValid) {
+        setUnspentTxs.clear();
+        setUnspentImmature.clear();
+        setUnspentDirty.clear();
+        vUpdate.reserve(mapWallet.size());
+        for (const auto& entry : mapWallet)
+            vUpdate.push_back(entry.first);
+        fUnspentTxsValid = true;
+    } else {
+        vUpdate.assign(setUnspentDirty.begin(), setUnspentDirty.end());
+        setUnspentDirty.clear();
+    }
+
+    for (const uint256& wtxid : vUpdate) {
+        setUnspentTxs.erase(wtxid);
+        setUnspentImmature.erase(wtxid);
+        auto it = mapWallet.find(wtxid);
+        if (it == mapWallet.end() || !IsUnspentCandidate(it->second))
+            continue;
+        setUnspentTxs.insert(wtxid);
+        setUnspentImmature.insert(wtxid);
+    }
+
+    // Txs only move to the mature bucket here, their block being disconnected queues them again
+    for (std::set<uint256>::iterator it = setUnspentImmature.begin(); it != setUnspentImmature.end();) {
+        if (IsStakeMature(locked_chain, mapWallet.at(*it)))
+            it = setUnspentImmature.erase(it);
+        else
+            ++it;
+    }
+}
+
 bool CWallet::EncryptWallet(const SecureString& strWalletPassphrase)
 {
     if (IsCrypted())
@@ -1049,6 +1118,7 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         for (std::pair<const uint256, CWalletTx>& item : mapWallet)
             item.second.MarkDirty();
+        fUnspentTxsValid = false;
     }
 }
 
@@ -1183,6 +1253,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
 
     // Break debit/credit balance caches:
     wtx.MarkDirty();
+    MarkUnspentDirty(hash);
 
     // Notify UI of new or updated transaction
     NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
@@ -1223,6 +1294,7 @@ void CWallet::LoadToWallet(CWalletTx& wtxIn)
         wtx.m_it_wtxOrdered = wtxOrdered.insert(std::make_pair(wtx.nOrderPos, &wtx));
     }
     AddToSpends(hash);
+    MarkUnspentDirty(hash);
     for (const CTxIn& txin : wtx.tx->vin) {
         auto it = mapWallet.find(txin.prevout.hash);
         if (it != mapWallet.end()) {
@@ -1305,6 +1377,7 @@ void CWallet::MarkInputsDirty(const CTransactionRef& tx)
         auto it = mapWallet.find(txin.prevout.hash);
         if (it != mapWallet.end()) {
             it->second.MarkDirty();
+            MarkUnspentDirty(it->first);
         }
     }
 }
@@ -1346,6 +1419,7 @@ bool CWallet::AbandonTransaction(interfaces::Chain::Lock& locked_chain, const ui
             wtx.m_confirm.nIndex = 0;
             wtx.setAbandoned();
             wtx.MarkDirty();
+            MarkUnspentDirty(now);
             batch.WriteTx(wtx);
             NotifyTransactionChanged(this, wtx.GetHash(), CT_UPDATED);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them abandoned too
@@ -1401,6 +1475,7 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
             wtx.m_confirm.hashBlock = hashBlock;
             wtx.setConflicted();
             wtx.MarkDirty();
+            MarkUnspentDirty(now);
             batch.WriteTx(wtx);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them conflicted too
             TxSpends::const_iterator iter = mapTxSpends.lower_bound(COutPoint(now, 0));
@@ -2482,9 +2557,11 @@ CWallet::Balance CWallet::GetBalance(const int min_depth, bool avoid_reuse) cons
     {
         auto locked_chain = chain().lock();
         LOCK(cs_wallet);
-        for (const auto& entry : mapWallet)
+        // Txs with every output spent add nothing to any of the balances
+        UpdateUnspentTxs(*locked_chain);
+        for (const uint256& wtxid : setUnspentTxs)
         {
-            const CWalletTx& wtx = entry.second;
+            const CWalletTx& wtx = mapWallet.at(wtxid);
             const bool is_trusted{wtx.IsTrusted(*locked_chain)};
             const int tx_depth{wtx.GetDepthInMainChain(*locked_chain)};
             const CAmount tx_credit_mine{wtx.GetAvailableCredit(*locked_chain, /* fUseCache */ true, ISMINE_SPENDABLE | reuse_filter)};
@@ -2534,10 +2611,10 @@ void CWallet::AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<
     const int min_depth = {coinControl ? coinControl->m_min_depth : DEFAULT_MIN_DEPTH};
     const int max_depth = {coinControl ? coinControl->m_max_depth : DEFAULT_MAX_DEPTH};
 
-    for (const auto& entry : mapWallet)
+    UpdateUnspentTxs(locked_chain);
+    for (const uint256& wtxid : setUnspentTxs)
     {
-        const uint256& wtxid = entry.first;
-        const CWalletTx& wtx = entry.second;
+        const CWalletTx& wtx = mapWallet.at(wtxid);
 
         if (!locked_chain.checkFinalTx(*wtx.tx)) {
             continue;
@@ -2600,10 +2677,10 @@ void CWallet::AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<
             if (wtx.tx->vout[i].nValue < nMinimumAmount || wtx.tx->vout[i].nValue > nMaximumAmount)
                 continue;
 
-            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(entry.first, i)))
+            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(wtxid, i)))
                 continue;
 
-            if (IsLockedCoin(entry.first, i))
+            if (IsLockedCoin(wtxid, i))
                 continue;
 
             if (IsSpent(locked_chain, wtxid, i))
@@ -2648,10 +2725,13 @@ void CWallet::AvailableCoinsForStaking(interfaces::Chain::Lock& locked_chain, st
 
     vCoins.clear();
 
-    for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+    UpdateUnspentTxs(locked_chain);
+    for (const uint256& wtxid : setUnspentTxs)
     {
-        const uint256& wtxid = it->first;
-        const CWalletTx* pcoin = &(*it).second;
+        if (setUnspentImmature.count(wtxid))
+            continue;
+
+        const CWalletTx* pcoin = &mapWallet.at(wtxid);
         int nDepth = pcoin->GetDepthInMainChain(locked_chain);
 
         if (nDepth < 1)
@@ -2668,7 +2748,7 @@ void CWallet::AvailableCoinsForStaking(interfaces::Chain::Lock& locked_chain, st
             bool solvable = IsSolvable(*this, pcoin->tx->vout[i].scriptPubKey);
             bool spendable = ((mine & ISMINE_SPENDABLE) != ISMINE_NO) || (((mine & ISMINE_WATCH_ONLY) != ISMINE_NO) && solvable);
             if (!(IsSpent(locked_chain, wtxid, i)) && mine != ISMINE_NO &&
-                !IsLockedCoin((*it).first, i) && (pcoin->tx->vout[i].nValue > 0) &&
+                !IsLockedCoin(wtxid, i) && (pcoin->tx->vout[i].nValue > 0) &&
                 !pcoin->tx->vout[i].scriptPubKey.HasOpCall() && !pcoin->tx->vout[i].scriptPubKey.HasOpCreate())
                     vCoins.push_back(COutput(pcoin, i, nDepth, spendable, solvable, pcoin->IsTrusted(locked_chain)));
         }
@@ -3848,6 +3928,7 @@ DBErrors CWallet::ZapSelectTx(std::vector<uint256>& vHashIn, std::vector<uint256
         const auto& it = mapWallet.find(hash);
         wtxOrdered.erase(it->second.m_it_wtxOrdered);
         mapWallet.erase(it);
+        MarkUnspentDirty(hash);
         NotifyTransactionChanged(this, hash, CT_DELETED);
     }
 
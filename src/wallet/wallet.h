@@ -802,6 +802,23 @@ private:
     void AddToSpends(const uint256& wtxid) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void RemoveFromSpends(const uint256& wtxid) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
+    /**
+     * Wallet txs that may have outputs left to spend, walked by the balance, the coin
+     * listing and the staker instead of mapWallet. A tx is left out once every output
+     * that is mine is spent by a confirmed wallet tx. The txs below staking maturity are
+     * also kept in setUnspentImmature, the others are mature until their block is
+     * disconnected. Changed txs are queued in setUnspentDirty and evaluated again by
+     * UpdateUnspentTxs before the next walk.
+     */
+    mutable std::set<uint256> setUnspentTxs GUARDED_BY(cs_wallet);
+    mutable std::set<uint256> setUnspentImmature GUARDED_BY(cs_wallet);
+    mutable std::set<uint256> setUnspentDirty GUARDED_BY(cs_wallet);
+    mutable bool fUnspentTxsValid GUARDED_BY(cs_wallet) = false;
+    void MarkUnspentDirty(const uint256& wtxid) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    bool IsUnspentCandidate(const CWalletTx& wtx) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    bool IsStakeMature(interfaces::Chain::Lock& locked_chain, const CWalletTx& wtx) const;
+    void UpdateUnspentTxs(interfaces::Chain::Lock& locked_chain) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
     /**
      * Add a transaction to the wallet, or update it.  pIndex and posInBlock should
      * be set when the transaction was known to be included in a block.  When
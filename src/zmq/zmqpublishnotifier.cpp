@@ -8,7 +8,9 @@
 #include <zmq/zmqpublishnotifier.h>
 #include <validation.h>
 #include <util/system.h>
+#include <util/convert.h>
 #include <rpc/server.h>
+#include <qtum/storageresults.h>
 
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
@@ -16,6 +18,8 @@ static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
+static const char *MSG_CONTRACTLOGS = "contractlogs";
+static const char *MSG_RAWRECEIPT   = "rawreceipt";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -206,3 +210,142 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+template <typename Stream, unsigned N>
+static void WriteFixedHash(Stream& s, const dev::FixedHash<N>& hash)
+{
+    s.write((const char*)hash.data(), N);
+}
+
+static void SerializeLogEntry(CDataStream& ss, const dev::eth::LogEntry& log)
+{
+    WriteFixedHash(ss, log.address);
+    WriteCompactSize(ss, log.topics.size());
+    for (const dev::h256& topic : log.topics)
+        WriteFixedHash(ss, topic);
+    ss << log.data;
+}
+
+// Receipts of the block from the -logevents index, only contract txs and the coinstake have any.
+// Notifications run after the fact, false when the block was disconnected in between since its
+// receipts are gone from the index by then
+static bool ReadBlockReceipts(const CBlock& block, const CBlockIndex* pindex, std::vector<TransactionReceiptInfo>& receipts)
+{
+    LOCK(cs_main);
+    if (!::ChainActive().Contains(pindex))
+        return false;
+    uint256 hashBlock = pindex->GetBlockHash();
+    for (const CTransactionRef& tx : block.vtx) {
+        if (!tx->HasCreateOrCall() && !tx->IsCoinStake())
+            continue;
+        for (TransactionReceiptInfo& receipt : pstorageresult->getResult(uintToh256(tx->GetHash()))) {
+            // The index is keyed by txid, skip the receipts of the tx in other blocks
+            if (receipt.blockHash == hashBlock)
+                receipts.push_back(std::move(receipt));
+        }
+    }
+    return true;
+}
+
+bool CZMQAbstractReceiptNotifier::Publish(bool fRemoved, const uint256 &hash, int nHeight, const std::vector<char> &body)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << fRemoved << hash << nHeight;
+    ss.write(body.data(), body.size());
+    return SendMessage(GetCommand(), &(*ss.begin()), ss.size());
+}
+
+bool CZMQAbstractReceiptNotifier::NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex)
+{
+    uint256 hash = pindex->GetBlockHash();
+    std::vector<TransactionReceiptInfo> receipts;
+    if (!ReadBlockReceipts(block, pindex, receipts)) {
+        // Publishing it would claim the block has no receipts, its disconnect is not published either
+        LogPrint(BCLog::ZMQ, "zmq: Skip %s %s, disconnected since\n", GetCommand(), hash.GetHex());
+        setSkipped.insert(hash);
+        return true;
+    }
+    LogPrint(BCLog::ZMQ, "zmq: Publish %s %s\n", GetCommand(), hash.GetHex());
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    SerializeReceipts(ss, receipts);
+    std::vector<char> body(ss.begin(), ss.end());
+
+    // Keep the message of the recent blocks, their receipts are deleted from the index on disconnect
+    if (mapRecent.emplace(hash, std::make_pair(pindex->nHeight, body)).second)
+        recentOrder.push_back(hash);
+    while (recentOrder.size() > ZMQ_RECEIPT_REORG_CACHE) {
+        mapRecent.erase(recentOrder.front());
+        recentOrder.pop_front();
+    }
+
+    return Publish(false, hash, pindex->nHeight, body);
+}
+
+bool CZMQAbstractReceiptNotifier::NotifyBlockDisconnected(const CBlock &block)
+{
+    uint256 hash = block.GetHash();
+    // The disconnect that made the connect notification skip the block is queued after it
+    if (setSkipped.erase(hash))
+        return true;
+    LogPrint(BCLog::ZMQ, "zmq: Publish removed %s %s\n", GetCommand(), hash.GetHex());
+
+    auto it = mapRecent.find(hash);
+    if (it != mapRecent.end())
+        return Publish(true, hash, it->second.first, it->second.second);
+
+    // Connected before this notifier started or too long ago, the subscriber gets the block to drop
+    int nHeight = -1;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindex = LookupBlockIndex(hash);
+        if (pindex)
+            nHeight = pindex->nHeight;
+    }
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    SerializeReceipts(ss, std::vector<TransactionReceiptInfo>());
+    return Publish(true, hash, nHeight, std::vector<char>(ss.begin(), ss.end()));
+}
+
+const char* CZMQPublishContractLogsNotifier::GetCommand() const
+{
+    return MSG_CONTRACTLOGS;
+}
+
+void CZMQPublishContractLogsNotifier::SerializeReceipts(CDataStream &ss, const std::vector<TransactionReceiptInfo> &receipts) const
+{
+    size_t nLogs = 0;
+    for (const TransactionReceiptInfo& receipt : receipts)
+        nLogs += receipt.logs.size();
+
+    WriteCompactSize(ss, nLogs);
+    for (const TransactionReceiptInfo& receipt : receipts) {
+        for (const dev::eth::LogEntry& log : receipt.logs) {
+            ss << receipt.transactionHash << receipt.outputIndex;
+            SerializeLogEntry(ss, log);
+        }
+    }
+}
+
+const char* CZMQPublishRawReceiptNotifier::GetCommand() const
+{
+    return MSG_RAWRECEIPT;
+}
+
+void CZMQPublishRawReceiptNotifier::SerializeReceipts(CDataStream &ss, const std::vector<TransactionReceiptInfo> &receipts) const
+{
+    WriteCompactSize(ss, receipts.size());
+    for (const TransactionReceiptInfo& receipt : receipts) {
+        ss << receipt.transactionHash << receipt.transactionIndex << receipt.outputIndex;
+        WriteFixedHash(ss, receipt.from);
+        WriteFixedHash(ss, receipt.to);
+        ss << receipt.cumulativeGasUsed << receipt.gasUsed;
+        WriteFixedHash(ss, receipt.contractAddress);
+        ss << (uint32_t)receipt.excepted << receipt.exceptedMessage;
+        WriteFixedHash(ss, receipt.stateRoot);
+        WriteFixedHash(ss, receipt.utxoRoot);
+        WriteCompactSize(ss, receipt.logs.size());
+        for (const dev::eth::LogEntry& log : receipt.logs)
+            SerializeLogEntry(ss, log);
+    }
+}
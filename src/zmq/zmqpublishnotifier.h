@@ -6,8 +6,19 @@
 #define BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
 
 #include <zmq/zmqabstractnotifier.h>
+#include <uint256.h>
+
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
 
 class CBlockIndex;
+class CDataStream;
+struct TransactionReceiptInfo;
+
+/** Number of recently connected blocks whose message is kept to be published again if the block is disconnected */
+static const size_t ZMQ_RECEIPT_REORG_CACHE = 100;
 
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
@@ -52,4 +63,44 @@ public:
     bool NotifyTransaction(const CTransaction &transaction) override;
 };
 
+/**
+ * Publishes the contract execution results of every block connected to the active chain
+ * in one message, and again with the removed flag set when the block is disconnected.
+ * The receipts are read and serialized once per block whatever the number of subscribers.
+ * Requires -logevents.
+ */
+class CZMQAbstractReceiptNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex) override;
+    bool NotifyBlockDisconnected(const CBlock &block) override;
+
+protected:
+    virtual const char* GetCommand() const = 0;
+    virtual void SerializeReceipts(CDataStream &ss, const std::vector<TransactionReceiptInfo> &receipts) const = 0;
+
+private:
+    bool Publish(bool fRemoved, const uint256 &hash, int nHeight, const std::vector<char> &body);
+
+    //! Serialized receipts of the recently connected blocks, by block hash
+    std::map<uint256, std::pair<int, std::vector<char>>> mapRecent;
+    std::deque<uint256> recentOrder;
+    //! Blocks disconnected before their connect notification ran, neither is published
+    std::set<uint256> setSkipped;
+};
+
+class CZMQPublishContractLogsNotifier : public CZMQAbstractReceiptNotifier
+{
+protected:
+    const char* GetCommand() const override;
+    void SerializeReceipts(CDataStream &ss, const std::vector<TransactionReceiptInfo> &receipts) const override;
+};
+
+class CZMQPublishRawReceiptNotifier : public CZMQAbstractReceiptNotifier
+{
+protected:
+    const char* GetCommand() const override;
+    void SerializeReceipts(CDataStream &ss, const std::vector<TransactionReceiptInfo> &receipts) const override;
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
@@ -103,10 +103,18 @@ class MempoolPersistTest(BitcoinTestFramework):
         wait_until(lambda: self.nodes[0].getmempoolinfo()["loaded"])
         assert_equal(len(self.nodes[0].getrawmempool()), 0)
 
-        self.log.debug("Stop-start node0. Verify that it has the transactions in its mempool.")
+        self.log.debug("Stop-start node0. Verify that it has the transactions in its mempool, restored from the snapshot on the same tip.")
         self.stop_nodes()
-        self.start_node(0)
-        wait_until(lambda: self.nodes[0].getmempoolinfo()["loaded"])
+        with self.nodes[0].assert_debug_log(['5 succeeded (5 restored from the snapshot)']):
+            self.start_node(0)
+            wait_until(lambda: self.nodes[0].getmempoolinfo()["loaded"])
+        assert_equal(len(self.nodes[0].getrawmempool()), 5)
+
+        self.log.debug("Stop-start node0 with another policy setting. Verify that the snapshot is validated again.")
+        self.stop_nodes()
+        with self.nodes[0].assert_debug_log(['taken with other policy settings', '5 succeeded (0 restored from the snapshot)']):
+            self.start_node(0, extra_args=["-datacarriersize=40"])
+            wait_until(lambda: self.nodes[0].getmempoolinfo()["loaded"])
         assert_equal(len(self.nodes[0].getrawmempool()), 5)
 
         mempooldat0 = os.path.join(self.nodes[0].datadir, 'regtest', 'mempool.dat')
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+# Copyright (c) 2020 The Metrix Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the per-peer block download window.
+
+Two peers announce the same chain to a fresh node. The slow peer delivers one
+block every SLOW_DELAY seconds, the fast peer answers immediately. Check that the
+node syncs the chain, measures the slow peer by the time its blocks arrive and
+keeps downloading from it.
+"""
+
+from test_framework.blocktools import create_block, create_coinbase
+from test_framework.messages import CBlockHeader, MSG_BLOCK, MSG_TYPE_MASK, msg_block, msg_headers
+from test_framework.mininode import NetworkThread, P2PDataStore, mininode_lock
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_greater_than, wait_until
+
+NUM_BLOCKS = 64
+SLOW_DELAY = 0.5
+
+
+class SlowBlockStore(P2PDataStore):
+    """Serves the blocks of its store one at a time, SLOW_DELAY seconds apart."""
+
+    def __init__(self):
+        super().__init__()
+        self.next_free = 0
+
+    def on_getdata(self, message):
+        loop = NetworkThread.network_event_loop
+        for inv in message.inv:
+            self.getdata_requests.append(inv.hash)
+            if (inv.type & MSG_TYPE_MASK) == MSG_BLOCK and inv.hash in self.block_store:
+                self.next_free = max(self.next_free, loop.time()) + SLOW_DELAY
+                loop.call_at(self.next_free, self.send_message, msg_block(self.block_store[inv.hash]))
+
+
+class BlockDownloadWindowTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def run_test(self):
+        node = self.nodes[0]
+        tip = int(node.getbestblockhash(), 16)
+        block_time = node.getblock(node.getbestblockhash())["time"] + 1
+        blocks = []
+        for height in range(1, NUM_BLOCKS + 1):
+            block = create_block(tip, create_coinbase(height), block_time)
+            block.solve()
+            blocks.append(block)
+            tip = block.sha256
+            block_time += 1
+
+        slow = node.add_p2p_connection(SlowBlockStore())
+        fast = node.add_p2p_connection(P2PDataStore())
+        for peer in (slow, fast):
+            for block in blocks:
+                peer.block_store[block.sha256] = block
+            peer.last_block_hash = blocks[-1].sha256
+
+        self.log.info("Announce the chain from the slow peer first, so it is asked for the start of the chain")
+        slow.send_message(msg_headers([CBlockHeader(b) for b in blocks]))
+        slow.sync_with_ping()
+        fast.send_message(msg_headers([CBlockHeader(b) for b in blocks]))
+        fast.sync_with_ping()
+
+        self.log.info("Sync the chain from both peers")
+        wait_until(lambda: node.getbestblockhash() == blocks[-1].hash, timeout=NUM_BLOCKS * SLOW_DELAY + 60)
+        with mininode_lock:
+            assert_greater_than(len(slow.getdata_requests), 0)
+            assert_greater_than(len(fast.getdata_requests), 0)
+
+        self.log.info("Check the slow peer is measured by when its blocks arrived")
+        peers = node.getpeerinfo()
+        assert_equal(len(peers), 2)
+        slow_info, fast_info = peers
+        assert_greater_than(slow_info["blocksdownloaded"], 0)
+        assert_greater_than(fast_info["blocksdownloaded"], 0)
+        assert_greater_than(slow_info["blocktime"], SLOW_DELAY / 2)
+        assert_greater_than(slow_info["blocktime"], fast_info["blocktime"])
+        assert_greater_than(slow_info["blockdownloadtime"], SLOW_DELAY / 2)
+        assert_greater_than(fast_info["blocksdownloaded"], slow_info["blocksdownloaded"])
+
+
+if __name__ == '__main__':
+    BlockDownloadWindowTest().main()
@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+# Copyright (c) 2015-2016 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+from test_framework.qtumconfig import *
+from test_framework.test_node import ErrorMatch
+import os
+import shutil
+
+class QtumStateSnapshotTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        self.nodes[0].generate(COINBASE_MATURITY+50)
+        # constructor stores 1 in slot 0, the contract has no code
+        self.nodes[0].createcontract("600160005500")
+        """
+        pragma solidity ^0.4.10;
+        contract Example {
+            function () payable {}
+        }
+        """
+        payable_contract = self.nodes[0].createcontract("60606040523415600b57fe5b5b60398060196000396000f30060606040525b600b5b5b565b0000a165627a7a7230582092926a9814888ff08700cbd86cf4ff8c50052f5fd894e794570d9551733591d60029")['address']
+        self.nodes[0].generate(1)
+        old_height = self.nodes[0].getblockcount()
+        self.nodes[0].sendtocontract(payable_contract, "00", 10)
+        self.nodes[0].generate(1)
+
+        height = self.nodes[0].getblockcount()
+        dump = self.nodes[0].dumpcontractstate("state.dat")
+        assert_equal(dump['height'], height)
+        assert_equal(dump['blockhash'], self.nodes[0].getblockhash(height))
+        assert_equal(dump['hashStateRoot'], self.nodes[0].getblock(dump['blockhash'])['hashStateRoot'])
+        assert_equal(dump['hashUTXORoot'], self.nodes[0].getblock(dump['blockhash'])['hashUTXORoot'])
+        assert(dump['nodes'] > 0)
+        assert(dump['preimages'] >= 2)
+        assert(os.path.isfile(dump['path']))
+        assert(not os.path.exists(dump['path'] + ".incomplete"))
+        assert_raises_rpc_error(-8, "already exists", self.nodes[0].dumpcontractstate, "state.dat")
+
+        # the state of an older block is still there without -prunestate
+        old = self.nodes[0].dumpcontractstate("state_old.dat", old_height)
+        assert_equal(old['blockhash'], self.nodes[0].getblockhash(old_height))
+        assert(old['hashStateRoot'] != dump['hashStateRoot'])
+        assert_raises_rpc_error(-32602, "Incorrect block number", self.nodes[0].dumpcontractstate, "state_future.dat", height + 1)
+
+        self.log.info("Resume from the snapshot after the contract state was lost")
+        account = self.nodes[0].getaccountinfo(payable_contract)
+        self.stop_node(0)
+        shutil.rmtree(os.path.join(self.nodes[0].datadir, self.chain, "stateQtum"))
+        self.nodes[0].assert_start_raises_init_error([], "The contract state of the chain tip is missing", match=ErrorMatch.PARTIAL_REGEX)
+        self.nodes[0].assert_start_raises_init_error(["-loadcontractstate=state_old.dat"], "the snapshot is of block %s" % old['blockhash'], match=ErrorMatch.PARTIAL_REGEX)
+        self.start_node(0, ["-loadcontractstate=state.dat"])
+        assert_equal(self.nodes[0].getaccountinfo(payable_contract), account)
+        self.nodes[0].sendtocontract(payable_contract, "00", 10)
+        self.nodes[0].generate(1)
+        assert_equal(self.nodes[0].getaccountinfo(payable_contract)['balance'], account['balance'] + 10 * 100000000)
+
+if __name__ == '__main__':
+    QtumStateSnapshotTest().main()
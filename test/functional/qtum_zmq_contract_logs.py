@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+# Copyright (c) 2015-2016 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the contractlogs and rawreceipt ZMQ notifications."""
+import struct
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+from test_framework.messages import deser_compact_size, deser_string
+from test_framework.qtumconfig import *
+from io import BytesIO
+from time import sleep
+
+TOPIC = "00000000000000000000000000000000000000000000000000000000000000c0"
+
+def receive(socket, topic):
+    msg_topic, body, seq = socket.recv_multipart()
+    assert_equal(msg_topic, topic)
+    f = BytesIO(body)
+    removed = struct.unpack("<?", f.read(1))[0]
+    blockhash = f.read(32)[::-1].hex()
+    height = struct.unpack("<i", f.read(4))[0]
+    return removed, blockhash, height, f
+
+def deser_log(f):
+    address = f.read(20).hex()
+    topics = [f.read(32).hex() for i in range(deser_compact_size(f))]
+    data = deser_string(f).hex()
+    return address, topics, data
+
+class QtumZMQContractLogsTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.address = 'tcp://127.0.0.1:28334'
+        self.extra_args = [['-logevents', '-zmqpubcontractlogs=%s' % self.address, '-zmqpubrawreceipt=%s' % self.address]]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_py3_zmq()
+        self.skip_if_no_bitcoind_zmq()
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        import zmq
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY+10)
+
+        self.ctx = zmq.Context()
+        try:
+            socket = self.ctx.socket(zmq.SUB)
+            socket.set(zmq.RCVTIMEO, 60000)
+            socket.setsockopt(zmq.SUBSCRIBE, b"contractlogs")
+            socket.setsockopt(zmq.SUBSCRIBE, b"rawreceipt")
+            socket.connect(self.address)
+            # Relax so that the subscriber is ready before publishing zmq messages
+            sleep(0.2)
+
+            # The constructor emits LOG1 with TOPIC and no data, the contract has no code
+            contract = node.createcontract("7f" + TOPIC + "60006000a100")
+            blockhash = node.generate(1)[0]
+            height = node.getblockcount()
+
+            self.log.info("Receive the logs of the connected block")
+            removed, msg_blockhash, msg_height, f = receive(socket, b"contractlogs")
+            assert_equal((removed, msg_blockhash, msg_height), (False, blockhash, height))
+            assert_equal(deser_compact_size(f), 1)
+            assert_equal(f.read(32)[::-1].hex(), contract['txid'])
+            assert_equal(struct.unpack("<I", f.read(4))[0], 0)
+            assert_equal(deser_log(f), (contract['address'], [TOPIC], ""))
+
+            self.log.info("Receive the receipts of the connected block")
+            removed, msg_blockhash, msg_height, f = receive(socket, b"rawreceipt")
+            assert_equal((removed, msg_blockhash, msg_height), (False, blockhash, height))
+            assert_equal(deser_compact_size(f), 1)
+            txid = f.read(32)[::-1].hex()
+            transaction_index, output_index = struct.unpack("<II", f.read(8))
+            sender, receiver = f.read(20).hex(), f.read(20).hex()
+            cumulative_gas_used, gas_used = struct.unpack("<QQ", f.read(16))
+            contract_address = f.read(20).hex()
+            excepted = struct.unpack("<I", f.read(4))[0]
+            assert_equal(txid, contract['txid'])
+            assert_equal(transaction_index, node.getblock(blockhash)['tx'].index(txid))
+            assert_equal(contract_address, contract['address'])
+            assert_equal(sender, contract['hash160'])
+            assert_equal(excepted, 0)
+            assert(gas_used > 0)
+            receipt = node.gettransactionreceipt(txid)[0]
+            assert_equal(gas_used, receipt['gasUsed'])
+            assert_equal(cumulative_gas_used, receipt['cumulativeGasUsed'])
+
+            self.log.info("Receive the logs again with the removed flag when the block is disconnected")
+            node.invalidateblock(blockhash)
+            removed, msg_blockhash, msg_height, f = receive(socket, b"contractlogs")
+            assert_equal((removed, msg_blockhash, msg_height), (True, blockhash, height))
+            assert_equal(deser_compact_size(f), 1)
+            f.read(36)
+            assert_equal(deser_log(f), (contract['address'], [TOPIC], ""))
+            removed, msg_blockhash, msg_height, f = receive(socket, b"rawreceipt")
+            assert_equal((removed, msg_blockhash), (True, blockhash))
+            assert_equal(deser_compact_size(f), 1)
+
+            assert_equal(sorted(n['type'] for n in node.getzmqnotifications()), ["pubcontractlogs", "pubrawreceipt"])
+        finally:
+            self.ctx.destroy(linger=None)
+
+        self.log.info("The notifications require -logevents")
+        self.stop_node(0)
+        node.assert_start_raises_init_error(['-zmqpubcontractlogs=%s' % self.address], "Error: -zmqpubcontractlogs and -zmqpubrawreceipt require -logevents.")
+
+if __name__ == '__main__':
+    QtumZMQContractLogsTest().main()
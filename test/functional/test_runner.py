@@ -100,6 +100,7 @@ BASE_SCRIPTS = [
     'wallet_listtransactions.py',
     # vv Tests less than 60s vv
     'p2p_sendheaders.py',
+    'p2p_block_download_window.py',
     'wallet_zapwallettxes.py',
     'wallet_importmulti.py',
     'mempool_limit.py',
@@ -269,7 +270,9 @@ BASE_SCRIPTS = [
     'qtum_evm_staticcall.py',
     'qtum_evm_constantinople_precompiles.py',
     'qtum_evm_constantinople_opcodes.py',
-    'qtum_block_index_cleanup.py'
+    'qtum_block_index_cleanup.py',
+    'qtum_state_snapshot.py',
+    'qtum_zmq_contract_logs.py'
 ]
 
 # Place EXTENDED_SCRIPTS first since it has the 3 longest running tests